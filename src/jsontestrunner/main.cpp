@@ -16,6 +16,7 @@
 struct options {
     std::string path;
     json::features features;
+    std::string engine; // use char_reader_builder with this engine, if set
     bool parse_only;
     typedef std::string (*write_func)(json::value const&);
     write_func write;
@@ -133,19 +134,44 @@ print_value_tree(FILE* fout, json::value& value, std::string const& path = ".")
     }
 }
 
+static bool parse_with_builder(std::string const& input,
+    json::features const& features,
+    std::string const& engine,
+    json::value* root,
+    std::string* errs)
+{
+    json::char_reader_builder builder;
+    if (features.strict_root_)
+        json::char_reader_builder::strict_mode(&builder.settings_);
+    builder["engine"] = engine;
+    json::char_reader* reader(builder.new_char_reader());
+    bool ok = reader->parse(input.data(), input.data() + input.size(), root, errs);
+    delete reader;
+    return ok;
+}
+
 static int parseAndSaveValueTree(std::string const& input,
     std::string const& actual,
     std::string const& kind,
     json::features const& features,
+    std::string const& engine,
     bool parse_only,
     json::value* root)
 {
-    json::reader reader(features);
-    bool parsing_successful = reader.parse(input, *root);
+    bool parsing_successful;
+    std::string errs;
+    if (engine.empty()) {
+        json::reader reader(features);
+        parsing_successful = reader.parse(input, *root);
+        errs = reader.get_formatted_messages();
+    }
+    else {
+        parsing_successful = parse_with_builder(input, features, engine, root, &errs);
+    }
     if (!parsing_successful) {
         printf("Failed to parse %s file: \n%s\n",
             kind.c_str(),
-            reader.get_formatted_messages().c_str());
+            errs.c_str());
         return 1;
     }
     if (!parse_only) {
@@ -224,7 +250,7 @@ static void print_config()
 
 static int print_usage(const char* argv[])
 {
-    printf("Usage: %s [--strict] input-json-file\n", argv[0]);
+    printf("Usage: %s [--json-checker] [--json-writer writer] [--json-engine engine] input-json-file\n", argv[0]);
     return 3;
 }
 
@@ -263,6 +289,10 @@ static int parse_cmdline(
             return 4;
         }
     }
+    if (index < argc && std::string(argv[index]) == "--json-engine") {
+        ++index;
+        opts->engine = argv[index++];
+    }
     if (index == argc || index + 1 < argc) {
         return print_usage(argv);
     }
@@ -294,7 +324,7 @@ static int run_test(options const& opts)
     json::value root;
     exitCode = parseAndSaveValueTree(
         input, actual_path, "input",
-        opts.features, opts.parse_only, &root);
+        opts.features, opts.engine, opts.parse_only, &root);
     if (exitCode || opts.parse_only) {
         return exitCode;
     }
@@ -306,7 +336,7 @@ static int run_test(options const& opts)
     json::value rewriteRoot;
     exitCode = parseAndSaveValueTree(
         rewrite, rewrite_actual_path, "rewrite",
-        opts.features, opts.parse_only, &rewriteRoot);
+        opts.features, opts.engine, opts.parse_only, &rewriteRoot);
     if (exitCode) {
         return exitCode;
     }
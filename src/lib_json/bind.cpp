@@ -0,0 +1,235 @@
+// Derived from public-domain/MIT-licensed code at
+// https://github.com/open-source-parsers/jsoncpp. Thanks, Baptiste Lepilleur!
+
+#include "bind.h"
+#include <cstring>
+
+namespace json {
+
+// Class key_table
+// //////////////////////////////////////////////////////////////////
+
+static uint32_t hash_key(uint32_t seed, char const* begin, char const* end)
+{
+    // FNV-1a, starting from the seed.
+    uint32_t hash = 2166136261u ^ seed;
+    for (char const* current = begin; current != end; ++current) {
+        hash ^= static_cast<unsigned char>(*current);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+key_table::key_table()
+    : seed_(0)
+    , mask_(0)
+{
+}
+
+void key_table::add(char const* name)
+{
+    names_.push_back(name);
+    rehash();
+}
+
+// Try seeds until every name has a slot of its own, growing the table when
+// that takes too long. With at least twice as many slots as names, a few
+// tries are usually enough.
+void key_table::rehash()
+{
+    size_t size = 1;
+    while (size < 2 * names_.size())
+        size *= 2;
+    for (;;) {
+        for (uint32_t seed = 0; seed != 64; ++seed) {
+            slots_.assign(size, -1);
+            bool collided = false;
+            for (size_t index = 0; index != names_.size() && !collided; ++index) {
+                std::string const& name = names_[index];
+                int& slot = slots_[hash_key(seed, name.data(), name.data() + name.size()) & (size - 1)];
+                if (slot >= 0) {
+                    // Names listed twice keep the first slot.
+                    collided = names_[slot] != name;
+                }
+                else {
+                    slot = int(index);
+                }
+            }
+            if (!collided) {
+                seed_ = seed;
+                mask_ = uint32_t(size - 1);
+                return;
+            }
+        }
+        size *= 2;
+    }
+}
+
+int key_table::find(char const* begin, char const* end) const
+{
+    if (slots_.empty())
+        return -1;
+    int index = slots_[hash_key(seed_, begin, end) & mask_];
+    if (index < 0)
+        return -1;
+    std::string const& name = names_[index];
+    size_t length = end - begin;
+    if (name.size() != length || memcmp(name.data(), begin, length) != 0)
+        return -1;
+    return index;
+}
+
+// Reading
+// //////////////////////////////////////////////////////////////////
+
+// Numbers are decoded into a #value, which does not allocate for them.
+static bool read_number(cursor& in, value& number)
+{
+    if (in.event() != et_number)
+        return in.fail("Expected a number");
+    return in.get_value(&number);
+}
+
+bool read_bound(cursor& in, bool& out)
+{
+    if (in.event() != et_bool)
+        return in.fail("Expected a boolean");
+    out = in.as_bool();
+    return true;
+}
+
+bool read_bound(cursor& in, int32_t& out)
+{
+    value number;
+    if (!read_number(in, number))
+        return false;
+    if (!number.is_int())
+        return in.fail("Number out of range for int32_t");
+    out = number.as_int();
+    return true;
+}
+
+bool read_bound(cursor& in, uint32_t& out)
+{
+    value number;
+    if (!read_number(in, number))
+        return false;
+    if (!number.is_uint())
+        return in.fail("Number out of range for uint32_t");
+    out = number.as_uint();
+    return true;
+}
+
+#if defined(JSON_HAS_INT64)
+bool read_bound(cursor& in, int64_t& out)
+{
+    value number;
+    if (!read_number(in, number))
+        return false;
+    if (!number.is_int64())
+        return in.fail("Number out of range for int64_t");
+    out = number.as_int64();
+    return true;
+}
+
+bool read_bound(cursor& in, uint64_t& out)
+{
+    value number;
+    if (!read_number(in, number))
+        return false;
+    if (!number.isUInt64())
+        return in.fail("Number out of range for uint64_t");
+    out = number.as_uint64();
+    return true;
+}
+#endif // if defined(JSON_HAS_INT64)
+
+bool read_bound(cursor& in, float& out)
+{
+    value number;
+    if (!read_number(in, number))
+        return false;
+    out = number.as_float();
+    return true;
+}
+
+bool read_bound(cursor& in, double& out)
+{
+    value number;
+    if (!read_number(in, number))
+        return false;
+    out = number.as_double();
+    return true;
+}
+
+bool read_bound(cursor& in, std::string& out)
+{
+    if (in.event() != et_string)
+        return in.fail("Expected a string");
+    char const* str;
+    char const* end;
+    if (!in.get_string(&str, &end))
+        return false;
+    out.assign(str, end); // reuses the capacity of 'out'
+    return true;
+}
+
+bool read_bound(cursor& in, value& out)
+{
+    return in.get_value(&out);
+}
+
+bool read_bound(cursor& in, std::vector<bool>& out)
+{
+    if (in.event() != et_begin_array)
+        return in.fail("Expected an array");
+    out.clear();
+    for (;;) {
+        event_type event = in.next();
+        if (event == et_end_array)
+            return true;
+        bool element;
+        if (event == et_error || !read_bound(in, element))
+            return false;
+        out.push_back(element);
+    }
+}
+
+// Writing
+// //////////////////////////////////////////////////////////////////
+
+void write_bound(std::ostream& out, bool in) { out << (in ? "true" : "false"); }
+
+void write_bound(std::ostream& out, int32_t in)
+{
+    out << value_to_string(largest_int_t(in));
+}
+
+void write_bound(std::ostream& out, uint32_t in)
+{
+    out << value_to_string(largest_uint_t(in));
+}
+
+#if defined(JSON_HAS_INT64)
+void write_bound(std::ostream& out, int64_t in) { out << value_to_string(in); }
+
+void write_bound(std::ostream& out, uint64_t in) { out << value_to_string(in); }
+#endif // if defined(JSON_HAS_INT64)
+
+void write_bound(std::ostream& out, float in) { out << value_to_string(double(in)); }
+
+void write_bound(std::ostream& out, double in) { out << value_to_string(in); }
+
+void write_bound(std::ostream& out, std::string const& in)
+{
+    out << value_to_quoted_string(in.data(), static_cast<unsigned>(in.size()));
+}
+
+void write_bound(std::ostream& out, value const& in)
+{
+    fast_writer writer;
+    writer.omit_ending_line_feed();
+    out << writer.write(in);
+}
+
+} // namespace json
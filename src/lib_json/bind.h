@@ -0,0 +1,304 @@
+// Derived from public-domain/MIT-licensed code at
+// https://github.com/open-source-parsers/jsoncpp. Thanks, Baptiste Lepilleur!
+
+#pragma once
+
+#include "cursor.h"
+#include "reader.h"
+#include "writer.h"
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Disable warning C4251: <data member>: <type> needs to have dll-interface to
+// be used by...
+#if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+#pragma warning(push)
+#pragma warning(disable : 4251)
+#endif // if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+
+namespace json {
+
+/** \brief Maps a C++ struct to a JSON object, member by member.
+ *
+ * Specialize it for each struct, listing the name and the pointer of every
+ * member that is read and written:
+ * \code
+ * struct point {
+ *   int32_t x;
+ *   int32_t y;
+ *   std::string label;
+ *   std::vector<point> links;
+ * };
+ *
+ * namespace json {
+ * template <>
+ * struct bind<point> {
+ *   template <typename Fields>
+ *   static void fields(Fields& f)
+ *   {
+ *     f("x", &point::x);
+ *     f("y", &point::y);
+ *     f("label", &point::label);
+ *     f("links", &point::links);
+ *   }
+ * };
+ * }
+ *
+ * point p;
+ * std::string errs;
+ * bool ok = json::parse_bound(builder, begin, end, &p, &errs);
+ * json::write_bound(std::cout, p);
+ * \endcode
+ *
+ * parse_bound() reads with a \ref cursor, straight into the members: no #value
+ * is built, and member names are looked up in a perfect hash table made once
+ * per struct. Members may have the types bool, int32_t, uint32_t, int64_t,
+ * uint64_t, float, double, std::string, #value, std::vector of any of these,
+ * or another struct with a bind specialization.
+ *
+ * - Members of the document that are not listed are skipped.
+ * - Listed members missing from the document, or null in it, keep their value.
+ * - A value of the wrong type, or a number out of range, is an error.
+ *
+ * write_bound() writes every listed member, in order, without whitespace.
+ */
+template <typename T>
+struct bind;
+
+/** \brief Perfect hash table of member names.
+ *
+ * Names are hashed with a seed that is chosen, when the table is built, so
+ * that no two of them share a slot. A lookup thus hashes the name and
+ * compares it with at most one entry.
+ */
+class JSON_API key_table {
+public:
+	key_table();
+
+	/// Add a name; it gets the next index, starting at 0.
+	void add(char const* name);
+
+	/// \return the index of the name [begin, end), or -1.
+	int find(char const* begin, char const* end) const;
+
+private:
+	void rehash();
+
+	std::vector<std::string> names_;
+	std::vector<int> slots_; // index in names_, or -1
+	uint32_t seed_;
+	uint32_t mask_;
+};
+
+/** \name Reading one value from a cursor
+ * The cursor is on the event of the value (after next()); on return it is on
+ * the last event of the value. On error the cursor is left at et_error.
+ */
+///@{
+bool JSON_API read_bound(cursor& in, bool& out);
+bool JSON_API read_bound(cursor& in, int32_t& out);
+bool JSON_API read_bound(cursor& in, uint32_t& out);
+#if defined(JSON_HAS_INT64)
+bool JSON_API read_bound(cursor& in, int64_t& out);
+bool JSON_API read_bound(cursor& in, uint64_t& out);
+#endif // if defined(JSON_HAS_INT64)
+bool JSON_API read_bound(cursor& in, float& out);
+bool JSON_API read_bound(cursor& in, double& out);
+bool JSON_API read_bound(cursor& in, std::string& out);
+bool JSON_API read_bound(cursor& in, value& out);
+bool JSON_API read_bound(cursor& in, std::vector<bool>& out);
+template <typename T>
+bool read_bound(cursor& in, std::vector<T>& out);
+template <typename T>
+bool read_bound(cursor& in, T& out);
+///@}
+
+/** \name Writing one value
+ */
+///@{
+void JSON_API write_bound(std::ostream& out, bool in);
+void JSON_API write_bound(std::ostream& out, int32_t in);
+void JSON_API write_bound(std::ostream& out, uint32_t in);
+#if defined(JSON_HAS_INT64)
+void JSON_API write_bound(std::ostream& out, int64_t in);
+void JSON_API write_bound(std::ostream& out, uint64_t in);
+#endif // if defined(JSON_HAS_INT64)
+void JSON_API write_bound(std::ostream& out, float in);
+void JSON_API write_bound(std::ostream& out, double in);
+void JSON_API write_bound(std::ostream& out, std::string const& in);
+void JSON_API write_bound(std::ostream& out, value const& in);
+template <typename T>
+void write_bound(std::ostream& out, std::vector<T> const& in);
+template <typename T>
+void write_bound(std::ostream& out, T const& in);
+///@}
+
+/** \brief Parse a document straight into 'root', through \ref bind.
+
+ Honors the settings of 'builder', except collect_comments.
+ Error messages are those of char_reader::parse(), plus those of type
+ mismatches.
+
+ \param root [out] Members read before an error keep their new values.
+ \param errs [out] Formatted error messages (if not NULL).
+ \return true if the document was successfully parsed.
+*/
+template <typename T>
+bool parse_bound(
+	char_reader_builder const& builder,
+	char const* begin_doc, char const* end_doc,
+	T* root, std::string* errs)
+{
+	cursor in(builder);
+	in.reset(begin_doc, end_doc);
+	bool ok = in.next() != et_error && read_bound(in, *root)
+		&& in.next() == et_end_of_stream;
+	if (errs)
+		*errs = in.get_formatted_messages();
+	return ok;
+}
+
+/// Members of struct T, in the order of bind<T>::fields().
+template <typename T>
+class bound_struct {
+public:
+	static bound_struct const& get()
+	{
+		static bound_struct const instance; // thread-safe in C++11
+		return instance;
+	}
+
+	bool read(cursor& in, T& out) const
+	{
+		if (in.event() != et_begin_object)
+			return in.fail("Expected an object");
+		while (in.next() == et_key) {
+			char const* name;
+			char const* end;
+			int index = in.get_string(&name, &end) ? keys_.find(name, end) : -1;
+			if (in.event() == et_error)
+				return false;
+			if (index < 0) {
+				if (!in.skip())
+					return false;
+				continue;
+			}
+			if (in.next() == et_error || !fields_[index]->read(in, out))
+				return false;
+		}
+		return in.event() == et_end_object;
+	}
+
+	void write(std::ostream& out, T const& in) const
+	{
+		out << '{';
+		for (size_t index = 0; index != fields_.size(); ++index) {
+			if (index)
+				out << ',';
+			out << quoted_names_[index];
+			fields_[index]->write(out, in);
+		}
+		out << '}';
+	}
+
+private:
+	struct field {
+		virtual ~field() {}
+		virtual bool read(cursor& in, T& out) const = 0;
+		virtual void write(std::ostream& out, T const& in) const = 0;
+	};
+
+	template <typename M>
+	struct member : field {
+		explicit member(M T::*pointer)
+		    : pointer_(pointer)
+		{
+		}
+		bool read(cursor& in, T& out) const
+		{
+			return in.event() == et_null || read_bound(in, out.*pointer_);
+		}
+		void write(std::ostream& out, T const& in) const
+		{
+			write_bound(out, in.*pointer_);
+		}
+		M T::*pointer_;
+	};
+
+	struct collector {
+		bound_struct* owner_;
+		template <typename M>
+		void operator()(char const* name, M T::*pointer)
+		{
+			owner_->keys_.add(name);
+			owner_->quoted_names_.push_back(value_to_quoted_string(name) + ':');
+			owner_->fields_.push_back(new member<M>(pointer));
+		}
+	};
+
+	bound_struct()
+	{
+		collector fields = { this };
+		bind<T>::fields(fields);
+	}
+	~bound_struct()
+	{
+		for (size_t index = 0; index != fields_.size(); ++index)
+			delete fields_[index];
+	}
+	bound_struct(bound_struct const&); // no impl
+	void operator=(bound_struct const&); // no impl
+
+	key_table keys_;
+	std::vector<std::string> quoted_names_;
+	std::vector<field*> fields_;
+};
+
+template <typename T>
+bool read_bound(cursor& in, std::vector<T>& out)
+{
+	if (in.event() != et_begin_array)
+		return in.fail("Expected an array");
+	out.clear();
+	for (;;) {
+		event_type event = in.next();
+		if (event == et_end_array)
+			return true;
+		if (event == et_error)
+			return false;
+		out.resize(out.size() + 1);
+		if (!read_bound(in, out.back()))
+			return false;
+	}
+}
+
+template <typename T>
+bool read_bound(cursor& in, T& out)
+{
+	return bound_struct<T>::get().read(in, out);
+}
+
+template <typename T>
+void write_bound(std::ostream& out, std::vector<T> const& in)
+{
+	out << '[';
+	for (size_t index = 0; index != in.size(); ++index) {
+		if (index)
+			out << ',';
+		write_bound(out, in[index]);
+	}
+	out << ']';
+}
+
+template <typename T>
+void write_bound(std::ostream& out, T const& in)
+{
+	bound_struct<T>::get().write(out, in);
+}
+
+} // namespace json
+
+#if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+#pragma warning(pop)
+#endif // if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
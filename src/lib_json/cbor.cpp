@@ -0,0 +1,618 @@
+// Derived from public-domain/MIT-licensed code at
+// https://github.com/open-source-parsers/jsoncpp. Thanks, Baptiste Lepilleur!
+
+#include "cbor.h"
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <set>
+#include <sstream>
+
+namespace json {
+
+// Major types of the initial byte of a data item, in its top three bits.
+enum cbor_major {
+    cm_unsigned = 0,
+    cm_negative = 1,
+    cm_bytes = 2,
+    cm_text = 3,
+    cm_array = 4,
+    cm_map = 5,
+    cm_tag = 6,
+    cm_simple = 7
+};
+
+// Additional information (the low five bits) that is not a length.
+static unsigned char const cbor_indefinite = 31;
+static unsigned char const cbor_false = 20;
+static unsigned char const cbor_true = 21;
+static unsigned char const cbor_null = 22;
+static unsigned char const cbor_undefined = 23;
+static unsigned char const cbor_half = 25;
+static unsigned char const cbor_single = 26;
+static unsigned char const cbor_double = 27;
+static unsigned char const cbor_break = 0xff;
+
+static double half_to_double(uint16_t half)
+{
+    // RFC 8949, appendix D.
+    int exponent = (half >> 10) & 0x1f;
+    int mantissa = half & 0x3ff;
+    double result;
+    if (exponent == 0)
+        result = std::ldexp(double(mantissa), -24);
+    else if (exponent != 31)
+        result = std::ldexp(double(mantissa + 1024), exponent - 25);
+    else
+        result = mantissa == 0 ? std::numeric_limits<double>::infinity()
+                               : std::numeric_limits<double>::quiet_NaN();
+    return (half & 0x8000) ? -result : result;
+}
+
+// Set *half to the half precision float equal to 'number', if there is one.
+static bool double_to_half(double number, uint16_t* half)
+{
+    uint16_t sign = std::signbit(number) ? 0x8000 : 0;
+    double magnitude = std::fabs(number);
+    uint32_t bits;
+    if (magnitude == 0 || std::isinf(magnitude)) {
+        bits = magnitude == 0 ? 0 : 0x7c00;
+    }
+    else if (magnitude < std::ldexp(1.0, -14)) {
+        // Subnormal: a multiple of 2^-24.
+        double mantissa = std::ldexp(magnitude, 24);
+        if (mantissa != std::floor(mantissa))
+            return false;
+        bits = uint32_t(mantissa);
+    }
+    else if (magnitude <= 65504) {
+        int exponent;
+        double fraction = std::frexp(magnitude, &exponent); // in [0.5, 1)
+        double mantissa = std::ldexp(fraction, 11) - 1024;
+        if (mantissa != std::floor(mantissa))
+            return false;
+        bits = uint32_t(exponent + 14) << 10 | uint32_t(mantissa);
+    }
+    else {
+        return false;
+    }
+    *half = uint16_t(sign | bits);
+    return true;
+}
+
+// Class cbor_stream_writer
+// //////////////////////////////////////////////////////////////////
+
+class cbor_stream_writer : public stream_writer {
+public:
+    explicit cbor_stream_writer(bool compact_floats);
+    virtual int write(value const& root, std::ostream* sout);
+
+private:
+    void write_value(value const& value);
+    void write_head(int major, uint64_t argument);
+    void write_bytes(uint64_t bits, int size);
+    void write_double(double number);
+    void flush();
+
+    std::string buffer_;
+    bool compact_floats_;
+};
+
+// The buffer goes to the stream when it is this large, and at the end.
+static size_t const cbor_flush_size = 64 * 1024;
+
+cbor_stream_writer::cbor_stream_writer(bool compact_floats)
+    : compact_floats_(compact_floats)
+{
+}
+
+int cbor_stream_writer::write(value const& root, std::ostream* sout)
+{
+    sout_ = sout;
+    buffer_.clear();
+    write_value(root);
+    flush();
+    sout_ = NULL;
+    return 0;
+}
+
+void cbor_stream_writer::flush()
+{
+    sout_->write(buffer_.data(), std::streamsize(buffer_.size()));
+    buffer_.clear();
+}
+
+// Append the low 'size' bytes of 'bits', most significant first.
+void cbor_stream_writer::write_bytes(uint64_t bits, int size)
+{
+    char bytes[8];
+    for (int index = size - 1; index >= 0; --index) {
+        bytes[index] = char(bits & 0xff);
+        bits >>= 8;
+    }
+    buffer_.append(bytes, size_t(size));
+}
+
+// The initial byte, with the argument in the fewest bytes that hold it.
+void cbor_stream_writer::write_head(int major, uint64_t argument)
+{
+    char initial = char(major << 5);
+    if (argument < 24) {
+        buffer_ += char(initial | char(argument));
+    }
+    else if (argument <= 0xff) {
+        buffer_ += char(initial | 24);
+        write_bytes(argument, 1);
+    }
+    else if (argument <= 0xffff) {
+        buffer_ += char(initial | 25);
+        write_bytes(argument, 2);
+    }
+    else if (argument <= 0xffffffffu) {
+        buffer_ += char(initial | 26);
+        write_bytes(argument, 4);
+    }
+    else {
+        buffer_ += char(initial | 27);
+        write_bytes(argument, 8);
+    }
+}
+
+void cbor_stream_writer::write_double(double number)
+{
+    char const simple = char(cm_simple << 5);
+    if (compact_floats_) {
+        uint16_t half;
+        if (std::isnan(number)) {
+            buffer_ += char(simple | cbor_half);
+            write_bytes(0x7e00, 2);
+            return;
+        }
+        if (double_to_half(number, &half)) {
+            buffer_ += char(simple | cbor_half);
+            write_bytes(half, 2);
+            return;
+        }
+        // Converting a double out of the range of float is undefined.
+        if (std::fabs(number) <= std::numeric_limits<float>::max()
+            && double(float(number)) == number) {
+            float single = float(number);
+            uint32_t bits;
+            std::memcpy(&bits, &single, sizeof bits);
+            buffer_ += char(simple | cbor_single);
+            write_bytes(bits, 4);
+            return;
+        }
+    }
+    uint64_t bits;
+    std::memcpy(&bits, &number, sizeof bits);
+    buffer_ += char(simple | cbor_double);
+    write_bytes(bits, 8);
+}
+
+void cbor_stream_writer::write_value(value const& value)
+{
+    if (buffer_.size() >= cbor_flush_size)
+        flush();
+    switch (value.type()) {
+    case vt_null:
+        buffer_ += char(cm_simple << 5 | cbor_null);
+        break;
+    case vt_int: {
+        largest_int_t number = value.as_largest_int();
+        if (number >= 0)
+            write_head(cm_unsigned, uint64_t(number));
+        else
+            write_head(cm_negative, ~uint64_t(number)); // -1 - number
+    } break;
+    case vt_uint:
+        write_head(cm_unsigned, value.as_largest_uint());
+        break;
+    case vt_real:
+        write_double(value.as_double());
+        break;
+    case vt_string: {
+        char const* str;
+        char const* end;
+        if (!value.get_string(&str, &end))
+            str = end = ""; // a string value that was never given one
+        write_head(cm_text, uint64_t(end - str));
+        buffer_.append(str, size_t(end - str));
+    } break;
+    case vt_bool:
+        buffer_ += char(cm_simple << 5 | (value.as_bool() ? cbor_true : cbor_false));
+        break;
+    case vt_array: {
+        array_index size = value.size();
+        write_head(cm_array, size);
+        for (array_index index = 0; index < size; ++index)
+            write_value(value[index]);
+    } break;
+    case vt_object:
+        write_head(cm_map, value.size());
+        for (value::const_iterator it = value.begin(); it != value.end(); ++it) {
+            char const* end;
+            char const* name = it.member_name(&end);
+            write_head(cm_text, uint64_t(end - name));
+            buffer_.append(name, size_t(end - name));
+            write_value(*it);
+        }
+        break;
+    }
+}
+
+// Class cbor_char_reader
+// //////////////////////////////////////////////////////////////////
+
+class cbor_char_reader : public char_reader {
+public:
+    cbor_char_reader(int stack_limit, bool fail_if_extra, bool reject_dup_keys);
+    virtual bool parse(
+        char const* begin_doc, char const* end_doc,
+        value* root, std::string* errs);
+
+private:
+    bool read_value(value& value, int depth);
+    bool read_head(int* major, uint64_t* argument, bool* indefinite);
+    bool read_bytes(int size, uint64_t* bits);
+    bool read_string(int major, uint64_t length, bool indefinite,
+        char const** str, char const** end, std::string* chunks);
+    bool read_array(value& value, uint64_t length, bool indefinite, int depth);
+    bool read_map(value& value, uint64_t length, bool indefinite, int depth);
+    bool at_break();
+    bool add_error(std::string const& message, char const* location);
+
+    char const* begin_;
+    char const* end_;
+    char const* current_;
+    std::string error_;
+    int stack_limit_;
+    bool fail_if_extra_;
+    bool reject_dup_keys_;
+};
+
+cbor_char_reader::cbor_char_reader(int stack_limit, bool fail_if_extra, bool reject_dup_keys)
+    : begin_(NULL)
+    , end_(NULL)
+    , current_(NULL)
+    , stack_limit_(stack_limit)
+    , fail_if_extra_(fail_if_extra)
+    , reject_dup_keys_(reject_dup_keys)
+{
+}
+
+bool cbor_char_reader::parse(
+    char const* begin_doc, char const* end_doc,
+    value* root, std::string* errs)
+{
+    begin_ = begin_doc;
+    end_ = end_doc;
+    current_ = begin_doc;
+    error_.clear();
+    bool ok = read_value(*root, 0);
+    if (ok && fail_if_extra_ && current_ != end_)
+        ok = add_error("Extra data after the root item", current_);
+    if (errs)
+        *errs = error_;
+    return ok;
+}
+
+bool cbor_char_reader::add_error(std::string const& message, char const* location)
+{
+    std::ostringstream oss;
+    oss << "* Byte " << (location - begin_) << "\n  " << message << "\n";
+    error_ = oss.str();
+    return false;
+}
+
+bool cbor_char_reader::read_bytes(int size, uint64_t* bits)
+{
+    if (end_ - current_ < size)
+        return add_error("Unexpected end of data", current_);
+    uint64_t result = 0;
+    for (int index = 0; index != size; ++index)
+        result = result << 8 | static_cast<unsigned char>(*current_++);
+    *bits = result;
+    return true;
+}
+
+// Read the initial byte and the argument after it. For major type 7 the
+// argument is the bits of the simple value or float.
+bool cbor_char_reader::read_head(int* major, uint64_t* argument, bool* indefinite)
+{
+    if (current_ == end_)
+        return add_error("Unexpected end of data", current_);
+    unsigned char initial = static_cast<unsigned char>(*current_++);
+    *major = initial >> 5;
+    unsigned char info = initial & 0x1f;
+    *indefinite = false;
+    if (info < 24) {
+        *argument = info;
+        return true;
+    }
+    if (info < 28)
+        return read_bytes(1 << (info - 24), argument);
+    if (info == cbor_indefinite && *major >= cm_bytes && *major <= cm_map) {
+        *indefinite = true;
+        return true;
+    }
+    if (initial == cbor_break)
+        return add_error("Unexpected break", current_ - 1);
+    if (info == cbor_indefinite)
+        return add_error("Indefinite length outside a string, array or map", current_ - 1);
+    return add_error("Reserved additional information", current_ - 1);
+}
+
+bool cbor_char_reader::at_break()
+{
+    if (current_ != end_ && static_cast<unsigned char>(*current_) == cbor_break) {
+        ++current_;
+        return true;
+    }
+    return false;
+}
+
+bool cbor_char_reader::read_value(value& value, int depth)
+{
+    if (depth > stack_limit_)
+        throw_runtime_error("Exceeded stack_limit in read_value().");
+    char const* start = current_;
+    int major;
+    uint64_t argument;
+    bool indefinite;
+    if (!read_head(&major, &argument, &indefinite))
+        return false;
+    switch (major) {
+    case cm_unsigned:
+        if (argument <= uint64_t(json::value::max_largest_int))
+            json::value(largest_int_t(argument)).swap_payload(value);
+        else
+            json::value(largest_uint_t(argument)).swap_payload(value);
+        break;
+    case cm_negative:
+        if (argument > uint64_t(json::value::max_largest_int))
+            return add_error("Negative integer below the range of vt_int", start);
+        json::value(largest_int_t(~argument)).swap_payload(value); // -1 - argument
+        break;
+    case cm_bytes:
+    case cm_text: {
+        char const* str;
+        char const* end;
+        std::string chunks;
+        if (!read_string(major, argument, indefinite, &str, &end, &chunks))
+            return false;
+        json::value(str, end).swap_payload(value);
+    } break;
+    case cm_array:
+        if (!read_array(value, argument, indefinite, depth))
+            return false;
+        break;
+    case cm_map:
+        if (!read_map(value, argument, indefinite, depth))
+            return false;
+        break;
+    case cm_tag:
+        if (argument == 2 || argument == 3)
+            return add_error("Bignums are not supported", start);
+        if (!read_value(value, depth + 1))
+            return false;
+        break;
+    default: {
+        unsigned char info = static_cast<unsigned char>(*start) & 0x1f;
+        switch (info) {
+        case cbor_false:
+        case cbor_true:
+            json::value(info == cbor_true).swap_payload(value);
+            break;
+        case cbor_null:
+        case cbor_undefined:
+            json::value().swap_payload(value);
+            break;
+        case cbor_half:
+            json::value(half_to_double(uint16_t(argument))).swap_payload(value);
+            break;
+        case cbor_single: {
+            uint32_t bits = uint32_t(argument);
+            float single;
+            std::memcpy(&single, &bits, sizeof single);
+            json::value(double(single)).swap_payload(value);
+        } break;
+        case cbor_double: {
+            double number;
+            std::memcpy(&number, &argument, sizeof number);
+            json::value(number).swap_payload(value);
+        } break;
+        default:
+            return add_error("Unsupported simple value", start);
+        }
+    } break;
+    }
+    value.set_offset_start(size_t(start - begin_));
+    value.set_offset_limit(size_t(current_ - begin_));
+    return true;
+}
+
+// A definite string is left in place; the chunks of an indefinite one are
+// joined in 'chunks'.
+bool cbor_char_reader::read_string(int major, uint64_t length, bool indefinite,
+    char const** str, char const** end, std::string* chunks)
+{
+    if (!indefinite) {
+        if (uint64_t(end_ - current_) < length)
+            return add_error("Unexpected end of data", current_);
+        *str = current_;
+        current_ += length;
+        *end = current_;
+        return true;
+    }
+    while (!at_break()) {
+        char const* start = current_;
+        int chunk_major;
+        bool chunk_indefinite;
+        if (!read_head(&chunk_major, &length, &chunk_indefinite))
+            return false;
+        if (chunk_major != major || chunk_indefinite)
+            return add_error("Chunk of an indefinite-length string is not a definite string of its type", start);
+        if (uint64_t(end_ - current_) < length)
+            return add_error("Unexpected end of data", current_);
+        chunks->append(current_, size_t(length));
+        current_ += length;
+    }
+    *str = chunks->data();
+    *end = *str + chunks->size();
+    return true;
+}
+
+bool cbor_char_reader::read_array(value& value, uint64_t length, bool indefinite, int depth)
+{
+    json::value(vt_array).swap_payload(value);
+    if (indefinite) {
+        for (array_index index = 0; !at_break(); ++index) {
+            if (!read_value(value[index], depth + 1))
+                return false;
+        }
+        return true;
+    }
+    // Each item takes a byte at least, so a length beyond the data is an
+    // error rather than a reason to allocate.
+    if (uint64_t(end_ - current_) < length)
+        return add_error("Unexpected end of data", current_);
+    if (length)
+        value.resize(array_index(length));
+    for (array_index index = 0; index != length; ++index) {
+        if (!read_value(value[index], depth + 1))
+            return false;
+    }
+    return true;
+}
+
+bool cbor_char_reader::read_map(value& value, uint64_t length, bool indefinite, int depth)
+{
+    json::value(vt_object).swap_payload(value);
+    if (!indefinite && uint64_t(end_ - current_) / 2 < length)
+        return add_error("Unexpected end of data", current_);
+    for (uint64_t count = 0; indefinite ? !at_break() : count != length; ++count) {
+        char const* start = current_;
+        int major;
+        uint64_t argument;
+        bool key_indefinite;
+        if (!read_head(&major, &argument, &key_indefinite))
+            return false;
+        if (major != cm_text && major != cm_bytes)
+            return add_error("Map key is not a string", start);
+        char const* name;
+        char const* end;
+        std::string chunks;
+        if (!read_string(major, argument, key_indefinite, &name, &end, &chunks))
+            return false;
+        if (reject_dup_keys_ && value.find(name, end))
+            return add_error("Duplicate key: '" + std::string(name, end) + "'", start);
+        if (!read_value(*value.demand(name, end), depth + 1))
+            return false;
+    }
+    return true;
+}
+
+// Class cbor_reader_builder
+// //////////////////////////////////////////////////////////////////
+
+cbor_reader_builder::cbor_reader_builder()
+{
+    set_defaults(&settings_);
+}
+cbor_reader_builder::~cbor_reader_builder()
+{
+}
+char_reader* cbor_reader_builder::new_char_reader() const
+{
+    return new cbor_char_reader(
+        settings_["stack_limit"].as_int(),
+        settings_["fail_if_extra"].as_bool(),
+        settings_["reject_dup_keys"].as_bool());
+}
+static void get_valid_cbor_reader_keys(std::set<std::string>* valid_keys)
+{
+    valid_keys->clear();
+    valid_keys->insert("stack_limit");
+    valid_keys->insert("fail_if_extra");
+    valid_keys->insert("reject_dup_keys");
+}
+bool cbor_reader_builder::validate(json::value* invalid) const
+{
+    json::value my_invalid;
+    if (!invalid)
+        invalid = &my_invalid; // so we do not need to test for NULL
+    json::value& inv = *invalid;
+    std::set<std::string> valid_keys;
+    get_valid_cbor_reader_keys(&valid_keys);
+    value::members keys = settings_.get_member_names();
+    size_t n = keys.size();
+    for (size_t i = 0; i < n; ++i) {
+        std::string const& key = keys[i];
+        if (valid_keys.find(key) == valid_keys.end()) {
+            inv[key] = settings_[key];
+        }
+    }
+    return 0u == inv.size();
+}
+value& cbor_reader_builder::operator[](std::string key)
+{
+    return settings_[key];
+}
+// static
+void cbor_reader_builder::set_defaults(json::value* settings)
+{
+    (*settings)["stack_limit"] = 1000;
+    (*settings)["fail_if_extra"] = true;
+    (*settings)["reject_dup_keys"] = false;
+}
+
+// Class cbor_writer_builder
+// //////////////////////////////////////////////////////////////////
+
+cbor_writer_builder::cbor_writer_builder()
+{
+    set_defaults(&settings_);
+}
+cbor_writer_builder::~cbor_writer_builder()
+{
+}
+stream_writer* cbor_writer_builder::new_stream_writer() const
+{
+    return new cbor_stream_writer(settings_["compact_floats"].as_bool());
+}
+static void get_valid_cbor_writer_keys(std::set<std::string>* valid_keys)
+{
+    valid_keys->clear();
+    valid_keys->insert("compact_floats");
+}
+bool cbor_writer_builder::validate(json::value* invalid) const
+{
+    json::value my_invalid;
+    if (!invalid)
+        invalid = &my_invalid; // so we do not need to test for NULL
+    json::value& inv = *invalid;
+    std::set<std::string> valid_keys;
+    get_valid_cbor_writer_keys(&valid_keys);
+    value::members keys = settings_.get_member_names();
+    size_t n = keys.size();
+    for (size_t i = 0; i < n; ++i) {
+        std::string const& key = keys[i];
+        if (valid_keys.find(key) == valid_keys.end()) {
+            inv[key] = settings_[key];
+        }
+    }
+    return 0u == inv.size();
+}
+value& cbor_writer_builder::operator[](std::string key)
+{
+    return settings_[key];
+}
+// static
+void cbor_writer_builder::set_defaults(json::value* settings)
+{
+    (*settings)["compact_floats"] = true;
+}
+
+} // namespace json
@@ -0,0 +1,145 @@
+// Derived from public-domain/MIT-licensed code at
+// https://github.com/open-source-parsers/jsoncpp. Thanks, Baptiste Lepilleur!
+
+#pragma once
+
+#include "reader.h"
+#include "writer.h"
+
+// Disable warning C4251: <data member>: <type> needs to have dll-interface to
+// be used by...
+#if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+#pragma warning(push)
+#pragma warning(disable : 4251)
+#endif // if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+
+namespace json {
+
+/** \brief Build a char_reader that reads <a HREF="https://www.rfc-editor.org/rfc/rfc8949">CBOR</a>
+ * (RFC 8949) instead of JSON text.
+
+Usage:
+\code
+  json::cbor_reader_builder builder;
+  std::unique_ptr<json::char_reader> reader(builder.new_char_reader());
+  json::value root;
+  std::string errs;
+  bool ok = reader->parse(bytes.data(), bytes.data() + bytes.size(), &root, &errs);
+\endcode
+
+Data items map to values as follows:
+- unsigned integers become vt_int if they fit in largest_int_t, vt_uint
+  otherwise; negative integers become vt_int. This is how the JSON reader
+  types numbers, so a value read from JSON text comes back from
+  cbor_writer_builder with the same type and value. Negative integers below
+  the range of largest_int_t are an error.
+- half, single and double precision floats become vt_real, exactly.
+- text and byte strings become vt_string; byte strings are not checked for
+  UTF-8, nor are text strings.
+- arrays and maps become vt_array and vt_object; map keys must be strings.
+- false, true, null and undefined become vt_bool and vt_null.
+- tags are skipped, and the item they tag is read. Bignums (tags 2 and 3) are
+  an error, as they do not fit in a value.
+- indefinite-length strings, arrays and maps are read like the others.
+
+Values get the offsets of their bytes (see value::get_offset_start()).
+Errors are reported by byte offset.
+*/
+class JSON_API cbor_reader_builder : public char_reader::factory {
+public:
+	/** Configuration of this builder.
+	Available settings (case-sensitive):
+	- `"stack_limit": integer`
+	  - Nesting deeper than this (arrays, maps and tags) throws, as with
+		char_reader_builder.
+	- `"fail_if_extra": false or true`
+	  - If true (the default), `parse()` returns false when bytes follow the
+		root item.
+	- `"reject_dup_keys": false or true`
+	  - If true, `parse()` returns false when a key is duplicated within a
+		map. Otherwise the last one wins.
+
+	You can examine 'settings_` yourself
+	to see the defaults. You can also write and read them just like any
+	JSON value.
+	\sa set_defaults()
+	*/
+	json::value settings_;
+
+	cbor_reader_builder();
+	virtual ~cbor_reader_builder();
+
+	virtual char_reader* new_char_reader() const;
+
+	/** \return true if 'settings' are legal and consistent;
+   *   otherwise, indicate bad settings via 'invalid'.
+   */
+	bool validate(json::value* invalid) const;
+
+	/** A simple way to update a specific setting.
+   */
+	value& operator[](std::string key);
+
+	/** Called by ctor, but you can use this to reset settings_.
+   * \pre 'settings' != NULL (but json::null is fine)
+   */
+	static void set_defaults(json::value* settings);
+};
+
+/** \brief Build a stream_writer that writes <a HREF="https://www.rfc-editor.org/rfc/rfc8949">CBOR</a>
+ * (RFC 8949) instead of JSON text.
+
+Usage:
+\code
+  json::cbor_writer_builder builder;
+  std::string bytes = json::write_string(builder, root);
+\endcode
+
+Integers are written in the shortest form of their major type, vt_real as
+floats (never as integers, so that they stay vt_real), strings as text
+strings, and containers with definite lengths. Comments are not written.
+Nothing is formatted or escaped, so writing costs little more than copying.
+*/
+class JSON_API cbor_writer_builder : public stream_writer::factory {
+public:
+	/** Configuration of this builder.
+	Available settings (case-sensitive):
+	- "compact_floats": false or true
+	  - If true (the default), write each double as the shortest of half,
+		single and double precision floats that holds it exactly, as RFC 8949
+		prefers. If false, always write double precision.
+
+	You can examine 'settings_` yourself
+	to see the defaults. You can also write and read them just like any
+	JSON value.
+	\sa set_defaults()
+	*/
+	json::value settings_;
+
+	cbor_writer_builder();
+	virtual ~cbor_writer_builder();
+
+	/**
+   * \throw std::exception if something goes wrong (e.g. invalid settings)
+   */
+	virtual stream_writer* new_stream_writer() const;
+
+	/** \return true if 'settings' are legal and consistent;
+   *   otherwise, indicate bad settings via 'invalid'.
+   */
+	bool validate(json::value* invalid) const;
+	/** A simple way to update a specific setting.
+   */
+	value& operator[](std::string key);
+
+	/** Called by ctor, but you can use this to reset settings_.
+   * \pre 'settings' != NULL (but json::null is fine)
+   */
+	static void set_defaults(json::value* settings);
+};
+
+} // namespace json
+
+#if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+#pragma warning(pop)
+#endif // if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
@@ -0,0 +1,115 @@
+// Derived from public-domain/MIT-licensed code at
+// https://github.com/open-source-parsers/jsoncpp. Thanks, Baptiste Lepilleur!
+
+#include "cursor.h"
+#include "our_reader.h"
+#include <cstring>
+
+namespace json {
+
+// Class cursor
+// //////////////////////////////////////////////////////////////////
+
+cursor::cursor(char_reader_builder const& builder)
+    : reader_(new our_reader(make_features(builder.settings_)))
+{
+    reader_->start_pull(0, 0);
+}
+
+cursor::~cursor()
+{
+    delete reader_;
+}
+
+void cursor::reset(char const* begin, char const* end)
+{
+    reader_->start_pull(begin, end);
+}
+
+event_type cursor::next() { return reader_->pull(); }
+
+event_type cursor::event() const { return reader_->pulled_event(); }
+
+bool cursor::skip() { return reader_->skip_pulled(); }
+
+int cursor::depth() const { return reader_->pulled_depth(); }
+
+size_t cursor::get_offset_start() const { return reader_->pulled_start(); }
+
+size_t cursor::get_offset_limit() const { return reader_->pulled_limit(); }
+
+bool cursor::get_string(char const** str, char const** end)
+{
+    return reader_->pulled_string(str, end);
+}
+
+bool cursor::is_key(char const* name)
+{
+    char const* str;
+    char const* end;
+    if (reader_->pulled_event() != et_key || !get_string(&str, &end))
+        return false;
+    size_t length = end - str;
+    return strlen(name) == length && memcmp(str, name, length) == 0;
+}
+
+bool cursor::get_value(value* decoded)
+{
+    return reader_->decode_pulled(*decoded);
+}
+
+value cursor::scalar()
+{
+    value decoded;
+    switch (reader_->pulled_event()) {
+    case et_key:
+    case et_string:
+    case et_number:
+    case et_bool:
+    case et_null:
+        if (reader_->decode_pulled(decoded))
+            return decoded;
+        break;
+    default:
+        break;
+    }
+    if (reader_->pulled_event() == et_error)
+        throw_runtime_error(reader_->get_formatted_messages());
+    throw_logic_error("json::cursor: the last event has no value to convert");
+    return decoded; // unreachable
+}
+
+std::string cursor::as_string()
+{
+    char const* str;
+    char const* end;
+    if (get_string(&str, &end))
+        return std::string(str, end);
+    return scalar().as_string();
+}
+
+int32_t cursor::as_int() { return scalar().as_int(); }
+
+uint32_t cursor::as_uint() { return scalar().as_uint(); }
+
+#if defined(JSON_HAS_INT64)
+int64_t cursor::as_int64() { return scalar().as_int64(); }
+
+uint64_t cursor::as_uint64() { return scalar().as_uint64(); }
+#endif // if defined(JSON_HAS_INT64)
+
+double cursor::as_double() { return scalar().as_double(); }
+
+bool cursor::as_bool() { return scalar().as_bool(); }
+
+bool cursor::fail(std::string const& message)
+{
+    return reader_->fail_pulled(message);
+}
+
+std::string cursor::get_formatted_messages() const
+{
+    return reader_->get_formatted_messages();
+}
+
+} // namespace json
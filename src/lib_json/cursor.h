@@ -0,0 +1,157 @@
+// Derived from public-domain/MIT-licensed code at
+// https://github.com/open-source-parsers/jsoncpp. Thanks, Baptiste Lepilleur!
+
+#pragma once
+
+#include "forwards.h"
+#include <string>
+
+// Disable warning C4251: <data member>: <type> needs to have dll-interface to
+// be used by...
+#if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+#pragma warning(push)
+#pragma warning(disable : 4251)
+#endif // if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+
+namespace json {
+
+class our_reader;
+
+/** \brief What a \ref cursor has just read.
+ */
+enum event_type {
+	et_none = 0, ///< nothing read yet
+	et_begin_object,
+	et_end_object,
+	et_begin_array,
+	et_end_array,
+	et_key, ///< member name; its value is the next event
+	et_string,
+	et_number,
+	et_bool,
+	et_null,
+	et_end_of_stream, ///< the root value has been read
+	et_error ///< see get_formatted_messages()
+};
+
+/** \brief Pull parser: reads a document one event at a time, without
+ * building a #value.
+ *
+ * Settings are those of char_reader_builder. Syntax errors are reported as
+ * et_error, with the same messages as char_reader.
+ *
+ * next() only finds where each token ends. The payload of a key or scalar is
+ * decoded when asked for, with get_string(), is_key(), get_value() or one of
+ * the as_*() conversions; only as_string() and get_value() allocate, so a
+ * decoder for a known message can be written without any allocation. Errors
+ * in a payload (a bad escape, say) are only found when it is decoded.
+ *
+ * Members that are not wanted can be passed over with skip(), which only
+ * looks at strings and brackets (and comments, if allowed) to find where a
+ * value ends; what is inside is not checked.
+ * \code
+ * json::cursor in(builder);
+ * in.reset(begin, end);
+ * if (in.next() == json::et_begin_object) {
+ *   while (in.next() == json::et_key) {
+ *     if (in.is_key("id") && in.next() == json::et_number)
+ *       id = in.as_int64();
+ *     else
+ *       in.skip();
+ *   }
+ * }
+ * \endcode
+ *
+ * \note The document text is not copied; it must outlive the cursor, or the
+ *       next reset().
+ */
+class JSON_API cursor {
+public:
+	explicit cursor(char_reader_builder const& builder);
+	~cursor();
+
+	/// Start reading [begin, end).
+	void reset(char const* begin, char const* end);
+
+	/// Read the next event. After et_end_of_stream or et_error, returns the
+	/// same again.
+	event_type next();
+
+	/// The last event read.
+	event_type event() const;
+
+	/** Skip a value without decoding it: the value of the current member
+	 * (after et_key), or the rest of the current object or array (after
+	 * et_begin_object or et_begin_array).
+	 * get_offset_start() and get_offset_limit() then give the extent of the
+	 * skipped value, and the next event is the one that follows it.
+	 * \return false on a syntax error; event() is then et_error.
+	 */
+	bool skip();
+
+	/// Nesting level of the last event: 0 for the root value, 1 for the
+	/// members of the root, and so on.
+	int depth() const;
+
+	/// Extent of the token of the last event, as offsets in the document.
+	size_t get_offset_start() const;
+	size_t get_offset_limit() const;
+
+	/** Contents of the string of the last et_key or et_string event.
+	 * They point into the document, or into a buffer of the cursor if the
+	 * string has escapes, and stay valid until the next call to next(),
+	 * skip() or reset().
+	 * \return false if the last event has no string, or on an error in it;
+	 *         event() is then et_error.
+	 */
+	bool get_string(char const** str, char const** end);
+	/// \return true if the last event is et_key, for a member of that name.
+	bool is_key(char const* name);
+
+	/** Decode the last event into a #value: the payload of a key or scalar,
+	 * or, right after et_begin_object or et_begin_array, the whole container.
+	 * In the latter case the next event is the one after the container.
+	 * \return false if there is nothing to decode, or on a syntax error;
+	 *         event() is then et_error.
+	 */
+	bool get_value(value* decoded);
+
+	/** Payload of the last key or scalar event, converted as by the
+	 * accessors of #value.
+	 * \throw std::runtime_error on a syntax error in the payload.
+	 * \throw std::logic_error if the last event has no payload, or it does not
+	 *        convert.
+	 */
+	std::string as_string();
+	int32_t as_int();
+	uint32_t as_uint();
+#if defined(JSON_HAS_INT64)
+	int64_t as_int64();
+	uint64_t as_uint64();
+#endif // if defined(JSON_HAS_INT64)
+	double as_double();
+	bool as_bool();
+
+	/** Report an error at the last event, such as a value of the wrong type
+	 * for the caller. event() is then et_error.
+	 * \return false
+	 */
+	bool fail(std::string const& message);
+
+	/// Errors found, formatted like char_reader does.
+	std::string get_formatted_messages() const;
+
+private:
+	cursor(cursor const&); // no impl
+	void operator=(cursor const&); // no impl
+
+	value scalar();
+
+	our_reader* reader_;
+};
+
+} // namespace json
+
+#if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+#pragma warning(pop)
+#endif // if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
@@ -0,0 +1,242 @@
+// Derived from public-domain/MIT-licensed code at
+// https://github.com/open-source-parsers/jsoncpp. Thanks, Baptiste Lepilleur!
+
+#include "extractor.h"
+#include "tool.h"
+#include <algorithm>
+#include <cstring>
+
+namespace json {
+
+static size_t const no_node = static_cast<size_t>(-1);
+
+static bool key_before(std::pair<std::string, size_t> const& step, std::string const& key)
+{
+    return compare_keys(step.first.data(), step.first.size(), key.data(), key.size()) < 0;
+}
+
+static bool index_before(std::pair<array_index, size_t> const& step, array_index index)
+{
+    return step.first < index;
+}
+
+// Class extractor
+// //////////////////////////////////////////////////////////////////
+
+extractor::extractor()
+    : nodes_(1)
+    , size_(0)
+{
+}
+
+size_t extractor::add(path const& p)
+{
+    size_t at = 0;
+    for (path::Args::const_iterator it = p.args_.begin(); it != p.args_.end(); ++it) {
+        path_argument const& arg = *it;
+        size_t next = nodes_.size();
+        if (arg.kind_ == path_argument::kind_index) {
+            std::vector<std::pair<array_index, size_t> >& steps = nodes_[at].indices;
+            std::vector<std::pair<array_index, size_t> >::iterator step = std::lower_bound(
+                steps.begin(), steps.end(), arg.index_, index_before);
+            if (step != steps.end() && step->first == arg.index_)
+                next = step->second;
+            else
+                steps.insert(step, std::make_pair(arg.index_, next));
+        }
+        else {
+            std::vector<std::pair<std::string, size_t> >& steps = nodes_[at].keys;
+            std::vector<std::pair<std::string, size_t> >::iterator step = std::lower_bound(
+                steps.begin(), steps.end(), arg.key_, key_before);
+            if (step != steps.end() && step->first == arg.key_)
+                next = step->second;
+            else
+                steps.insert(step, std::make_pair(arg.key_, next));
+        }
+        if (next == nodes_.size())
+            nodes_.push_back(node());
+        at = next;
+    }
+    nodes_[at].targets.push_back(size_);
+    return size_++;
+}
+
+size_t extractor::size() const
+{
+    return size_;
+}
+
+size_t extractor::find_key(node const& at, char const* begin, char const* end) const
+{
+    size_t low = 0;
+    size_t high = at.keys.size();
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        std::string const& key = at.keys[middle].first;
+        int comp = compare_keys(key.data(), key.size(), begin, end - begin);
+        if (comp == 0)
+            return at.keys[middle].second;
+        if (comp < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return no_node;
+}
+
+void extractor::extract(value const& root, value const** found) const
+{
+    std::fill(found, found + size_, static_cast<value const*>(NULL));
+    walk(0, root, found);
+}
+
+void extractor::walk(size_t at, value const& current, value const** found) const
+{
+    node const& here = nodes_[at];
+    for (size_t i = 0; i < here.targets.size(); ++i)
+        found[here.targets[i]] = &current;
+    if (!here.keys.empty() && current.is_object()) {
+        if (here.keys.size() > 1 && current.size() < 4 * here.keys.size()) {
+            // Many of the members are wanted: go through them all, alongside
+            // the wanted names, as both are in the same order.
+            size_t k = 0;
+            value::const_iterator it = current.begin();
+            value::const_iterator end = current.end();
+            while (it != end && k < here.keys.size()) {
+                char const* name_end;
+                char const* name = it.member_name(&name_end);
+                std::string const& key = here.keys[k].first;
+                int comp = compare_keys(key.data(), key.size(), name, name_end - name);
+                if (comp < 0) {
+                    ++k;
+                }
+                else if (comp > 0) {
+                    ++it;
+                }
+                else {
+                    walk(here.keys[k].second, *it, found);
+                    ++k;
+                    ++it;
+                }
+            }
+        }
+        else {
+            for (size_t k = 0; k < here.keys.size(); ++k) {
+                std::string const& key = here.keys[k].first;
+                value const* member = current.find(key.data(), key.data() + key.size());
+                if (member)
+                    walk(here.keys[k].second, *member, found);
+            }
+        }
+    }
+    if (!here.indices.empty() && current.is_array()) {
+        for (size_t k = 0; k < here.indices.size(); ++k) {
+            array_index index = here.indices[k].first;
+            if (!current.is_valid_index(index))
+                break;
+            walk(here.indices[k].second, current[index], found);
+        }
+    }
+}
+
+bool extractor::extract(cursor& in, value* values, bool* found) const
+{
+    std::fill(values, values + size_, value());
+    std::fill(found, found + size_, false);
+    size_t missing = size_;
+    if (!missing)
+        return true;
+    if (in.next() == et_error)
+        return false;
+    return pull(0, in, values, found, &missing);
+}
+
+// The same as walk(), for a value decoded from a cursor.
+void extractor::copy(size_t at, value const& current, value* values, bool* found,
+    size_t* missing) const
+{
+    node const& here = nodes_[at];
+    for (size_t i = 0; i < here.targets.size(); ++i) {
+        size_t target = here.targets[i];
+        if (!found[target]) {
+            values[target] = current;
+            found[target] = true;
+            --*missing;
+        }
+    }
+    if (!here.keys.empty() && current.is_object()) {
+        for (size_t k = 0; k < here.keys.size(); ++k) {
+            std::string const& key = here.keys[k].first;
+            value const* member = current.find(key.data(), key.data() + key.size());
+            if (member)
+                copy(here.keys[k].second, *member, values, found, missing);
+        }
+    }
+    if (!here.indices.empty() && current.is_array()) {
+        for (size_t k = 0; k < here.indices.size(); ++k) {
+            array_index index = here.indices[k].first;
+            if (!current.is_valid_index(index))
+                break;
+            copy(here.indices[k].second, current[index], values, found, missing);
+        }
+    }
+}
+
+// The cursor is on the first event of the value at node 'at'. On return it is
+// on the last one, unless every path has been found.
+bool extractor::pull(size_t at, cursor& in, value* values, bool* found,
+    size_t* missing) const
+{
+    node const& here = nodes_[at];
+    for (size_t i = 0; i < here.targets.size(); ++i) {
+        if (!found[here.targets[i]]) {
+            value decoded;
+            if (!in.get_value(&decoded))
+                return false;
+            copy(at, decoded, values, found, missing);
+            return true;
+        }
+    }
+    event_type event = in.event();
+    if (event == et_begin_object && !here.keys.empty()) {
+        while ((event = in.next()) == et_key) {
+            char const* begin;
+            char const* end;
+            if (!in.get_string(&begin, &end))
+                return false;
+            size_t next = find_key(here, begin, end);
+            if (next == no_node) {
+                if (!in.skip())
+                    return false;
+                continue;
+            }
+            in.next();
+            if (!pull(next, in, values, found, missing))
+                return false;
+            if (!*missing)
+                return true;
+        }
+        return event == et_end_object;
+    }
+    if (event == et_begin_array && !here.indices.empty()) {
+        size_t k = 0;
+        array_index index = 0;
+        while ((event = in.next()) != et_end_array) {
+            if (k < here.indices.size() && here.indices[k].first == index) {
+                if (!pull(here.indices[k].second, in, values, found, missing))
+                    return false;
+                if (!*missing)
+                    return true;
+                ++k;
+            }
+            else if (!in.skip()) {
+                return false;
+            }
+            ++index;
+        }
+        return true;
+    }
+    return in.skip();
+}
+
+} // namespace json
@@ -0,0 +1,100 @@
+// Derived from public-domain/MIT-licensed code at
+// https://github.com/open-source-parsers/jsoncpp. Thanks, Baptiste Lepilleur!
+
+#pragma once
+
+#include "cursor.h"
+#include "value.h"
+#include <string>
+#include <utility>
+#include <vector>
+
+// Disable warning C4251: <data member>: <type> needs to have dll-interface to
+// be used by...
+#if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+#pragma warning(push)
+#pragma warning(disable : 4251)
+#endif // if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+
+namespace json {
+
+/** \brief Finds many paths in a document at once.
+ *
+ * The paths are merged into a prefix tree when they are added, so that a
+ * step that several of them share is taken once: finding ".user.id",
+ * ".user.name" and ".user.email" looks up "user" once, not three times.
+ * \code
+ * json::extractor fields;
+ * size_t id = fields.add(json::path(".user.id"));
+ * size_t name = fields.add(json::path(".user.name"));
+ *
+ * json::value const* found[2];
+ * fields.extract(root, found);
+ * if (found[id])
+ *   use(found[id]->as_int64());
+ * \endcode
+ *
+ * A document can also be read with a \ref cursor, without building a #value
+ * of it: members that no path goes through are skipped, and reading stops as
+ * soon as every path has been found.
+ *
+ * Build an extractor once and use it on many documents; extract() does not
+ * allocate, except to decode values from a cursor.
+ */
+class JSON_API extractor {
+public:
+	extractor();
+
+	/// Add a path.
+	/// \return its index in the arrays filled by extract(). Paths are
+	///         numbered from 0, in the order they are added.
+	size_t add(path const& p);
+
+	/// Number of paths added.
+	size_t size() const;
+
+	/** Find every path in 'root', in one walk of it.
+	 * \param found has size() elements; found[i] is set to the node at path i,
+	 *        or NULL if there is none.
+	 */
+	void extract(value const& root, value const** found) const;
+
+	/** Read the next value from 'in', and decode the nodes at the paths.
+	 * \param values has size() elements; values[i] is set to the node at path
+	 *        i, or null if there is none.
+	 * \param found has size() elements; found[i] tells whether there is one.
+	 * \return false on a syntax error; in.event() is then et_error.
+	 *
+	 * The cursor must be just reset(), or on the event before the value, such
+	 * as its et_key. Once every path is found the rest of the value is not
+	 * read, so is not checked either, and the cursor is left where it
+	 * stopped. If a member name is repeated, the first one is taken.
+	 */
+	bool extract(cursor& in, value* values, bool* found) const;
+
+private:
+	struct node {
+		std::vector<size_t> targets; // the paths that end here
+		// The next steps, by member name (sorted as #value sorts them) and by
+		// index (ascending), with the node they lead to.
+		std::vector<std::pair<std::string, size_t> > keys;
+		std::vector<std::pair<array_index, size_t> > indices;
+	};
+	typedef std::vector<node> nodes;
+
+	size_t find_key(node const& at, char const* begin, char const* end) const;
+	void walk(size_t at, value const& current, value const** found) const;
+	void copy(size_t at, value const& current, value* values, bool* found,
+		size_t* missing) const;
+	bool pull(size_t at, cursor& in, value* values, bool* found,
+		size_t* missing) const;
+
+	nodes nodes_; // nodes_[0] is the root
+	size_t size_;
+};
+
+} // namespace json
+
+#if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+#pragma warning(pop)
+#endif // if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
@@ -8,9 +8,16 @@
 namespace json {
 
 class fast_writer;
+class gather_writer;
 class styled_writer;
 
 class reader;
+class char_reader_builder;
+class cbor_reader_builder;
+class cbor_writer_builder;
+class msgpack_reader_builder;
+class msgpack_writer_builder;
+class msgpack_stream;
 
 class features;
 
@@ -22,6 +29,16 @@ class value;
 class value_iterator_base;
 class value_iterator;
 class value_const_iterator;
+class tape;
+class tape_view;
+class snapshot;
+class snapshot_view;
+class lazy_document;
+class lazy_value;
+class cursor;
+class extractor;
+class query;
+class key_table;
 
 } // end namespace
 
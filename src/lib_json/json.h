@@ -10,6 +10,16 @@
 #include "value.h"
 #include "reader.h"
 #include "writer.h"
+#include "tape.h"
+#include "lazy.h"
+#include "cursor.h"
+#include "bind.h"
+#include "cbor.h"
+#include "msgpack.h"
+#include "snapshot.h"
+#include "extractor.h"
+#include "query.h"
+#include "patch.h"
 #include "features.h"
 
 #endif // JSON_JSON_H_INCLUDED
@@ -0,0 +1,362 @@
+// Derived from public-domain/MIT-licensed code at
+// https://github.com/open-source-parsers/jsoncpp. Thanks, Baptiste Lepilleur!
+
+#include "assertions.h"
+#include "lazy.h"
+#include "our_reader.h"
+#include <cstring>
+
+namespace json {
+
+// Class lazy_document
+// //////////////////////////////////////////////////////////////////
+
+lazy_document::lazy_document()
+    : reader_(0)
+{
+}
+
+lazy_document::~lazy_document()
+{
+    delete reader_;
+}
+
+void lazy_document::clear()
+{
+    nodes_.clear();
+    keys_.clear();
+}
+
+void lazy_document::reset(our_reader* reader)
+{
+    clear();
+    delete reader_;
+    reader_ = reader;
+}
+
+bool lazy_document::empty() const { return nodes_.empty(); }
+
+lazy_value lazy_document::root() const
+{
+    if (nodes_.empty())
+        return lazy_value();
+    return lazy_value(this, 0);
+}
+
+size_t lazy_document::decoded_count() const { return nodes_.size(); }
+
+void lazy_document::expand(size_t index) const
+{
+    if (nodes_[index].expanded_)
+        return;
+    if (!reader_->expand(*this, index))
+        throw_runtime_error(reader_->get_formatted_messages());
+}
+
+// Class lazy_value
+// //////////////////////////////////////////////////////////////////
+
+lazy_value::lazy_value()
+    : document_(0)
+    , index_(0)
+{
+}
+
+lazy_value::lazy_value(lazy_document const* owner, size_t index)
+    : document_(owner)
+    , index_(index)
+{
+}
+
+lazy_document::node const& lazy_value::get_node() const
+{
+    return document_->nodes_[index_];
+}
+
+size_t lazy_value::children(array_index* count) const
+{
+    document_->expand(index_);
+    lazy_document::node const& node = get_node();
+    *count = node.child_count_;
+    return node.first_child_;
+}
+
+value_type lazy_value::type() const
+{
+    if (!document_)
+        return vt_null;
+    return get_node().type_;
+}
+
+bool lazy_value::is_null() const { return type() == vt_null; }
+
+bool lazy_value::is_bool() const { return type() == vt_bool; }
+
+bool lazy_value::is_int() const { return document_ && get_node().scalar_.is_int(); }
+
+bool lazy_value::is_int64() const { return document_ && get_node().scalar_.is_int64(); }
+
+bool lazy_value::is_uint() const { return document_ && get_node().scalar_.is_uint(); }
+
+bool lazy_value::isUInt64() const { return document_ && get_node().scalar_.isUInt64(); }
+
+bool lazy_value::isIntegral() const { return document_ && get_node().scalar_.isIntegral(); }
+
+bool lazy_value::isDouble() const { return document_ && get_node().scalar_.isDouble(); }
+
+bool lazy_value::isNumeric() const { return document_ && get_node().scalar_.isNumeric(); }
+
+bool lazy_value::isString() const { return type() == vt_string; }
+
+bool lazy_value::is_array() const { return type() == vt_array; }
+
+bool lazy_value::is_object() const { return type() == vt_object; }
+
+// Containers do not keep a decoded value; as_*() on them asserts, as it
+// would for most conversions of an object or array #value.
+value const& lazy_value::scalar() const
+{
+    if (!document_)
+        return value::null_ref;
+    JSON_ASSERT_MESSAGE(!is_array() && !is_object(),
+        "in json::lazy_value::as_*(): requires a scalar value");
+    return get_node().scalar_;
+}
+
+const char* lazy_value::as_cstring() const
+{
+    JSON_ASSERT_MESSAGE(type() == vt_string,
+        "in json::lazy_value::as_cstring(): requires vt_string");
+    return get_node().scalar_.as_cstring();
+}
+
+bool lazy_value::get_string(char const** str, char const** end) const
+{
+    if (type() != vt_string)
+        return false;
+    return get_node().scalar_.get_string(str, end);
+}
+
+std::string lazy_value::as_string() const { return scalar().as_string(); }
+
+int32_t lazy_value::as_int() const { return scalar().as_int(); }
+
+uint32_t lazy_value::as_uint() const { return scalar().as_uint(); }
+
+#if defined(JSON_HAS_INT64)
+int64_t lazy_value::as_int64() const { return scalar().as_int64(); }
+
+uint64_t lazy_value::as_uint64() const { return scalar().as_uint64(); }
+#endif // if defined(JSON_HAS_INT64)
+
+largest_int_t lazy_value::as_largest_int() const { return scalar().as_largest_int(); }
+
+largest_uint_t lazy_value::as_largest_uint() const { return scalar().as_largest_uint(); }
+
+float lazy_value::as_float() const { return scalar().as_float(); }
+
+double lazy_value::as_double() const { return scalar().as_double(); }
+
+bool lazy_value::as_bool() const { return scalar().as_bool(); }
+
+array_index lazy_value::size() const
+{
+    if (!is_array() && !is_object())
+        return 0;
+    array_index count;
+    children(&count);
+    return count;
+}
+
+bool lazy_value::empty() const
+{
+    if (is_null() || is_array() || is_object())
+        return size() == 0u;
+    return false;
+}
+
+bool lazy_value::operator!() const { return is_null(); }
+
+lazy_value lazy_value::operator[](array_index index) const
+{
+    JSON_ASSERT_MESSAGE(
+        type() == vt_null || type() == vt_array,
+        "in json::lazy_value::operator[](array_index): requires vt_array");
+    if (type() == vt_null)
+        return lazy_value();
+    array_index count;
+    size_t first = children(&count);
+    if (index >= count)
+        return lazy_value();
+    return lazy_value(document_, first + index);
+}
+
+lazy_value lazy_value::operator[](int index) const
+{
+    JSON_ASSERT_MESSAGE(
+        index >= 0,
+        "in json::lazy_value::operator[](int index): index cannot be negative");
+    return (*this)[array_index(index)];
+}
+
+bool lazy_value::is_valid_index(array_index index) const { return index < size(); }
+
+bool lazy_value::find(char const* key, char const* end, lazy_value* found) const
+{
+    JSON_ASSERT_MESSAGE(
+        type() == vt_null || type() == vt_object,
+        "in json::lazy_value::find(key, end, found): requires vt_object or vt_null");
+    if (type() == vt_null)
+        return false;
+    array_index count;
+    size_t first = children(&count);
+    size_t length = end - key;
+    for (size_t index = first; index < first + count; ++index) {
+        lazy_document::node const& member = document_->nodes_[index];
+        if (member.key_length_ == length && memcmp(member.key_, key, length) == 0) {
+            *found = lazy_value(document_, index);
+            return true;
+        }
+    }
+    return false;
+}
+
+lazy_value lazy_value::operator[](const char* key) const
+{
+    lazy_value found;
+    find(key, key + strlen(key), &found);
+    return found;
+}
+
+lazy_value lazy_value::operator[](std::string const& key) const
+{
+    lazy_value found;
+    find(key.data(), key.data() + key.length(), &found);
+    return found;
+}
+
+bool lazy_value::is_member(std::string const& key) const
+{
+    lazy_value found;
+    return find(key.data(), key.data() + key.length(), &found);
+}
+
+value::members lazy_value::get_member_names() const
+{
+    JSON_ASSERT_MESSAGE(
+        type() == vt_null || type() == vt_object,
+        "in json::lazy_value::get_member_names(), value must be vt_object");
+    value::members members;
+    if (type() == vt_null)
+        return members;
+    members.reserve(size());
+    for (const_iterator it = begin(); it != end(); ++it)
+        members.push_back(it.name());
+    return members;
+}
+
+lazy_value::const_iterator lazy_value::begin() const
+{
+    if (!is_array() && !is_object())
+        return const_iterator();
+    array_index count;
+    size_t first = children(&count);
+    return const_iterator(lazy_value(document_, first), first);
+}
+
+lazy_value::const_iterator lazy_value::end() const
+{
+    if (!is_array() && !is_object())
+        return const_iterator();
+    array_index count;
+    size_t first = children(&count);
+    return const_iterator(lazy_value(document_, first + count), first);
+}
+
+bool lazy_value::is_expanded() const
+{
+    return document_ && get_node().expanded_;
+}
+
+value lazy_value::to_value() const
+{
+    value result;
+    switch (type()) {
+    case vt_array: {
+        result = value(vt_array);
+        array_index index = 0;
+        for (const_iterator it = begin(); it != end(); ++it)
+            result[index++] = it->to_value();
+    } break;
+    case vt_object: {
+        result = value(vt_object);
+        for (const_iterator it = begin(); it != end(); ++it) {
+            char const* name_end;
+            char const* name = it.member_name(&name_end);
+            *result.demand(name, name_end) = it->to_value();
+        }
+    } break;
+    default:
+        if (!document_)
+            return result;
+        result = get_node().scalar_;
+        break;
+    }
+    result.set_offset_start(get_offset_start());
+    result.set_offset_limit(get_offset_limit());
+    return result;
+}
+
+size_t lazy_value::get_offset_start() const
+{
+    return document_ ? get_node().start_ : 0;
+}
+
+size_t lazy_value::get_offset_limit() const
+{
+    return document_ ? get_node().limit_ : 0;
+}
+
+// Class lazy_value::const_iterator
+// //////////////////////////////////////////////////////////////////
+
+lazy_value::const_iterator::const_iterator()
+    : current_()
+    , first_(0)
+{
+}
+
+lazy_value::const_iterator::const_iterator(lazy_value const& current, size_t first)
+    : current_(current)
+    , first_(first)
+{
+}
+
+uint32_t lazy_value::const_iterator::index() const
+{
+    if (current_.get_node().key_)
+        return uint32_t(-1);
+    return uint32_t(current_.index_ - first_);
+}
+
+std::string lazy_value::const_iterator::name() const
+{
+    char const* end;
+    char const* key = member_name(&end);
+    if (!key)
+        return std::string();
+    return std::string(key, end);
+}
+
+char const* lazy_value::const_iterator::member_name(char const** end) const
+{
+    lazy_document::node const& node = current_.get_node();
+    if (!node.key_) {
+        *end = NULL;
+        return NULL;
+    }
+    *end = node.key_ + node.key_length_;
+    return node.key_;
+}
+
+} // namespace json
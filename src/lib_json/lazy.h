@@ -0,0 +1,261 @@
+// Derived from public-domain/MIT-licensed code at
+// https://github.com/open-source-parsers/jsoncpp. Thanks, Baptiste Lepilleur!
+
+#pragma once
+
+#include "value.h"
+#include <deque>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Disable warning C4251: <data member>: <type> needs to have dll-interface to
+// be used by...
+#if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+#pragma warning(push)
+#pragma warning(disable : 4251)
+#endif // if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+
+namespace json {
+
+class our_reader;
+
+/** \brief JSON document that is decoded on demand.
+ *
+ * Parsing only locates the root value. The children of an object or array
+ * are decoded the first time they are needed, i.e. on the first call to
+ * operator[], find(), size() or begin() on that container; until then the
+ * container is just a pair of offsets into the document (the same offsets as
+ * value::get_offset_start() and value::get_offset_limit()), and each nested
+ * container below it costs no more than a scan for its closing bracket.
+ *
+ * This pays off for large documents of which only a few branches are read.
+ * \code
+ * json::char_reader_builder builder;
+ * json::lazy_document doc;
+ * std::string errs;
+ * if (json::parse_lazy(builder, begin, end, &doc, &errs)) {
+ *   std::string name = doc.root()["header"]["name"].as_string();
+ * }
+ * \endcode
+ *
+ * \note The document text is not copied; it must outlive the lazy_document.
+ * \note Syntax errors inside a container are only found when that container
+ *       is decoded. They are then thrown as std::runtime_error, with the same
+ *       message as char_reader would have reported.
+ * \note Decoding modifies the lazy_document, so a document must not be read
+ *       from several threads at once.
+ */
+class JSON_API lazy_document {
+public:
+	lazy_document();
+	~lazy_document();
+
+	/// Forget the document.
+	void clear();
+
+	/// \return true if nothing has been parsed into this document.
+	bool empty() const;
+
+	/// The root value of the document, or a null view if empty().
+	lazy_value root() const;
+
+	/// Number of values decoded so far, for diagnostics.
+	size_t decoded_count() const;
+
+private:
+	lazy_document(lazy_document const&); // no impl
+	void operator=(lazy_document const&); // no impl
+
+	friend class lazy_value;
+	friend class our_reader;
+	friend bool parse_lazy(char_reader_builder const&, char const*, char const*,
+		lazy_document*, std::string*);
+
+	struct node {
+		value_type type_;
+		value scalar_; // decoded value, for all but vt_object and vt_array
+		size_t start_;
+		size_t limit_;
+		char const* key_; // member name, for members of an object
+		size_t key_length_;
+		size_t first_child_;
+		array_index child_count_;
+		int depth_;
+		bool expanded_;
+	};
+
+	void reset(our_reader* reader);
+	/// Decode the children of nodes_[index], if not done yet.
+	void expand(size_t index) const;
+
+	mutable std::vector<node> nodes_;
+	mutable std::deque<std::string> keys_; // member names that needed decoding
+	our_reader* reader_;
+};
+
+/** \brief Read-only handle to one value inside a \ref lazy_document.
+ *
+ * Offers the familiar read API of #value. A handle obtained for a missing
+ * member or index is a null handle, like value::null_ref.
+ */
+class JSON_API lazy_value {
+public:
+	class const_iterator;
+
+	/// A null handle, not attached to any document.
+	lazy_value();
+
+	value_type type() const;
+
+	bool is_null() const;
+	bool is_bool() const;
+	bool is_int() const;
+	bool is_int64() const;
+	bool is_uint() const;
+	bool isUInt64() const;
+	bool isIntegral() const;
+	bool isDouble() const;
+	bool isNumeric() const;
+	bool isString() const;
+	bool is_array() const;
+	bool is_object() const;
+
+	const char* as_cstring() const; ///< Embedded zeroes could cause you trouble!
+	std::string as_string() const; ///< Embedded zeroes are possible.
+	/** Get raw char* of string-value.
+	 *  \return false if !string. (Seg-fault if str or end are NULL.)
+	 */
+	bool get_string(char const** str, char const** end) const;
+	int32_t as_int() const;
+	uint32_t as_uint() const;
+#if defined(JSON_HAS_INT64)
+	int64_t as_int64() const;
+	uint64_t as_uint64() const;
+#endif // if defined(JSON_HAS_INT64)
+	largest_int_t as_largest_int() const;
+	largest_uint_t as_largest_uint() const;
+	float as_float() const;
+	double as_double() const;
+	bool as_bool() const;
+
+	/// Number of values in array or object. Decodes the children.
+	array_index size() const;
+	/// \brief Return true if empty array, empty object, or null;
+	/// otherwise, false.
+	bool empty() const;
+	/// Return is_null()
+	bool operator!() const;
+
+	/// Access an array element (zero based index).
+	/// \return a null handle if out of range.
+	lazy_value operator[](array_index index) const;
+	lazy_value operator[](int index) const;
+	/// Return true if index < size().
+	bool is_valid_index(array_index index) const;
+
+	/// Access an object member by name.
+	/// \return a null handle if there is no member with that name.
+	lazy_value operator[](const char* key) const;
+	/// \param key may contain embedded nulls.
+	lazy_value operator[](std::string const& key) const;
+	/** Look up an object member by name.
+	 *  Update 'found' iff found.
+	 *  \param key may contain embedded nulls.
+	 *  \return true iff found
+	 */
+	bool find(char const* key, char const* end, lazy_value* found) const;
+	/// Return true if the object has a member named key.
+	bool is_member(std::string const& key) const;
+	/// \brief Return a list of the member names.
+	/// \pre type() is vt_object or vt_null
+	value::members get_member_names() const;
+
+	const_iterator begin() const;
+	const_iterator end() const;
+
+	/// \return true if the children of this object or array are decoded.
+	bool is_expanded() const;
+
+	/// Deep copy into a regular #value, decoding everything below.
+	value to_value() const;
+
+	size_t get_offset_start() const;
+	size_t get_offset_limit() const;
+
+private:
+	friend class lazy_document;
+
+	lazy_value(lazy_document const* owner, size_t index);
+
+	lazy_document::node const& get_node() const;
+	value const& scalar() const;
+	/// Index of the first child, after making sure children are decoded.
+	size_t children(array_index* count) const;
+
+	lazy_document const* document_;
+	size_t index_;
+};
+
+/** \brief Forward iterator over the elements of an array, or the members of
+ * an object, in a \ref lazy_document.
+ */
+class JSON_API lazy_value::const_iterator {
+public:
+	typedef std::forward_iterator_tag iterator_category;
+	typedef lazy_value value_type;
+	typedef int difference_type;
+	typedef lazy_value reference;
+	typedef lazy_value const* pointer;
+
+	const_iterator();
+
+	bool operator==(const_iterator const& other) const
+	{
+		return current_.index_ == other.current_.index_;
+	}
+	bool operator!=(const_iterator const& other) const
+	{
+		return !(*this == other);
+	}
+
+	const_iterator& operator++()
+	{
+		++current_.index_;
+		return *this;
+	}
+	const_iterator operator++(int)
+	{
+		const_iterator temp(*this);
+		++*this;
+		return temp;
+	}
+
+	reference operator*() const { return current_; }
+	pointer operator->() const { return &current_; }
+
+	/// Return the index of the referenced value, or -1 if it is not an vt_array.
+	uint32_t index() const;
+
+	/// Return the member name of the referenced value, or "" if it is not an
+	/// vt_object.
+	std::string name() const;
+
+	/// Return the member name of the referenced value, or NULL if it is not an
+	/// vt_object. Because end is passed as an OUT param, embedded nulls are supported.
+	char const* member_name(char const** end) const;
+
+private:
+	friend class lazy_value;
+
+	const_iterator(lazy_value const& current, size_t first);
+
+	lazy_value current_;
+	size_t first_; // index of the first sibling
+};
+
+} // namespace json
+
+#if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+#pragma warning(pop)
+#endif // if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
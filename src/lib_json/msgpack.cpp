@@ -0,0 +1,730 @@
+// Derived from public-domain/MIT-licensed code at
+// https://github.com/open-source-parsers/jsoncpp. Thanks, Baptiste Lepilleur!
+
+#include "msgpack.h"
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <set>
+#include <sstream>
+
+namespace json {
+
+// First bytes of the formats that are not fix* ranges.
+enum msgpack_format {
+    mf_nil = 0xc0,
+    mf_never_used = 0xc1,
+    mf_false = 0xc2,
+    mf_true = 0xc3,
+    mf_bin8 = 0xc4,
+    mf_bin16 = 0xc5,
+    mf_bin32 = 0xc6,
+    mf_ext8 = 0xc7,
+    mf_ext16 = 0xc8,
+    mf_ext32 = 0xc9,
+    mf_float32 = 0xca,
+    mf_float64 = 0xcb,
+    mf_uint8 = 0xcc,
+    mf_uint16 = 0xcd,
+    mf_uint32 = 0xce,
+    mf_uint64 = 0xcf,
+    mf_int8 = 0xd0,
+    mf_int16 = 0xd1,
+    mf_int32 = 0xd2,
+    mf_int64 = 0xd3,
+    mf_fixext1 = 0xd4,
+    mf_fixext16 = 0xd8,
+    mf_str8 = 0xd9,
+    mf_str16 = 0xda,
+    mf_str32 = 0xdb,
+    mf_array16 = 0xdc,
+    mf_array32 = 0xdd,
+    mf_map16 = 0xde,
+    mf_map32 = 0xdf
+};
+
+static uint64_t read_big_endian(char const* bytes, int size)
+{
+    uint64_t result = 0;
+    for (int index = 0; index != size; ++index)
+        result = result << 8 | static_cast<unsigned char>(bytes[index]);
+    return result;
+}
+
+// Measure the object that starts at 'begin': *size is the number of bytes of
+// its header and payload, and *children the number of objects in it (twice
+// the count of a map). Nothing else is checked.
+// \return false if [begin, end) ends within the header.
+static bool measure_object(char const* begin, char const* end, uint64_t* size, uint64_t* children)
+{
+    if (begin == end)
+        return false;
+    unsigned char format = static_cast<unsigned char>(*begin);
+    *size = 1;
+    *children = 0;
+    if (format <= 0x7f || format >= 0xe0)
+        return true;
+    if (format <= 0x8f) {
+        *children = 2 * uint64_t(format & 0x0f);
+        return true;
+    }
+    if (format <= 0x9f) {
+        *children = format & 0x0f;
+        return true;
+    }
+    if (format <= 0xbf) {
+        *size += format & 0x1f;
+        return true;
+    }
+    int length_size = 0; // bytes of the length or count after the format
+    int extra = 0; // bytes between them and the payload
+    switch (format) {
+    case mf_bin8:
+    case mf_str8:
+        length_size = 1;
+        break;
+    case mf_bin16:
+    case mf_str16:
+    case mf_array16:
+    case mf_map16:
+        length_size = 2;
+        break;
+    case mf_bin32:
+    case mf_str32:
+    case mf_array32:
+    case mf_map32:
+        length_size = 4;
+        break;
+    case mf_ext8:
+    case mf_ext16:
+    case mf_ext32:
+        length_size = 1 << (format - mf_ext8);
+        extra = 1;
+        break;
+    case mf_float32:
+        *size += 4;
+        return true;
+    case mf_float64:
+        *size += 8;
+        return true;
+    case mf_uint8:
+    case mf_uint16:
+    case mf_uint32:
+    case mf_uint64:
+        *size += 1u << (format - mf_uint8);
+        return true;
+    case mf_int8:
+    case mf_int16:
+    case mf_int32:
+    case mf_int64:
+        *size += 1u << (format - mf_int8);
+        return true;
+    default:
+        if (format >= mf_fixext1 && format <= mf_fixext16)
+            *size += 1 + (1u << (format - mf_fixext1));
+        return true; // nil, false, true, never used
+    }
+    if (end - begin < 1 + length_size)
+        return false;
+    uint64_t length = read_big_endian(begin + 1, length_size);
+    *size += uint64_t(length_size);
+    if (format == mf_array16 || format == mf_array32)
+        *children = length;
+    else if (format == mf_map16 || format == mf_map32)
+        *children = 2 * length;
+    else
+        *size += uint64_t(extra) + length;
+    return true;
+}
+
+// Class msgpack_stream_writer
+// //////////////////////////////////////////////////////////////////
+
+class msgpack_stream_writer : public stream_writer {
+public:
+    explicit msgpack_stream_writer(bool compact_floats);
+    virtual int write(value const& root, std::ostream* sout);
+
+private:
+    void write_value(value const& value);
+    void write_format(int format, uint64_t bits, int size);
+    void write_length(int fix, int format8, int format16, uint64_t length);
+    void write_unsigned(uint64_t number);
+    void write_signed(int64_t number);
+    void write_double(double number);
+    void flush();
+
+    std::string buffer_;
+    bool compact_floats_;
+};
+
+// The buffer goes to the stream when it is this large, and at the end.
+static size_t const msgpack_flush_size = 64 * 1024;
+
+msgpack_stream_writer::msgpack_stream_writer(bool compact_floats)
+    : compact_floats_(compact_floats)
+{
+}
+
+int msgpack_stream_writer::write(value const& root, std::ostream* sout)
+{
+    sout_ = sout;
+    buffer_.clear();
+    write_value(root);
+    flush();
+    sout_ = NULL;
+    return 0;
+}
+
+void msgpack_stream_writer::flush()
+{
+    sout_->write(buffer_.data(), std::streamsize(buffer_.size()));
+    buffer_.clear();
+}
+
+// Append the format byte, then the low 'size' bytes of 'bits', most
+// significant first.
+void msgpack_stream_writer::write_format(int format, uint64_t bits, int size)
+{
+    char bytes[9];
+    bytes[0] = char(format);
+    for (int index = size; index >= 1; --index) {
+        bytes[index] = char(bits & 0xff);
+        bits >>= 8;
+    }
+    buffer_.append(bytes, size_t(size) + 1);
+}
+
+// The header of a str, array or map: the fix format below 'fix_limit', and
+// the 8 (for str), 16 and 32 bit ones after it. format8 is 0 for containers.
+void msgpack_stream_writer::write_length(int fix, int format8, int format16, uint64_t length)
+{
+    int const fix_limit = format8 ? 32 : 16;
+    if (length < uint64_t(fix_limit))
+        buffer_ += char(fix | int(length));
+    else if (format8 && length <= 0xff)
+        write_format(format8, length, 1);
+    else if (length <= 0xffff)
+        write_format(format16, length, 2);
+    else
+        write_format(format16 + 1, length, 4);
+}
+
+void msgpack_stream_writer::write_unsigned(uint64_t number)
+{
+    if (number <= 0x7f)
+        buffer_ += char(number);
+    else if (number <= 0xff)
+        write_format(mf_uint8, number, 1);
+    else if (number <= 0xffff)
+        write_format(mf_uint16, number, 2);
+    else if (number <= 0xffffffffu)
+        write_format(mf_uint32, number, 4);
+    else
+        write_format(mf_uint64, number, 8);
+}
+
+void msgpack_stream_writer::write_signed(int64_t number)
+{
+    if (number >= 0)
+        write_unsigned(uint64_t(number));
+    else if (number >= -32)
+        buffer_ += char(number);
+    else if (number >= std::numeric_limits<int8_t>::min())
+        write_format(mf_int8, uint64_t(number), 1);
+    else if (number >= std::numeric_limits<int16_t>::min())
+        write_format(mf_int16, uint64_t(number), 2);
+    else if (number >= std::numeric_limits<int32_t>::min())
+        write_format(mf_int32, uint64_t(number), 4);
+    else
+        write_format(mf_int64, uint64_t(number), 8);
+}
+
+void msgpack_stream_writer::write_double(double number)
+{
+    // Converting a double out of the range of float is undefined.
+    if (compact_floats_
+        && (std::isnan(number) || std::isinf(number)
+            || (std::fabs(number) <= std::numeric_limits<float>::max()
+                && double(float(number)) == number))) {
+        float single = float(number);
+        uint32_t bits;
+        std::memcpy(&bits, &single, sizeof bits);
+        write_format(mf_float32, bits, 4);
+        return;
+    }
+    uint64_t bits;
+    std::memcpy(&bits, &number, sizeof bits);
+    write_format(mf_float64, bits, 8);
+}
+
+void msgpack_stream_writer::write_value(value const& value)
+{
+    if (buffer_.size() >= msgpack_flush_size)
+        flush();
+    switch (value.type()) {
+    case vt_null:
+        buffer_ += char(mf_nil);
+        break;
+    case vt_int:
+        write_signed(value.as_largest_int());
+        break;
+    case vt_uint:
+        write_unsigned(value.as_largest_uint());
+        break;
+    case vt_real:
+        write_double(value.as_double());
+        break;
+    case vt_string: {
+        char const* str;
+        char const* end;
+        if (!value.get_string(&str, &end))
+            str = end = ""; // a string value that was never given one
+        write_length(0xa0, mf_str8, mf_str16, uint64_t(end - str));
+        buffer_.append(str, size_t(end - str));
+    } break;
+    case vt_bool:
+        buffer_ += char(value.as_bool() ? mf_true : mf_false);
+        break;
+    case vt_array: {
+        array_index size = value.size();
+        write_length(0x90, 0, mf_array16, size);
+        for (array_index index = 0; index < size; ++index)
+            write_value(value[index]);
+    } break;
+    case vt_object:
+        write_length(0x80, 0, mf_map16, value.size());
+        for (value::const_iterator it = value.begin(); it != value.end(); ++it) {
+            char const* end;
+            char const* name = it.member_name(&end);
+            write_length(0xa0, mf_str8, mf_str16, uint64_t(end - name));
+            buffer_.append(name, size_t(end - name));
+            write_value(*it);
+        }
+        break;
+    }
+}
+
+// Class msgpack_char_reader
+// //////////////////////////////////////////////////////////////////
+
+class msgpack_char_reader : public char_reader {
+public:
+    msgpack_char_reader(int stack_limit, bool fail_if_extra, bool reject_dup_keys);
+    virtual bool parse(
+        char const* begin_doc, char const* end_doc,
+        value* root, std::string* errs);
+
+private:
+    bool read_value(value& value, int depth);
+    bool read_bytes(int size, uint64_t* bits);
+    bool read_string(uint64_t length, char const** str, char const** end);
+    bool read_array(value& value, uint64_t length, int depth);
+    bool read_map(value& value, uint64_t length, int depth);
+    bool add_error(std::string const& message, char const* location);
+
+    char const* begin_;
+    char const* end_;
+    char const* current_;
+    std::string error_;
+    int stack_limit_;
+    bool fail_if_extra_;
+    bool reject_dup_keys_;
+};
+
+msgpack_char_reader::msgpack_char_reader(int stack_limit, bool fail_if_extra, bool reject_dup_keys)
+    : begin_(NULL)
+    , end_(NULL)
+    , current_(NULL)
+    , stack_limit_(stack_limit)
+    , fail_if_extra_(fail_if_extra)
+    , reject_dup_keys_(reject_dup_keys)
+{
+}
+
+bool msgpack_char_reader::parse(
+    char const* begin_doc, char const* end_doc,
+    value* root, std::string* errs)
+{
+    begin_ = begin_doc;
+    end_ = end_doc;
+    current_ = begin_doc;
+    error_.clear();
+    bool ok = read_value(*root, 0);
+    if (ok && fail_if_extra_ && current_ != end_)
+        ok = add_error("Extra data after the root object", current_);
+    if (errs)
+        *errs = error_;
+    return ok;
+}
+
+bool msgpack_char_reader::add_error(std::string const& message, char const* location)
+{
+    std::ostringstream oss;
+    oss << "* Byte " << (location - begin_) << "\n  " << message << "\n";
+    error_ = oss.str();
+    return false;
+}
+
+bool msgpack_char_reader::read_bytes(int size, uint64_t* bits)
+{
+    if (end_ - current_ < size)
+        return add_error("Unexpected end of data", current_);
+    *bits = read_big_endian(current_, size);
+    current_ += size;
+    return true;
+}
+
+bool msgpack_char_reader::read_string(uint64_t length, char const** str, char const** end)
+{
+    if (uint64_t(end_ - current_) < length)
+        return add_error("Unexpected end of data", current_);
+    *str = current_;
+    current_ += length;
+    *end = current_;
+    return true;
+}
+
+bool msgpack_char_reader::read_value(value& value, int depth)
+{
+    if (depth > stack_limit_)
+        throw_runtime_error("Exceeded stack_limit in read_value().");
+    char const* start = current_;
+    if (current_ == end_)
+        return add_error("Unexpected end of data", current_);
+    unsigned char format = static_cast<unsigned char>(*current_++);
+    uint64_t bits;
+    if (format <= 0x7f) {
+        json::value(largest_int_t(format)).swap_payload(value);
+    }
+    else if (format >= 0xe0) {
+        json::value(largest_int_t(int8_t(format))).swap_payload(value);
+    }
+    else if (format <= 0x8f) {
+        if (!read_map(value, format & 0x0f, depth))
+            return false;
+    }
+    else if (format <= 0x9f) {
+        if (!read_array(value, format & 0x0f, depth))
+            return false;
+    }
+    else if (format <= 0xbf) {
+        char const* str;
+        char const* end;
+        if (!read_string(format & 0x1f, &str, &end))
+            return false;
+        json::value(str, end).swap_payload(value);
+    }
+    else {
+        switch (format) {
+        case mf_nil:
+            json::value().swap_payload(value);
+            break;
+        case mf_false:
+        case mf_true:
+            json::value(format == mf_true).swap_payload(value);
+            break;
+        case mf_bin8:
+        case mf_bin16:
+        case mf_bin32:
+        case mf_str8:
+        case mf_str16:
+        case mf_str32: {
+            int const length_size = 1 << (format >= mf_str8 ? format - mf_str8 : format - mf_bin8);
+            char const* str;
+            char const* end;
+            if (!read_bytes(length_size, &bits) || !read_string(bits, &str, &end))
+                return false;
+            json::value(str, end).swap_payload(value);
+        } break;
+        case mf_float32: {
+            if (!read_bytes(4, &bits))
+                return false;
+            uint32_t single_bits = uint32_t(bits);
+            float single;
+            std::memcpy(&single, &single_bits, sizeof single);
+            json::value(double(single)).swap_payload(value);
+        } break;
+        case mf_float64: {
+            if (!read_bytes(8, &bits))
+                return false;
+            double number;
+            std::memcpy(&number, &bits, sizeof number);
+            json::value(number).swap_payload(value);
+        } break;
+        case mf_uint8:
+        case mf_uint16:
+        case mf_uint32:
+        case mf_uint64:
+            if (!read_bytes(1 << (format - mf_uint8), &bits))
+                return false;
+            if (bits <= uint64_t(json::value::max_largest_int))
+                json::value(largest_int_t(bits)).swap_payload(value);
+            else
+                json::value(largest_uint_t(bits)).swap_payload(value);
+            break;
+        case mf_int8:
+        case mf_int16:
+        case mf_int32:
+        case mf_int64: {
+            int const size = 1 << (format - mf_int8);
+            if (!read_bytes(size, &bits))
+                return false;
+            // Sign-extend from the top bit of the 'size' bytes read.
+            int const shift = 64 - 8 * size;
+            json::value(largest_int_t(int64_t(bits << shift) >> shift)).swap_payload(value);
+        } break;
+        case mf_array16:
+        case mf_array32:
+            if (!read_bytes(format == mf_array16 ? 2 : 4, &bits) || !read_array(value, bits, depth))
+                return false;
+            break;
+        case mf_map16:
+        case mf_map32:
+            if (!read_bytes(format == mf_map16 ? 2 : 4, &bits) || !read_map(value, bits, depth))
+                return false;
+            break;
+        case mf_never_used:
+            return add_error("Format 0xc1 is never used", start);
+        default:
+            return add_error("Extension types are not supported", start);
+        }
+    }
+    value.set_offset_start(size_t(start - begin_));
+    value.set_offset_limit(size_t(current_ - begin_));
+    return true;
+}
+
+bool msgpack_char_reader::read_array(value& value, uint64_t length, int depth)
+{
+    json::value(vt_array).swap_payload(value);
+    // Each object takes a byte at least, so a count beyond the data is an
+    // error rather than a reason to allocate.
+    if (uint64_t(end_ - current_) < length)
+        return add_error("Unexpected end of data", current_);
+    if (length)
+        value.resize(array_index(length));
+    for (array_index index = 0; index != length; ++index) {
+        if (!read_value(value[index], depth + 1))
+            return false;
+    }
+    return true;
+}
+
+bool msgpack_char_reader::read_map(value& value, uint64_t length, int depth)
+{
+    json::value(vt_object).swap_payload(value);
+    if (uint64_t(end_ - current_) / 2 < length)
+        return add_error("Unexpected end of data", current_);
+    bool ok = true;
+    for (uint64_t count = 0; count != length; ++count) {
+        char const* start = current_;
+        if (current_ == end_)
+            return add_error("Unexpected end of data", current_);
+        unsigned char format = static_cast<unsigned char>(*current_++);
+        uint64_t length_bits;
+        if (format >= 0xa0 && format <= 0xbf)
+            length_bits = format & 0x1f;
+        else if (format >= mf_str8 && format <= mf_str32)
+            ok = read_bytes(1 << (format - mf_str8), &length_bits);
+        else if (format >= mf_bin8 && format <= mf_bin32)
+            ok = read_bytes(1 << (format - mf_bin8), &length_bits);
+        else
+            return add_error("Map key is not a string", start);
+        if (!ok)
+            return false;
+        char const* name;
+        char const* end;
+        if (!read_string(length_bits, &name, &end))
+            return false;
+        if (reject_dup_keys_ && value.find(name, end))
+            return add_error("Duplicate key: '" + std::string(name, end) + "'", start);
+        if (!read_value(*value.demand(name, end), depth + 1))
+            return false;
+    }
+    return true;
+}
+
+// Class msgpack_reader_builder
+// //////////////////////////////////////////////////////////////////
+
+msgpack_reader_builder::msgpack_reader_builder()
+{
+    set_defaults(&settings_);
+}
+msgpack_reader_builder::~msgpack_reader_builder()
+{
+}
+char_reader* msgpack_reader_builder::new_char_reader() const
+{
+    return new msgpack_char_reader(
+        settings_["stack_limit"].as_int(),
+        settings_["fail_if_extra"].as_bool(),
+        settings_["reject_dup_keys"].as_bool());
+}
+static void get_valid_msgpack_reader_keys(std::set<std::string>* valid_keys)
+{
+    valid_keys->clear();
+    valid_keys->insert("stack_limit");
+    valid_keys->insert("fail_if_extra");
+    valid_keys->insert("reject_dup_keys");
+}
+bool msgpack_reader_builder::validate(json::value* invalid) const
+{
+    json::value my_invalid;
+    if (!invalid)
+        invalid = &my_invalid; // so we do not need to test for NULL
+    json::value& inv = *invalid;
+    std::set<std::string> valid_keys;
+    get_valid_msgpack_reader_keys(&valid_keys);
+    value::members keys = settings_.get_member_names();
+    size_t n = keys.size();
+    for (size_t i = 0; i < n; ++i) {
+        std::string const& key = keys[i];
+        if (valid_keys.find(key) == valid_keys.end()) {
+            inv[key] = settings_[key];
+        }
+    }
+    return 0u == inv.size();
+}
+value& msgpack_reader_builder::operator[](std::string key)
+{
+    return settings_[key];
+}
+// static
+void msgpack_reader_builder::set_defaults(json::value* settings)
+{
+    (*settings)["stack_limit"] = 1000;
+    (*settings)["fail_if_extra"] = true;
+    (*settings)["reject_dup_keys"] = false;
+}
+
+// Class msgpack_stream
+// //////////////////////////////////////////////////////////////////
+
+msgpack_stream::msgpack_stream(msgpack_reader_builder const& builder)
+    : reader_(builder.new_char_reader())
+    , read_(0)
+    , scanned_(0)
+    , pending_(1)
+{
+}
+
+msgpack_stream::~msgpack_stream()
+{
+    delete reader_;
+}
+
+void msgpack_stream::feed(char const* begin, char const* end)
+{
+    // Drop the messages read, once they are most of the buffer.
+    if (read_ && read_ >= buffer_.size() - read_) {
+        buffer_.erase(0, read_);
+        scanned_ -= read_;
+        read_ = 0;
+    }
+    buffer_.append(begin, end);
+}
+
+// Pass over the objects of the next message that are all there.
+// \return true if the message is.
+bool msgpack_stream::scan()
+{
+    char const* data = buffer_.data();
+    char const* end = data + buffer_.size();
+    while (pending_) {
+        uint64_t size;
+        uint64_t children;
+        if (!measure_object(data + scanned_, end, &size, &children)
+            || uint64_t(end - data - scanned_) < size)
+            return false;
+        scanned_ += size_t(size);
+        pending_ += children - 1;
+    }
+    return true;
+}
+
+bool msgpack_stream::next(value* root)
+{
+    errors_.clear();
+    if (!scan())
+        return false;
+    char const* begin = buffer_.data() + read_;
+    char const* end = buffer_.data() + scanned_;
+    read_ = scanned_;
+    pending_ = 1;
+    return reader_->parse(begin, end, root, &errors_);
+}
+
+bool msgpack_stream::good() const
+{
+    return errors_.empty();
+}
+
+std::string msgpack_stream::get_formatted_messages() const
+{
+    return errors_;
+}
+
+size_t msgpack_stream::buffered() const
+{
+    return buffer_.size() - read_;
+}
+
+void msgpack_stream::reset()
+{
+    buffer_.clear();
+    read_ = 0;
+    scanned_ = 0;
+    pending_ = 1;
+    errors_.clear();
+}
+
+// Class msgpack_writer_builder
+// //////////////////////////////////////////////////////////////////
+
+msgpack_writer_builder::msgpack_writer_builder()
+{
+    set_defaults(&settings_);
+}
+msgpack_writer_builder::~msgpack_writer_builder()
+{
+}
+stream_writer* msgpack_writer_builder::new_stream_writer() const
+{
+    return new msgpack_stream_writer(settings_["compact_floats"].as_bool());
+}
+static void get_valid_msgpack_writer_keys(std::set<std::string>* valid_keys)
+{
+    valid_keys->clear();
+    valid_keys->insert("compact_floats");
+}
+bool msgpack_writer_builder::validate(json::value* invalid) const
+{
+    json::value my_invalid;
+    if (!invalid)
+        invalid = &my_invalid; // so we do not need to test for NULL
+    json::value& inv = *invalid;
+    std::set<std::string> valid_keys;
+    get_valid_msgpack_writer_keys(&valid_keys);
+    value::members keys = settings_.get_member_names();
+    size_t n = keys.size();
+    for (size_t i = 0; i < n; ++i) {
+        std::string const& key = keys[i];
+        if (valid_keys.find(key) == valid_keys.end()) {
+            inv[key] = settings_[key];
+        }
+    }
+    return 0u == inv.size();
+}
+value& msgpack_writer_builder::operator[](std::string key)
+{
+    return settings_[key];
+}
+// static
+void msgpack_writer_builder::set_defaults(json::value* settings)
+{
+    (*settings)["compact_floats"] = true;
+}
+
+} // namespace json
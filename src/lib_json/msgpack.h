@@ -0,0 +1,216 @@
+// Derived from public-domain/MIT-licensed code at
+// https://github.com/open-source-parsers/jsoncpp. Thanks, Baptiste Lepilleur!
+
+#pragma once
+
+#include "reader.h"
+#include "writer.h"
+#include <string>
+
+// Disable warning C4251: <data member>: <type> needs to have dll-interface to
+// be used by...
+#if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+#pragma warning(push)
+#pragma warning(disable : 4251)
+#endif // if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+
+namespace json {
+
+/** \brief Build a char_reader that reads <a HREF="https://msgpack.org">MessagePack</a>
+ * instead of JSON text.
+
+Usage:
+\code
+  json::msgpack_reader_builder builder;
+  std::unique_ptr<json::char_reader> reader(builder.new_char_reader());
+  json::value root;
+  std::string errs;
+  bool ok = reader->parse(bytes.data(), bytes.data() + bytes.size(), &root, &errs);
+\endcode
+
+Objects map to values as follows:
+- unsigned integers become vt_int if they fit in largest_int_t, vt_uint
+  otherwise, and signed integers become vt_int, as the JSON reader types
+  numbers. A value read from JSON text thus comes back from
+  msgpack_writer_builder with the same type and value.
+- float 32 and float 64 become vt_real, exactly.
+- str and bin become vt_string; neither is checked for UTF-8.
+- arrays and maps become vt_array and vt_object; map keys must be str or bin.
+- nil, false and true become vt_null and vt_bool.
+- extension types are an error.
+
+Values get the offsets of their bytes (see value::get_offset_start()).
+Errors are reported by byte offset. To read messages as they arrive on a
+socket, see msgpack_stream.
+*/
+class JSON_API msgpack_reader_builder : public char_reader::factory {
+public:
+	/** Configuration of this builder.
+	Available settings (case-sensitive):
+	- `"stack_limit": integer`
+	  - Nesting deeper than this throws, as with char_reader_builder.
+	- `"fail_if_extra": false or true`
+	  - If true (the default), `parse()` returns false when bytes follow the
+		root object.
+	- `"reject_dup_keys": false or true`
+	  - If true, `parse()` returns false when a key is duplicated within a
+		map. Otherwise the last one wins.
+
+	You can examine 'settings_` yourself
+	to see the defaults. You can also write and read them just like any
+	JSON value.
+	\sa set_defaults()
+	*/
+	json::value settings_;
+
+	msgpack_reader_builder();
+	virtual ~msgpack_reader_builder();
+
+	virtual char_reader* new_char_reader() const;
+
+	/** \return true if 'settings' are legal and consistent;
+   *   otherwise, indicate bad settings via 'invalid'.
+   */
+	bool validate(json::value* invalid) const;
+
+	/** A simple way to update a specific setting.
+   */
+	value& operator[](std::string key);
+
+	/** Called by ctor, but you can use this to reset settings_.
+   * \pre 'settings' != NULL (but json::null is fine)
+   */
+	static void set_defaults(json::value* settings);
+};
+
+/** \brief Reads MessagePack messages from data that arrives in pieces of
+ * any size, as from a socket.
+
+Usage:
+\code
+  json::msgpack_reader_builder builder;
+  json::msgpack_stream in(builder);
+  while ((count = recv(fd, buffer, sizeof buffer, 0)) > 0) {
+    in.feed(buffer, buffer + count);
+    json::value message;
+    while (in.next(&message))
+      handle(message);
+    if (!in.good())
+      log(in.get_formatted_messages());
+  }
+\endcode
+
+Messages are objects written one after the other, with nothing between
+them. MessagePack gives the length of every string and the count of every
+container up front, so where a message ends is known without decoding it:
+feed() only looks at the headers of the new bytes, and a message is decoded
+once, when all of it is there. Feeding a message byte by byte costs about
+as much as feeding it whole.
+
+The data fed is kept until the messages in it are read, so a stream that
+is fed more than it is read grows without bound.
+*/
+class JSON_API msgpack_stream {
+public:
+	/// Decodes as the char_reader of 'builder' would, but its "fail_if_extra"
+	/// is ignored.
+	/// \throw std::exception on invalid settings, like new_char_reader().
+	explicit msgpack_stream(msgpack_reader_builder const& builder);
+	~msgpack_stream();
+
+	/// Append [begin, end) to the data to read.
+	void feed(char const* begin, char const* end);
+
+	/** Read the next message.
+	 * \return true, with the message in *root. false if the data fed so far
+	 *   ends before the next message does, or if the message is invalid;
+	 *   good() then tells which. An invalid message is passed over, so that
+	 *   the messages after it can still be read.
+	 * \throw std::exception if the message is nested deeper than
+	 *   "stack_limit".
+	 */
+	bool next(value* root);
+
+	/// false if the last call to next() read an invalid message.
+	bool good() const;
+
+	/// Why the last message was invalid, with offsets from its first byte,
+	/// or an empty string.
+	std::string get_formatted_messages() const;
+
+	/// Number of bytes fed but not read yet.
+	size_t buffered() const;
+
+	/// Drop the data fed so far.
+	void reset();
+
+private:
+	msgpack_stream(msgpack_stream const&); // no impl
+	msgpack_stream& operator=(msgpack_stream const&); // no impl
+
+	bool scan();
+
+	char_reader* reader_;
+	std::string buffer_;
+	size_t read_; // offset in buffer_ of the next message
+	size_t scanned_; // offset in buffer_ up to which whole objects were seen
+	uint64_t pending_; // objects of the next message not seen yet
+	std::string errors_;
+};
+
+/** \brief Build a stream_writer that writes <a HREF="https://msgpack.org">MessagePack</a>
+ * instead of JSON text.
+
+Usage:
+\code
+  json::msgpack_writer_builder builder;
+  std::string bytes = json::write_string(builder, root);
+\endcode
+
+Integers are written in the smallest format that holds them, vt_real as
+floats (never as integers, so that they stay vt_real), strings as str, and
+containers as array and map. Comments are not written. Nothing is
+formatted or escaped, so writing costs little more than copying.
+*/
+class JSON_API msgpack_writer_builder : public stream_writer::factory {
+public:
+	/** Configuration of this builder.
+	Available settings (case-sensitive):
+	- "compact_floats": false or true
+	  - If true (the default), write a double as float 32 when that holds it
+		exactly. If false, always write float 64.
+
+	You can examine 'settings_` yourself
+	to see the defaults. You can also write and read them just like any
+	JSON value.
+	\sa set_defaults()
+	*/
+	json::value settings_;
+
+	msgpack_writer_builder();
+	virtual ~msgpack_writer_builder();
+
+	/**
+   * \throw std::exception if something goes wrong (e.g. invalid settings)
+   */
+	virtual stream_writer* new_stream_writer() const;
+
+	/** \return true if 'settings' are legal and consistent;
+   *   otherwise, indicate bad settings via 'invalid'.
+   */
+	bool validate(json::value* invalid) const;
+	/** A simple way to update a specific setting.
+   */
+	value& operator[](std::string key);
+
+	/** Called by ctor, but you can use this to reset settings_.
+   * \pre 'settings' != NULL (but json::null is fine)
+   */
+	static void set_defaults(json::value* settings);
+};
+
+} // namespace json
+
+#if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+#pragma warning(pop)
+#endif // if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
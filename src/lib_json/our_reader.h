@@ -0,0 +1,227 @@
+// Derived from public-domain/MIT-licensed code at
+// https://github.com/open-source-parsers/jsoncpp. Thanks, Baptiste Lepilleur!
+
+#pragma once
+
+/* This header declares the parser behind char_reader_builder, so that the
+ * alternative document representations (tape, lazy_document, ...) can share
+ * its tokenizer and error reporting.
+ *
+ * It is an internal header that must not be exposed.
+ */
+
+#include "cursor.h"
+#include "reader.h"
+#include "structural_index.h"
+#include <deque>
+#include <stack>
+#include <string>
+#include <vector>
+
+namespace json {
+
+class tape_builder;
+class lazy_document;
+
+// exact copy of features
+class our_features {
+public:
+	static our_features all();
+	our_features();
+	bool allow_comments_;
+	bool strict_root_;
+	bool allow_dropped_null_placeholders_;
+	bool allow_numeric_keys_;
+	bool allow_single_quotes_;
+	bool fail_if_extra_;
+	bool reject_dup_keys_;
+	bool use_structural_index_; // "engine": "simd"
+	bool keep_source_;
+	bool dedupe_;
+	int stack_limit_;
+	int threads_; // for a top-level array; 0 for one per core
+}; // our_features
+
+our_features make_features(value const& settings);
+
+// exact copy of reader, renamed to our_reader
+class our_reader {
+public:
+	typedef const char* location_t;
+	struct structured_error {
+		size_t offset_start;
+		size_t offset_limit;
+		std::string message;
+	};
+
+	our_reader(our_features const& features);
+	bool parse(const char* begin_doc,
+		const char* end_doc,
+		value& root,
+		bool collect_comments = true);
+	bool parse(const char* begin_doc,
+		const char* end_doc,
+		tape& root);
+	bool parse(const char* begin_doc,
+		const char* end_doc,
+		lazy_document& root);
+	/// Decode the children of the container at doc.nodes_[index].
+	bool expand(lazy_document const& doc, size_t index);
+	/// Read the elements in one slice of a top-level array, for parse_slices().
+	bool read_slice(location_t begin_doc,
+		location_t slice_begin,
+		location_t slice_end,
+		value& elements);
+	/// Pull parsing, for cursor.
+	void start_pull(const char* begin_doc, const char* end_doc);
+	event_type pull();
+	bool skip_pulled();
+	event_type pulled_event() const { return pulled_event_; }
+	size_t pulled_start() const { return pulled_.start_ - begin_; }
+	size_t pulled_limit() const { return pulled_.end_ - begin_; }
+	int pulled_depth() const;
+	bool pulled_string(char const** str, char const** end);
+	bool decode_pulled(value& decoded);
+	bool fail_pulled(std::string const& message);
+	std::string get_formatted_messages() const;
+	std::vector<structured_error> get_structured_errors() const;
+	bool push_error(value const&, std::string const& message);
+	bool push_error(value const&, std::string const& message, class value const& extra);
+	bool good() const;
+
+private:
+	our_reader(our_reader const&); // no impl
+	void operator=(our_reader const&); // no impl
+
+	enum token_type {
+		tt_end_of_stream = 0,
+		tt_object_begin,
+		tt_object_end,
+		tt_array_begin,
+		tt_array_end,
+		tt_string,
+		tt_number,
+		tt_true,
+		tt_false,
+		tt_null,
+		tt_array_separator,
+		tt_member_separator,
+		tt_comment,
+		tt_error
+	};
+
+	class token {
+	public:
+		token_type type_;
+		location_t start_;
+		location_t end_;
+	};
+
+	class error_info {
+	public:
+		token token_;
+		std::string message_;
+		location_t extra_;
+	};
+
+	typedef std::deque<error_info> errors;
+
+	void start_index();
+	bool read_token(token& token);
+	void skip_spaces();
+	void skip_spaces_indexed();
+	bool read_string_indexed();
+	template <typename Sink>
+	bool walk_index(Sink& out);
+	bool ends_token(location_t at, size_t next) const;
+	bool parse_slices(value& root, bool& successful);
+	bool find_elements(std::vector<size_t>& separators);
+	bool match(location_t pattern, int pattern_length);
+	bool read_comment();
+	bool read_c_style_comment();
+	bool read_cpp_style_comment();
+	bool read_string();
+	bool read_string_single_quote();
+	void read_number();
+	bool read_value();
+	bool read_object(token& token);
+	bool read_array(token& token);
+	bool read_value(tape_builder& out);
+	bool read_object(token& token, tape_builder& out);
+	bool read_array(token& token, tape_builder& out);
+	bool read_value(lazy_document const& doc);
+	bool read_object(lazy_document const& doc);
+	bool read_array(lazy_document const& doc);
+	bool skip_container(token& token_start);
+	bool skip_container_indexed();
+	bool decode_number(token& token);
+	bool decode_number(token& token, value& decoded);
+	bool decode_string(token& token);
+	bool decode_string(token& token, std::string& decoded);
+	bool decode_string(token& token, tape_builder& out);
+	bool decode_double(token& token);
+	bool decode_double(token& token, value& decoded);
+	bool decode_unicode_codepoint(token& token,
+		location_t& current,
+		location_t end,
+		unsigned int& unicode);
+	bool decode_unicode_escape_sequence(token& token,
+		location_t& current,
+		location_t end,
+		unsigned int& unicode);
+	bool add_error(std::string const& message, token& token, location_t extra = 0);
+	bool recover_from_error(token_type skip_until_token);
+	bool add_error_and_recover(std::string const& message,
+		token& token,
+		token_type skip_until_token);
+	void skip_until_space();
+	event_type pull_value(token& token);
+	event_type pull_close(token& token);
+	event_type pull_error(std::string const& message, token& token);
+	bool pull_failed();
+	value& current_value();
+	char get_next_char();
+	void get_location_line_and_column(location_t location, int& line, int& column) const;
+	std::string get_location_line_and_column(location_t location) const;
+	void add_comment(location_t begin, location_t end, comment_placement placement);
+	void skip_comment_tokens(token& token);
+
+	typedef std::stack<value*> nodes;
+	nodes nodes_;
+	errors errors_;
+	std::string document_;
+	location_t begin_;
+	location_t end_;
+	location_t current_;
+	location_t last_value_end_;
+	value* last_value_;
+	std::string comments_before_;
+	std::string scratch_; // reused for escaped strings, to avoid allocations
+	std::string closers_; // see skip_container()
+	structural_index index_;
+	bool indexed_; // tokens are located through index_
+	size_t next_; // first entry of index_ that may be at or after current_
+	int stack_depth_;
+
+	enum pull_state {
+		ps_value,
+		ps_first_member,
+		ps_member,
+		ps_colon,
+		ps_first_element,
+		ps_separator,
+		ps_done
+	};
+	std::string containers_; // '}' or ']' for each container open in pull()
+	pull_state pull_state_;
+	event_type pulled_event_;
+	bool empty_key_; // the last member name pulled was ""
+	token pulled_;
+	std::string pulled_text_; // decoded string of pulled_, if it had escapes
+
+	our_features const features_;
+	bool collect_comments_;
+	bool saw_comment_;
+}; // our_reader
+
+} // namespace json
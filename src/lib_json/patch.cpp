@@ -0,0 +1,749 @@
+// Derived from public-domain/MIT-licensed code at
+// https://github.com/open-source-parsers/jsoncpp. Thanks, Baptiste Lepilleur!
+
+#include "patch.h"
+#include "tool.h"
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+namespace json {
+
+// A JSON Pointer, as written and as decoded into its reference tokens.
+struct pointer {
+    std::string text;
+    std::vector<std::string> tokens;
+};
+
+// Decode an RFC 6901 pointer. \return false if 'text' is not one.
+static bool parse_pointer(std::string const& text, pointer* out)
+{
+    out->text = text;
+    out->tokens.clear();
+    if (text.empty())
+        return true;
+    if (text[0] != '/')
+        return false;
+    std::string token;
+    for (size_t i = 1; i <= text.size(); ++i) {
+        if (i == text.size() || text[i] == '/') {
+            out->tokens.push_back(token);
+            token.clear();
+            continue;
+        }
+        char c = text[i];
+        if (c == '~') {
+            char escaped = i + 1 < text.size() ? text[++i] : 0;
+            if (escaped == '0')
+                c = '~';
+            else if (escaped == '1')
+                c = '/';
+            else
+                return false;
+        }
+        token += c;
+    }
+    return true;
+}
+
+// An array index: decimal digits, without leading zeros.
+static bool parse_index(std::string const& token, array_index* out)
+{
+    if (token.empty() || token.size() > 10 || (token[0] == '0' && token.size() > 1))
+        return false;
+    largest_uint_t index = 0;
+    for (size_t i = 0; i < token.size(); ++i) {
+        if (token[i] < '0' || token[i] > '9')
+            return false;
+        index = index * 10 + (token[i] - '0');
+    }
+    if (index >= value::max_uint)
+        return false;
+    *out = array_index(index);
+    return true;
+}
+
+// Equality of RFC 6902 "test": numbers are equal by value.
+static bool same(value const& a, value const& b)
+{
+    if (is_number(a) && is_number(b))
+        return compare_numbers(a, b) == 0;
+    if (a.type() != b.type())
+        return false;
+    if (a.is_array()) {
+        if (a.size() != b.size())
+            return false;
+        for (array_index i = 0; i < a.size(); ++i) {
+            if (!same(a[i], b[i]))
+                return false;
+        }
+        return true;
+    }
+    if (a.is_object()) {
+        if (a.size() != b.size())
+            return false;
+        // Members are sorted by name in both.
+        value::const_iterator it = a.begin();
+        value::const_iterator other = b.begin();
+        for (; it != a.end(); ++it, ++other) {
+            char const* end;
+            char const* name = it.member_name(&end);
+            char const* other_end;
+            char const* other_name = other.member_name(&other_end);
+            if (end - name != other_end - other_name
+                || memcmp(name, other_name, end - name) != 0
+                || !same(*it, *other))
+                return false;
+        }
+        return true;
+    }
+    return a == b;
+}
+
+// Swap 'moved' into 'container': as the member named 'token', which must not
+// exist, or as the element inserted at index 'token', which must be at most
+// the size.
+static void insert_at(value& container, std::string const& token, value& moved)
+{
+    if (container.is_object()) {
+        container.demand(token.data(), token.data() + token.size())->swap(moved);
+        return;
+    }
+    array_index index = 0;
+    parse_index(token, &index);
+    for (array_index i = container.size(); i > index; --i)
+        container[i].swap(container[i - 1]);
+    container[index].swap(moved);
+}
+
+// Swap the member or element 'token' out of 'container', into *taken.
+static void take_at(value& container, std::string const& token, value* taken)
+{
+    if (container.is_object()) {
+        container.remove_member(token.data(), token.data() + token.size(), taken);
+        return;
+    }
+    array_index index = 0;
+    parse_index(token, &index);
+    container[index]; // an element the array was never given is a null to take
+    container.remove_index(index, taken);
+}
+
+static std::string quoted(std::string const& text)
+{
+    return "\"" + text + "\"";
+}
+
+// Class patcher
+// //////////////////////////////////////////////////////////////////
+
+// Applies the operations of a patch to a document, logging how to undo each
+// change it makes.
+class patcher {
+public:
+    explicit patcher(value& doc);
+
+    bool apply(value const& operation, std::string* why);
+    void rollback();
+
+private:
+    enum undo_kind {
+        undo_add, // take out what was added, into carry_
+        undo_remove, // put back what was removed
+        undo_replace // swap back what was replaced
+    };
+    struct undo {
+        undo_kind kind;
+        std::vector<std::string> tokens; // of the place, with indices in full
+        value saved; // what was removed or replaced
+        bool in_carry; // what was removed is in carry_ rather than saved
+    };
+
+    patcher(patcher const&); // no impl
+    patcher& operator=(patcher const&); // no impl
+
+    bool read_pointer(value const& operation, char const* name, pointer* out,
+        std::string* why) const;
+    value const* find(std::vector<std::string> const& tokens, size_t count) const;
+    value* resolve(std::vector<std::string> const& tokens, size_t count);
+    value* container_of(pointer const& at, std::string* why);
+    undo& log(undo_kind kind, std::vector<std::string> const& tokens);
+
+    bool add(pointer const& at, value& added, std::string* why);
+    bool remove(pointer const& at, bool into_carry, std::string* why);
+    void replace(pointer const& at, value& target, value& replacement);
+
+    value& doc_;
+    std::deque<undo> undo_; // a deque, so that saved values are never copied
+    value carry_; // a value on its way from "from" to "path" in a move
+};
+
+patcher::patcher(value& doc)
+    : doc_(doc)
+{
+}
+
+bool patcher::read_pointer(value const& operation, char const* name, pointer* out,
+    std::string* why) const
+{
+    value const* text = operation.find(name, name + strlen(name));
+    if (!text || !text->isString()) {
+        *why = std::string("missing \"") + name + "\"";
+        return false;
+    }
+    if (!parse_pointer(text->as_string(), out)) {
+        *why = quoted(text->as_string()) + " is not a JSON Pointer";
+        return false;
+    }
+    return true;
+}
+
+// The value at the first 'count' tokens, or NULL.
+value const* patcher::find(std::vector<std::string> const& tokens, size_t count) const
+{
+    value const* node = &doc_;
+    for (size_t i = 0; i < count && node; ++i) {
+        std::string const& token = tokens[i];
+        if (node->is_object()) {
+            node = node->find(token.data(), token.data() + token.size());
+        }
+        else if (node->is_array()) {
+            array_index index;
+            node = parse_index(token, &index) && index < node->size() ? &(*node)[index] : NULL;
+        }
+        else {
+            node = NULL;
+        }
+    }
+    return node;
+}
+
+// The same, to be changed: it is reached through the non-const members of
+// the values on the way, so that they know (see value::touch()).
+value* patcher::resolve(std::vector<std::string> const& tokens, size_t count)
+{
+    if (!find(tokens, count))
+        return NULL;
+    value* node = &doc_;
+    for (size_t i = 0; i < count; ++i) {
+        std::string const& token = tokens[i];
+        if (node->is_object()) {
+            node = node->demand(token.data(), token.data() + token.size());
+        }
+        else {
+            array_index index = 0;
+            parse_index(token, &index);
+            node = &(*node)[index];
+        }
+    }
+    return node;
+}
+
+// The object or array in which the last token of 'at' is looked up.
+value* patcher::container_of(pointer const& at, std::string* why)
+{
+    value* container = resolve(at.tokens, at.tokens.size() - 1);
+    if (!container || !(container->is_object() || container->is_array())) {
+        *why = "the parent of " + quoted(at.text) + " is not an object or an array";
+        return NULL;
+    }
+    return container;
+}
+
+patcher::undo& patcher::log(undo_kind kind, std::vector<std::string> const& tokens)
+{
+    undo_.push_back(undo());
+    undo& added = undo_.back();
+    added.kind = kind;
+    added.tokens = tokens;
+    added.in_carry = false;
+    return added;
+}
+
+// Swap 'added' into the document at 'at'.
+bool patcher::add(pointer const& at, value& added, std::string* why)
+{
+    if (at.tokens.empty()) {
+        replace(at, doc_, added);
+        return true;
+    }
+    value* container = container_of(at, why);
+    if (!container)
+        return false;
+    std::string const& token = at.tokens.back();
+    if (container->is_object()) {
+        if (container->find(token.data(), token.data() + token.size())) {
+            replace(at, *container->demand(token.data(), token.data() + token.size()), added);
+            return true;
+        }
+        log(undo_add, at.tokens);
+        insert_at(*container, token, added);
+        return true;
+    }
+    array_index index = container->size();
+    if (token != "-" && (!parse_index(token, &index) || index > container->size())) {
+        *why = quoted(at.text) + " is not an index of the array, or its end";
+        return false;
+    }
+    std::ostringstream oss;
+    oss << index;
+    undo& logged = log(undo_add, at.tokens);
+    logged.tokens.back() = oss.str();
+    insert_at(*container, logged.tokens.back(), added);
+    return true;
+}
+
+// Swap the value at 'at' out of the document, keeping it for undo(), or into
+// carry_ for a move.
+bool patcher::remove(pointer const& at, bool into_carry, std::string* why)
+{
+    if (at.tokens.empty()) {
+        *why = "the document itself cannot be removed";
+        return false;
+    }
+    if (!find(at.tokens, at.tokens.size())) {
+        *why = "no value at " + quoted(at.text);
+        return false;
+    }
+    value* container = resolve(at.tokens, at.tokens.size() - 1);
+    undo& logged = log(undo_remove, at.tokens);
+    logged.in_carry = into_carry;
+    take_at(*container, at.tokens.back(), into_carry ? &carry_ : &logged.saved);
+    return true;
+}
+
+// Swap 'replacement' in as the payload of 'target', the value at 'at'. Its
+// comments stay in place.
+void patcher::replace(pointer const& at, value& target, value& replacement)
+{
+    undo& logged = log(undo_replace, at.tokens);
+    target.swap_payload(replacement);
+    logged.saved.swap(replacement);
+}
+
+bool patcher::apply(value const& operation, std::string* why)
+{
+    value const* name = operation.is_object() ? operation.find("op", "op" + 2) : NULL;
+    if (!name || !name->isString()) {
+        *why = "missing \"op\"";
+        return false;
+    }
+    std::string op = name->as_string();
+    pointer at;
+    if (!read_pointer(operation, "path", &at, why))
+        return false;
+    if (op == "remove")
+        return remove(at, false, why);
+    if (op == "move" || op == "copy") {
+        pointer from;
+        if (!read_pointer(operation, "from", &from, why))
+            return false;
+        value const* source = find(from.tokens, from.tokens.size());
+        if (!source) {
+            *why = "no value at " + quoted(from.text);
+            return false;
+        }
+        if (op == "copy") {
+            value copy(*source);
+            return add(at, copy, why);
+        }
+        if (from.tokens == at.tokens)
+            return true;
+        if (from.tokens.size() < at.tokens.size()
+            && std::equal(from.tokens.begin(), from.tokens.end(), at.tokens.begin())) {
+            *why = quoted(from.text) + " cannot be moved into itself";
+            return false;
+        }
+        // If add() fails, undoing the remove puts carry_ back.
+        return remove(from, true, why) && add(at, carry_, why);
+    }
+    value const* given = operation.find("value", "value" + 5);
+    if (!given) {
+        *why = "missing \"value\"";
+        return false;
+    }
+    if (op == "add") {
+        value added(*given);
+        return add(at, added, why);
+    }
+    if (op == "replace" || op == "test") {
+        value const* target = find(at.tokens, at.tokens.size());
+        if (!target) {
+            *why = "no value at " + quoted(at.text);
+            return false;
+        }
+        if (op == "test") {
+            if (same(*target, *given))
+                return true;
+            *why = "the value at " + quoted(at.text) + " is not the one given";
+            return false;
+        }
+        value replacement(*given);
+        replace(at, *resolve(at.tokens, at.tokens.size()), replacement);
+        return true;
+    }
+    *why = "unknown operation " + quoted(op);
+    return false;
+}
+
+void patcher::rollback()
+{
+    while (!undo_.empty()) {
+        undo& last = undo_.back();
+        std::vector<std::string> const& tokens = last.tokens;
+        switch (last.kind) {
+        case undo_add:
+            take_at(*resolve(tokens, tokens.size() - 1), tokens.back(), &carry_);
+            break;
+        case undo_remove:
+            insert_at(*resolve(tokens, tokens.size() - 1), tokens.back(),
+                last.in_carry ? carry_ : last.saved);
+            break;
+        case undo_replace:
+            resolve(tokens, tokens.size())->swap_payload(last.saved);
+            carry_.swap(last.saved);
+            break;
+        }
+        undo_.pop_back();
+    }
+}
+
+bool apply_patch(value& doc, value const& patch, std::string* errs)
+{
+    if (!patch.is_array()) {
+        if (errs)
+            *errs = "A patch must be an array of operations";
+        return false;
+    }
+    patcher applying(doc);
+    std::string why;
+    for (array_index i = 0; i < patch.size(); ++i) {
+        if (!applying.apply(patch[i], &why)) {
+            applying.rollback();
+            if (errs) {
+                std::ostringstream oss;
+                oss << "Operation " << i << ": " << why;
+                *errs = oss.str();
+            }
+            return false;
+        }
+    }
+    return true;
+}
+
+// Class differ
+// //////////////////////////////////////////////////////////////////
+
+// Builds the patch of diff(), walking both documents together.
+class differ {
+public:
+    explicit differ(value* patch);
+
+    void compare(value const& from, value const& to, std::string* at);
+
+private:
+    typedef std::vector<value const*> elements;
+
+    differ(differ const&); // no impl
+    differ& operator=(differ const&); // no impl
+
+    uint64_t hash(value const& v);
+    uint64_t hash(value const& v, size_t* nodes);
+    bool equal(value const& a, value const& b);
+    void compare_objects(value const& from, value const& to, std::string* at);
+    void compare_arrays(value const& from, value const& to, std::string* at);
+    void compare_runs(elements const& from, size_t from_begin, size_t from_end,
+        elements const& to, size_t to_begin, size_t to_end, std::string* at,
+        array_index* position);
+    void emit(char const* op, std::string const& at, value const* added);
+
+    // Hashes of the containers of more than memo_threshold values.
+    static size_t const memo_threshold = 32;
+
+    value* patch_;
+    std::unordered_map<value const*, uint64_t> hashes_;
+};
+
+// Append the reference token 'token' to the pointer 'at', escaped.
+static void append_token(std::string* at, char const* token, char const* end)
+{
+    *at += '/';
+    for (; token != end; ++token) {
+        if (*token == '~')
+            *at += "~0";
+        else if (*token == '/')
+            *at += "~1";
+        else
+            *at += *token;
+    }
+}
+
+static void append_index(std::string* at, array_index index)
+{
+    char digits[16];
+    char* end = digits + sizeof digits;
+    char* current = end;
+    do {
+        *--current = char('0' + index % 10);
+        index /= 10;
+    } while (index);
+    append_token(at, current, end);
+}
+
+// The elements of an array, for access in O(1).
+static void list_elements(value const& array, std::vector<value const*>* out)
+{
+    array_index size = array.size();
+    out->reserve(size);
+    for (array_index index = 0; index < size; ++index)
+        out->push_back(&array[index]);
+}
+
+differ::differ(value* patch)
+    : patch_(patch)
+{
+}
+
+uint64_t differ::hash(value const& v)
+{
+    size_t nodes = 0;
+    return hash(v, &nodes);
+}
+
+// Adds the number of values in 'v' to *nodes.
+uint64_t differ::hash(value const& v, size_t* nodes)
+{
+    ++*nodes;
+    if (v.type() != vt_array && v.type() != vt_object)
+        return v.hash();
+    std::unordered_map<value const*, uint64_t>::iterator known = hashes_.find(&v);
+    if (known != hashes_.end())
+        return known->second;
+    size_t inside = 0;
+    uint64_t h = hash_mix(v.type());
+    for (value::const_iterator it = v.begin(); it != v.end(); ++it) {
+        if (v.is_object()) {
+            char const* end;
+            char const* name = it.member_name(&end);
+            h = hash_mix(h ^ hash_bytes(name, end));
+        }
+        h = hash_mix(h ^ hash(*it, &inside));
+    }
+    // Small containers cost less to hash again than to look up.
+    if (inside >= memo_threshold)
+        hashes_[&v] = h;
+    *nodes += inside;
+    return h;
+}
+
+bool differ::equal(value const& a, value const& b)
+{
+    return &a == &b || (hash(a) == hash(b) && a == b);
+}
+
+void differ::emit(char const* op, std::string const& at, value const* added)
+{
+    value& operation = patch_->append(value(vt_object));
+    operation["op"] = op;
+    operation["path"] = at;
+    if (added)
+        operation["value"] = *added;
+}
+
+void differ::compare(value const& from, value const& to, std::string* at)
+{
+    // compare_arrays() hashes the elements anyway, and finds equal arrays to
+    // be all prefix.
+    if (from.type() == vt_array && to.type() == vt_array) {
+        if (&from != &to)
+            compare_arrays(from, to, at);
+        return;
+    }
+    if (equal(from, to))
+        return;
+    if (from.type() == vt_object && to.type() == vt_object)
+        compare_objects(from, to, at);
+    else
+        emit("replace", *at, &to);
+}
+
+void differ::compare_objects(value const& from, value const& to, std::string* at)
+{
+    size_t length = at->size();
+    // Members are sorted by name in both: merge them.
+    value::const_iterator it = from.begin();
+    value::const_iterator other = to.begin();
+    while (it != from.end() || other != to.end()) {
+        char const* end = 0;
+        char const* name = it != from.end() ? it.member_name(&end) : 0;
+        char const* other_end = 0;
+        char const* other_name = other != to.end() ? other.member_name(&other_end) : 0;
+        int comp;
+        if (!name)
+            comp = 1;
+        else if (!other_name)
+            comp = -1;
+        else {
+            size_t size = end - name;
+            size_t other_size = other_end - other_name;
+            comp = memcmp(name, other_name, std::min(size, other_size));
+            if (!comp)
+                comp = size < other_size ? -1 : (size > other_size ? 1 : 0);
+        }
+        if (comp < 0) {
+            append_token(at, name, end);
+            emit("remove", *at, NULL);
+            ++it;
+        }
+        else if (comp > 0) {
+            append_token(at, other_name, other_end);
+            emit("add", *at, &*other);
+            ++other;
+        }
+        else {
+            append_token(at, name, end);
+            compare(*it, *other, at);
+            ++it;
+            ++other;
+        }
+        at->resize(length);
+    }
+}
+
+void differ::compare_arrays(value const& from, value const& to, std::string* at)
+{
+    elements a;
+    elements b;
+    list_elements(from, &a);
+    list_elements(to, &b);
+    std::vector<uint64_t> a_hashes(a.size());
+    std::vector<uint64_t> b_hashes(b.size());
+    for (size_t i = 0; i < a.size(); ++i)
+        a_hashes[i] = hash(*a[i]);
+    for (size_t j = 0; j < b.size(); ++j)
+        b_hashes[j] = hash(*b[j]);
+
+    size_t begin = 0;
+    while (begin < a.size() && begin < b.size() && a_hashes[begin] == b_hashes[begin]
+        && *a[begin] == *b[begin])
+        ++begin;
+    size_t a_end = a.size();
+    size_t b_end = b.size();
+    while (a_end > begin && b_end > begin && a_hashes[a_end - 1] == b_hashes[b_end - 1]
+        && *a[a_end - 1] == *b[b_end - 1]) {
+        --a_end;
+        --b_end;
+    }
+
+    // Elements whose hash appears once in each middle part are anchors. Sort
+    // the (hash, index) pairs of both parts, and go through them together.
+    std::vector<std::pair<uint64_t, size_t> > a_sorted;
+    std::vector<std::pair<uint64_t, size_t> > b_sorted;
+    a_sorted.reserve(a_end - begin);
+    b_sorted.reserve(b_end - begin);
+    for (size_t i = begin; i < a_end; ++i)
+        a_sorted.push_back(std::make_pair(a_hashes[i], i));
+    for (size_t j = begin; j < b_end; ++j)
+        b_sorted.push_back(std::make_pair(b_hashes[j], j));
+    std::sort(a_sorted.begin(), a_sorted.end());
+    std::sort(b_sorted.begin(), b_sorted.end());
+    std::vector<std::pair<size_t, size_t> > anchors;
+    for (size_t i = 0, j = 0; i < a_sorted.size() && j < b_sorted.size();) {
+        uint64_t h = a_sorted[i].first;
+        if (h < b_sorted[j].first) {
+            ++i;
+            continue;
+        }
+        if (b_sorted[j].first < h) {
+            ++j;
+            continue;
+        }
+        size_t i_next = i + 1;
+        while (i_next < a_sorted.size() && a_sorted[i_next].first == h)
+            ++i_next;
+        size_t j_next = j + 1;
+        while (j_next < b_sorted.size() && b_sorted[j_next].first == h)
+            ++j_next;
+        if (i_next == i + 1 && j_next == j + 1
+            && *a[a_sorted[i].second] == *b[b_sorted[j].second])
+            anchors.push_back(std::make_pair(a_sorted[i].second, b_sorted[j].second));
+        i = i_next;
+        j = j_next;
+    }
+    std::sort(anchors.begin(), anchors.end()); // in the order of a
+
+    // Keep the longest run of anchors that is in order in b too, by patience
+    // sorting: tails[k] is the anchor that ends the best run of length k + 1.
+    std::vector<size_t> tails;
+    std::vector<size_t> before(anchors.size());
+    for (size_t k = 0; k < anchors.size(); ++k) {
+        size_t low = 0;
+        size_t high = tails.size();
+        while (low < high) {
+            size_t middle = (low + high) / 2;
+            if (anchors[tails[middle]].second < anchors[k].second)
+                low = middle + 1;
+            else
+                high = middle;
+        }
+        before[k] = low ? tails[low - 1] : size_t(-1);
+        if (low == tails.size())
+            tails.push_back(k);
+        else
+            tails[low] = k;
+    }
+    std::vector<std::pair<size_t, size_t> > kept(tails.size());
+    for (size_t k = tails.empty() ? size_t(-1) : tails.back(), n = tails.size(); n; k = before[k])
+        kept[--n] = anchors[k];
+
+    size_t length = at->size();
+    array_index position = array_index(begin);
+    size_t i = begin;
+    size_t j = begin;
+    for (size_t k = 0; k < kept.size(); ++k) {
+        compare_runs(a, i, kept[k].first, b, j, kept[k].second, at, &position);
+        ++position;
+        i = kept[k].first + 1;
+        j = kept[k].second + 1;
+    }
+    compare_runs(a, i, a_end, b, j, b_end, at, &position);
+    at->resize(length);
+}
+
+// Turn [from_begin, from_end) of 'from' into [to_begin, to_end) of 'to', which
+// begin at index *position of the array being patched.
+void differ::compare_runs(elements const& from, size_t from_begin, size_t from_end,
+    elements const& to, size_t to_begin, size_t to_end, std::string* at,
+    array_index* position)
+{
+    size_t length = at->size();
+    size_t paired = std::min(from_end - from_begin, to_end - to_begin);
+    for (size_t k = 0; k < paired; ++k, ++*position) {
+        append_index(at, *position);
+        compare(*from[from_begin + k], *to[to_begin + k], at);
+        at->resize(length);
+    }
+    append_index(at, *position);
+    for (size_t k = from_begin + paired; k < from_end; ++k)
+        emit("remove", *at, NULL);
+    at->resize(length);
+    for (size_t k = to_begin + paired; k < to_end; ++k, ++*position) {
+        append_index(at, *position);
+        emit("add", *at, to[k]);
+        at->resize(length);
+    }
+}
+
+value diff(value const& from, value const& to)
+{
+    value patch(vt_array);
+    differ comparing(&patch);
+    std::string at;
+    comparing.compare(from, to, &at);
+    return patch;
+}
+
+} // namespace json
@@ -0,0 +1,67 @@
+// Derived from public-domain/MIT-licensed code at
+// https://github.com/open-source-parsers/jsoncpp. Thanks, Baptiste Lepilleur!
+
+#pragma once
+
+#include "value.h"
+#include <string>
+
+// Disable warning C4251: <data member>: <type> needs to have dll-interface to
+// be used by...
+#if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+#pragma warning(push)
+#pragma warning(disable : 4251)
+#endif // if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+
+namespace json {
+
+/** \brief Apply a <a HREF="https://tools.ietf.org/html/rfc6902">JSON Patch</a>
+ * to 'doc', in place.
+ *
+ * 'patch' is an array of operations ("add", "remove", "replace", "move",
+ * "copy" and "test"), whose paths are JSON Pointers (RFC 6901). They are
+ * applied in order, without copying the document:
+ * - values are swapped into and out of the document, so that "move" and
+ *   "remove" cost the same for a subtree of any size; only the "value" of
+ *   "add", "replace" and "test", and the source of "copy", are copied;
+ * - what each operation took out, or replaced, is kept, so that if one of
+ *   them fails, those before it are undone, in reverse, and 'doc' is left
+ *   exactly as it was.
+ *
+ * "test" compares numbers by value, whatever their type, as RFC 6902 asks.
+ *
+ * \code
+ * json::value patch;
+ * reader.parse("[{\"op\": \"move\", \"from\": \"/a\", \"path\": \"/b/0\"}]", patch);
+ * std::string errs;
+ * if (!json::apply_patch(doc, patch, &errs))
+ *   log(errs);
+ * \endcode
+ *
+ * \return true if every operation was applied. Otherwise false, with 'doc'
+ *         unchanged, and which operation failed and why in *errs (if not NULL).
+ */
+bool JSON_API apply_patch(value& doc, value const& patch, std::string* errs = NULL);
+
+/** \brief A JSON Patch that apply_patch() turns 'from' into 'to' with.
+ *
+ * The patch is small rather than minimal; it is found in time about
+ * proportional to the size of the documents:
+ * - every subtree is hashed once, so that subtrees that differ are told
+ *   apart by comparing two numbers, and equal ones are compared only once;
+ * - members of objects are matched by name;
+ * - elements of arrays are matched by a common prefix and suffix, then by
+ *   the elements that appear exactly once in both arrays, in the same order
+ *   (as in patience diff); the elements between matches are compared pairwise
+ *   and the rest removed or added.
+ *
+ * Only "add", "remove" and "replace" are used. Values compare as with
+ * value::operator==, so that 1 and 1.0 differ.
+ */
+value JSON_API diff(value const& from, value const& to);
+
+} // namespace json
+
+#if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+#pragma warning(pop)
+#endif // if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
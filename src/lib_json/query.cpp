@@ -0,0 +1,698 @@
+// Derived from public-domain/MIT-licensed code at
+// https://github.com/open-source-parsers/jsoncpp. Thanks, Baptiste Lepilleur!
+
+#include "query.h"
+#include "tool.h"
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+namespace json {
+
+enum selector_kind {
+    sk_name,
+    sk_wildcard,
+    sk_index,
+    sk_slice,
+    sk_filter
+};
+
+enum term_op {
+    op_or,
+    op_and,
+    op_not,
+    op_exists, // the node at the path in 'left' exists
+    op_equal,
+    op_not_equal,
+    op_less,
+    op_less_equal,
+    op_greater,
+    op_greater_equal,
+    op_literal,
+    op_path
+};
+
+// Equality of RFC 9535: missing nodes are equal only to each other.
+static bool equal(value const* a, value const* b)
+{
+    if (!a || !b)
+        return !a && !b;
+    if (is_number(*a) && is_number(*b))
+        return compare_numbers(*a, *b) == 0;
+    return a->type() == b->type() && *a == *b;
+}
+
+// Only numbers, and strings, are ordered.
+static bool less(value const* a, value const* b)
+{
+    if (!a || !b)
+        return false;
+    if (is_number(*a) && is_number(*b))
+        return compare_numbers(*a, *b) < 0;
+    return a->type() == vt_string && b->type() == vt_string && *a < *b;
+}
+
+// Index 'index' of an array of 'size' elements, counting from the end if it
+// is negative, or -1 if it is out of range.
+static largest_int_t normalize(largest_int_t index, largest_int_t size)
+{
+    if (index < 0)
+        index += size;
+    return index < 0 || index >= size ? -1 : index;
+}
+
+static largest_int_t clamp(largest_int_t index, largest_int_t low, largest_int_t high)
+{
+    return index < low ? low : (index > high ? high : index);
+}
+
+// Class query_parser
+// //////////////////////////////////////////////////////////////////
+
+// Compiles the text of a query into its segments and filter terms.
+class query_parser {
+public:
+    explicit query_parser(query& compiled);
+
+    void parse();
+
+private:
+    typedef query::step step;
+    typedef query::term term;
+    typedef query::selector selector;
+    typedef query::segment segment;
+
+    void fail(char const* expected) const;
+    char peek() const;
+    bool accept(char c);
+    bool accept(char const* token);
+    void expect(char c, char const* expected);
+    void skip_spaces();
+
+    void parse_dotted(segment* into);
+    void parse_bracket(segment* into);
+    void parse_selector(segment* into);
+    std::string parse_name();
+    std::string parse_quoted();
+    unsigned int parse_hex4();
+    bool parse_int(largest_int_t* out);
+    value parse_number();
+
+    size_t parse_or();
+    size_t parse_and();
+    size_t parse_unary();
+    size_t parse_comparable();
+    void parse_steps(std::vector<step>* into);
+    size_t add_term(int op, size_t left, size_t right);
+
+    query& compiled_;
+    std::string const& text_;
+    size_t at_;
+};
+
+query_parser::query_parser(query& compiled)
+    : compiled_(compiled)
+    , text_(compiled.expression_)
+    , at_(0)
+{
+}
+
+void query_parser::fail(char const* expected) const
+{
+    std::ostringstream oss;
+    oss << "Invalid query \"" << text_ << "\": expected " << expected << " at " << at_;
+    throw_runtime_error(oss.str());
+}
+
+char query_parser::peek() const
+{
+    return at_ < text_.size() ? text_[at_] : 0;
+}
+
+bool query_parser::accept(char c)
+{
+    if (at_ < text_.size() && text_[at_] == c) {
+        ++at_;
+        return true;
+    }
+    return false;
+}
+
+bool query_parser::accept(char const* token)
+{
+    size_t length = strlen(token);
+    if (text_.compare(at_, length, token) != 0)
+        return false;
+    at_ += length;
+    return true;
+}
+
+void query_parser::expect(char c, char const* expected)
+{
+    if (!accept(c))
+        fail(expected);
+}
+
+void query_parser::skip_spaces()
+{
+    while (at_ < text_.size() && (text_[at_] == ' ' || text_[at_] == '\t'
+                                     || text_[at_] == '\n' || text_[at_] == '\r'))
+        ++at_;
+}
+
+void query_parser::parse()
+{
+    expect('$', "'$'");
+    for (;;) {
+        skip_spaces();
+        if (at_ == text_.size())
+            break;
+        segment parsed;
+        parsed.descendants = false;
+        if (accept("..")) {
+            parsed.descendants = true;
+            if (peek() == '[')
+                parse_bracket(&parsed);
+            else
+                parse_dotted(&parsed);
+        }
+        else if (accept('.')) {
+            parse_dotted(&parsed);
+        }
+        else if (peek() == '[') {
+            parse_bracket(&parsed);
+        }
+        else {
+            fail("'.' or '['");
+        }
+        compiled_.segments_.push_back(parsed);
+    }
+}
+
+void query_parser::parse_dotted(segment* into)
+{
+    selector parsed = selector();
+    if (accept('*')) {
+        parsed.kind = sk_wildcard;
+    }
+    else {
+        parsed.kind = sk_name;
+        parsed.name = parse_name();
+    }
+    into->selectors.push_back(parsed);
+}
+
+void query_parser::parse_bracket(segment* into)
+{
+    expect('[', "'['");
+    do {
+        skip_spaces();
+        parse_selector(into);
+        skip_spaces();
+    } while (accept(','));
+    expect(']', "']'");
+}
+
+void query_parser::parse_selector(segment* into)
+{
+    selector parsed = selector();
+    char c = peek();
+    if (c == '\'' || c == '"') {
+        parsed.kind = sk_name;
+        parsed.name = parse_quoted();
+    }
+    else if (accept('*')) {
+        parsed.kind = sk_wildcard;
+    }
+    else if (accept('?')) {
+        parsed.kind = sk_filter;
+        parsed.filter = parse_or();
+    }
+    else {
+        parsed.has_start = parse_int(&parsed.start);
+        skip_spaces();
+        if (accept(':')) {
+            parsed.kind = sk_slice;
+            skip_spaces();
+            parsed.has_end = parse_int(&parsed.end);
+            skip_spaces();
+            parsed.step = 1;
+            if (accept(':')) {
+                skip_spaces();
+                parse_int(&parsed.step);
+            }
+        }
+        else if (parsed.has_start) {
+            parsed.kind = sk_index;
+        }
+        else {
+            fail("a selector");
+        }
+    }
+    into->selectors.push_back(parsed);
+}
+
+std::string query_parser::parse_name()
+{
+    size_t start = at_;
+    while (at_ < text_.size()) {
+        unsigned char c = static_cast<unsigned char>(text_[at_]);
+        bool letter = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c >= 0x80;
+        if (!letter && !(at_ > start && c >= '0' && c <= '9'))
+            break;
+        ++at_;
+    }
+    if (at_ == start)
+        fail("a member name");
+    return text_.substr(start, at_ - start);
+}
+
+std::string query_parser::parse_quoted()
+{
+    char quote = text_[at_++];
+    std::string decoded;
+    for (;;) {
+        if (at_ == text_.size())
+            fail("a closing quote");
+        char c = text_[at_++];
+        if (c == quote)
+            return decoded;
+        if (c != '\\') {
+            decoded += c;
+            continue;
+        }
+        switch (peek()) {
+        case 'b': decoded += '\b'; break;
+        case 'f': decoded += '\f'; break;
+        case 'n': decoded += '\n'; break;
+        case 'r': decoded += '\r'; break;
+        case 't': decoded += '\t'; break;
+        case '/':
+        case '\\':
+        case '\'':
+        case '"':
+            decoded += peek();
+            break;
+        case 'u': {
+            ++at_;
+            unsigned int cp = parse_hex4();
+            if (cp >= 0xD800 && cp <= 0xDBFF) {
+                if (!accept("\\u"))
+                    fail("a low surrogate");
+                unsigned int low = parse_hex4();
+                if (low < 0xDC00 || low > 0xDFFF)
+                    fail("a low surrogate");
+                cp = 0x10000 + ((cp & 0x3FF) << 10) + (low & 0x3FF);
+            }
+            decoded += codepoint_to_utf8(cp);
+            continue;
+        }
+        default:
+            fail("an escape sequence");
+        }
+        ++at_;
+    }
+}
+
+unsigned int query_parser::parse_hex4()
+{
+    unsigned int cp = 0;
+    for (int i = 0; i < 4; ++i) {
+        char c = peek();
+        cp <<= 4;
+        if (c >= '0' && c <= '9')
+            cp += c - '0';
+        else if (c >= 'a' && c <= 'f')
+            cp += c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            cp += c - 'A' + 10;
+        else
+            fail("a hexadecimal digit");
+        ++at_;
+    }
+    return cp;
+}
+
+// An optional integer. \return false, without moving, if there is none.
+bool query_parser::parse_int(largest_int_t* out)
+{
+    size_t start = at_;
+    bool negative = accept('-');
+    if (peek() < '0' || peek() > '9') {
+        at_ = start;
+        return false;
+    }
+    largest_uint_t magnitude = 0;
+    largest_uint_t const limit = largest_uint_t(value::max_largest_int) + (negative ? 1 : 0);
+    while (peek() >= '0' && peek() <= '9') {
+        unsigned digit = text_[at_] - '0';
+        if (magnitude > (limit - digit) / 10)
+            fail("a smaller integer");
+        magnitude = magnitude * 10 + digit;
+        ++at_;
+    }
+    *out = negative ? largest_int_t(0 - magnitude) : largest_int_t(magnitude);
+    return true;
+}
+
+value query_parser::parse_number()
+{
+    size_t start = at_;
+    largest_int_t integer;
+    if (!parse_int(&integer))
+        fail("a value");
+    bool real = false;
+    if (accept('.')) {
+        real = true;
+        if (peek() < '0' || peek() > '9')
+            fail("a digit");
+        while (peek() >= '0' && peek() <= '9')
+            ++at_;
+    }
+    if (accept('e') || accept('E')) {
+        real = true;
+        if (!accept('+'))
+            accept('-');
+        if (peek() < '0' || peek() > '9')
+            fail("a digit");
+        while (peek() >= '0' && peek() <= '9')
+            ++at_;
+    }
+    if (!real)
+        return value(integer);
+    std::string number(text_, start, at_ - start);
+    return value(strtod(number.c_str(), 0));
+}
+
+size_t query_parser::add_term(int op, size_t left, size_t right)
+{
+    term added;
+    added.op = op;
+    added.left = left;
+    added.right = right;
+    added.absolute = false;
+    compiled_.terms_.push_back(added);
+    return compiled_.terms_.size() - 1;
+}
+
+size_t query_parser::parse_or()
+{
+    size_t left = parse_and();
+    skip_spaces();
+    while (accept("||")) {
+        size_t right = parse_and();
+        left = add_term(op_or, left, right);
+        skip_spaces();
+    }
+    return left;
+}
+
+size_t query_parser::parse_and()
+{
+    size_t left = parse_unary();
+    skip_spaces();
+    while (accept("&&")) {
+        size_t right = parse_unary();
+        left = add_term(op_and, left, right);
+        skip_spaces();
+    }
+    return left;
+}
+
+size_t query_parser::parse_unary()
+{
+    skip_spaces();
+    if (accept('!'))
+        return add_term(op_not, parse_unary(), 0);
+    if (accept('(')) {
+        size_t inner = parse_or();
+        expect(')', "')'");
+        return inner;
+    }
+    size_t operand_at = at_;
+    size_t left = parse_comparable();
+    skip_spaces();
+    int op;
+    if (accept("=="))
+        op = op_equal;
+    else if (accept("!="))
+        op = op_not_equal;
+    else if (accept("<="))
+        op = op_less_equal;
+    else if (accept(">="))
+        op = op_greater_equal;
+    else if (accept('<'))
+        op = op_less;
+    else if (accept('>'))
+        op = op_greater;
+    else if (compiled_.terms_[left].op == op_path)
+        return add_term(op_exists, left, 0);
+    else {
+        at_ = operand_at;
+        fail("a path or a comparison");
+        return 0;
+    }
+    size_t right = parse_comparable();
+    return add_term(op, left, right);
+}
+
+size_t query_parser::parse_comparable()
+{
+    skip_spaces();
+    char c = peek();
+    if (c == '@' || c == '$') {
+        ++at_;
+        size_t added = add_term(op_path, 0, 0);
+        std::vector<step> steps;
+        parse_steps(&steps);
+        compiled_.terms_[added].absolute = c == '$';
+        compiled_.terms_[added].steps.swap(steps);
+        return added;
+    }
+    value literal;
+    if (c == '\'' || c == '"')
+        literal = parse_quoted();
+    else if (accept("true"))
+        literal = true;
+    else if (accept("false"))
+        literal = false;
+    else if (accept("null"))
+        literal = value();
+    else
+        literal = parse_number();
+    size_t added = add_term(op_literal, 0, 0);
+    compiled_.terms_[added].literal.swap(literal);
+    return added;
+}
+
+void query_parser::parse_steps(std::vector<step>* into)
+{
+    for (;;) {
+        step parsed;
+        parsed.index = 0;
+        parsed.is_index = false;
+        if (accept('.')) {
+            parsed.name = parse_name();
+        }
+        else if (accept('[')) {
+            skip_spaces();
+            char c = peek();
+            if (c == '\'' || c == '"')
+                parsed.name = parse_quoted();
+            else if (parse_int(&parsed.index))
+                parsed.is_index = true;
+            else
+                fail("an index or a quoted name");
+            skip_spaces();
+            expect(']', "']'");
+        }
+        else {
+            return;
+        }
+        into->push_back(parsed);
+    }
+}
+
+// Class query
+// //////////////////////////////////////////////////////////////////
+
+query::query(std::string const& expression)
+    : expression_(expression)
+{
+    query_parser(*this).parse();
+}
+
+std::string const& query::expression() const
+{
+    return expression_;
+}
+
+void query::select(value const& root, std::vector<value const*>* results) const
+{
+    if (segments_.empty()) {
+        results->push_back(&root);
+        return;
+    }
+    // Each segment is applied to every node selected by the one before; the
+    // last one adds to the results directly.
+    std::vector<value const*> current(1, &root);
+    std::vector<value const*> next;
+    for (size_t s = 0; s < segments_.size(); ++s) {
+        bool last = s + 1 == segments_.size();
+        std::vector<value const*>* out = last ? results : &next;
+        for (size_t i = 0; i < current.size(); ++i)
+            apply(segments_[s], root, *current[i], out);
+        if (!last) {
+            if (next.empty())
+                return;
+            current.swap(next);
+            next.clear();
+        }
+    }
+}
+
+value const* query::first(value const& root) const
+{
+    std::vector<value const*> results;
+    select(root, &results);
+    return results.empty() ? NULL : results[0];
+}
+
+void query::apply(segment const& with, value const& root, value const& node,
+    std::vector<value const*>* out) const
+{
+    for (size_t i = 0; i < with.selectors.size(); ++i)
+        apply(with.selectors[i], root, node, out);
+    if (with.descendants && (node.is_array() || node.is_object())) {
+        for (value::const_iterator it = node.begin(); it != node.end(); ++it)
+            apply(with, root, *it, out);
+    }
+}
+
+void query::apply(selector const& with, value const& root, value const& node,
+    std::vector<value const*>* out) const
+{
+    switch (with.kind) {
+    case sk_name:
+        if (node.is_object()) {
+            value const* member = node.find(with.name.data(), with.name.data() + with.name.size());
+            if (member)
+                out->push_back(member);
+        }
+        break;
+    case sk_wildcard:
+        if (node.is_array()) {
+            array_index size = node.size();
+            for (array_index index = 0; index < size; ++index)
+                out->push_back(&node[index]);
+        }
+        else if (node.is_object()) {
+            for (value::const_iterator it = node.begin(); it != node.end(); ++it)
+                out->push_back(&*it);
+        }
+        break;
+    case sk_index:
+        if (node.is_array()) {
+            largest_int_t index = normalize(with.start, node.size());
+            if (index >= 0)
+                out->push_back(&node[array_index(index)]);
+        }
+        break;
+    case sk_slice: {
+        if (!node.is_array() || with.step == 0)
+            break;
+        largest_int_t size = node.size();
+        largest_int_t start = with.start < 0 ? with.start + size : with.start;
+        largest_int_t end = with.end < 0 ? with.end + size : with.end;
+        if (with.step > 0) {
+            largest_int_t low = with.has_start ? clamp(start, 0, size) : 0;
+            largest_int_t high = with.has_end ? clamp(end, 0, size) : size;
+            // Stop before the step that would pass 'high', as adding it
+            // could overflow.
+            for (largest_int_t i = low; i < high; i += with.step) {
+                out->push_back(&node[array_index(i)]);
+                if (with.step >= high - i)
+                    break;
+            }
+        }
+        else {
+            largest_int_t high = with.has_start ? clamp(start, -1, size - 1) : size - 1;
+            largest_int_t low = with.has_end ? clamp(end, -1, size - 1) : -1;
+            for (largest_int_t i = high; low < i; i += with.step) {
+                out->push_back(&node[array_index(i)]);
+                if (with.step <= low - i)
+                    break;
+            }
+        }
+    } break;
+    case sk_filter:
+        if (node.is_array()) {
+            array_index size = node.size();
+            for (array_index index = 0; index < size; ++index) {
+                if (holds(with.filter, root, node[index]))
+                    out->push_back(&node[index]);
+            }
+        }
+        else if (node.is_object()) {
+            for (value::const_iterator it = node.begin(); it != node.end(); ++it) {
+                if (holds(with.filter, root, *it))
+                    out->push_back(&*it);
+            }
+        }
+        break;
+    }
+}
+
+bool query::holds(size_t at, value const& root, value const& current) const
+{
+    term const& t = terms_[at];
+    switch (t.op) {
+    case op_or:
+        return holds(t.left, root, current) || holds(t.right, root, current);
+    case op_and:
+        return holds(t.left, root, current) && holds(t.right, root, current);
+    case op_not:
+        return !holds(t.left, root, current);
+    case op_exists:
+        return operand(terms_[t.left], root, current) != NULL;
+    default:
+        break;
+    }
+    value const* a = operand(terms_[t.left], root, current);
+    value const* b = operand(terms_[t.right], root, current);
+    switch (t.op) {
+    case op_equal:
+        return equal(a, b);
+    case op_not_equal:
+        return !equal(a, b);
+    case op_less:
+        return less(a, b);
+    case op_less_equal:
+        return less(a, b) || equal(a, b);
+    case op_greater:
+        return less(b, a);
+    default: // op_greater_equal
+        return less(b, a) || equal(a, b);
+    }
+}
+
+// The literal, or the node at the path, of an operand; NULL if there is none.
+value const* query::operand(term const& t, value const& root, value const& current) const
+{
+    if (t.op == op_literal)
+        return &t.literal;
+    value const* node = t.absolute ? &root : &current;
+    for (size_t i = 0; i < t.steps.size() && node; ++i) {
+        step const& s = t.steps[i];
+        if (s.is_index) {
+            largest_int_t index = node->is_array() ? normalize(s.index, node->size()) : -1;
+            node = index < 0 ? NULL : &(*node)[array_index(index)];
+        }
+        else {
+            node = node->is_object() ? node->find(s.name.data(), s.name.data() + s.name.size()) : NULL;
+        }
+    }
+    return node;
+}
+
+} // namespace json
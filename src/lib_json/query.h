@@ -0,0 +1,115 @@
+// Derived from public-domain/MIT-licensed code at
+// https://github.com/open-source-parsers/jsoncpp. Thanks, Baptiste Lepilleur!
+
+#pragma once
+
+#include "value.h"
+#include <string>
+#include <vector>
+
+// Disable warning C4251: <data member>: <type> needs to have dll-interface to
+// be used by...
+#if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+#pragma warning(push)
+#pragma warning(disable : 4251)
+#endif // if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+
+namespace json {
+
+/** \brief A JSONPath query (RFC 9535), compiled once and run on many
+ * documents.
+ *
+ * Syntax:
+ * - "$" => root node
+ * - "$.name", "$['name']", "$[\"name\"]" => member 'name'
+ * - "$[n]" => element 'n'; negative indices count from the end
+ * - "$.*", "$[*]" => every element or member
+ * - "$[start:end:step]" => a slice of an array, as in Python
+ * - "$[0,2,'a']" => several selectors, whose results are concatenated
+ * - "$..name", "$..*", "$..[0]" => the same, applied to a node and to all the
+ *   nodes under it
+ * - "$[?@.price < 10 && @.isbn]" => the elements or members for which the
+ *   filter holds
+ *
+ * A filter compares literals (numbers, 'strings', true, false, null) and the
+ * nodes at single-node paths, from the current node ("@.a[0]") or from the
+ * root ("$.limit"), with ==, !=, <, <=, > and >=; a path alone tests that the
+ * node exists. Tests combine with &&, || and !, and parentheses. Comparisons
+ * follow RFC 9535: numbers compare by value, whatever their type; strings
+ * compare by code point; < and the like are false between other types; a
+ * missing node is equal only to another missing node.
+ *
+ * Members of an object are visited in the order of #value, that is by name.
+ *
+ * \code
+ * json::query cheap("$.store.book[?@.price < 10].title");
+ * std::vector<json::value const*> titles;
+ * cheap.select(root, &titles);
+ * \endcode
+ */
+class JSON_API query {
+public:
+	/// \throw std::runtime_error if 'expression' is not valid, saying where.
+	explicit query(std::string const& expression);
+
+	/** Append the nodes selected in 'root' to *results, in order. They point
+	 * into 'root', so stay valid while it is not modified.
+	 */
+	void select(value const& root, std::vector<value const*>* results) const;
+
+	/// The first node selected in 'root', or NULL if there is none.
+	value const* first(value const& root) const;
+
+	/// The text this query was compiled from.
+	std::string const& expression() const;
+
+private:
+	// One step of a single-node path in a filter.
+	struct step {
+		std::string name;
+		largest_int_t index;
+		bool is_index;
+	};
+	// A node of a filter expression.
+	struct term {
+		int op;
+		size_t left; // operands, in terms_
+		size_t right;
+		value literal;
+		bool absolute; // a path from the root, rather than from the current node
+		std::vector<step> steps;
+	};
+	struct selector {
+		int kind;
+		std::string name;
+		largest_int_t start; // index, or slice
+		largest_int_t end;
+		largest_int_t step;
+		bool has_start;
+		bool has_end;
+		size_t filter; // root of the filter expression, in terms_
+	};
+	struct segment {
+		bool descendants; // ".." rather than "."
+		std::vector<selector> selectors;
+	};
+
+	friend class query_parser;
+
+	void apply(segment const& with, value const& root, value const& node,
+		std::vector<value const*>* out) const;
+	void apply(selector const& with, value const& root, value const& node,
+		std::vector<value const*>* out) const;
+	bool holds(size_t at, value const& root, value const& current) const;
+	value const* operand(term const& t, value const& root, value const& current) const;
+
+	std::string expression_;
+	std::vector<segment> segments_;
+	std::vector<term> terms_;
+};
+
+} // namespace json
+
+#if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+#pragma warning(pop)
+#endif // if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
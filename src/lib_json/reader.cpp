@@ -3,16 +3,23 @@
 
 #include "assertions.h"
 #include "reader.h"
+#include "lazy.h"
+#include "our_reader.h"
+#include "tape.h"
 #include "value.h"
 #include "tool.h"
 #include <utility>
 #include <cstdio>
+#include <cstdlib>
 #include <cassert>
+#include <exception>
 #include <cstring>
 #include <istream>
 #include <sstream>
 #include <memory>
 #include <set>
+#include <system_error>
+#include <thread>
 
 #if defined(_MSC_VER) && _MSC_VER < 1500 // VC++ 8.0 and below
 #define snprintf _snprintf
@@ -187,10 +194,12 @@ bool reader::read_value()
     case tt_object_begin:
         successful = read_object(token);
         current_value().set_offset_limit(current_ - begin_);
+        current_value().set_shareable(); // nothing in it is held any more
         break;
     case tt_array_begin:
         successful = read_array(token);
         current_value().set_offset_limit(current_ - begin_);
+        current_value().set_shareable();
         break;
     case tt_number:
         successful = decode_number(token);
@@ -949,20 +958,6 @@ bool reader::good() const
     return !errors_.size();
 }
 
-// exact copy of features
-class our_features {
-public:
-    static our_features all();
-    our_features();
-    bool allow_comments_;
-    bool strict_root_;
-    bool allow_dropped_null_placeholders_;
-    bool allow_numeric_keys_;
-    bool allow_single_quotes_;
-    bool fail_if_extra_;
-    bool reject_dup_keys_;
-    int stack_limit_;
-}; // our_features
 
 // exact copy of Implementation of class features
 // ////////////////////////////////
@@ -974,6 +969,10 @@ our_features::our_features()
     , allow_numeric_keys_(false)
     , allow_single_quotes_(false)
     , fail_if_extra_(false)
+    , use_structural_index_(false)
+    , keep_source_(false)
+    , dedupe_(false)
+    , threads_(1)
 {
 }
 
@@ -982,118 +981,105 @@ our_features our_features::all() { return our_features(); }
 // Implementation of class reader
 // ////////////////////////////////
 
-// exact copy of reader, renamed to our_reader
-class our_reader {
+// Appends entries to a tape while our_reader walks the document.
+// Containers get a placeholder begin entry which is patched when the matching
+// close is reached.
+class tape_builder {
 public:
-    typedef const char* location_t;
-    struct structured_error {
-        size_t offset_start;
-        size_t offset_limit;
-        std::string message;
-    };
+    explicit tape_builder(tape& out)
+        : out_(out)
+    {
+        out_.clear();
+    }
 
-    our_reader(our_features const& features);
-    bool parse(const char* begin_doc,
-        const char* end_doc,
-        value& root,
-        bool collect_comments = true);
-    std::string get_formatted_messages() const;
-    std::vector<structured_error> get_structured_errors() const;
-    bool push_error(value const&, std::string const& message);
-    bool push_error(value const&, std::string const& message, class value const& extra);
-    bool good() const;
+    size_t begin_object() { return begin(tape::tag_object_begin); }
+    size_t begin_array() { return begin(tape::tag_array_begin); }
+    void end_object(size_t begin, size_t count)
+    {
+        end(begin, tape::tag_object_end, count);
+    }
+    void end_array(size_t begin, size_t count)
+    {
+        end(begin, tape::tag_array_end, count);
+    }
 
-private:
-    our_reader(our_reader const&); // no impl
-    void operator=(our_reader const&); // no impl
-
-    enum token_type {
-        tt_end_of_stream = 0,
-        tt_object_begin,
-        tt_object_end,
-        tt_array_begin,
-        tt_array_end,
-        tt_string,
-        tt_number,
-        tt_true,
-        tt_false,
-        tt_null,
-        tt_array_separator,
-        tt_member_separator,
-        tt_comment,
-        tt_error
-    };
+    void add_null() { push(tape::tag_null, 0); }
+    void add_bool(bool b) { push(b ? tape::tag_true : tape::tag_false, 0); }
+    void add_number(value const& decoded)
+    {
+        switch (decoded.type()) {
+        case vt_int:
+            push(tape::tag_int, 0);
+            out_.entries_.push_back(uint64_t(decoded.as_largest_int()));
+            break;
+        case vt_uint:
+            push(tape::tag_uint, 0);
+            out_.entries_.push_back(uint64_t(decoded.as_largest_uint()));
+            break;
+        default: {
+            double real = decoded.as_double();
+            uint64_t bits;
+            memcpy(&bits, &real, sizeof(bits));
+            push(tape::tag_real, 0);
+            out_.entries_.push_back(bits);
+        } break;
+        }
+    }
+    void add_string(char const* str, size_t length)
+    {
+        size_t at = out_.strings_.size();
+        push(tape::tag_string, at);
+        unsigned prefix = static_cast<unsigned>(length);
+        out_.strings_.resize(at + sizeof(prefix) + length + 1);
+        char* dest = &out_.strings_[at];
+        memcpy(dest, &prefix, sizeof(prefix));
+        memcpy(dest + sizeof(prefix), str, length);
+        dest[sizeof(prefix) + length] = '\0';
+    }
+
+    // True if the (still open) object at 'begin' already has the given key.
+    bool has_key(size_t begin, char const* key, size_t length) const
+    {
+        size_t current = begin + 1;
+        while (current < out_.entries_.size()) {
+            char const* name;
+            char const* name_end;
+            tape_view(&out_, current).get_string(&name, &name_end);
+            if (size_t(name_end - name) == length && memcmp(name, key, length) == 0)
+                return true;
+            current = out_.next_index(current + 1);
+        }
+        return false;
+    }
 
-    class token {
-    public:
-        token_type type_;
-        location_t start_;
-        location_t end_;
-    };
+    tape_view root() const { return out_.root(); }
 
-    class error_info {
-    public:
-        token token_;
-        std::string message_;
-        location_t extra_;
-    };
+private:
+    size_t begin(tape::tag t)
+    {
+        size_t index = out_.entries_.size();
+        push(t, 0);
+        return index;
+    }
+    void end(size_t begin, tape::tag end_tag, size_t count)
+    {
+        size_t close = out_.entries_.size();
+        if (close > 0xFFFFFFFFu)
+            throw_runtime_error("tape exceeds 2^32 entries");
+        if (count > tape::count_mask)
+            count = tape::count_mask;
+        tape::tag begin_tag = tape::tag_of(out_.entries_[begin]);
+        out_.entries_[begin] = tape::make_entry(begin_tag, (uint64_t(count) << 32) | close);
+        push(end_tag, begin);
+    }
+    void push(tape::tag t, uint64_t payload)
+    {
+        out_.entries_.push_back(tape::make_entry(t, payload));
+    }
+
+    tape& out_;
+};
 
-    typedef std::deque<error_info> errors;
-
-    bool read_token(token& token);
-    void skip_spaces();
-    bool match(location_t pattern, int pattern_length);
-    bool read_comment();
-    bool read_c_style_comment();
-    bool read_cpp_style_comment();
-    bool read_string();
-    bool read_string_single_quote();
-    void read_number();
-    bool read_value();
-    bool read_object(token& token);
-    bool read_array(token& token);
-    bool decode_number(token& token);
-    bool decode_number(token& token, value& decoded);
-    bool decode_string(token& token);
-    bool decode_string(token& token, std::string& decoded);
-    bool decode_double(token& token);
-    bool decode_double(token& token, value& decoded);
-    bool decode_unicode_codepoint(token& token,
-        location_t& current,
-        location_t end,
-        unsigned int& unicode);
-    bool decode_unicode_escape_sequence(token& token,
-        location_t& current,
-        location_t end,
-        unsigned int& unicode);
-    bool add_error(std::string const& message, token& token, location_t extra = 0);
-    bool recover_from_error(token_type skip_until_token);
-    bool add_error_and_recover(std::string const& message,
-        token& token,
-        token_type skip_until_token);
-    void skip_until_space();
-    value& current_value();
-    char get_next_char();
-    void get_location_line_and_column(location_t location, int& line, int& column) const;
-    std::string get_location_line_and_column(location_t location) const;
-    void add_comment(location_t begin, location_t end, comment_placement placement);
-    void skip_comment_tokens(token& token);
-
-    typedef std::stack<value*> nodes;
-    nodes nodes_;
-    errors errors_;
-    std::string document_;
-    location_t begin_;
-    location_t end_;
-    location_t current_;
-    location_t last_value_end_;
-    value* last_value_;
-    std::string comments_before_;
-    int stack_depth_;
-
-    our_features const features_;
-    bool collect_comments_;
-}; // our_reader
 
 // complete copy of Read impl, for our_reader
 
@@ -1106,9 +1092,311 @@ our_reader::our_reader(our_features const& features)
     , last_value_end_()
     , last_value_()
     , comments_before_()
+    , indexed_(false)
+    , next_(0)
+    , pull_state_(ps_done)
+    , pulled_event_(et_none)
+    , empty_key_(false)
     , features_(features)
     , collect_comments_()
+    , saw_comment_(false)
+{
+}
+
+// Stage two of the "simd" engine
+// ////////////////////////////////
+//
+// walk_index() reads a document straight from index_, one entry per token,
+// and feeds a sink. It only accepts plain, valid JSON; for anything else
+// (errors, dropped placeholders, numeric keys, trailing text, exceeding the
+// stack limit...) it gives up, and parse() starts over with read_value(), so
+// that results and error messages are exactly those of the classic engine.
+//
+// A sink has:
+//   void begin_object(size_t start), begin_array(size_t start)
+//   void end_container(size_t limit)
+//   bool has_key(char const* name, size_t length)   // in the current object
+//   void key(char const* name, size_t length)
+//   void scalar(value& decoded, size_t start, size_t limit)
+//   void string(char const* str, size_t length, size_t start, size_t limit)
+
+// Builds a value tree, as read_value() would.
+class value_sink {
+public:
+    explicit value_sink(value& root)
+        : slot_(&root)
+    {
+    }
+
+    void begin_object(size_t start) { begin(vt_object, start); }
+    void begin_array(size_t start) { begin(vt_array, start); }
+    void end_container(size_t limit)
+    {
+        stack_.back().container_->set_offset_limit(limit);
+        stack_.back().container_->set_shareable(); // nothing in it is held any more
+        stack_.pop_back();
+    }
+    bool has_key(char const* name, size_t length) const
+    {
+        return stack_.back().container_->find(name, name + length) != 0;
+    }
+    void key(char const* name, size_t length)
+    {
+        slot_ = stack_.back().container_->demand(name, name + length);
+    }
+    void scalar(value& decoded, size_t start, size_t limit)
+    {
+        value& target = next_slot();
+        target.swap_payload(decoded);
+        target.set_offset_start(start);
+        target.set_offset_limit(limit);
+    }
+    void string(char const* str, size_t length, size_t start, size_t limit)
+    {
+        value decoded(str, str + length);
+        scalar(decoded, start, limit);
+    }
+
+private:
+    struct level {
+        value* container_;
+        array_index size_;
+    };
+
+    value& next_slot()
+    {
+        if (!stack_.empty() && stack_.back().container_->type() == vt_array) {
+            level& top = stack_.back();
+            return (*top.container_)[top.size_++];
+        }
+        return *slot_;
+    }
+    void begin(value_type type, size_t start)
+    {
+        value& target = next_slot();
+        value init(type);
+        target.swap_payload(init);
+        target.set_offset_start(start);
+        level entered = { &target, 0 };
+        stack_.push_back(entered);
+    }
+
+    value* slot_; // where the next value of an object (or the root) goes
+    std::vector<level> stack_;
+};
+
+// Fills a tape, as read_value(tape_builder&) would.
+class tape_sink {
+public:
+    explicit tape_sink(tape_builder& out)
+        : out_(out)
+    {
+    }
+
+    void begin_object(size_t) { begin(out_.begin_object(), true); }
+    void begin_array(size_t) { begin(out_.begin_array(), false); }
+    void end_container(size_t)
+    {
+        level& top = stack_.back();
+        if (top.object_)
+            out_.end_object(top.begin_, top.size_);
+        else
+            out_.end_array(top.begin_, top.size_);
+        stack_.pop_back();
+    }
+    bool has_key(char const* name, size_t length) const
+    {
+        return out_.has_key(stack_.back().begin_, name, length);
+    }
+    void key(char const* name, size_t length) { out_.add_string(name, length); }
+    void scalar(value& decoded, size_t, size_t)
+    {
+        count();
+        switch (decoded.type()) {
+        case vt_null:
+            out_.add_null();
+            break;
+        case vt_bool:
+            out_.add_bool(decoded.as_bool());
+            break;
+        default:
+            out_.add_number(decoded);
+            break;
+        }
+    }
+    void string(char const* str, size_t length, size_t, size_t)
+    {
+        count();
+        out_.add_string(str, length);
+    }
+
+private:
+    struct level {
+        size_t begin_;
+        size_t size_;
+        bool object_;
+    };
+
+    void count()
+    {
+        if (!stack_.empty())
+            ++stack_.back().size_;
+    }
+    void begin(size_t begin, bool object)
+    {
+        count();
+        level entered = { begin, 0, object };
+        stack_.push_back(entered);
+    }
+
+    tape_builder& out_;
+    std::vector<level> stack_;
+};
+
+// The rest of a number or literal must run up to whitespace or to the next
+// indexed position, otherwise it is followed by garbage.
+bool our_reader::ends_token(location_t at, size_t next) const
 {
+    if (at == end_)
+        return true;
+    char c = *at;
+    if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+        return true;
+    return next != index_.size() && begin_ + index_[next] == at;
+}
+
+template <typename Sink>
+bool our_reader::walk_index(Sink& out)
+{
+    enum expecting {
+        expect_value,
+        expect_key,
+        expect_separator
+    };
+    size_t const count = index_.size();
+    size_t next = 0;
+    std::string& closers = closers_; // '}' or ']' for each open container
+    closers.clear();
+    expecting state = expect_value;
+    for (;;) {
+        if (next == count)
+            return state == expect_separator && closers.empty();
+        location_t at = begin_ + index_[next];
+        size_t const offset = at - begin_;
+        if (state == expect_separator) {
+            if (closers.empty())
+                return false; // extra text after the root
+            if (*at == ',') {
+                ++next;
+                state = closers[closers.size() - 1] == '}' ? expect_key : expect_value;
+            }
+            else if (*at == closers[closers.size() - 1]) {
+                ++next;
+                out.end_container(offset + 1);
+                closers.erase(closers.size() - 1);
+            }
+            else {
+                return false;
+            }
+            continue;
+        }
+        if (state == expect_key) {
+            if (*at != '"' || next + 2 >= count || begin_[index_[next + 1]] != '"'
+                || begin_[index_[next + 2]] != ':')
+                return false;
+            char const* name = at + 1;
+            size_t length = index_[next + 1] - offset - 1;
+            if (memchr(name, '\\', length)) {
+                token token;
+                token.type_ = tt_string;
+                token.start_ = at;
+                token.end_ = begin_ + index_[next + 1] + 1;
+                if (!decode_string(token, scratch_.erase()))
+                    return false;
+                name = scratch_.data();
+                length = scratch_.length();
+            }
+            if (length >= (1U << 30))
+                return false;
+            if (features_.reject_dup_keys_ && out.has_key(name, length))
+                return false;
+            out.key(name, length);
+            next += 3;
+            state = expect_value;
+            continue;
+        }
+        // expect_value
+        if (int(closers.size()) >= features_.stack_limit_)
+            return false; // read_value() will throw
+        ++next;
+        state = expect_separator;
+        switch (*at) {
+        case '{':
+        case '[': {
+            bool object = *at == '{';
+            if (object)
+                out.begin_object(offset);
+            else
+                out.begin_array(offset);
+            char closer = object ? '}' : ']';
+            if (next != count && begin_[index_[next]] == closer) {
+                ++next;
+                out.end_container(index_[next - 1] + 1);
+            }
+            else {
+                closers += closer;
+                state = object ? expect_key : expect_value;
+            }
+        } break;
+        case '"': {
+            if (next == count || begin_[index_[next]] != '"')
+                return false;
+            token token;
+            token.type_ = tt_string;
+            token.start_ = at;
+            token.end_ = begin_ + index_[next] + 1;
+            ++next;
+            char const* str = at + 1;
+            size_t length = token.end_ - at - 2;
+            if (memchr(str, '\\', length)) {
+                if (!decode_string(token, scratch_.erase()))
+                    return false;
+                str = scratch_.data();
+                length = scratch_.length();
+            }
+            out.string(str, length, offset, token.end_ - begin_);
+        } break;
+        case 't':
+        case 'f':
+        case 'n': {
+            char const* literal = *at == 't' ? "true" : *at == 'f' ? "false" : "null";
+            size_t length = strlen(literal);
+            if (size_t(end_ - at) < length || memcmp(at, literal, length) != 0
+                || !ends_token(at + length, next))
+                return false;
+            value decoded;
+            if (*at != 'n')
+                decoded = *at == 't';
+            out.scalar(decoded, offset, offset + length);
+        } break;
+        default: {
+            if (*at != '-' && (*at < '0' || *at > '9'))
+                return false;
+            current_ = at + 1;
+            read_number();
+            if (!ends_token(current_, next))
+                return false;
+            token token;
+            token.type_ = tt_number;
+            token.start_ = at;
+            token.end_ = current_;
+            value decoded;
+            if (!decode_number(token, decoded))
+                return false;
+            out.scalar(decoded, offset, current_ - begin_);
+        } break;
+        }
+    }
 }
 
 bool our_reader::parse(const char* begin_doc,
@@ -1124,16 +1412,34 @@ bool our_reader::parse(const char* begin_doc,
     end_ = end_doc;
     collect_comments_ = collect_comments;
     current_ = begin_;
+    start_index();
     last_value_end_ = 0;
     last_value_ = 0;
     comments_before_ = "";
+    saw_comment_ = false;
     errors_.clear();
     while (!nodes_.empty())
         nodes_.pop();
     nodes_.push(&root);
 
     stack_depth_ = 0;
-    bool successful = read_value();
+    bool successful;
+    value_sink sink(root);
+    if (features_.threads_ != 1 && parse_slices(root, successful)) {
+        current_ = end_;
+    }
+    else if (indexed_ && walk_index(sink)) {
+        current_ = end_;
+        successful = true;
+    }
+    else {
+        current_ = begin_; // start over; errors are reported by read_value()
+        next_ = 0;
+        errors_.clear();
+        value fresh;
+        root.swap_payload(fresh);
+        successful = read_value();
+    }
     token token;
     skip_comment_tokens(token);
     if (features_.fail_if_extra_) {
@@ -1157,9 +1463,326 @@ bool our_reader::parse(const char* begin_doc,
             return false;
         }
     }
+    // Only plain JSON is kept: the text of values is copied from it as is.
+    if (successful && features_.keep_source_ && !saw_comment_ && !features_.allow_single_quotes_
+        && !features_.allow_numeric_keys_ && !features_.allow_dropped_null_placeholders_)
+        root.set_source(begin_doc, end_doc);
+    if (successful && features_.dedupe_)
+        dedupe(root);
+    return successful;
+}
+
+bool our_reader::parse(const char* begin_doc,
+    const char* end_doc,
+    tape& root)
+{
+    begin_ = begin_doc;
+    end_ = end_doc;
+    collect_comments_ = false;
+    current_ = begin_;
+    start_index();
+    last_value_end_ = 0;
+    last_value_ = 0;
+    comments_before_ = "";
+    errors_.clear();
+    while (!nodes_.empty())
+        nodes_.pop();
+
+    tape_builder out(root);
+    stack_depth_ = 0;
+    bool successful;
+    tape_sink sink(out);
+    if (indexed_ && walk_index(sink)) {
+        current_ = end_;
+        successful = true;
+    }
+    else {
+        current_ = begin_; // start over; errors are reported by read_value()
+        next_ = 0;
+        errors_.clear();
+        root.clear();
+        successful = read_value(out);
+    }
+    token token;
+    skip_comment_tokens(token);
+    if (features_.fail_if_extra_) {
+        if (token.type_ != tt_error && token.type_ != tt_end_of_stream) {
+            add_error("Extra non-whitespace after JSON value.", token);
+            successful = false;
+        }
+    }
+    if (successful && features_.strict_root_) {
+        tape_view top = out.root();
+        if (!top.is_array() && !top.is_object()) {
+            // Set error location to start of doc, ideally should be first token found
+            // in doc
+            token.type_ = tt_error;
+            token.start_ = begin_doc;
+            token.end_ = end_doc;
+            add_error(
+                "A valid JSON document must be either an array or an object value.",
+                token);
+            successful = false;
+        }
+    }
+    if (!successful)
+        root.clear();
+    return successful;
+}
+
+bool our_reader::parse(const char* begin_doc,
+    const char* end_doc,
+    lazy_document& root)
+{
+    begin_ = begin_doc;
+    end_ = end_doc;
+    collect_comments_ = false;
+    current_ = begin_;
+    start_index();
+    last_value_end_ = 0;
+    last_value_ = 0;
+    comments_before_ = "";
+    errors_.clear();
+    while (!nodes_.empty())
+        nodes_.pop();
+
+    root.clear();
+    stack_depth_ = 0;
+    bool successful = read_value(root);
+    token token;
+    skip_comment_tokens(token);
+    if (successful && features_.fail_if_extra_) {
+        if (token.type_ != tt_error && token.type_ != tt_end_of_stream) {
+            add_error("Extra non-whitespace after JSON value.", token);
+            successful = false;
+        }
+    }
+    if (successful && features_.strict_root_) {
+        value_type type = root.nodes_[0].type_;
+        if (type != vt_array && type != vt_object) {
+            // Set error location to start of doc, ideally should be first token found
+            // in doc
+            token.type_ = tt_error;
+            token.start_ = begin_doc;
+            token.end_ = end_doc;
+            add_error(
+                "A valid JSON document must be either an array or an object value.",
+                token);
+            successful = false;
+        }
+    }
+    if (!successful)
+        root.clear();
     return successful;
 }
 
+// Parallel parsing of a top-level array
+// ////////////////////////////////
+//
+// The elements of a large top-level array are split at the commas found by
+// the structural index, and contiguous runs of elements ("slices") are parsed
+// by their own our_reader on their own thread. Each slice reader is given the
+// whole document, and only reads from its slice, so offsets and error
+// locations are relative to the whole document.
+
+// Below this many bytes per slice, a thread costs more than it saves.
+static size_t const min_slice_bytes = 64 * 1024;
+
+struct slice_job {
+    our_reader* reader_;
+    char const* begin_doc_;
+    char const* begin_;
+    char const* end_;
+    value elements_;
+    bool ok_;
+    std::exception_ptr failure_;
+};
+
+static void run_slice(slice_job* job)
+{
+    try {
+        job->ok_ = job->reader_->read_slice(job->begin_doc_, job->begin_, job->end_,
+            job->elements_);
+    }
+    catch (...) {
+        job->ok_ = false;
+        job->failure_ = std::current_exception();
+    }
+}
+
+// Offsets of the commas between the elements of a top-level array, followed by
+// the offset of its closing bracket. Gives up on anything else: another root,
+// unbalanced brackets, empty elements, text after the array.
+bool our_reader::find_elements(std::vector<size_t>& separators)
+{
+    size_t const count = index_.size();
+    if (count < 2 || begin_[index_[0]] != '[')
+        return false;
+    std::string& closers = closers_;
+    closers.clear();
+    bool expect_element = true;
+    for (size_t next = 0; next != count; ++next) {
+        size_t offset = index_[next];
+        char c = begin_[offset];
+        bool top = closers.size() == 1;
+        if (top && c != ',' && c != ']')
+            expect_element = false;
+        switch (c) {
+        case '{':
+        case '[':
+            closers += c == '{' ? '}' : ']';
+            break;
+        case '}':
+        case ']':
+            if (closers.empty() || c != closers[closers.size() - 1])
+                return false;
+            closers.erase(closers.size() - 1);
+            if (closers.empty()) {
+                if (expect_element && !separators.empty())
+                    return false; // "[1,]"
+                separators.push_back(offset);
+                return next + 1 == count;
+            }
+            break;
+        case ',':
+            if (top) {
+                if (expect_element)
+                    return false; // "[,1]", "[1,,2]"
+                separators.push_back(offset);
+                expect_element = true;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    return false;
+}
+
+bool our_reader::parse_slices(value& root, bool& successful)
+{
+    size_t const length = end_ - begin_;
+    size_t threads = features_.threads_ ? size_t(features_.threads_)
+                                        : size_t(std::thread::hardware_concurrency());
+    threads = std::min(threads, length / min_slice_bytes);
+    if (threads < 2 || features_.allow_single_quotes_ || features_.allow_dropped_null_placeholders_
+        || features_.stack_limit_ < 1)
+        return false;
+    if (!indexed_ && (!index_.build(begin_, end_) || index_.has_strays()))
+        return false; // unusual documents are read sequentially
+    std::vector<size_t> separators;
+    if (!find_elements(separators) || separators.size() < threads)
+        return false;
+    location_t const open = begin_ + index_[0];
+    location_t const close = begin_ + separators.back();
+
+    // Cut after the first comma past each multiple of length / threads.
+    std::vector<slice_job> jobs(threads);
+    location_t slice_begin = open + 1;
+    size_t used = 0;
+    size_t const target = (close - open) / threads;
+    size_t const commas = separators.size() - 1;
+    for (size_t i = 0; i != commas && used + 1 < threads; ++i) {
+        if (size_t(begin_ + separators[i] - slice_begin) < target)
+            continue;
+        jobs[used].begin_ = slice_begin;
+        jobs[used].end_ = begin_ + separators[i];
+        slice_begin = jobs[used].end_ + 1;
+        ++used;
+    }
+    jobs[used].begin_ = slice_begin;
+    jobs[used].end_ = close;
+    jobs.resize(used + 1);
+
+    our_features slice_features = features_;
+    slice_features.threads_ = 1;
+    slice_features.dedupe_ = false; // once, when joined
+    slice_features.use_structural_index_ = false;
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i != jobs.size(); ++i) {
+        jobs[i].reader_ = new our_reader(slice_features);
+        jobs[i].begin_doc_ = begin_;
+        if (i == 0)
+            continue;
+        try {
+            workers.push_back(std::thread(run_slice, &jobs[i]));
+        }
+        catch (std::system_error const&) {
+            run_slice(&jobs[i]); // out of threads
+        }
+    }
+    run_slice(&jobs[0]);
+    for (size_t i = 0; i != workers.size(); ++i)
+        workers[i].join();
+
+    value init(vt_array);
+    root.swap_payload(init);
+    root.set_offset_start(open - begin_);
+    root.set_offset_limit(close + 1 - begin_);
+    successful = true;
+    bool start_over = false;
+    std::exception_ptr failure;
+    array_index index = 0;
+    for (size_t i = 0; i != jobs.size(); ++i) {
+        slice_job& job = jobs[i];
+        if (successful && !job.ok_) {
+            // The first error of the earliest failing slice is the first
+            // error of the document. It is the only one reported, unless
+            // fail_if_extra_ also complains about what follows the point
+            // where recovery stops; that takes a sequential parse to tell.
+            successful = false;
+            failure = job.failure_;
+            errors_ = job.reader_->errors_;
+            start_over = !failure && features_.fail_if_extra_;
+        }
+        if (successful) {
+            for (array_index n = 0; n != job.elements_.size(); ++n)
+                root[index++].swap(job.elements_[n]);
+        }
+        delete job.reader_;
+    }
+    root.set_shareable();
+    if (failure)
+        std::rethrow_exception(failure);
+    if (start_over)
+        errors_.clear();
+    return !start_over;
+}
+
+// Read the comma-separated elements in [slice_begin, slice_end), which are
+// inside the top-level array of the document starting at begin_doc.
+bool our_reader::read_slice(location_t begin_doc, location_t slice_begin, location_t slice_end,
+    value& elements)
+{
+    begin_ = begin_doc;
+    end_ = slice_end;
+    collect_comments_ = false;
+    current_ = slice_begin;
+    indexed_ = false;
+    errors_.clear();
+    while (!nodes_.empty())
+        nodes_.pop();
+
+    elements = value(vt_array);
+    array_index index = 0;
+    for (;;) {
+        nodes_.push(&elements[index++]);
+        stack_depth_ = 1; // inside the top-level array
+        bool ok = read_value();
+        nodes_.pop();
+        if (!ok)
+            return false;
+        token token;
+        read_token(token);
+        if (token.type_ == tt_end_of_stream)
+            return true;
+        if (token.type_ != tt_array_separator) {
+            add_error("Missing ',' or ']' in array declaration", token);
+            return false;
+        }
+    }
+}
+
 bool our_reader::read_value()
 {
     if (stack_depth_ >= features_.stack_limit_)
@@ -1178,10 +1801,12 @@ bool our_reader::read_value()
     case tt_object_begin:
         successful = read_object(token);
         current_value().set_offset_limit(current_ - begin_);
+        current_value().set_shareable(); // nothing in it is held any more
         break;
     case tt_array_begin:
         successful = read_array(token);
         current_value().set_offset_limit(current_ - begin_);
+        current_value().set_shareable();
         break;
     case tt_number:
         successful = decode_number(token);
@@ -1249,7 +1874,10 @@ void our_reader::skip_comment_tokens(token& token)
 
 bool our_reader::read_token(token& token)
 {
-    skip_spaces();
+    if (indexed_)
+        skip_spaces_indexed();
+    else
+        skip_spaces();
     token.start_ = current_;
     char c = get_next_char();
     bool ok = true;
@@ -1268,7 +1896,7 @@ bool our_reader::read_token(token& token)
         break;
     case '"':
         token.type_ = tt_string;
-        ok = read_string();
+        ok = indexed_ ? read_string_indexed() : read_string();
         break;
     case '\'':
         if (features_.allow_single_quotes_) {
@@ -1336,11 +1964,54 @@ void our_reader::skip_spaces()
     }
 }
 
-bool our_reader::match(location_t pattern, int pattern_length)
+// Stage one of the "simd" engine: when enabled, index the whole document so
+// that read_token() can jump over whitespace and strings. Documents that may
+// contain comments or single-quoted strings are read without the index,
+// since the index does not know about them.
+void our_reader::start_index()
 {
-    if (end_ - current_ < pattern_length)
-        return false;
-    int index = pattern_length;
+    indexed_ = features_.use_structural_index_
+        && !features_.allow_single_quotes_
+        && index_.build(begin_, end_)
+        && !index_.has_strays(); // read_token() accepts comments in any mode
+    next_ = 0;
+}
+
+// Any whitespace at current_ extends to the next indexed position. Otherwise
+// current_ is at a token already, or in the rest of a number or literal that
+// read_token() should complain about; both are left alone.
+void our_reader::skip_spaces_indexed()
+{
+    if (current_ == end_)
+        return;
+    char c = *current_;
+    if (c != ' ' && c != '\t' && c != '\r' && c != '\n')
+        return;
+    size_t const offset = current_ - begin_;
+    while (next_ != index_.size() && index_[next_] < offset)
+        ++next_;
+    current_ = next_ != index_.size() ? begin_ + index_[next_] : end_;
+}
+
+// After the opening quote, the next indexed position is the closing quote.
+bool our_reader::read_string_indexed()
+{
+    size_t const offset = current_ - begin_;
+    while (next_ != index_.size() && index_[next_] < offset)
+        ++next_;
+    if (next_ != index_.size() && begin_[index_[next_]] == '"') {
+        current_ = begin_ + index_[next_] + 1;
+        ++next_;
+        return true;
+    }
+    return read_string(); // unterminated; let it report so
+}
+
+bool our_reader::match(location_t pattern, int pattern_length)
+{
+    if (end_ - current_ < pattern_length)
+        return false;
+    int index = pattern_length;
     while (index--)
         if (current_[index] != pattern[index])
             return false;
@@ -1359,6 +2030,7 @@ bool our_reader::read_comment()
         successful = read_cpp_style_comment();
     if (!successful)
         return false;
+    saw_comment_ = true;
 
     if (collect_comments_) {
         comment_placement placement = comment_before;
@@ -1435,56 +2107,423 @@ void our_reader::read_number()
     }
 }
 bool our_reader::read_string()
+{
+    while (current_ != end_) {
+        current_ = find_quote_or_backslash(current_, end_);
+        if (current_ == end_)
+            break;
+        if (*current_++ == '"')
+            return true;
+        if (current_ != end_) // escaped character
+            ++current_;
+    }
+    return false;
+}
+
+bool our_reader::read_string_single_quote()
 {
     char c = 0;
     while (current_ != end_) {
         c = get_next_char();
         if (c == '\\')
             get_next_char();
-        else if (c == '"')
+        else if (c == '\'')
+            break;
+    }
+    return c == '\'';
+}
+
+bool our_reader::read_object(token& token_start)
+{
+    token token_name;
+    std::string name;
+    value init(vt_object);
+    current_value().swap_payload(init);
+    current_value().set_offset_start(token_start.start_ - begin_);
+    while (read_token(token_name)) {
+        bool initial_token_ok = true;
+        while (token_name.type_ == tt_comment && initial_token_ok)
+            initial_token_ok = read_token(token_name);
+        if (!initial_token_ok)
+            break;
+        if (token_name.type_ == tt_object_end && name.empty()) // empty object
+            return true;
+        name = "";
+        if (token_name.type_ == tt_string) {
+            if (!decode_string(token_name, name))
+                return recover_from_error(tt_object_end);
+        }
+        else if (token_name.type_ == tt_number && features_.allow_numeric_keys_) {
+            value number_name;
+            if (!decode_number(token_name, number_name))
+                return recover_from_error(tt_object_end);
+            name = number_name.as_string();
+        }
+        else {
+            break;
+        }
+
+        token colon;
+        if (!read_token(colon) || colon.type_ != tt_member_separator) {
+            return add_error_and_recover(
+                "Missing ':' after object member name", colon, tt_object_end);
+        }
+        if (name.length() >= (1U << 30))
+            throw_runtime_error("keylength >= 2^30");
+        if (features_.reject_dup_keys_ && current_value().is_member(name)) {
+            std::string msg = "Duplicate key: '" + name + "'";
+            return add_error_and_recover(
+                msg, token_name, tt_object_end);
+        }
+        value& value = current_value()[name];
+        nodes_.push(&value);
+        bool ok = read_value();
+        nodes_.pop();
+        if (!ok) // error already set
+            return recover_from_error(tt_object_end);
+
+        token comma;
+        if (!read_token(comma) || (comma.type_ != tt_object_end && comma.type_ != tt_array_separator && comma.type_ != tt_comment)) {
+            return add_error_and_recover(
+                "Missing ',' or '}' in object declaration", comma, tt_object_end);
+        }
+        bool finalizeTokenOk = true;
+        while (comma.type_ == tt_comment && finalizeTokenOk)
+            finalizeTokenOk = read_token(comma);
+        if (comma.type_ == tt_object_end)
+            return true;
+    }
+    return add_error_and_recover(
+        "Missing '}' or object member name", token_name, tt_object_end);
+}
+
+bool our_reader::read_array(token& token_start)
+{
+    value init(vt_array);
+    current_value().swap_payload(init);
+    current_value().set_offset_start(token_start.start_ - begin_);
+    skip_spaces();
+    if (*current_ == ']') // empty array
+    {
+        token endArray;
+        read_token(endArray);
+        return true;
+    }
+    int index = 0;
+    for (;;) {
+        value& value = current_value()[index++];
+        nodes_.push(&value);
+        bool ok = read_value();
+        nodes_.pop();
+        if (!ok) // error already set
+            return recover_from_error(tt_array_end);
+
+        token token;
+        // Accept Comment after last item in the array.
+        ok = read_token(token);
+        while (token.type_ == tt_comment && ok) {
+            ok = read_token(token);
+        }
+        bool badTokenType = (token.type_ != tt_array_separator && token.type_ != tt_array_end);
+        if (!ok || badTokenType) {
+            return add_error_and_recover(
+                "Missing ',' or ']' in array declaration", token, tt_array_end);
+        }
+        if (token.type_ == tt_array_end)
+            break;
+    }
+    return true;
+}
+
+// The tape overloads below follow read_value(), read_object() and
+// read_array() token for token, so that both produce the same errors. On
+// error the partially filled tape is discarded by parse(), hence no recovery.
+
+bool our_reader::read_value(tape_builder& out)
+{
+    if (stack_depth_ >= features_.stack_limit_)
+        throw_runtime_error("Exceeded stack_limit in read_value().");
+    ++stack_depth_;
+    token token;
+    skip_comment_tokens(token);
+    bool successful = true;
+
+    switch (token.type_) {
+    case tt_object_begin:
+        successful = read_object(token, out);
+        break;
+    case tt_array_begin:
+        successful = read_array(token, out);
+        break;
+    case tt_number: {
+        value decoded;
+        successful = decode_number(token, decoded);
+        if (successful)
+            out.add_number(decoded);
+    } break;
+    case tt_string:
+        successful = decode_string(token, out);
+        break;
+    case tt_true:
+        out.add_bool(true);
+        break;
+    case tt_false:
+        out.add_bool(false);
+        break;
+    case tt_null:
+        out.add_null();
+        break;
+    case tt_array_separator:
+    case tt_object_end:
+    case tt_array_end:
+        if (features_.allow_dropped_null_placeholders_) {
+            // "Un-read" the current token and add a null.
+            current_--;
+            out.add_null();
+            break;
+        } // else, fall through ...
+    default:
+        return add_error("Syntax error: value, object or array expected.", token);
+    }
+
+    --stack_depth_;
+    return successful;
+}
+
+bool our_reader::read_object(token& /*token_start*/, tape_builder& out)
+{
+    token token_name;
+    size_t begin = out.begin_object();
+    size_t count = 0;
+    while (read_token(token_name)) {
+        bool initial_token_ok = true;
+        while (token_name.type_ == tt_comment && initial_token_ok)
+            initial_token_ok = read_token(token_name);
+        if (!initial_token_ok)
+            break;
+        if (token_name.type_ == tt_object_end && count == 0) { // empty object
+            out.end_object(begin, count);
+            return true;
+        }
+        char const* name = token_name.start_ + 1;
+        size_t length = token_name.end_ - token_name.start_ - 2;
+        if (token_name.type_ == tt_string) {
+            if (*token_name.start_ != '"' || memchr(name, '\\', length)) {
+                if (!decode_string(token_name, scratch_.erase()))
+                    return false;
+                name = scratch_.data();
+                length = scratch_.length();
+            }
+        }
+        else if (token_name.type_ == tt_number && features_.allow_numeric_keys_) {
+            value number_name;
+            if (!decode_number(token_name, number_name))
+                return false;
+            scratch_ = number_name.as_string();
+            name = scratch_.data();
+            length = scratch_.length();
+        }
+        else {
+            break;
+        }
+
+        token colon;
+        if (!read_token(colon) || colon.type_ != tt_member_separator) {
+            return add_error_and_recover(
+                "Missing ':' after object member name", colon, tt_object_end);
+        }
+        if (length >= (1U << 30))
+            throw_runtime_error("keylength >= 2^30");
+        if (features_.reject_dup_keys_ && out.has_key(begin, name, length)) {
+            std::string msg = "Duplicate key: '" + std::string(name, length) + "'";
+            return add_error_and_recover(
+                msg, token_name, tt_object_end);
+        }
+        out.add_string(name, length);
+        if (!read_value(out)) // error already set
+            return false;
+        ++count;
+
+        token comma;
+        if (!read_token(comma) || (comma.type_ != tt_object_end && comma.type_ != tt_array_separator && comma.type_ != tt_comment)) {
+            return add_error_and_recover(
+                "Missing ',' or '}' in object declaration", comma, tt_object_end);
+        }
+        bool finalizeTokenOk = true;
+        while (comma.type_ == tt_comment && finalizeTokenOk)
+            finalizeTokenOk = read_token(comma);
+        if (comma.type_ == tt_object_end) {
+            out.end_object(begin, count);
+            return true;
+        }
+    }
+    return add_error_and_recover(
+        "Missing '}' or object member name", token_name, tt_object_end);
+}
+
+bool our_reader::read_array(token& /*token_start*/, tape_builder& out)
+{
+    size_t begin = out.begin_array();
+    size_t count = 0;
+    skip_spaces();
+    if (current_ != end_ && *current_ == ']') // empty array
+    {
+        token endArray;
+        read_token(endArray);
+        out.end_array(begin, count);
+        return true;
+    }
+    for (;;) {
+        if (!read_value(out)) // error already set
+            return false;
+        ++count;
+
+        token token;
+        // Accept Comment after last item in the array.
+        bool ok = read_token(token);
+        while (token.type_ == tt_comment && ok) {
+            ok = read_token(token);
+        }
+        bool badTokenType = (token.type_ != tt_array_separator && token.type_ != tt_array_end);
+        if (!ok || badTokenType) {
+            return add_error_and_recover(
+                "Missing ',' or ']' in array declaration", token, tt_array_end);
+        }
+        if (token.type_ == tt_array_end)
+            break;
+    }
+    out.end_array(begin, count);
+    return true;
+}
+
+// The lazy_document overloads below decode one level at a time: objects and
+// arrays nested in the container being expanded are only skipped over, and
+// recorded with their offsets. The grammar and error messages are those of
+// read_object() and read_array().
+
+bool our_reader::expand(lazy_document const& doc, size_t index)
+{
+    errors_.clear();
+    lazy_document::node const& node = doc.nodes_[index];
+    current_ = begin_ + node.start_ + 1; // skip '{' or '['
+    if (indexed_)
+        next_ = index_.lower_bound(node.start_ + 1);
+    stack_depth_ = node.depth_ + 1;
+    size_t first = doc.nodes_.size();
+    bool successful = node.type_ == vt_object ? read_object(doc) : read_array(doc);
+    if (!successful) {
+        doc.nodes_.resize(first);
+        return false;
+    }
+    lazy_document::node& expanded = doc.nodes_[index];
+    expanded.first_child_ = first;
+    expanded.child_count_ = array_index(doc.nodes_.size() - first);
+    expanded.expanded_ = true;
+    return true;
+}
+
+bool our_reader::read_value(lazy_document const& doc)
+{
+    if (stack_depth_ >= features_.stack_limit_)
+        throw_runtime_error("Exceeded stack_limit in read_value().");
+    ++stack_depth_;
+    token token;
+    skip_comment_tokens(token);
+    bool successful = true;
+
+    lazy_document::node node;
+    node.type_ = vt_null;
+    node.start_ = token.start_ - begin_;
+    node.limit_ = token.end_ - begin_;
+    node.key_ = 0;
+    node.key_length_ = 0;
+    node.first_child_ = 0;
+    node.child_count_ = 0;
+    node.depth_ = stack_depth_ - 1;
+    node.expanded_ = false;
+
+    switch (token.type_) {
+    case tt_object_begin:
+        node.type_ = vt_object;
+        successful = skip_container(token);
+        node.limit_ = current_ - begin_;
+        break;
+    case tt_array_begin:
+        node.type_ = vt_array;
+        successful = skip_container(token);
+        node.limit_ = current_ - begin_;
+        break;
+    case tt_number:
+        successful = decode_number(token, node.scalar_);
+        node.type_ = node.scalar_.type();
+        break;
+    case tt_string:
+        successful = decode_string(token, scratch_.erase());
+        node.type_ = vt_string;
+        node.scalar_ = scratch_;
+        break;
+    case tt_true:
+        node.type_ = vt_bool;
+        node.scalar_ = true;
+        break;
+    case tt_false:
+        node.type_ = vt_bool;
+        node.scalar_ = false;
+        break;
+    case tt_null:
+        break;
+    case tt_array_separator:
+    case tt_object_end:
+    case tt_array_end:
+        if (features_.allow_dropped_null_placeholders_) {
+            // "Un-read" the current token and mark the current value as a null
+            // token.
+            current_--;
+            node.start_ = current_ - begin_ - 1;
+            node.limit_ = current_ - begin_;
             break;
+        } // else, fall through ...
+    default:
+        return add_error("Syntax error: value, object or array expected.", token);
     }
-    return c == '"';
-}
 
-bool our_reader::read_string_single_quote()
-{
-    char c = 0;
-    while (current_ != end_) {
-        c = get_next_char();
-        if (c == '\\')
-            get_next_char();
-        else if (c == '\'')
-            break;
-    }
-    return c == '\'';
+    doc.nodes_.push_back(node);
+    --stack_depth_;
+    return successful;
 }
 
-bool our_reader::read_object(token& token_start)
+bool our_reader::read_object(lazy_document const& doc)
 {
     token token_name;
-    std::string name;
-    value init(vt_object);
-    current_value().swap_payload(init);
-    current_value().set_offset_start(token_start.start_ - begin_);
+    size_t first = doc.nodes_.size();
     while (read_token(token_name)) {
         bool initial_token_ok = true;
         while (token_name.type_ == tt_comment && initial_token_ok)
             initial_token_ok = read_token(token_name);
         if (!initial_token_ok)
             break;
-        if (token_name.type_ == tt_object_end && name.empty()) // empty object
+        if (token_name.type_ == tt_object_end && doc.nodes_.size() == first) // empty object
             return true;
-        name = "";
+        char const* name;
+        size_t length;
         if (token_name.type_ == tt_string) {
-            if (!decode_string(token_name, name))
-                return recover_from_error(tt_object_end);
+            name = token_name.start_ + 1;
+            length = token_name.end_ - token_name.start_ - 2;
+            if (*token_name.start_ != '"' || memchr(name, '\\', length)) {
+                doc.keys_.push_back(std::string());
+                if (!decode_string(token_name, doc.keys_.back()))
+                    return false;
+                name = doc.keys_.back().data();
+                length = doc.keys_.back().length();
+            }
         }
         else if (token_name.type_ == tt_number && features_.allow_numeric_keys_) {
             value number_name;
             if (!decode_number(token_name, number_name))
-                return recover_from_error(tt_object_end);
-            name = number_name.as_string();
+                return false;
+            doc.keys_.push_back(number_name.as_string());
+            name = doc.keys_.back().data();
+            length = doc.keys_.back().length();
         }
         else {
             break;
@@ -1495,19 +2534,22 @@ bool our_reader::read_object(token& token_start)
             return add_error_and_recover(
                 "Missing ':' after object member name", colon, tt_object_end);
         }
-        if (name.length() >= (1U << 30))
+        if (length >= (1U << 30))
             throw_runtime_error("keylength >= 2^30");
-        if (features_.reject_dup_keys_ && current_value().is_member(name)) {
-            std::string msg = "Duplicate key: '" + name + "'";
-            return add_error_and_recover(
-                msg, token_name, tt_object_end);
+        if (features_.reject_dup_keys_) {
+            for (size_t member = first; member < doc.nodes_.size(); ++member) {
+                lazy_document::node const& other = doc.nodes_[member];
+                if (other.key_length_ == length && memcmp(other.key_, name, length) == 0) {
+                    std::string msg = "Duplicate key: '" + std::string(name, length) + "'";
+                    return add_error_and_recover(
+                        msg, token_name, tt_object_end);
+                }
+            }
         }
-        value& value = current_value()[name];
-        nodes_.push(&value);
-        bool ok = read_value();
-        nodes_.pop();
-        if (!ok) // error already set
-            return recover_from_error(tt_object_end);
+        if (!read_value(doc)) // error already set
+            return false;
+        doc.nodes_.back().key_ = name;
+        doc.nodes_.back().key_length_ = length;
 
         token comma;
         if (!read_token(comma) || (comma.type_ != tt_object_end && comma.type_ != tt_array_separator && comma.type_ != tt_comment)) {
@@ -1524,30 +2566,22 @@ bool our_reader::read_object(token& token_start)
         "Missing '}' or object member name", token_name, tt_object_end);
 }
 
-bool our_reader::read_array(token& token_start)
+bool our_reader::read_array(lazy_document const& doc)
 {
-    value init(vt_array);
-    current_value().swap_payload(init);
-    current_value().set_offset_start(token_start.start_ - begin_);
     skip_spaces();
-    if (*current_ == ']') // empty array
+    if (current_ != end_ && *current_ == ']') // empty array
     {
         token endArray;
         read_token(endArray);
         return true;
     }
-    int index = 0;
     for (;;) {
-        value& value = current_value()[index++];
-        nodes_.push(&value);
-        bool ok = read_value();
-        nodes_.pop();
-        if (!ok) // error already set
-            return recover_from_error(tt_array_end);
+        if (!read_value(doc)) // error already set
+            return false;
 
         token token;
         // Accept Comment after last item in the array.
-        ok = read_token(token);
+        bool ok = read_token(token);
         while (token.type_ == tt_comment && ok) {
             ok = read_token(token);
         }
@@ -1562,6 +2596,443 @@ bool our_reader::read_array(token& token_start)
     return true;
 }
 
+// Moves current_ just past the bracket that closes token_start, looking only
+// at strings, comments and brackets. Everything else inside is left for
+// expand() to check. With an index, this is a walk over its entries;
+// otherwise a vectorized scan jumps from one bracket or quote to the next.
+bool our_reader::skip_container(token& token_start)
+{
+    closers_.assign(1, token_start.type_ == tt_object_begin ? '}' : ']');
+    if (indexed_)
+        return skip_container_indexed();
+    while (current_ != end_) {
+        current_ = find_bracket_or_quote(current_, end_);
+        if (current_ == end_)
+            break;
+        token token;
+        token.type_ = tt_error;
+        token.start_ = current_;
+        token.end_ = current_ + 1;
+        char c = *current_++;
+        switch (c) {
+        case '"':
+            if (!read_string())
+                return add_error("Missing closing quote at end of string", token);
+            break;
+        case '\'':
+            if (features_.allow_single_quotes_ && !read_string_single_quote())
+                return add_error("Missing closing quote at end of string", token);
+            break;
+        case '/':
+            if (features_.allow_comments_ && current_ != end_ && (*current_ == '*' || *current_ == '/')) {
+                if (!read_comment())
+                    return add_error("Unterminated comment", token);
+            }
+            break;
+        case '{':
+            closers_ += '}';
+            break;
+        case '[':
+            closers_ += ']';
+            break;
+        case '}':
+        case ']':
+            if (c != closers_[closers_.size() - 1]) {
+                return add_error(closers_[closers_.size() - 1] == '}'
+                        ? "Missing ',' or '}' in object declaration"
+                        : "Missing ',' or ']' in array declaration",
+                    token);
+            }
+            closers_.erase(closers_.size() - 1);
+            if (closers_.empty())
+                return true;
+            break;
+        default:
+            break;
+        }
+    }
+    token token;
+    token.type_ = tt_error;
+    token.start_ = current_;
+    token.end_ = current_;
+    return add_error(closers_[closers_.size() - 1] == '}'
+            ? "Missing '}' or object member name"
+            : "Missing ',' or ']' in array declaration",
+        token);
+}
+
+// The index has no comments or single quotes (see start_index()), and lists
+// both quotes of every string.
+bool our_reader::skip_container_indexed()
+{
+    size_t const count = index_.size();
+    size_t next = index_.lower_bound(current_ - begin_);
+    for (; next != count; ++next) {
+        location_t at = begin_ + index_[next];
+        token token;
+        token.type_ = tt_error;
+        token.start_ = at;
+        token.end_ = at + 1;
+        switch (*at) {
+        case '"':
+            if (++next == count) {
+                current_ = end_;
+                return add_error("Missing closing quote at end of string", token);
+            }
+            break;
+        case '{':
+            closers_ += '}';
+            break;
+        case '[':
+            closers_ += ']';
+            break;
+        case '}':
+        case ']':
+            if (*at != closers_[closers_.size() - 1]) {
+                current_ = at + 1;
+                return add_error(closers_[closers_.size() - 1] == '}'
+                        ? "Missing ',' or '}' in object declaration"
+                        : "Missing ',' or ']' in array declaration",
+                    token);
+            }
+            closers_.erase(closers_.size() - 1);
+            if (closers_.empty()) {
+                current_ = at + 1;
+                next_ = next + 1;
+                return true;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    current_ = end_;
+    token token;
+    token.type_ = tt_error;
+    token.start_ = current_;
+    token.end_ = current_;
+    return add_error(closers_[closers_.size() - 1] == '}'
+            ? "Missing '}' or object member name"
+            : "Missing ',' or ']' in array declaration",
+        token);
+}
+
+// Pull parsing
+// ////////////////////////////////
+//
+// pull() follows read_value(), read_object() and read_array() token for
+// token, one event at a time, with an explicit stack of open containers
+// instead of recursion. Errors stop the parse, as in the tape overloads.
+
+void our_reader::start_pull(const char* begin_doc, const char* end_doc)
+{
+    begin_ = begin_doc;
+    end_ = end_doc;
+    collect_comments_ = false;
+    current_ = begin_;
+    start_index();
+    errors_.clear();
+    containers_.clear();
+    pull_state_ = ps_value;
+    pulled_event_ = et_none;
+    pulled_.type_ = tt_error;
+    pulled_.start_ = begin_;
+    pulled_.end_ = begin_;
+}
+
+event_type our_reader::pull()
+{
+    if (pull_state_ == ps_done)
+        return pulled_event_;
+    token& token = pulled_;
+    for (;;) {
+        switch (pull_state_) {
+        case ps_first_member:
+        case ps_member:
+            read_token(token);
+            while (token.type_ == tt_comment)
+                read_token(token);
+            // As in read_object(), '}' may follow ',' when the previous
+            // member name was empty.
+            if (token.type_ == tt_object_end && (pull_state_ == ps_first_member || empty_key_))
+                return pull_close(token);
+            if (token.type_ == tt_string
+                || (token.type_ == tt_number && features_.allow_numeric_keys_)) {
+                empty_key_ = token.type_ == tt_string && token.end_ - token.start_ == 2;
+                pull_state_ = ps_colon;
+                return pulled_event_ = et_key;
+            }
+            return pull_error("Missing '}' or object member name", token);
+        case ps_colon:
+            read_token(token);
+            if (token.type_ != tt_member_separator)
+                return pull_error("Missing ':' after object member name", token);
+            pull_state_ = ps_value;
+            break;
+        case ps_first_element:
+            skip_spaces();
+            if (current_ != end_ && *current_ == ']') { // empty array
+                read_token(token);
+                return pull_close(token);
+            }
+        // fall through
+        case ps_value:
+            skip_comment_tokens(token);
+            return pull_value(token);
+        case ps_separator:
+            if (containers_.empty()) {
+                pull_state_ = ps_done;
+                skip_comment_tokens(token);
+                if (features_.fail_if_extra_ && token.type_ != tt_error
+                    && token.type_ != tt_end_of_stream)
+                    return pull_error("Extra non-whitespace after JSON value.", token);
+                return pulled_event_ = et_end_of_stream;
+            }
+            read_token(token);
+            if (containers_[containers_.size() - 1] == '}') {
+                if (token.type_ != tt_object_end && token.type_ != tt_array_separator
+                    && token.type_ != tt_comment)
+                    return pull_error("Missing ',' or '}' in object declaration", token);
+                while (token.type_ == tt_comment)
+                    read_token(token);
+                if (token.type_ == tt_object_end)
+                    return pull_close(token);
+                pull_state_ = ps_member;
+            }
+            else {
+                while (token.type_ == tt_comment)
+                    read_token(token);
+                if (token.type_ == tt_array_end)
+                    return pull_close(token);
+                if (token.type_ != tt_array_separator)
+                    return pull_error("Missing ',' or ']' in array declaration", token);
+                pull_state_ = ps_value;
+            }
+            break;
+        default:
+            return pulled_event_;
+        }
+    }
+}
+
+event_type our_reader::pull_value(token& token)
+{
+    if (int(containers_.size()) >= features_.stack_limit_)
+        throw_runtime_error("Exceeded stack_limit in read_value().");
+    event_type event;
+    switch (token.type_) {
+    case tt_object_begin:
+        containers_ += '}';
+        pull_state_ = ps_first_member;
+        return pulled_event_ = et_begin_object;
+    case tt_array_begin:
+        containers_ += ']';
+        pull_state_ = ps_first_element;
+        return pulled_event_ = et_begin_array;
+    case tt_string:
+        event = et_string;
+        break;
+    case tt_number:
+        event = et_number;
+        break;
+    case tt_true:
+    case tt_false:
+        event = et_bool;
+        break;
+    case tt_null:
+        event = et_null;
+        break;
+    case tt_array_separator:
+    case tt_object_end:
+    case tt_array_end:
+        if (features_.allow_dropped_null_placeholders_) {
+            // "Un-read" the token; the null is empty, just before it.
+            current_ = token.start_;
+            token.type_ = tt_null;
+            token.end_ = token.start_;
+            event = et_null;
+            break;
+        } // else, fall through ...
+    default:
+        return pull_error("Syntax error: value, object or array expected.", token);
+    }
+    if (containers_.empty() && features_.strict_root_) {
+        // Set error location to start of doc, as parse() does
+        token.type_ = tt_error;
+        token.start_ = begin_;
+        token.end_ = end_;
+        return pull_error(
+            "A valid JSON document must be either an array or an object value.",
+            token);
+    }
+    pull_state_ = ps_separator;
+    return pulled_event_ = event;
+}
+
+event_type our_reader::pull_close(token& token)
+{
+    containers_.erase(containers_.size() - 1);
+    pull_state_ = ps_separator;
+    return pulled_event_ = token.type_ == tt_object_end ? et_end_object : et_end_array;
+}
+
+event_type our_reader::pull_error(std::string const& message, token& token)
+{
+    add_error(message, token);
+    pull_state_ = ps_done;
+    return pulled_event_ = et_error;
+}
+
+bool our_reader::fail_pulled(std::string const& message)
+{
+    if (pulled_event_ == et_error)
+        return false;
+    add_error(message, pulled_);
+    return pull_failed();
+}
+
+// The error is already set.
+bool our_reader::pull_failed()
+{
+    pull_state_ = ps_done;
+    pulled_event_ = et_error;
+    return false;
+}
+
+bool our_reader::skip_pulled()
+{
+    token& token = pulled_;
+    switch (pulled_event_) {
+    case et_key: {
+        read_token(token);
+        if (token.type_ != tt_member_separator) {
+            pull_error("Missing ':' after object member name", token);
+            return false;
+        }
+        skip_comment_tokens(token);
+        switch (token.type_) {
+        case tt_object_begin:
+        case tt_array_begin:
+            break;
+        case tt_string:
+        case tt_number:
+        case tt_true:
+        case tt_false:
+        case tt_null:
+            token.type_ = tt_error; // no payload
+            pull_state_ = ps_separator;
+            return true;
+        default:
+            return pull_value(token) != et_error; // a dropped null, if allowed
+        }
+    } break;
+    case et_begin_object:
+    case et_begin_array:
+        containers_.erase(containers_.size() - 1);
+        break;
+    case et_error:
+        return false;
+    default:
+        return true;
+    }
+    location_t start = token.start_;
+    if (!skip_container(token)) {
+        pull_state_ = ps_done;
+        pulled_event_ = et_error;
+        return false;
+    }
+    token.type_ = tt_error; // no payload
+    token.start_ = start;
+    token.end_ = current_;
+    pull_state_ = ps_separator;
+    return true;
+}
+
+int our_reader::pulled_depth() const
+{
+    int depth = int(containers_.size());
+    if (pulled_event_ == et_begin_object || pulled_event_ == et_begin_array)
+        --depth;
+    return depth;
+}
+
+bool our_reader::pulled_string(char const** str, char const** end)
+{
+    if (pulled_.type_ != tt_string || pulled_event_ == et_error)
+        return false;
+    location_t contents = pulled_.start_ + 1;
+    location_t limit = pulled_.end_ - 1;
+    if (find_quote_or_backslash(contents, limit) == limit) {
+        // Nothing to decode; hand out the document text.
+        *str = contents;
+        *end = limit;
+        return true;
+    }
+    pulled_text_.clear(); // keeps its capacity
+    if (!decode_string(pulled_, pulled_text_))
+        return pull_failed();
+    *str = pulled_text_.data();
+    *end = pulled_text_.data() + pulled_text_.size();
+    return true;
+}
+
+bool our_reader::decode_pulled(value& decoded)
+{
+    if (pulled_event_ == et_error)
+        return false;
+    if (pulled_event_ == et_begin_object || pulled_event_ == et_begin_array) {
+        if (pull_state_ != ps_first_member && pull_state_ != ps_first_element)
+            return false; // skipped
+        // Read the rest of the container as read_value() would.
+        containers_.erase(containers_.size() - 1);
+        stack_depth_ = int(containers_.size()) + 1;
+        while (!nodes_.empty())
+            nodes_.pop();
+        nodes_.push(&decoded);
+        bool successful = pulled_.type_ == tt_object_begin ? read_object(pulled_)
+                                                           : read_array(pulled_);
+        decoded.set_offset_limit(current_ - begin_);
+        nodes_.pop();
+        if (!successful)
+            return pull_failed();
+        pulled_.type_ = tt_error; // no payload left
+        pulled_.end_ = current_;
+        pull_state_ = ps_separator;
+        return true;
+    }
+    bool successful = true;
+    switch (pulled_.type_) {
+    case tt_string: {
+        char const* str;
+        char const* end;
+        successful = pulled_string(&str, &end);
+        if (successful) {
+            value v(str, end);
+            decoded.swap_payload(v);
+        }
+    } break;
+    case tt_number:
+        successful = decode_number(pulled_, decoded);
+        break;
+    case tt_true:
+    case tt_false: {
+        value v(pulled_.type_ == tt_true);
+        decoded.swap_payload(v);
+    } break;
+    case tt_null: {
+        value v;
+        decoded.swap_payload(v);
+    } break;
+    default:
+        return false;
+    }
+    if (!successful)
+        return pull_failed();
+    decoded.set_offset_start(pulled_.start_ - begin_);
+    decoded.set_offset_limit(pulled_.end_ - begin_);
+    return true;
+}
+
 bool our_reader::decode_number(token& token)
 {
     value decoded;
@@ -1627,7 +3098,6 @@ bool our_reader::decode_double(token& token, value& decoded)
 {
     double value = 0;
     const int bufferSize = 32;
-    int count;
     int length = int(token.end_ - token.start_);
 
     // Sanity check to avoid buffer overflow exploits.
@@ -1635,25 +3105,25 @@ bool our_reader::decode_double(token& token, value& decoded)
         return add_error("Unable to parse token length", token);
     }
 
-    // Avoid using a string constant for the format control string given to
-    // sscanf, as this can cause hard to debug crashes on OS X. See here for more
-    // info:
-    //
-    //     http://developer.apple.com/library/mac/#DOCUMENTATION/DeveloperTools/gcc-4.0.1/gcc/Incompatibilities.html
-    char format[] = "%lf";
-
+    // strtod() converts like sscanf("%lf"), without parsing a format string
+    // for every number.
+    bool converted;
     if (length <= bufferSize) {
         char buffer[bufferSize + 1];
         memcpy(buffer, token.start_, length);
         buffer[length] = 0;
-        count = sscanf(buffer, format, &value);
+        char* parsed_end;
+        value = strtod(buffer, &parsed_end);
+        converted = parsed_end != buffer;
     }
     else {
         std::string buffer(token.start_, token.end_);
-        count = sscanf(buffer.c_str(), format, &value);
+        char* parsed_end;
+        value = strtod(buffer.c_str(), &parsed_end);
+        converted = parsed_end != buffer.c_str();
     }
 
-    if (count != 1)
+    if (!converted)
         return add_error("'" + std::string(token.start_, token.end_) + "' is not a number.",
             token);
     decoded = value;
@@ -1678,6 +3148,13 @@ bool our_reader::decode_string(token& token, std::string& decoded)
     location_t current = token.start_ + 1; // skip '"'
     location_t end = token.end_ - 1; // do not include '"'
     while (current != end) {
+        // Copy everything up to the next escape (or quote) in one go.
+        location_t run = current;
+        while (current != end && *current != '"' && *current != '\\')
+            ++current;
+        decoded.append(run, current);
+        if (current == end)
+            break;
         char c = *current++;
         if (c == '"')
             break;
@@ -1720,13 +3197,24 @@ bool our_reader::decode_string(token& token, std::string& decoded)
                 return add_error("Bad escape sequence in string", token, current);
             }
         }
-        else {
-            decoded += c;
-        }
     }
     return true;
 }
 
+bool our_reader::decode_string(token& token, tape_builder& out)
+{
+    location_t begin = token.start_ + 1; // skip '"'
+    location_t end = token.end_ - 1; // do not include '"'
+    if (*token.start_ == '"' && !memchr(begin, '\\', end - begin)) {
+        out.add_string(begin, end - begin);
+        return true;
+    }
+    if (!decode_string(token, scratch_.erase()))
+        return false;
+    out.add_string(scratch_.data(), scratch_.length());
+    return true;
+}
+
 bool our_reader::decode_unicode_codepoint(token& token,
     location_t& current,
     location_t end,
@@ -1975,19 +3463,38 @@ char_reader_builder::char_reader_builder()
 char_reader_builder::~char_reader_builder()
 {
 }
+our_features make_features(value const& settings)
+{
+    our_features features = our_features::all();
+    features.allow_comments_ = settings["allow_comments"].as_bool();
+    features.strict_root_ = settings["strict_root"].as_bool();
+    features.allow_dropped_null_placeholders_ = settings["allow_dropped_null_placeholders"].as_bool();
+    features.allow_numeric_keys_ = settings["allow_numeric_keys"].as_bool();
+    features.allow_single_quotes_ = settings["allow_single_quotes"].as_bool();
+    features.stack_limit_ = settings["stack_limit"].as_int();
+    features.fail_if_extra_ = settings["fail_if_extra"].as_bool();
+    features.reject_dup_keys_ = settings["reject_dup_keys"].as_bool();
+    features.keep_source_ = settings["keep_source"].as_bool();
+    features.dedupe_ = settings["dedupe"].as_bool();
+    features.threads_ = settings["threads"].as_int();
+    if (features.threads_ < 0)
+        throw_runtime_error("threads must be >= 0");
+    std::string engine = settings["engine"].as_string();
+    if (engine == "simd") {
+        features.use_structural_index_ = true;
+    }
+    else if (engine == "classic") {
+        features.use_structural_index_ = false;
+    }
+    else {
+        throw_runtime_error("engine must be 'classic' or 'simd'");
+    }
+    return features;
+}
 char_reader* char_reader_builder::new_char_reader() const
 {
     bool collect_comments = settings_["collect_comments"].as_bool();
-    our_features features = our_features::all();
-    features.allow_comments_ = settings_["allow_comments"].as_bool();
-    features.strict_root_ = settings_["strict_root"].as_bool();
-    features.allow_dropped_null_placeholders_ = settings_["allow_dropped_null_placeholders"].as_bool();
-    features.allow_numeric_keys_ = settings_["allow_numeric_keys"].as_bool();
-    features.allow_single_quotes_ = settings_["allow_single_quotes"].as_bool();
-    features.stack_limit_ = settings_["stack_limit"].as_int();
-    features.fail_if_extra_ = settings_["fail_if_extra"].as_bool();
-    features.reject_dup_keys_ = settings_["reject_dup_keys"].as_bool();
-    return new our_char_reader(collect_comments, features);
+    return new our_char_reader(collect_comments, make_features(settings_));
 }
 static void get_valid_reader_keys(std::set<std::string>* valid_keys)
 {
@@ -2001,6 +3508,10 @@ static void get_valid_reader_keys(std::set<std::string>* valid_keys)
     valid_keys->insert("stack_limit");
     valid_keys->insert("fail_if_extra");
     valid_keys->insert("reject_dup_keys");
+    valid_keys->insert("engine");
+    valid_keys->insert("threads");
+    valid_keys->insert("keep_source");
+    valid_keys->insert("dedupe");
 }
 bool char_reader_builder::validate(json::value* invalid) const
 {
@@ -2050,6 +3561,10 @@ void char_reader_builder::set_defaults(json::value* settings)
     (*settings)["stack_limit"] = 1000;
     (*settings)["fail_if_extra"] = false;
     (*settings)["reject_dup_keys"] = false;
+    (*settings)["engine"] = "classic";
+    (*settings)["threads"] = 1;
+    (*settings)["keep_source"] = false;
+    (*settings)["dedupe"] = false;
     //! [CharReaderBuilderDefaults]
 }
 
@@ -2070,6 +3585,33 @@ bool parse_from_stream(
     return reader->parse(begin, end, root, errs);
 }
 
+bool parse_tape(
+    char_reader_builder const& builder,
+    char const* begin_doc, char const* end_doc,
+    tape* root, std::string* errs)
+{
+    our_reader reader(make_features(builder.settings_));
+    bool ok = reader.parse(begin_doc, end_doc, *root);
+    if (errs) {
+        *errs = reader.get_formatted_messages();
+    }
+    return ok;
+}
+
+bool parse_lazy(
+    char_reader_builder const& builder,
+    char const* begin_doc, char const* end_doc,
+    lazy_document* root, std::string* errs)
+{
+    our_reader* reader = new our_reader(make_features(builder.settings_));
+    root->reset(reader);
+    bool ok = reader->parse(begin_doc, end_doc, *root);
+    if (errs) {
+        *errs = reader->get_formatted_messages();
+    }
+    return ok;
+}
+
 std::istream& operator>>(std::istream& sin, value& root)
 {
     char_reader_builder b;
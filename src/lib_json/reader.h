@@ -302,6 +302,31 @@ public:
 		the JSON value in the input string.
 	- `"reject_dup_keys": false or true`
 	  - If true, `parse()` returns false when a key is duplicated within an object.
+	- `"engine": "classic" or "simd"`
+	  - "simd" first locates every token of the document with vector
+		instructions, then parses from that index. Same results and errors
+		as "classic". Falls back to "classic" on CPUs without SSE2, with
+		allow_single_quotes, and for documents with '/', '\\' or '\'' outside
+		strings (comments, or errors).
+	- `"threads": int`
+	  - If the root is an array, split its elements into up to this many
+		slices of at least 64 KiB, each parsed on its own thread, and join
+		the results. 0 means one thread per core; 1 (the default) parses on the
+		calling thread only. Values, offsets and errors are the same either way.
+	- `"keep_source": false or true`
+	  - If true, keep a copy of the document with the root value (see
+		value::set_source()), so that fast_writer and gather_writer copy the
+		text of values that have not changed since instead of writing them
+		anew. Whitespace inside those values comes out as it was. Documents
+		with comments, and the settings allow_single_quotes,
+		allow_numeric_keys and allow_dropped_null_placeholders, which admit
+		text that is not plain JSON, keep no source.
+	- `"dedupe": false or true`
+	  - If true, make the equal subtrees and strings of the document share
+		one copy once it is parsed (see json::dedupe()), for documents that
+		repeat themselves to take less memory. Changing a value afterwards,
+		through the document or a reference into it, changes that value
+		only: the values that share it with it are left as they were.
 
 	You can examine 'settings_` yourself
 	to see the defaults. You can also write and read them just like any
@@ -347,6 +372,38 @@ bool JSON_API parse_from_stream(
 	std::istream&,
 	value* root, std::string* errs);
 
+/** \brief Parse a document into a flat, read-only \ref tape.
+
+ Honors the same settings as the char_reader that 'builder' would create,
+ except "collect_comments" (a tape never keeps comments).
+ Error messages are those of char_reader::parse().
+
+ \param root [out] Cleared first; left empty if an error occurred.
+ \param errs [out] Formatted error messages (if not NULL).
+ \return true if the document was successfully parsed.
+*/
+bool JSON_API parse_tape(
+	char_reader_builder const& builder,
+	char const* begin_doc, char const* end_doc,
+	tape* root, std::string* errs);
+
+/** \brief Locate the root of a document, leaving the rest to be decoded on
+ * demand. See \ref lazy_document.
+
+ The settings of 'builder' are honored, except collect_comments.
+ Only the root value is checked here; errors inside an object or array are
+ thrown when it is first accessed.
+
+ \param begin_doc Must outlive 'root'; it is not copied.
+ \param root [out] Cleared first; left empty if an error occurred.
+ \param errs [out] Formatted error messages (if not NULL).
+ \return true if the root was successfully located.
+*/
+bool JSON_API parse_lazy(
+	char_reader_builder const& builder,
+	char const* begin_doc, char const* end_doc,
+	lazy_document* root, std::string* errs);
+
 /** \brief Read from 'sin' into 'root'.
 
  Always keep comments from the input JSON.
@@ -0,0 +1,687 @@
+// Derived from public-domain/MIT-licensed code at
+// https://github.com/open-source-parsers/jsoncpp. Thanks, Baptiste Lepilleur!
+
+#include "assertions.h"
+#include "snapshot.h"
+#include "tool.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
+namespace json {
+
+// Header: magic, version, size of the snapshot, then the slot of the root.
+static char const snapshot_magic[4] = { 'J', 'S', 'N', 'P' };
+static size_t const snapshot_size_offset = 8;
+static size_t const snapshot_root_offset = 16;
+static size_t const snapshot_header_size = 24;
+
+// What the first half of a slot says about the second.
+enum slot_kind {
+    sk_null = 0,
+    sk_false,
+    sk_true,
+    sk_int, ///< the int32_t itself
+    sk_uint, ///< the uint32_t itself
+    sk_int64, ///< offset of the int64_t
+    sk_uint64, ///< offset of the uint64_t
+    sk_real, ///< offset of the double
+    sk_string, ///< offset of the length, the bytes and a 0
+    sk_array, ///< offset of the size, then the slots
+    sk_object ///< offset of the size, then the key offsets, then the slots
+};
+
+static size_t const slot_size = 8;
+static size_t const key_size = 4;
+
+static uint32_t load_u32(char const* bytes)
+{
+    unsigned char const* b = reinterpret_cast<unsigned char const*>(bytes);
+    return uint32_t(b[0]) | uint32_t(b[1]) << 8 | uint32_t(b[2]) << 16 | uint32_t(b[3]) << 24;
+}
+
+static uint64_t load_u64(char const* bytes)
+{
+    return uint64_t(load_u32(bytes)) | uint64_t(load_u32(bytes + 4)) << 32;
+}
+
+static void store_u32(char* bytes, uint32_t number)
+{
+    for (int index = 0; index != 4; ++index)
+        bytes[index] = char(number >> (8 * index));
+}
+
+static void store_u64(char* bytes, uint64_t number)
+{
+    store_u32(bytes, uint32_t(number));
+    store_u32(bytes + 4, uint32_t(number >> 32));
+}
+
+// Class snapshot_writer
+// //////////////////////////////////////////////////////////////////
+
+class snapshot_writer {
+public:
+    std::string write(value const& root);
+
+private:
+    size_t reserve(size_t size);
+    uint32_t offset_of(size_t offset) const;
+    uint32_t add_string(char const* str, char const* end);
+    void write_slot(value const& value, size_t slot);
+
+    std::string out_;
+    std::unordered_map<std::string, uint32_t> strings_;
+};
+
+std::string snapshot_writer::write(value const& root)
+{
+    out_.assign(snapshot_header_size, '\0');
+    memcpy(&out_[0], snapshot_magic, sizeof snapshot_magic);
+    store_u32(&out_[4], snapshot::version);
+    write_slot(root, snapshot_root_offset);
+    store_u64(&out_[snapshot_size_offset], out_.size());
+    strings_.clear();
+    std::string result;
+    result.swap(out_);
+    return result;
+}
+
+// Append 'size' bytes of zeroes, aligned to 4 bytes.
+size_t snapshot_writer::reserve(size_t size)
+{
+    size_t offset = (out_.size() + 3) & ~size_t(3);
+    out_.resize(offset + size);
+    return offset;
+}
+
+uint32_t snapshot_writer::offset_of(size_t offset) const
+{
+    if (offset > std::numeric_limits<uint32_t>::max())
+        throw_runtime_error("write_snapshot(): a snapshot must be smaller than 4 GiB");
+    return uint32_t(offset);
+}
+
+uint32_t snapshot_writer::add_string(char const* str, char const* end)
+{
+    std::pair<std::unordered_map<std::string, uint32_t>::iterator, bool> added
+        = strings_.insert(std::make_pair(std::string(str, end), 0u));
+    if (added.second) {
+        size_t length = size_t(end - str);
+        size_t offset = reserve(4 + length + 1);
+        store_u32(&out_[offset], offset_of(length));
+        memcpy(&out_[offset + 4], str, length);
+        added.first->second = offset_of(offset);
+    }
+    return added.first->second;
+}
+
+void snapshot_writer::write_slot(value const& value, size_t slot)
+{
+    uint32_t kind = sk_null;
+    uint32_t payload = 0;
+    switch (value.type()) {
+    case vt_null:
+        break;
+    case vt_bool:
+        kind = value.as_bool() ? sk_true : sk_false;
+        break;
+    case vt_int: {
+        largest_int_t number = value.as_largest_int();
+        if (number >= std::numeric_limits<int32_t>::min() && number <= std::numeric_limits<int32_t>::max()) {
+            kind = sk_int;
+            payload = uint32_t(int32_t(number));
+        }
+        else {
+            kind = sk_int64;
+            size_t offset = reserve(8);
+            store_u64(&out_[offset], uint64_t(number));
+            payload = offset_of(offset);
+        }
+    } break;
+    case vt_uint: {
+        largest_uint_t number = value.as_largest_uint();
+        if (number <= std::numeric_limits<uint32_t>::max()) {
+            kind = sk_uint;
+            payload = uint32_t(number);
+        }
+        else {
+            kind = sk_uint64;
+            size_t offset = reserve(8);
+            store_u64(&out_[offset], uint64_t(number));
+            payload = offset_of(offset);
+        }
+    } break;
+    case vt_real: {
+        double real = value.as_double();
+        uint64_t bits;
+        memcpy(&bits, &real, sizeof bits);
+        kind = sk_real;
+        size_t offset = reserve(8);
+        store_u64(&out_[offset], bits);
+        payload = offset_of(offset);
+    } break;
+    case vt_string: {
+        char const* str;
+        char const* end;
+        if (!value.get_string(&str, &end))
+            str = end = ""; // a string value that was never given one
+        kind = sk_string;
+        payload = add_string(str, end);
+    } break;
+    case vt_array: {
+        array_index size = value.size();
+        size_t offset = reserve(4 + size * slot_size);
+        store_u32(&out_[offset], size);
+        for (array_index index = 0; index != size; ++index)
+            write_slot(value[index], offset + 4 + index * slot_size);
+        kind = sk_array;
+        payload = offset_of(offset);
+    } break;
+    case vt_object: {
+        // Members come in the order of their keys, which is the order of the
+        // key table.
+        array_index size = value.size();
+        size_t offset = reserve(4 + size * (key_size + slot_size));
+        store_u32(&out_[offset], size);
+        size_t slots = offset + 4 + size * key_size;
+        array_index index = 0;
+        for (value::const_iterator it = value.begin(); it != value.end(); ++it, ++index) {
+            char const* end;
+            char const* name = it.member_name(&end);
+            uint32_t key = add_string(name, end);
+            store_u32(&out_[offset + 4 + index * key_size], key);
+            write_slot(*it, slots + index * slot_size);
+        }
+        kind = sk_object;
+        payload = offset_of(offset);
+    } break;
+    }
+    store_u32(&out_[slot], kind);
+    store_u32(&out_[slot + 4], payload);
+}
+
+std::string write_snapshot(value const& root)
+{
+    snapshot_writer writer;
+    return writer.write(root);
+}
+
+// Class snapshot
+// //////////////////////////////////////////////////////////////////
+
+snapshot::snapshot()
+    : data_(0)
+    , size_(0)
+{
+}
+
+bool snapshot::reset(char const* begin, char const* end, std::string* errs)
+{
+    clear();
+    std::string error;
+    size_t available = size_t(end - begin);
+    if (available < snapshot_header_size || memcmp(begin, snapshot_magic, sizeof snapshot_magic))
+        error = "Not a snapshot";
+    else if (load_u32(begin + 4) != version)
+        error = "Unsupported snapshot version";
+    else if (load_u64(begin + snapshot_size_offset) > available
+        || load_u64(begin + snapshot_size_offset) < snapshot_header_size)
+        error = "Snapshot is shorter than its header says";
+    if (errs)
+        *errs = error;
+    if (!error.empty())
+        return false;
+    data_ = begin;
+    size_ = size_t(load_u64(begin + snapshot_size_offset));
+    return true;
+}
+
+void snapshot::clear()
+{
+    data_ = 0;
+    size_ = 0;
+}
+
+bool snapshot::empty() const { return !data_; }
+
+snapshot_view snapshot::root() const
+{
+    if (!data_)
+        return snapshot_view();
+    return snapshot_view(this, snapshot_root_offset);
+}
+
+size_t snapshot::size() const { return size_; }
+
+// The 'size' bytes at 'offset', or NULL if they are not all in the snapshot.
+char const* snapshot::record(uint64_t offset, uint64_t size) const
+{
+    if (offset > size_ || size > size_ - offset)
+        return NULL;
+    return data_ + offset;
+}
+
+// The string whose record is at 'offset'.
+bool snapshot::string_at(uint64_t offset, char const** str, char const** end) const
+{
+    char const* record = this->record(offset, 4);
+    if (!record || !this->record(offset, 4 + uint64_t(load_u32(record)) + 1))
+        return false;
+    *str = record + 4;
+    *end = *str + load_u32(record);
+    return true;
+}
+
+// Class snapshot_view
+// //////////////////////////////////////////////////////////////////
+
+snapshot_view::snapshot_view()
+    : snapshot_(0)
+    , slot_(0)
+{
+}
+
+snapshot_view::snapshot_view(snapshot const* owner, uint64_t slot)
+    : snapshot_(owner)
+    , slot_(slot)
+{
+}
+
+// Slots are only made for offsets that container() or the header checked.
+uint32_t snapshot_view::kind() const
+{
+    if (!snapshot_)
+        return sk_null;
+    return load_u32(snapshot_->data_ + slot_);
+}
+
+uint32_t snapshot_view::payload() const
+{
+    return load_u32(snapshot_->data_ + slot_ + 4);
+}
+
+// The record of an array or object, with its size, or NULL.
+char const* snapshot_view::container(array_index* size) const
+{
+    *size = 0;
+    uint32_t kind = this->kind();
+    // Records of containers come after the slots that refer to them, which
+    // rules out cycles in corrupt snapshots.
+    if ((kind != sk_array && kind != sk_object) || payload() <= slot_)
+        return NULL;
+    char const* record = snapshot_->record(payload(), 4);
+    if (!record)
+        return NULL;
+    array_index count = load_u32(record);
+    uint64_t entry_size = kind == sk_array ? slot_size : key_size + slot_size;
+    if (!snapshot_->record(payload(), 4 + count * entry_size))
+        return NULL;
+    *size = count;
+    return record;
+}
+
+value_type snapshot_view::type() const
+{
+    switch (kind()) {
+    case sk_false:
+    case sk_true:
+        return vt_bool;
+    case sk_int:
+    case sk_int64:
+        return vt_int;
+    case sk_uint:
+    case sk_uint64:
+        return vt_uint;
+    case sk_real:
+        return vt_real;
+    case sk_string:
+        return vt_string;
+    case sk_array:
+        return vt_array;
+    case sk_object:
+        return vt_object;
+    default:
+        return vt_null;
+    }
+}
+
+value snapshot_view::scalar() const
+{
+    uint32_t kind = this->kind();
+    char const* number = NULL;
+    if (kind == sk_int64 || kind == sk_uint64 || kind == sk_real) {
+        number = snapshot_->record(payload(), 8);
+        if (!number)
+            return value();
+    }
+    switch (kind) {
+    case sk_true:
+        return value(true);
+    case sk_false:
+        return value(false);
+    case sk_int:
+        return value(largest_int_t(int32_t(payload())));
+    case sk_uint:
+        return value(largest_uint_t(payload()));
+    case sk_int64:
+        return value(largest_int_t(load_u64(number)));
+    case sk_uint64:
+        return value(largest_uint_t(load_u64(number)));
+    case sk_real: {
+        double real;
+        uint64_t bits = load_u64(number);
+        memcpy(&real, &bits, sizeof(real));
+        return value(real);
+    }
+    case sk_string: {
+        char const* str;
+        char const* end;
+        if (!get_string(&str, &end))
+            return value();
+        return value(static_string(str));
+    }
+    case sk_object:
+        return value(vt_object);
+    case sk_array:
+        return value(vt_array);
+    default:
+        return value();
+    }
+}
+
+bool snapshot_view::is_null() const { return type() == vt_null; }
+
+bool snapshot_view::is_bool() const { return type() == vt_bool; }
+
+bool snapshot_view::is_int() const { return scalar().is_int(); }
+
+bool snapshot_view::is_int64() const { return scalar().is_int64(); }
+
+bool snapshot_view::is_uint() const { return scalar().is_uint(); }
+
+bool snapshot_view::isUInt64() const { return scalar().isUInt64(); }
+
+bool snapshot_view::isIntegral() const { return scalar().isIntegral(); }
+
+bool snapshot_view::isDouble() const { return scalar().isDouble(); }
+
+bool snapshot_view::isNumeric() const { return scalar().isNumeric(); }
+
+bool snapshot_view::isString() const { return type() == vt_string; }
+
+bool snapshot_view::is_array() const { return type() == vt_array; }
+
+bool snapshot_view::is_object() const { return type() == vt_object; }
+
+const char* snapshot_view::as_cstring() const
+{
+    char const* str;
+    char const* end;
+    JSON_ASSERT_MESSAGE(get_string(&str, &end),
+        "in json::snapshot_view::as_cstring(): requires vt_string");
+    return str;
+}
+
+bool snapshot_view::get_string(char const** str, char const** end) const
+{
+    if (kind() != sk_string)
+        return false;
+    return snapshot_->string_at(payload(), str, end);
+}
+
+std::string snapshot_view::as_string() const
+{
+    char const* str;
+    char const* end;
+    if (get_string(&str, &end))
+        return std::string(str, end);
+    return scalar().as_string();
+}
+
+int32_t snapshot_view::as_int() const { return scalar().as_int(); }
+
+uint32_t snapshot_view::as_uint() const { return scalar().as_uint(); }
+
+#if defined(JSON_HAS_INT64)
+int64_t snapshot_view::as_int64() const { return scalar().as_int64(); }
+
+uint64_t snapshot_view::as_uint64() const { return scalar().as_uint64(); }
+#endif // if defined(JSON_HAS_INT64)
+
+largest_int_t snapshot_view::as_largest_int() const { return scalar().as_largest_int(); }
+
+largest_uint_t snapshot_view::as_largest_uint() const { return scalar().as_largest_uint(); }
+
+float snapshot_view::as_float() const { return scalar().as_float(); }
+
+double snapshot_view::as_double() const { return scalar().as_double(); }
+
+bool snapshot_view::as_bool() const { return scalar().as_bool(); }
+
+array_index snapshot_view::size() const
+{
+    array_index size;
+    container(&size);
+    return size;
+}
+
+bool snapshot_view::empty() const
+{
+    if (is_null() || is_array() || is_object())
+        return size() == 0u;
+    return false;
+}
+
+bool snapshot_view::operator!() const { return is_null(); }
+
+snapshot_view snapshot_view::operator[](array_index index) const
+{
+    JSON_ASSERT_MESSAGE(
+        type() == vt_null || type() == vt_array,
+        "in json::snapshot_view::operator[](array_index): requires vt_array");
+    array_index size;
+    char const* record = container(&size);
+    if (!record || index >= size)
+        return snapshot_view();
+    return snapshot_view(snapshot_, uint64_t(record - snapshot_->data_) + 4 + index * slot_size);
+}
+
+snapshot_view snapshot_view::operator[](int index) const
+{
+    JSON_ASSERT_MESSAGE(
+        index >= 0,
+        "in json::snapshot_view::operator[](int index): index cannot be negative");
+    return (*this)[array_index(index)];
+}
+
+bool snapshot_view::is_valid_index(array_index index) const { return index < size(); }
+
+bool snapshot_view::find(char const* key, char const* end, snapshot_view* found) const
+{
+    if (kind() != sk_object)
+        return false;
+    array_index size;
+    char const* record = container(&size);
+    if (!record)
+        return false;
+    // Binary search of the key table.
+    array_index low = 0;
+    array_index high = size;
+    while (low < high) {
+        array_index middle = low + (high - low) / 2;
+        char const* name;
+        char const* name_end;
+        if (!snapshot_->string_at(load_u32(record + 4 + middle * key_size), &name, &name_end))
+            return false;
+        int comp = compare_keys(name, size_t(name_end - name), key, size_t(end - key));
+        if (comp < 0) {
+            low = middle + 1;
+        }
+        else if (comp > 0) {
+            high = middle;
+        }
+        else {
+            uint64_t slots = uint64_t(record - snapshot_->data_) + 4 + size * key_size;
+            *found = snapshot_view(snapshot_, slots + middle * slot_size);
+            return true;
+        }
+    }
+    return false;
+}
+
+snapshot_view snapshot_view::operator[](const char* key) const
+{
+    snapshot_view found;
+    find(key, key + strlen(key), &found);
+    return found;
+}
+
+snapshot_view snapshot_view::operator[](std::string const& key) const
+{
+    snapshot_view found;
+    find(key.data(), key.data() + key.length(), &found);
+    return found;
+}
+
+bool snapshot_view::is_member(std::string const& key) const
+{
+    snapshot_view found;
+    return find(key.data(), key.data() + key.length(), &found);
+}
+
+value::members snapshot_view::get_member_names() const
+{
+    JSON_ASSERT_MESSAGE(
+        type() == vt_null || type() == vt_object,
+        "in json::snapshot_view::get_member_names(), value must be vt_object");
+    value::members members;
+    if (type() == vt_null)
+        return members;
+    members.reserve(size());
+    for (const_iterator it = begin(); it != end(); ++it)
+        members.push_back(it.name());
+    return members;
+}
+
+snapshot_view::const_iterator snapshot_view::begin() const
+{
+    array_index size;
+    char const* record = container(&size);
+    if (!record)
+        return const_iterator();
+    return const_iterator(snapshot_, record, size, kind() == sk_object, 0);
+}
+
+snapshot_view::const_iterator snapshot_view::end() const
+{
+    array_index size;
+    char const* record = container(&size);
+    if (!record)
+        return const_iterator();
+    return const_iterator(snapshot_, record, size, kind() == sk_object, size);
+}
+
+value snapshot_view::to_value() const
+{
+    switch (type()) {
+    case vt_string: {
+        char const* str;
+        char const* end;
+        if (!get_string(&str, &end))
+            return value();
+        return value(str, end);
+    }
+    case vt_array: {
+        value result(vt_array);
+        array_index index = 0;
+        for (const_iterator it = begin(); it != end(); ++it)
+            result[index++] = it->to_value();
+        return result;
+    }
+    case vt_object: {
+        value result(vt_object);
+        for (const_iterator it = begin(); it != end(); ++it) {
+            char const* name_end;
+            char const* name = it.member_name(&name_end);
+            if (name)
+                *result.demand(name, name_end) = it->to_value();
+        }
+        return result;
+    }
+    default:
+        return scalar();
+    }
+}
+
+// Class snapshot_view::const_iterator
+// //////////////////////////////////////////////////////////////////
+
+snapshot_view::const_iterator::const_iterator()
+    : current_()
+    , record_(0)
+    , size_(0)
+    , position_(0)
+    , object_(false)
+{
+}
+
+snapshot_view::const_iterator::const_iterator(snapshot const* owner, char const* record,
+    array_index size, bool object, array_index position)
+    : current_(owner, 0)
+    , record_(record)
+    , size_(size)
+    , position_(position)
+    , object_(object)
+{
+    settle();
+}
+
+// Point current_ at the slot of position_, or make it null at the end.
+void snapshot_view::const_iterator::settle()
+{
+    snapshot const* owner = current_.snapshot_;
+    if (position_ >= size_) {
+        current_ = snapshot_view();
+        return;
+    }
+    uint64_t slots = uint64_t(record_ - owner->data_) + 4 + (object_ ? size_ * key_size : 0);
+    current_ = snapshot_view(owner, slots + position_ * slot_size);
+}
+
+snapshot_view::const_iterator& snapshot_view::const_iterator::operator++()
+{
+    ++position_;
+    settle();
+    return *this;
+}
+
+uint32_t snapshot_view::const_iterator::index() const
+{
+    if (object_)
+        return uint32_t(-1);
+    return position_;
+}
+
+std::string snapshot_view::const_iterator::name() const
+{
+    char const* end;
+    char const* key = member_name(&end);
+    if (!key)
+        return std::string();
+    return std::string(key, end);
+}
+
+char const* snapshot_view::const_iterator::member_name(char const** end) const
+{
+    char const* name;
+    if (!object_ || position_ >= size_
+        || !current_.snapshot_->string_at(load_u32(record_ + 4 + position_ * key_size), &name, end)) {
+        *end = NULL;
+        return NULL;
+    }
+    return name;
+}
+
+} // namespace json
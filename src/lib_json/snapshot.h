@@ -0,0 +1,261 @@
+// Derived from public-domain/MIT-licensed code at
+// https://github.com/open-source-parsers/jsoncpp. Thanks, Baptiste Lepilleur!
+
+#pragma once
+
+#include "value.h"
+#include <iterator>
+#include <string>
+
+// Disable warning C4251: <data member>: <type> needs to have dll-interface to
+// be used by...
+#if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+#pragma warning(push)
+#pragma warning(disable : 4251)
+#endif // if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+
+namespace json {
+
+/** \brief Lay out 'root' in the binary snapshot format read by \ref snapshot.
+ *
+ * Write the result to a file once; load it later with mmap() (or any read
+ * into memory) and snapshot::reset(), without parsing.
+ * \throw std::runtime_error if the snapshot would be 4 GiB or more.
+ */
+std::string JSON_API write_snapshot(value const& root);
+
+/** \brief Read-only handle to a document in the binary snapshot format.
+ *
+ * The format is made to be queried where it lies, so opening a snapshot costs
+ * the same for any size of document:
+ * - every value is an 8-byte slot, holding its type and either the value
+ *   itself (null, booleans, 32-bit integers) or the offset of its record;
+ * - an array record is its size, then the slots of its elements, so that
+ *   operator[](index) is O(1);
+ * - an object record is its size, then the offsets of its keys, sorted as
+ *   #value sorts them, then the slots of its values, so that a member is
+ *   found by binary search;
+ * - strings (keys and values alike) are kept once each in a pool, with their
+ *   length and a terminating 0;
+ * - offsets are 32-bit and from the start of the snapshot, so it can be
+ *   mapped at any address. Numbers are little-endian.
+ *
+ * A header holds a magic number and a format version, checked by reset().
+ * The records themselves are not checked up front; offsets and sizes that
+ * fall outside the snapshot, and containers that would contain themselves,
+ * read as null or empty, so that a corrupt file gives wrong answers rather
+ * than a crash.
+ *
+ * \code
+ * int fd = open("reference.snap", O_RDONLY);
+ * struct stat st;
+ * fstat(fd, &st);
+ * char const* data = (char const*)mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+ * json::snapshot doc;
+ * std::string errs;
+ * if (doc.reset(data, data + st.st_size, &errs)) {
+ *   json::snapshot_view root = doc.root();
+ *   std::string name = root["name"].as_string();
+ * }
+ * \endcode
+ *
+ * \note The snapshot does not copy the bytes: they, and this snapshot, must
+ *       outlive every snapshot_view taken from it.
+ */
+class JSON_API snapshot {
+public:
+	/// Version of the format written by write_snapshot().
+	static uint32_t const version = 1;
+
+	snapshot();
+
+	/** Refer to the snapshot in [begin, end), after checking its header.
+	 * \return false, with the reason in *errs (if not NULL), if it is not a
+	 *   snapshot of this version, or is shorter than its header says. This
+	 *   snapshot is then empty.
+	 */
+	bool reset(char const* begin, char const* end, std::string* errs);
+
+	/// Refer to nothing.
+	void clear();
+
+	/// \return true if no snapshot has been reset() into this one.
+	bool empty() const;
+
+	/// The root value, or a null view if empty().
+	snapshot_view root() const;
+
+	/// Number of bytes of the snapshot, as written in its header.
+	size_t size() const;
+
+private:
+	friend class snapshot_view;
+
+	char const* record(uint64_t offset, uint64_t size) const;
+	bool string_at(uint64_t offset, char const** str, char const** end) const;
+
+	char const* data_;
+	size_t size_;
+};
+
+/** \brief Lightweight, read-only handle to one value inside a \ref snapshot.
+ *
+ * Offers the familiar read API of #value (operator[], find(), size(),
+ * iteration, as_*()), without allocating. A view obtained for a missing
+ * member or index is a null view, like value::null_ref.
+ */
+class JSON_API snapshot_view {
+public:
+	class const_iterator;
+
+	/// A null view, not attached to any snapshot.
+	snapshot_view();
+
+	value_type type() const;
+
+	bool is_null() const;
+	bool is_bool() const;
+	bool is_int() const;
+	bool is_int64() const;
+	bool is_uint() const;
+	bool isUInt64() const;
+	bool isIntegral() const;
+	bool isDouble() const;
+	bool isNumeric() const;
+	bool isString() const;
+	bool is_array() const;
+	bool is_object() const;
+
+	const char* as_cstring() const; ///< Embedded zeroes could cause you trouble!
+	std::string as_string() const; ///< Embedded zeroes are possible.
+	/** Get raw char* of string-value, pointing into the snapshot.
+	 *  \return false if !string. (Seg-fault if str or end are NULL.)
+	 */
+	bool get_string(char const** str, char const** end) const;
+	int32_t as_int() const;
+	uint32_t as_uint() const;
+#if defined(JSON_HAS_INT64)
+	int64_t as_int64() const;
+	uint64_t as_uint64() const;
+#endif // if defined(JSON_HAS_INT64)
+	largest_int_t as_largest_int() const;
+	largest_uint_t as_largest_uint() const;
+	float as_float() const;
+	double as_double() const;
+	bool as_bool() const;
+
+	/// Number of values in array or object
+	array_index size() const;
+	/// \brief Return true if empty array, empty object, or null;
+	/// otherwise, false.
+	bool empty() const;
+	/// Return is_null()
+	bool operator!() const;
+
+	/// Access an array element (zero based index). O(1).
+	/// \return a null view if out of range.
+	snapshot_view operator[](array_index index) const;
+	snapshot_view operator[](int index) const;
+	/// Return true if index < size().
+	bool is_valid_index(array_index index) const;
+
+	/// Access an object member by name. O(log(members)) key comparisons.
+	/// \return a null view if there is no member with that name.
+	snapshot_view operator[](const char* key) const;
+	/// \param key may contain embedded nulls.
+	snapshot_view operator[](std::string const& key) const;
+	/** Look up an object member by name.
+	 *  Update 'found' iff found.
+	 *  \param key may contain embedded nulls.
+	 *  \return true iff found
+	 */
+	bool find(char const* key, char const* end, snapshot_view* found) const;
+	/// Return true if the object has a member named key.
+	bool is_member(std::string const& key) const;
+	/// \brief Return a list of the member names.
+	/// \pre type() is vt_object or vt_null
+	value::members get_member_names() const;
+
+	const_iterator begin() const;
+	const_iterator end() const;
+
+	/// Deep copy into a regular #value, e.g. to modify part of the document.
+	value to_value() const;
+
+private:
+	friend class snapshot;
+
+	snapshot_view(snapshot const* owner, uint64_t slot);
+
+	uint32_t kind() const;
+	uint32_t payload() const;
+	char const* container(array_index* size) const;
+	value scalar() const;
+
+	snapshot const* snapshot_;
+	uint64_t slot_; // offset of the slot of this value
+};
+
+/** \brief Forward iterator over the elements of an array, or the members of an
+ * object, in a \ref snapshot, in the order of #value.
+ */
+class JSON_API snapshot_view::const_iterator {
+public:
+	typedef std::forward_iterator_tag iterator_category;
+	typedef snapshot_view value_type;
+	typedef int difference_type;
+	typedef snapshot_view reference;
+	typedef snapshot_view const* pointer;
+
+	const_iterator();
+
+	bool operator==(const_iterator const& other) const
+	{
+		return position_ == other.position_ && record_ == other.record_;
+	}
+	bool operator!=(const_iterator const& other) const
+	{
+		return !(*this == other);
+	}
+
+	const_iterator& operator++();
+	const_iterator operator++(int)
+	{
+		const_iterator temp(*this);
+		++*this;
+		return temp;
+	}
+
+	reference operator*() const { return current_; }
+	pointer operator->() const { return &current_; }
+
+	/// Return the index of the referenced value, or -1 if it is not an vt_array.
+	uint32_t index() const;
+
+	/// Return the member name of the referenced value, or "" if it is not an
+	/// vt_object.
+	std::string name() const;
+
+	/// Return the member name of the referenced value, or NULL if it is not an
+	/// vt_object. Because end is passed as an OUT param, embedded nulls are supported.
+	char const* member_name(char const** end) const;
+
+private:
+	friend class snapshot_view;
+
+	const_iterator(snapshot const* owner, char const* record, array_index size,
+		bool object, array_index position);
+	void settle();
+
+	snapshot_view current_;
+	char const* record_; // of the container, or NULL
+	array_index size_;
+	array_index position_;
+	bool object_;
+};
+
+} // namespace json
+
+#if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+#pragma warning(pop)
+#endif // if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
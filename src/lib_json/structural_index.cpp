@@ -0,0 +1,325 @@
+// Derived from public-domain/MIT-licensed code at
+// https://github.com/open-source-parsers/jsoncpp. Thanks, Baptiste Lepilleur!
+
+#include "structural_index.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define JSON_HAS_SSE2 1
+#include <emmintrin.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define JSON_HAS_AVX2 1 // compiled for a target attribute, used if the CPU has it
+#include <immintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+namespace json {
+
+#if defined(JSON_HAS_SSE2)
+
+// One bit per byte of a 64-byte block, for each class of character.
+struct block_masks {
+    uint64_t quote;
+    uint64_t backslash;
+    uint64_t op; // { } [ ] : ,
+    uint64_t space;
+    uint64_t stray; // / and '
+};
+
+static inline uint64_t mask16(__m128i bytes, int shift)
+{
+    return uint64_t(uint32_t(_mm_movemask_epi8(bytes))) << shift;
+}
+
+static void classify_sse2(char const* block, block_masks* masks)
+{
+    __m128i const quote = _mm_set1_epi8('"');
+    __m128i const backslash = _mm_set1_epi8('\\');
+    __m128i const lower = _mm_set1_epi8(0x20);
+    __m128i const open = _mm_set1_epi8('{'); // '[' | 0x20 == '{'
+    __m128i const close = _mm_set1_epi8('}'); // ']' | 0x20 == '}'
+    __m128i const colon = _mm_set1_epi8(':');
+    __m128i const comma = _mm_set1_epi8(',');
+    __m128i const blank = _mm_set1_epi8(' ');
+    __m128i const tab = _mm_set1_epi8('\t');
+    __m128i const lf = _mm_set1_epi8('\n');
+    __m128i const cr = _mm_set1_epi8('\r');
+    __m128i const slash = _mm_set1_epi8('/');
+    __m128i const apostrophe = _mm_set1_epi8('\'');
+    memset(masks, 0, sizeof(*masks));
+    for (int i = 0; i < 4; ++i) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<__m128i const*>(block + 16 * i));
+        __m128i folded = _mm_or_si128(bytes, lower);
+        masks->quote |= mask16(_mm_cmpeq_epi8(bytes, quote), 16 * i);
+        masks->backslash |= mask16(_mm_cmpeq_epi8(bytes, backslash), 16 * i);
+        masks->op |= mask16(
+            _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(folded, open), _mm_cmpeq_epi8(folded, close)),
+                _mm_or_si128(_mm_cmpeq_epi8(bytes, colon), _mm_cmpeq_epi8(bytes, comma))),
+            16 * i);
+        masks->space |= mask16(
+            _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(bytes, blank), _mm_cmpeq_epi8(bytes, tab)),
+                _mm_or_si128(_mm_cmpeq_epi8(bytes, lf), _mm_cmpeq_epi8(bytes, cr))),
+            16 * i);
+        masks->stray |= mask16(
+            _mm_or_si128(_mm_cmpeq_epi8(bytes, slash), _mm_cmpeq_epi8(bytes, apostrophe)),
+            16 * i);
+    }
+}
+
+#if defined(JSON_HAS_AVX2)
+static inline __attribute__((target("avx2"))) uint64_t mask32(__m256i bytes, int shift)
+{
+    return uint64_t(uint32_t(_mm256_movemask_epi8(bytes))) << shift;
+}
+
+static __attribute__((target("avx2"))) void classify_avx2(char const* block, block_masks* masks)
+{
+    __m256i const quote = _mm256_set1_epi8('"');
+    __m256i const backslash = _mm256_set1_epi8('\\');
+    __m256i const lower = _mm256_set1_epi8(0x20);
+    __m256i const open = _mm256_set1_epi8('{');
+    __m256i const close = _mm256_set1_epi8('}');
+    __m256i const colon = _mm256_set1_epi8(':');
+    __m256i const comma = _mm256_set1_epi8(',');
+    __m256i const blank = _mm256_set1_epi8(' ');
+    __m256i const tab = _mm256_set1_epi8('\t');
+    __m256i const lf = _mm256_set1_epi8('\n');
+    __m256i const cr = _mm256_set1_epi8('\r');
+    __m256i const slash = _mm256_set1_epi8('/');
+    __m256i const apostrophe = _mm256_set1_epi8('\'');
+    memset(masks, 0, sizeof(*masks));
+    for (int i = 0; i < 2; ++i) {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(block + 32 * i));
+        __m256i folded = _mm256_or_si256(bytes, lower);
+        masks->quote |= mask32(_mm256_cmpeq_epi8(bytes, quote), 32 * i);
+        masks->backslash |= mask32(_mm256_cmpeq_epi8(bytes, backslash), 32 * i);
+        masks->op |= mask32(
+            _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(folded, open), _mm256_cmpeq_epi8(folded, close)),
+                _mm256_or_si256(_mm256_cmpeq_epi8(bytes, colon), _mm256_cmpeq_epi8(bytes, comma))),
+            32 * i);
+        masks->space |= mask32(
+            _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(bytes, blank), _mm256_cmpeq_epi8(bytes, tab)),
+                _mm256_or_si256(_mm256_cmpeq_epi8(bytes, lf), _mm256_cmpeq_epi8(bytes, cr))),
+            32 * i);
+        masks->stray |= mask32(
+            _mm256_or_si256(_mm256_cmpeq_epi8(bytes, slash), _mm256_cmpeq_epi8(bytes, apostrophe)),
+            32 * i);
+    }
+}
+
+static bool cpu_has_avx2()
+{
+    static bool const has = __builtin_cpu_supports("avx2") != 0;
+    return has;
+}
+#endif // if defined(JSON_HAS_AVX2)
+
+static inline int count_trailing_zeros(uint64_t bits)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, bits);
+    return int(index);
+#else
+    return __builtin_ctzll(bits);
+#endif
+}
+
+// Bit i is set iff an odd number of bits at or below i are set, i.e. for
+// quotes, iff byte i is inside a string (including its opening quote).
+static inline uint64_t prefix_xor(uint64_t bits)
+{
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+// Characters preceded by an odd number of backslashes. A run of backslashes
+// may continue from the previous block; *carry tells whether its first byte
+// is escaped.
+static inline uint64_t find_escaped(uint64_t backslash, uint64_t* carry)
+{
+    uint64_t const even_bits = 0x5555555555555555ULL;
+    backslash &= ~*carry;
+    uint64_t follows_escape = (backslash << 1) | *carry;
+    // Runs starting on an odd bit: adding the run to its start carries out of
+    // its end, which flips the parity of the escaped bit after it.
+    uint64_t odd_starts = backslash & ~even_bits & ~follows_escape;
+    uint64_t sequences_on_even = odd_starts + backslash;
+    *carry = sequences_on_even < backslash ? 1 : 0;
+    uint64_t invert_mask = sequences_on_even << 1;
+    return (even_bits ^ invert_mask) & follows_escape;
+}
+
+#endif // if defined(JSON_HAS_SSE2)
+
+structural_index::structural_index()
+    : has_strays_(false)
+{
+}
+
+bool structural_index::build(char const* begin, char const* end)
+{
+    positions_.clear();
+    has_strays_ = false;
+#if defined(JSON_HAS_SSE2)
+    size_t const length = end - begin;
+    if (length >= 0xFFFFFFFFu)
+        return false;
+    void (*classify)(char const*, block_masks*) = &classify_sse2;
+#if defined(JSON_HAS_AVX2)
+    if (cpu_has_avx2())
+        classify = &classify_avx2;
+#endif
+
+    uint64_t escape_carry = 0; // first byte of the block is escaped
+    uint64_t in_string_carry = 0; // all ones if the block starts inside a string
+    uint64_t scalar_carry = 0; // last byte of the previous block was a scalar
+    uint64_t strays = 0;
+    size_t count = 0; // entries used in positions_, which grows ahead
+    positions_.resize(length / 8 + 64);
+    char padded[64];
+    for (size_t offset = 0; offset < length; offset += 64) {
+        char const* block = begin + offset;
+        if (length - offset < 64) {
+            memset(padded, ' ', sizeof(padded));
+            memcpy(padded, block, length - offset);
+            block = padded;
+        }
+        block_masks masks;
+        classify(block, &masks);
+
+        uint64_t escaped = find_escaped(masks.backslash, &escape_carry);
+        uint64_t quote = masks.quote & ~escaped;
+        uint64_t in_string = prefix_xor(quote) ^ in_string_carry;
+        in_string_carry = uint64_t(int64_t(in_string) >> 63);
+        uint64_t string = in_string | quote; // with both quotes
+
+        uint64_t op = masks.op & ~string;
+        uint64_t scalar = ~(masks.op | masks.space | string);
+        uint64_t follows_scalar = (scalar << 1) | scalar_carry;
+        scalar_carry = scalar >> 63;
+        uint64_t structurals = op | quote | (scalar & ~follows_scalar);
+        strays |= (masks.stray | masks.backslash) & ~string;
+
+        if (count + 64 > positions_.size())
+            positions_.resize(std::max(2 * positions_.size(), count + 64));
+        uint32_t* const first = &positions_[count];
+        uint32_t* out = first;
+        while (structurals) {
+            *out++ = uint32_t(offset + count_trailing_zeros(structurals));
+            structurals &= structurals - 1;
+        }
+        count += out - first;
+    }
+    positions_.resize(count);
+    has_strays_ = strays != 0;
+    return true;
+#else
+    (void)begin;
+    (void)end;
+    return false;
+#endif
+}
+
+size_t structural_index::lower_bound(size_t offset) const
+{
+    return std::lower_bound(positions_.begin(), positions_.end(), offset) - positions_.begin();
+}
+
+// The scans below look at 16 bytes at a time, and finish byte by byte.
+
+char const* find_quote_or_backslash(char const* begin, char const* end)
+{
+#if defined(JSON_HAS_SSE2)
+    __m128i const quote = _mm_set1_epi8('"');
+    __m128i const backslash = _mm_set1_epi8('\\');
+    for (; end - begin >= 16; begin += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<__m128i const*>(begin));
+        int found = _mm_movemask_epi8(
+            _mm_or_si128(_mm_cmpeq_epi8(bytes, quote), _mm_cmpeq_epi8(bytes, backslash)));
+        if (found)
+            return begin + count_trailing_zeros(uint64_t(found));
+    }
+#endif
+    while (begin != end && *begin != '"' && *begin != '\\')
+        ++begin;
+    return begin;
+}
+
+char const* find_char_to_escape(char const* begin, char const* end)
+{
+#if defined(JSON_HAS_SSE2)
+    __m128i const last_control = _mm_set1_epi8(0x1F);
+    __m128i const quote = _mm_set1_epi8('"');
+    __m128i const backslash = _mm_set1_epi8('\\');
+    for (; end - begin >= 16; begin += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<__m128i const*>(begin));
+        // Unsigned bytes <= 0x1F are left unchanged by max(bytes, 0x1F).
+        __m128i control = _mm_cmpeq_epi8(_mm_max_epu8(bytes, last_control), last_control);
+        int found = _mm_movemask_epi8(
+            _mm_or_si128(control,
+                _mm_or_si128(_mm_cmpeq_epi8(bytes, quote), _mm_cmpeq_epi8(bytes, backslash))));
+        if (found)
+            return begin + count_trailing_zeros(uint64_t(found));
+    }
+#endif
+    for (; begin != end; ++begin) {
+        unsigned char c = static_cast<unsigned char>(*begin);
+        if (c < 0x20 || c == '"' || c == '\\')
+            break;
+    }
+    return begin;
+}
+
+char const* find_bracket_or_quote(char const* begin, char const* end)
+{
+#if defined(JSON_HAS_SSE2)
+    __m128i const lower = _mm_set1_epi8(0x20);
+    __m128i const open = _mm_set1_epi8('{');
+    __m128i const close = _mm_set1_epi8('}');
+    __m128i const quote = _mm_set1_epi8('"');
+    __m128i const apostrophe = _mm_set1_epi8('\'');
+    __m128i const slash = _mm_set1_epi8('/');
+    for (; end - begin >= 16; begin += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<__m128i const*>(begin));
+        __m128i folded = _mm_or_si128(bytes, lower);
+        int found = _mm_movemask_epi8(
+            _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(folded, open), _mm_cmpeq_epi8(folded, close)),
+                _mm_or_si128(_mm_cmpeq_epi8(bytes, quote),
+                    _mm_or_si128(_mm_cmpeq_epi8(bytes, apostrophe), _mm_cmpeq_epi8(bytes, slash)))));
+        if (found)
+            return begin + count_trailing_zeros(uint64_t(found));
+    }
+#endif
+    for (; begin != end; ++begin) {
+        switch (*begin) {
+        case '{':
+        case '}':
+        case '[':
+        case ']':
+        case '"':
+        case '\'':
+        case '/':
+            return begin;
+        default:
+            break;
+        }
+    }
+    return begin;
+}
+
+} // namespace json
@@ -0,0 +1,74 @@
+// Derived from public-domain/MIT-licensed code at
+// https://github.com/open-source-parsers/jsoncpp. Thanks, Baptiste Lepilleur!
+
+#pragma once
+
+/* This header declares stage one of the "simd" reader engine: a vectorized
+ * pass that lists where every token of a document starts. It also has the
+ * vectorized scans that skip over strings and containers, and the one that
+ * finds what the writer must escape in a string.
+ *
+ * It is an internal header that must not be exposed.
+ */
+
+#include "config.h"
+#include <cstddef>
+#include <vector>
+
+namespace json {
+
+/** \brief Offsets of the structural characters of a document.
+ *
+ * The document is classified 64 bytes at a time with SIMD compares. Escaped
+ * characters and the extent of strings are derived from the resulting
+ * bitmasks, carrying state from one block to the next, so that a quote is
+ * never mistaken for the end of a string and brackets inside strings are
+ * ignored.
+ *
+ * The index lists, in increasing order, the offset of
+ * - every '{', '}', '[', ']', ':' and ',' outside strings,
+ * - every unescaped '"' (both the opening and the closing quote),
+ * - the first character of every other run of non-whitespace outside strings
+ *   (numbers, true, false, null, and anything invalid).
+ *
+ * Between two listed offsets there is thus only whitespace, string contents,
+ * or the rest of a number or literal.
+ */
+class structural_index {
+public:
+	structural_index();
+
+	/** Index [begin, end).
+	 * \return false if this CPU has no supported vector unit, or the document
+	 *         is too large for 32-bit offsets. The index is then empty.
+	 */
+	bool build(char const* begin, char const* end);
+
+	/** true if a '/', '\\' or '\'' was seen outside strings. The document may
+	 * then have comments, or errors after which the extent of strings is not
+	 * what the index says.
+	 */
+	bool has_strays() const { return has_strays_; }
+
+	size_t size() const { return positions_.size(); }
+	uint32_t operator[](size_t index) const { return positions_[index]; }
+
+	/// Index of the first entry that is >= offset, or size().
+	size_t lower_bound(size_t offset) const;
+
+private:
+	std::vector<uint32_t> positions_;
+	bool has_strays_;
+};
+
+/// First '"' or '\\' in [begin, end), or end.
+char const* find_quote_or_backslash(char const* begin, char const* end);
+
+/// First '{', '}', '[', ']', '"', '\'' or '/' in [begin, end), or end.
+char const* find_bracket_or_quote(char const* begin, char const* end);
+
+/// First character that must be escaped in a JSON string ('"', '\\' or a
+/// control character, including '\0') in [begin, end), or end.
+char const* find_char_to_escape(char const* begin, char const* end);
+
+} // namespace json
@@ -0,0 +1,443 @@
+// Derived from public-domain/MIT-licensed code at
+// https://github.com/open-source-parsers/jsoncpp. Thanks, Baptiste Lepilleur!
+
+#include "assertions.h"
+#include "tape.h"
+#include <cstring>
+
+namespace json {
+
+// Class tape
+// //////////////////////////////////////////////////////////////////
+
+tape::tape()
+{
+}
+
+void tape::clear()
+{
+    entries_.clear();
+    strings_.clear();
+}
+
+bool tape::empty() const { return entries_.empty(); }
+
+tape_view tape::root() const
+{
+    if (entries_.empty())
+        return tape_view();
+    return tape_view(this, 0);
+}
+
+size_t tape::entry_count() const { return entries_.size(); }
+
+size_t tape::string_bytes() const { return strings_.size(); }
+
+size_t tape::next_index(size_t index) const
+{
+    uint64_t entry = entries_[index];
+    switch (tag_of(entry)) {
+    case tag_int:
+    case tag_uint:
+    case tag_real:
+        return index + 2;
+    case tag_object_begin:
+    case tag_array_begin:
+        return size_t(payload_of(entry) & 0xFFFFFFFFu) + 1;
+    default:
+        return index + 1;
+    }
+}
+
+// Class tape_view
+// //////////////////////////////////////////////////////////////////
+
+tape_view::tape_view()
+    : tape_(0)
+    , index_(0)
+{
+}
+
+tape_view::tape_view(tape const* owner, size_t index)
+    : tape_(owner)
+    , index_(index)
+{
+}
+
+uint64_t tape_view::entry() const
+{
+    if (!tape_)
+        return tape::make_entry(tape::tag_null, 0);
+    return tape_->entries_[index_];
+}
+
+value_type tape_view::type() const
+{
+    switch (tape::tag_of(entry())) {
+    case tape::tag_true:
+    case tape::tag_false:
+        return vt_bool;
+    case tape::tag_int:
+        return vt_int;
+    case tape::tag_uint:
+        return vt_uint;
+    case tape::tag_real:
+        return vt_real;
+    case tape::tag_string:
+        return vt_string;
+    case tape::tag_object_begin:
+        return vt_object;
+    case tape::tag_array_begin:
+        return vt_array;
+    default:
+        return vt_null;
+    }
+}
+
+// Numbers and strings are handed to a stack-allocated #value, so that the
+// conversion rules stay exactly those of value::as_*(). Strings are wrapped
+// as a static_string, which does not copy.
+value tape_view::scalar() const
+{
+    uint64_t entry = this->entry();
+    switch (tape::tag_of(entry)) {
+    case tape::tag_true:
+        return value(true);
+    case tape::tag_false:
+        return value(false);
+    case tape::tag_int:
+        return value(largest_int_t(tape_->entries_[index_ + 1]));
+    case tape::tag_uint:
+        return value(largest_uint_t(tape_->entries_[index_ + 1]));
+    case tape::tag_real: {
+        double real;
+        uint64_t bits = tape_->entries_[index_ + 1];
+        memcpy(&real, &bits, sizeof(real));
+        return value(real);
+    }
+    case tape::tag_string:
+        return value(static_string(as_cstring()));
+    case tape::tag_object_begin:
+        return value(vt_object);
+    case tape::tag_array_begin:
+        return value(vt_array);
+    default:
+        return value();
+    }
+}
+
+bool tape_view::is_null() const { return type() == vt_null; }
+
+bool tape_view::is_bool() const { return type() == vt_bool; }
+
+bool tape_view::is_int() const { return scalar().is_int(); }
+
+bool tape_view::is_int64() const { return scalar().is_int64(); }
+
+bool tape_view::is_uint() const { return scalar().is_uint(); }
+
+bool tape_view::isUInt64() const { return scalar().isUInt64(); }
+
+bool tape_view::isIntegral() const { return scalar().isIntegral(); }
+
+bool tape_view::isDouble() const { return scalar().isDouble(); }
+
+bool tape_view::isNumeric() const { return scalar().isNumeric(); }
+
+bool tape_view::isString() const { return type() == vt_string; }
+
+bool tape_view::is_array() const { return type() == vt_array; }
+
+bool tape_view::is_object() const { return type() == vt_object; }
+
+const char* tape_view::as_cstring() const
+{
+    JSON_ASSERT_MESSAGE(type() == vt_string,
+        "in json::tape_view::as_cstring(): requires vt_string");
+    return tape_->strings_.data() + tape::payload_of(entry()) + sizeof(unsigned);
+}
+
+bool tape_view::get_string(char const** str, char const** end) const
+{
+    if (type() != vt_string)
+        return false;
+    char const* prefixed = tape_->strings_.data() + tape::payload_of(entry());
+    unsigned length;
+    memcpy(&length, prefixed, sizeof(length));
+    *str = prefixed + sizeof(unsigned);
+    *end = *str + length;
+    return true;
+}
+
+std::string tape_view::as_string() const
+{
+    char const* str;
+    char const* end;
+    if (get_string(&str, &end))
+        return std::string(str, end);
+    return scalar().as_string();
+}
+
+int32_t tape_view::as_int() const { return scalar().as_int(); }
+
+uint32_t tape_view::as_uint() const { return scalar().as_uint(); }
+
+#if defined(JSON_HAS_INT64)
+int64_t tape_view::as_int64() const { return scalar().as_int64(); }
+
+uint64_t tape_view::as_uint64() const { return scalar().as_uint64(); }
+#endif // if defined(JSON_HAS_INT64)
+
+largest_int_t tape_view::as_largest_int() const { return scalar().as_largest_int(); }
+
+largest_uint_t tape_view::as_largest_uint() const { return scalar().as_largest_uint(); }
+
+float tape_view::as_float() const { return scalar().as_float(); }
+
+double tape_view::as_double() const { return scalar().as_double(); }
+
+bool tape_view::as_bool() const { return scalar().as_bool(); }
+
+array_index tape_view::size() const
+{
+    uint64_t entry = this->entry();
+    switch (tape::tag_of(entry)) {
+    case tape::tag_object_begin:
+    case tape::tag_array_begin: {
+        uint64_t count = tape::payload_of(entry) >> 32;
+        if (count < tape::count_mask)
+            return array_index(count);
+        // Saturated; count the hard way.
+        array_index n = 0;
+        for (const_iterator it = begin(); it != end(); ++it)
+            ++n;
+        return n;
+    }
+    default:
+        return 0;
+    }
+}
+
+bool tape_view::empty() const
+{
+    if (is_null() || is_array() || is_object())
+        return size() == 0u;
+    return false;
+}
+
+bool tape_view::operator!() const { return is_null(); }
+
+tape_view tape_view::operator[](array_index index) const
+{
+    JSON_ASSERT_MESSAGE(
+        type() == vt_null || type() == vt_array,
+        "in json::tape_view::operator[](array_index): requires vt_array");
+    if (type() == vt_null)
+        return tape_view();
+    size_t current = index_ + 1;
+    for (; index > 0; --index) {
+        if (tape::tag_of(tape_->entries_[current]) == tape::tag_array_end)
+            return tape_view();
+        current = tape_->next_index(current);
+    }
+    if (tape::tag_of(tape_->entries_[current]) == tape::tag_array_end)
+        return tape_view();
+    return tape_view(tape_, current);
+}
+
+tape_view tape_view::operator[](int index) const
+{
+    JSON_ASSERT_MESSAGE(
+        index >= 0,
+        "in json::tape_view::operator[](int index): index cannot be negative");
+    return (*this)[array_index(index)];
+}
+
+bool tape_view::is_valid_index(array_index index) const { return index < size(); }
+
+bool tape_view::find(char const* key, char const* end, tape_view* found) const
+{
+    JSON_ASSERT_MESSAGE(
+        type() == vt_null || type() == vt_object,
+        "in json::tape_view::find(key, end, found): requires vt_object or vt_null");
+    if (type() == vt_null)
+        return false;
+    size_t length = end - key;
+    size_t current = index_ + 1;
+    while (tape::tag_of(tape_->entries_[current]) != tape::tag_object_end) {
+        char const* name;
+        char const* name_end;
+        tape_view(tape_, current).get_string(&name, &name_end);
+        if (size_t(name_end - name) == length && memcmp(name, key, length) == 0) {
+            *found = tape_view(tape_, current + 1);
+            return true;
+        }
+        current = tape_->next_index(current + 1);
+    }
+    return false;
+}
+
+tape_view tape_view::operator[](const char* key) const
+{
+    tape_view found;
+    find(key, key + strlen(key), &found);
+    return found;
+}
+
+tape_view tape_view::operator[](std::string const& key) const
+{
+    tape_view found;
+    find(key.data(), key.data() + key.length(), &found);
+    return found;
+}
+
+bool tape_view::is_member(std::string const& key) const
+{
+    tape_view found;
+    return find(key.data(), key.data() + key.length(), &found);
+}
+
+value::members tape_view::get_member_names() const
+{
+    JSON_ASSERT_MESSAGE(
+        type() == vt_null || type() == vt_object,
+        "in json::tape_view::get_member_names(), value must be vt_object");
+    value::members members;
+    if (type() == vt_null)
+        return members;
+    members.reserve(size());
+    for (const_iterator it = begin(); it != end(); ++it)
+        members.push_back(it.name());
+    return members;
+}
+
+tape_view::const_iterator tape_view::begin() const
+{
+    switch (tape::tag_of(entry())) {
+    case tape::tag_object_begin:
+        return const_iterator(*this, index_ + 1, 0);
+    case tape::tag_array_begin:
+        return const_iterator(tape_view(tape_, index_ + 1), 0, 0);
+    default:
+        return const_iterator();
+    }
+}
+
+tape_view::const_iterator tape_view::end() const
+{
+    switch (tape::tag_of(entry())) {
+    case tape::tag_object_begin:
+    case tape::tag_array_begin: {
+        size_t close = size_t(tape::payload_of(entry()) & 0xFFFFFFFFu);
+        return const_iterator(tape_view(tape_, close), 0, 0);
+    }
+    default:
+        return const_iterator();
+    }
+}
+
+value tape_view::to_value() const
+{
+    switch (type()) {
+    case vt_string: {
+        char const* str;
+        char const* end;
+        get_string(&str, &end);
+        return value(str, end);
+    }
+    case vt_array: {
+        value result(vt_array);
+        array_index index = 0;
+        for (const_iterator it = begin(); it != end(); ++it)
+            result[index++] = it->to_value();
+        return result;
+    }
+    case vt_object: {
+        value result(vt_object);
+        for (const_iterator it = begin(); it != end(); ++it) {
+            char const* name_end;
+            char const* name = it.member_name(&name_end);
+            *result.demand(name, name_end) = it->to_value();
+        }
+        return result;
+    }
+    default:
+        return scalar();
+    }
+}
+
+// Class tape_view::const_iterator
+// //////////////////////////////////////////////////////////////////
+
+tape_view::const_iterator::const_iterator()
+    : current_()
+    , key_(0)
+    , position_(0)
+{
+}
+
+tape_view::const_iterator::const_iterator(
+    tape_view const& current, size_t key, uint32_t position)
+    : current_(current)
+    , key_(key)
+    , position_(position)
+{
+    settle();
+}
+
+// For objects, key_ walks the key entries and current_ is the value after
+// it; at the end both point at the closing entry, so that comparisons with
+// end() only need to look at current_.
+void tape_view::const_iterator::settle()
+{
+    if (!key_)
+        return;
+    tape const* owner = current_.tape_;
+    if (tape::tag_of(owner->entries_[key_]) == tape::tag_object_end)
+        current_ = tape_view(owner, key_);
+    else
+        current_ = tape_view(owner, key_ + 1);
+}
+
+tape_view::const_iterator& tape_view::const_iterator::operator++()
+{
+    tape const* owner = current_.tape_;
+    size_t next = owner->next_index(current_.index_);
+    ++position_;
+    if (key_) {
+        key_ = next;
+        settle();
+    }
+    else {
+        current_ = tape_view(owner, next);
+    }
+    return *this;
+}
+
+uint32_t tape_view::const_iterator::index() const
+{
+    if (key_)
+        return uint32_t(-1);
+    return position_;
+}
+
+std::string tape_view::const_iterator::name() const
+{
+    char const* end;
+    char const* key = member_name(&end);
+    if (!key)
+        return std::string();
+    return std::string(key, end);
+}
+
+char const* tape_view::const_iterator::member_name(char const** end) const
+{
+    char const* name;
+    if (!key_ || !tape_view(current_.tape_, key_).get_string(&name, end)) {
+        *end = NULL;
+        return NULL;
+    }
+    return name;
+}
+
+} // namespace json
@@ -0,0 +1,254 @@
+// Derived from public-domain/MIT-licensed code at
+// https://github.com/open-source-parsers/jsoncpp. Thanks, Baptiste Lepilleur!
+
+#pragma once
+
+#include "value.h"
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Disable warning C4251: <data member>: <type> needs to have dll-interface to
+// be used by...
+#if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+#pragma warning(push)
+#pragma warning(disable : 4251)
+#endif // if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+
+namespace json {
+
+/** \brief Flat, read-only representation of a parsed JSON document.
+ *
+ * The structure of the document is kept in one contiguous array of 64-bit
+ * tagged entries, and the bytes of every key and string value are kept in a
+ * second buffer. Objects and arrays are bracketed by a begin and an end entry,
+ * and the begin entry records the index of its matching end, so a whole
+ * subtree can be stepped over in O(1).
+ *
+ * Filling a tape costs two contiguous buffers instead of one heap node per
+ * value, which makes it a good fit for consumers that only read.
+ *
+ * Use parse_tape() to fill a tape and root() to read it:
+ * \code
+ * json::char_reader_builder builder;
+ * json::tape doc;
+ * std::string errs;
+ * if (json::parse_tape(builder, begin, end, &doc, &errs)) {
+ *   json::tape_view root = doc.root();
+ *   std::string name = root["name"].as_string();
+ * }
+ * \endcode
+ *
+ * \note A tape_view is only valid for as long as the tape it came from.
+ */
+class JSON_API tape {
+public:
+	tape();
+
+	/// Remove all entries and strings.
+	void clear();
+
+	/// \return true if nothing has been parsed into this tape.
+	bool empty() const;
+
+	/// The root value of the document, or a null view if empty().
+	tape_view root() const;
+
+	/// Number of 64-bit structural entries, for sizing and diagnostics.
+	size_t entry_count() const;
+
+	/// Number of bytes used by the string buffer.
+	size_t string_bytes() const;
+
+private:
+	friend class tape_view;
+	friend class tape_builder;
+
+	enum tag {
+		tag_null = 0,
+		tag_true,
+		tag_false,
+		tag_int, ///< payload in the next entry
+		tag_uint, ///< payload in the next entry
+		tag_real, ///< payload in the next entry
+		tag_string, ///< offset into strings_
+		tag_object_begin, ///< index of matching end, and member count
+		tag_object_end, ///< index of matching begin
+		tag_array_begin, ///< index of matching end, and element count
+		tag_array_end ///< index of matching begin
+	};
+
+	static uint64_t const payload_mask = (uint64_t(1) << 56) - 1;
+	static uint64_t const count_mask = (uint64_t(1) << 24) - 1;
+
+	static tag tag_of(uint64_t entry) { return tag(entry >> 56); }
+	static uint64_t payload_of(uint64_t entry) { return entry & payload_mask; }
+	static uint64_t make_entry(tag t, uint64_t payload)
+	{
+		return (uint64_t(t) << 56) | (payload & payload_mask);
+	}
+
+	/// Index of the entry following the value that starts at 'index'.
+	size_t next_index(size_t index) const;
+
+	std::vector<uint64_t> entries_;
+	std::string strings_; // each: unsigned length, bytes, then a 0
+};
+
+/** \brief Lightweight, read-only handle to one value inside a \ref tape.
+ *
+ * Offers the familiar read API of #value (operator[], find(), size(),
+ * iteration, as_*()), without allocating. A view obtained for a missing
+ * member or index is a null view, like value::null_ref.
+ */
+class JSON_API tape_view {
+public:
+	class const_iterator;
+
+	/// A null view, not attached to any tape.
+	tape_view();
+
+	value_type type() const;
+
+	bool is_null() const;
+	bool is_bool() const;
+	bool is_int() const;
+	bool is_int64() const;
+	bool is_uint() const;
+	bool isUInt64() const;
+	bool isIntegral() const;
+	bool isDouble() const;
+	bool isNumeric() const;
+	bool isString() const;
+	bool is_array() const;
+	bool is_object() const;
+
+	const char* as_cstring() const; ///< Embedded zeroes could cause you trouble!
+	std::string as_string() const; ///< Embedded zeroes are possible.
+	/** Get raw char* of string-value, pointing into the tape.
+	 *  \return false if !string. (Seg-fault if str or end are NULL.)
+	 */
+	bool get_string(char const** str, char const** end) const;
+	int32_t as_int() const;
+	uint32_t as_uint() const;
+#if defined(JSON_HAS_INT64)
+	int64_t as_int64() const;
+	uint64_t as_uint64() const;
+#endif // if defined(JSON_HAS_INT64)
+	largest_int_t as_largest_int() const;
+	largest_uint_t as_largest_uint() const;
+	float as_float() const;
+	double as_double() const;
+	bool as_bool() const;
+
+	/// Number of values in array or object
+	array_index size() const;
+	/// \brief Return true if empty array, empty object, or null;
+	/// otherwise, false.
+	bool empty() const;
+	/// Return is_null()
+	bool operator!() const;
+
+	/// Access an array element (zero based index). O(index) entry hops.
+	/// \return a null view if out of range.
+	tape_view operator[](array_index index) const;
+	tape_view operator[](int index) const;
+	/// Return true if index < size().
+	bool is_valid_index(array_index index) const;
+
+	/// Access an object member by name. O(members) key comparisons.
+	/// \return a null view if there is no member with that name.
+	tape_view operator[](const char* key) const;
+	/// \param key may contain embedded nulls.
+	tape_view operator[](std::string const& key) const;
+	/** Look up an object member by name.
+	 *  Update 'found' iff found.
+	 *  \param key may contain embedded nulls.
+	 *  \return true iff found
+	 */
+	bool find(char const* key, char const* end, tape_view* found) const;
+	/// Return true if the object has a member named key.
+	bool is_member(std::string const& key) const;
+	/// \brief Return a list of the member names.
+	/// \pre type() is vt_object or vt_null
+	value::members get_member_names() const;
+
+	const_iterator begin() const;
+	const_iterator end() const;
+
+	/// Deep copy into a regular #value, e.g. to modify part of the document.
+	value to_value() const;
+
+private:
+	friend class tape;
+	friend class tape_builder;
+
+	tape_view(tape const* owner, size_t index);
+
+	uint64_t entry() const;
+	value scalar() const;
+
+	tape const* tape_;
+	size_t index_;
+};
+
+/** \brief Forward iterator over the elements of an array, or the members of
+ * an object, in a \ref tape.
+ */
+class JSON_API tape_view::const_iterator {
+public:
+	typedef std::forward_iterator_tag iterator_category;
+	typedef tape_view value_type;
+	typedef int difference_type;
+	typedef tape_view reference;
+	typedef tape_view const* pointer;
+
+	const_iterator();
+
+	bool operator==(const_iterator const& other) const
+	{
+		return current_.index_ == other.current_.index_;
+	}
+	bool operator!=(const_iterator const& other) const
+	{
+		return !(*this == other);
+	}
+
+	const_iterator& operator++();
+	const_iterator operator++(int)
+	{
+		const_iterator temp(*this);
+		++*this;
+		return temp;
+	}
+
+	reference operator*() const { return current_; }
+	pointer operator->() const { return &current_; }
+
+	/// Return the index of the referenced value, or -1 if it is not an vt_array.
+	uint32_t index() const;
+
+	/// Return the member name of the referenced value, or "" if it is not an
+	/// vt_object.
+	std::string name() const;
+
+	/// Return the member name of the referenced value, or NULL if it is not an
+	/// vt_object. Because end is passed as an OUT param, embedded nulls are supported.
+	char const* member_name(char const** end) const;
+
+private:
+	friend class tape_view;
+
+	const_iterator(tape_view const& current, size_t key, uint32_t index);
+	void settle();
+
+	tape_view current_;
+	size_t key_; // index of the key entry, or 0 for arrays
+	uint32_t position_;
+};
+
+} // namespace json
+
+#if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+#pragma warning(pop)
+#endif // if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
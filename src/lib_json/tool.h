@@ -3,10 +3,13 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cstring>
+
 /* This header provides common string manipulation support, such as UTF-8,
- * portable conversion from/to string...
+ * portable conversion from/to string, comparison of numbers, hashing...
  *
- * It is an internal header that must not be exposed.
+ * It is an internal header that must not be exposed. Include value.h first.
  */
 
 namespace json {
@@ -85,5 +88,70 @@ static inline void fix_numeric_locale(char* begin, char* end)
 	}
 }
 
+/// true for vt_int, vt_uint and vt_real.
+static inline bool is_number(value const& v)
+{
+	value_type type = v.type();
+	return type == vt_int || type == vt_uint || type == vt_real;
+}
+
+/// -1, 0 or 1, as a is less than, equal to or greater than b, two numbers
+/// of any type. (JSON has only one type of number.)
+static inline int compare_numbers(value const& a, value const& b)
+{
+	if (a.type() == vt_real || b.type() == vt_real) {
+		double x = a.as_double();
+		double y = b.as_double();
+		return x < y ? -1 : (y < x ? 1 : 0);
+	}
+	if (a.type() == vt_int && a.as_largest_int() < 0) {
+		if (b.type() == vt_int && b.as_largest_int() < 0) {
+			largest_int_t x = a.as_largest_int();
+			largest_int_t y = b.as_largest_int();
+			return x < y ? -1 : (y < x ? 1 : 0);
+		}
+		return -1;
+	}
+	if (b.type() == vt_int && b.as_largest_int() < 0)
+		return 1;
+	largest_uint_t x = a.as_largest_uint();
+	largest_uint_t y = b.as_largest_uint();
+	return x < y ? -1 : (y < x ? 1 : 0);
+}
+
+/// Scramble 'h' so that every bit of it affects every bit of the result
+/// (the finalizer of splitmix64). A bijection.
+static inline uint64_t hash_mix(uint64_t h)
+{
+	h ^= h >> 30;
+	h *= 0xbf58476d1ce4e5b9ULL;
+	h ^= h >> 27;
+	h *= 0x94d049bb133111ebULL;
+	h ^= h >> 31;
+	return h;
+}
+
+/// 64-bit FNV-1a of [begin, end).
+static inline uint64_t hash_bytes(char const* begin, char const* end)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for (char const* current = begin; current != end; ++current) {
+		hash ^= static_cast<unsigned char>(*current);
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+/// -1, 0 or 1, as the key [a, a + a_length) comes before, is equal to or
+/// comes after [b, b + b_length) in the map of an object (see
+/// value::czstring::operator<): by their common prefix, then by length.
+static inline int compare_keys(char const* a, size_t a_length, char const* b, size_t b_length)
+{
+	int comp = memcmp(a, b, std::min(a_length, b_length));
+	if (comp)
+		return comp;
+	return a_length < b_length ? -1 : (a_length > b_length ? 1 : 0);
+}
+
 } // namespace json {
 
@@ -4,6 +4,7 @@
 #include "assertions.h"
 #include "value.h"
 #include "writer.h"
+#include "tool.h"
 #include <math.h>
 #include <sstream>
 #include <utility>
@@ -11,6 +12,10 @@
 #include <cassert>
 #include <cstddef> // size_t
 #include <algorithm> // min()
+#include <atomic>
+#include <new> // placement new
+#include <unordered_map>
+#include <vector>
 
 #define JSON_ASSERT_UNREACHABLE assert(false)
 
@@ -96,7 +101,15 @@ static inline char* duplicate_string_value(const char* value,
     return new_string;
 }
 
-/* Record the length as a prefix.
+// The prefix of a string that values and member names may share: a count of
+// those that hold it, then its length. The characters and a terminating zero
+// follow.
+struct string_prefix {
+    std::atomic<unsigned> refs_;
+    unsigned length_;
+};
+
+/* Record the length, and one holder, as a prefix.
  */
 static inline char* duplicate_and_prefix_string_value(
     const char* value,
@@ -104,18 +117,20 @@ static inline char* duplicate_and_prefix_string_value(
 {
     // Avoid an integer overflow in the call to malloc below by limiting length
     // to a sane value.
-    JSON_ASSERT_MESSAGE(length <= (unsigned)value::max_int - sizeof(unsigned) - 1U,
+    JSON_ASSERT_MESSAGE(length <= (unsigned)value::max_int - sizeof(string_prefix) - 1U,
         "in json::value::duplicate_and_prefix_string_value(): "
         "length too big for prefixing");
-    unsigned actualLength = length + sizeof(unsigned) + 1U;
+    unsigned actualLength = length + sizeof(string_prefix) + 1U;
     char* new_string = static_cast<char*>(malloc(actualLength));
     if (new_string == 0) {
         throw_runtime_error(
             "in json::value::duplicate_and_prefix_string_value(): "
             "Failed to allocate string value buffer");
     }
-    *reinterpret_cast<unsigned*>(new_string) = length;
-    memcpy(new_string + sizeof(unsigned), value, length);
+    string_prefix* prefix = new (new_string) string_prefix;
+    prefix->refs_.store(1, std::memory_order_relaxed);
+    prefix->length_ = length;
+    memcpy(new_string + sizeof(string_prefix), value, length);
     new_string[actualLength - 1U] = 0; // to avoid buffer over-run accidents by users later
     return new_string;
 }
@@ -128,11 +143,29 @@ inline static void decode_prefixed_string(
         *value = prefixed;
     }
     else {
-        *length = *reinterpret_cast<unsigned const*>(prefixed);
-        *value = prefixed + sizeof(unsigned);
+        *length = reinterpret_cast<string_prefix const*>(prefixed)->length_;
+        *value = prefixed + sizeof(string_prefix);
     }
 }
-/** Free the string duplicated by duplicate_string_value()/duplicate_and_prefix_string_value().
+/** Hold one more time the string prefixed by duplicate_and_prefix_string_value().
+ */
+static inline char* share_prefixed_string(char* prefixed)
+{
+    reinterpret_cast<string_prefix*>(prefixed)->refs_.fetch_add(1, std::memory_order_relaxed);
+    return prefixed;
+}
+/** Let go of the string prefixed by duplicate_and_prefix_string_value(), and
+ * free it if nothing else holds it.
+ */
+static inline void release_prefixed_string(char* prefixed)
+{
+    string_prefix* prefix = reinterpret_cast<string_prefix*>(prefixed);
+    if (prefix->refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        prefix->~string_prefix();
+        free(prefixed);
+    }
+}
+/** Free the string duplicated by duplicate_string_value().
  */
 static inline void release_string_value(char* value) { free(value); }
 
@@ -255,9 +288,12 @@ value::czstring::czstring(char const* str, unsigned length, duplication_policy a
 }
 
 value::czstring::czstring(czstring const& other)
-    : cstr_(other.storage_.policy_ != no_duplication && other.cstr_ != 0
-              ? duplicate_string_value(other.cstr_, other.storage_.length_)
-              : other.cstr_)
+    : cstr_(other.storage_.policy_ == no_duplication || other.cstr_ == 0
+              ? other.cstr_
+              : (other.storage_.policy_ == duplicate
+                        ? share_prefixed_string(const_cast<char*>(other.cstr_) - sizeof(string_prefix))
+                        : duplicate_and_prefix_string_value(other.cstr_, other.storage_.length_))
+                  + sizeof(string_prefix))
 {
     storage_.policy_ = (other.cstr_
             ? (other.storage_.policy_ == no_duplication
@@ -270,7 +306,17 @@ value::czstring::czstring(czstring const& other)
 value::czstring::~czstring()
 {
     if (cstr_ && storage_.policy_ == duplicate)
-        release_string_value(const_cast<char*>(cstr_));
+        release_prefixed_string(const_cast<char*>(cstr_) - sizeof(string_prefix));
+}
+
+void value::czstring::share(char const* data)
+{
+    JSON_ASSERT(storage_.policy_ == duplicate);
+    if (cstr_ == data)
+        return;
+    char* held = share_prefixed_string(const_cast<char*>(data) - sizeof(string_prefix));
+    release_prefixed_string(const_cast<char*>(cstr_) - sizeof(string_prefix));
+    cstr_ = held + sizeof(string_prefix);
 }
 
 void value::czstring::swap(czstring& other)
@@ -323,6 +369,48 @@ const char* value::czstring::data() const { return cstr_; }
 unsigned value::czstring::length() const { return storage_.length_; }
 bool value::czstring::is_static_string() const { return storage_.policy_ == no_duplication; }
 
+// //////////////////////////////////////////////////////////////////
+// //////////////////////////////////////////////////////////////////
+// //////////////////////////////////////////////////////////////////
+// class value::shared_values
+// //////////////////////////////////////////////////////////////////
+// //////////////////////////////////////////////////////////////////
+// //////////////////////////////////////////////////////////////////
+
+struct value::shared_values : object_values {
+    shared_values()
+        : refs_(1)
+        , leaked_(false)
+    {
+    }
+    explicit shared_values(object_values const& other)
+        : object_values(other)
+        , refs_(1)
+        , leaked_(false)
+    {
+    }
+    shared_values* copy() const
+    {
+        return new shared_values(static_cast<object_values const&>(*this));
+    }
+    shared_values* share()
+    {
+        refs_.fetch_add(1, std::memory_order_relaxed);
+        return this;
+    }
+    void release()
+    {
+        if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            delete this;
+    }
+    bool is_shared() const { return refs_.load(std::memory_order_acquire) > 1; }
+
+    std::atomic<unsigned> refs_;
+    // A reference or an iterator into it was handed out, through which it
+    // may change at any time: it is not to be shared (see value::leak()).
+    bool leaked_;
+};
+
 // //////////////////////////////////////////////////////////////////
 // //////////////////////////////////////////////////////////////////
 // //////////////////////////////////////////////////////////////////
@@ -353,7 +441,7 @@ value::value(value_type type)
         break;
     case vt_array:
     case vt_object:
-        value_.map_ = new object_values();
+        value_.map_ = new shared_values();
         break;
     case vt_bool:
         value_.bool_ = false;
@@ -426,7 +514,9 @@ value::value(bool value)
 value::value(value const& other)
     : type_(other.type_)
     , allocated_(false)
-    , comments_(0)
+    , from_source_(false)
+    , has_source_parts_(false)
+    , extras_(0)
     , start_(other.start_)
     , limit_(other.limit_)
 {
@@ -440,11 +530,7 @@ value::value(value const& other)
         break;
     case vt_string:
         if (other.value_.string_ && other.allocated_) {
-            unsigned len;
-            char const* str;
-            decode_prefixed_string(other.allocated_, other.value_.string_,
-                &len, &str);
-            value_.string_ = duplicate_and_prefix_string_value(str, len);
+            value_.string_ = share_prefixed_string(other.value_.string_);
             allocated_ = true;
         }
         else {
@@ -454,20 +540,26 @@ value::value(value const& other)
         break;
     case vt_array:
     case vt_object:
-        value_.map_ = new object_values(*other.value_.map_);
+        // Values from a source are marked with their place in it, which is
+        // not that of the document this copy goes to.
+        value_.map_ = other.has_source_parts_ || other.value_.map_->leaked_
+            ? other.value_.map_->copy()
+            : other.value_.map_->share();
         break;
     default:
         JSON_ASSERT_UNREACHABLE;
     }
-    if (other.comments_) {
-        comments_ = new comment_info[number_of_comment_placement];
-        for (int comment = 0; comment < number_of_comment_placement; ++comment) {
-            comment_info const& other_comment = other.comments_[comment];
-            if (other_comment.comment_)
-                comments_[comment].set_comment(
-                    other_comment.comment_, strlen(other_comment.comment_));
+    // Comments and the cached hash are copied, the cached text is not.
+    for (int comment = 0; comment < number_of_comment_placement; ++comment) {
+        if (other.has_comment(comment_placement(comment))) {
+            char const* other_comment = other.extras_->comments_[comment].comment_;
+            extras().comments_[comment].set_comment(other_comment, strlen(other_comment));
         }
     }
+    if (other.extras_ && other.extras_->has_hash_) {
+        extras().hash_ = other.extras_->hash_;
+        extras_->has_hash_ = true;
+    }
 }
 
 value::~value()
@@ -481,18 +573,17 @@ value::~value()
         break;
     case vt_string:
         if (allocated_)
-            release_string_value(value_.string_);
+            release_prefixed_string(value_.string_);
         break;
     case vt_array:
     case vt_object:
-        delete value_.map_;
+        value_.map_->release();
         break;
     default:
         JSON_ASSERT_UNREACHABLE;
     }
 
-    if (comments_)
-        delete[] comments_;
+    delete extras_;
 }
 
 value& value::operator=(value other)
@@ -503,6 +594,12 @@ value& value::operator=(value other)
 
 void value::swap_payload(value& other)
 {
+    // Exchanged rather than changed, the payloads need not be made our own.
+    drop_derived();
+    other.drop_derived();
+    // Values in the payloads may go to another document, with another source.
+    forget_source();
+    other.forget_source();
     value_type temp = type_;
     type_ = other.type_;
     other.type_ = temp;
@@ -515,7 +612,7 @@ void value::swap_payload(value& other)
 void value::swap(value& other)
 {
     swap_payload(other);
-    std::swap(comments_, other.comments_);
+    std::swap(extras_, other.extras_);
     std::swap(start_, other.start_);
     std::swap(limit_, other.limit_);
 }
@@ -596,6 +693,9 @@ bool value::operator==(value const& other) const
     int temp = other.type_;
     if (type_ != temp)
         return false;
+    if (extras_ && extras_->has_hash_ && other.extras_ && other.extras_->has_hash_
+        && extras_->hash_ != other.extras_->hash_)
+        return false;
     switch (type_) {
     case vt_null:
         return true;
@@ -924,6 +1024,7 @@ void value::clear()
 {
     JSON_ASSERT_MESSAGE(type_ == vt_null || type_ == vt_array || type_ == vt_object,
         "in json::value::clear(): requires complex value");
+    touch();
     start_ = 0;
     limit_ = 0;
     switch (type_) {
@@ -940,6 +1041,7 @@ void value::resize(array_index newSize)
 {
     JSON_ASSERT_MESSAGE(type_ == vt_null || type_ == vt_array,
         "in json::value::resize(): requires vt_array");
+    touch();
     if (type_ == vt_null)
         *this = value(vt_array);
     array_index oldSize = size();
@@ -960,8 +1062,10 @@ value& value::operator[](array_index index)
     JSON_ASSERT_MESSAGE(
         type_ == vt_null || type_ == vt_array,
         "in json::value::operator[](array_index): requires vt_array");
+    touch();
     if (type_ == vt_null)
         *this = value(vt_array);
+    leak();
     czstring key(index);
     object_values::iterator it = value_.map_->lower_bound(key);
     if (it != value_.map_->end() && (*it).first == key)
@@ -1006,7 +1110,9 @@ void value::init_basic(value_type type, bool allocated)
 {
     type_ = type;
     allocated_ = allocated;
-    comments_ = 0;
+    from_source_ = false;
+    has_source_parts_ = false;
+    extras_ = 0;
     start_ = 0;
     limit_ = 0;
 }
@@ -1019,8 +1125,10 @@ value& value::resolve_reference(const char* key)
     JSON_ASSERT_MESSAGE(
         type_ == vt_null || type_ == vt_object,
         "in json::value::resolve_reference(): requires vt_object");
+    touch();
     if (type_ == vt_null)
         *this = value(vt_object);
+    leak();
     czstring actual_key(
         key, static_cast<unsigned>(strlen(key)), czstring::no_duplication); // NOTE!
     object_values::iterator it = value_.map_->lower_bound(actual_key);
@@ -1039,8 +1147,10 @@ value& value::resolve_reference(char const* key, char const* end)
     JSON_ASSERT_MESSAGE(
         type_ == vt_null || type_ == vt_object,
         "in json::value::resolve_reference(key, end): requires vt_object");
+    touch();
     if (type_ == vt_null)
         *this = value(vt_object);
+    leak();
     czstring actual_key(
         key, static_cast<unsigned>(end - key), czstring::duplicate_on_copy);
     object_values::iterator it = value_.map_->lower_bound(actual_key);
@@ -1074,6 +1184,13 @@ value const* value::find(char const* key, char const* end) const
         return NULL;
     return &(*it).second;
 }
+value* value::demand(char const* key, char const* end)
+{
+    JSON_ASSERT_MESSAGE(
+        type_ == vt_null || type_ == vt_object,
+        "in json::value::demand(key, end): requires vt_object or vt_null");
+    return &resolve_reference(key, end);
+}
 value const& value::operator[](const char* key) const
 {
     value const* found = find(key, key + strlen(key));
@@ -1122,6 +1239,7 @@ value value::get(std::string const& key, value const& default_value) const
 
 bool value::remove_member(const char* key, const char* end, value* removed)
 {
+    touch();
     if (type_ != vt_object) {
         return false;
     }
@@ -1129,7 +1247,7 @@ bool value::remove_member(const char* key, const char* end, value* removed)
     object_values::iterator it = value_.map_->find(actual_key);
     if (it == value_.map_->end())
         return false;
-    *removed = it->second;
+    removed->swap(it->second);
     value_.map_->erase(it);
     return true;
 }
@@ -1159,6 +1277,7 @@ value value::remove_member(std::string const& key)
 
 bool value::remove_index(array_index index, value* removed)
 {
+    touch();
     if (type_ != vt_array) {
         return false;
     }
@@ -1167,17 +1286,18 @@ bool value::remove_index(array_index index, value* removed)
     if (it == value_.map_->end()) {
         return false;
     }
-    *removed = it->second;
-    array_index oldSize = size();
-    // shift left all items left, into the place of the "removed"
-    for (array_index i = index; i < (oldSize - 1); ++i) {
+    removed->swap(it->second);
+    array_index old_size = size();
+    // shift left all items left, into the place of the "removed", by swapping
+    // rather than copying them
+    for (array_index i = index; i < (old_size - 1); ++i) {
         czstring key(i);
-        (*value_.map_)[key] = (*this)[i + 1];
+        czstring key_next(i + 1);
+        (*value_.map_)[key].swap((*value_.map_)[key_next]);
     }
     // erase the last one ("leftover")
-    czstring key_last(oldSize - 1);
-    object_values::iterator itLast = value_.map_->find(key_last);
-    value_.map_->erase(itLast);
+    czstring key_last(old_size - 1);
+    value_.map_->erase(key_last);
     return true;
 }
 
@@ -1314,13 +1434,12 @@ bool value::is_object() const { return type_ == vt_object; }
 
 void value::set_comment(const char* comment, size_t len, comment_placement placement)
 {
-    if (!comments_)
-        comments_ = new comment_info[number_of_comment_placement];
+    touch();
     if ((len > 0) && (comment[len - 1] == '\n')) {
         // Always discard trailing newline, to aid indentation.
         len -= 1;
     }
-    comments_[placement].set_comment(comment, len);
+    extras().comments_[placement].set_comment(comment, len);
 }
 
 void value::set_comment(const char* comment, comment_placement placement)
@@ -1335,16 +1454,198 @@ void value::set_comment(std::string const& comment, comment_placement placement)
 
 bool value::has_comment(comment_placement placement) const
 {
-    return comments_ != 0 && comments_[placement].comment_ != 0;
+    return extras_ != 0 && extras_->comments_[placement].comment_ != 0;
 }
 
 std::string value::get_comment(comment_placement placement) const
 {
     if (has_comment(placement))
-        return comments_[placement].comment_;
+        return extras_->comments_[placement].comment_;
     return "";
 }
 
+std::string const* value::cached_text(std::string const& key) const
+{
+    if (!extras_ || extras_->cache_key_.empty() || extras_->cache_key_ != key)
+        return NULL;
+    return &extras_->cache_text_;
+}
+
+void value::set_cached_text(std::string const& key, std::string& text) const
+{
+    extra_info& extra = extras();
+    extra.cache_key_ = key;
+    extra.cache_text_.swap(text);
+    text.clear();
+}
+
+void value::drop_cached_text()
+{
+    if (extras_ && !extras_->cache_key_.empty()) {
+        extras_->cache_key_.clear();
+        std::string().swap(extras_->cache_text_);
+    }
+}
+
+value::extra_info& value::extras() const
+{
+    if (!extras_)
+        extras_ = new extra_info();
+    return *extras_;
+}
+
+// Called by every non-const member that may change this value, or hand out
+// a reference through which it may be changed.
+void value::touch()
+{
+    drop_derived();
+    own();
+}
+
+// Forget what was found from the payload, or said about it, as it changes.
+void value::drop_derived()
+{
+    drop_cached_text();
+    if (extras_)
+        extras_->has_hash_ = false;
+    from_source_ = false;
+}
+
+// Copy shared elements or members, so that changing them changes this value
+// only.
+void value::own()
+{
+    if ((type_ == vt_array || type_ == vt_object) && value_.map_->is_shared()) {
+        shared_values* copy = value_.map_->copy();
+        value_.map_->release();
+        value_.map_ = copy;
+    }
+}
+
+// Called by every non-const member that hands out a reference or an
+// iterator into the elements or members, once they are this value's own.
+// Until set_shareable(), copies do not share them, as a change through what
+// was handed out would change the copies too.
+void value::leak()
+{
+    if (type_ == vt_array || type_ == vt_object)
+        value_.map_->leaked_ = true;
+}
+
+// Says that nothing handed out by leak() is used any more, so that copies
+// may share the elements or members again. For builders, like the readers,
+// once they are done with a container.
+void value::set_shareable()
+{
+    if (type_ == vt_array || type_ == vt_object)
+        value_.map_->leaked_ = false;
+}
+
+bool value::is_shared() const
+{
+    return (type_ == vt_array || type_ == vt_object) && value_.map_->is_shared();
+}
+
+uint64_t value::hash() const
+{
+    if (extras_ && extras_->has_hash_)
+        return extras_->hash_;
+    switch (type_) {
+    case vt_null:
+        return hash_mix(vt_null);
+    case vt_int:
+        return hash_mix(hash_mix(uint64_t(value_.int_)) ^ vt_int);
+    case vt_uint:
+        return hash_mix(hash_mix(value_.uint_) ^ vt_uint);
+    case vt_real: {
+        // -0.0 == 0.0. The bits are taken as a number, not as bytes, so that
+        // the hash does not depend on the byte order.
+        double real = value_.real_ == 0 ? 0 : value_.real_;
+        uint64_t bits;
+        memcpy(&bits, &real, sizeof bits);
+        return hash_mix(hash_mix(bits) ^ vt_real);
+    }
+    case vt_bool:
+        return hash_mix(vt_bool * 2 + (value_.bool_ ? 1 : 0));
+    case vt_string: {
+        unsigned length = 0;
+        char const* str = "";
+        if (value_.string_)
+            decode_prefixed_string(allocated_, value_.string_, &length, &str);
+        return hash_mix(hash_bytes(str, str + length) ^ vt_string);
+    }
+    case vt_array: {
+        uint64_t h = hash_mix(vt_array);
+        for (object_values::const_iterator it = value_.map_->begin(); it != value_.map_->end(); ++it)
+            h = hash_mix(h + it->second.hash());
+        return h;
+    }
+    case vt_object: {
+        // A sum of the hashes of the members, which does not depend on their
+        // order.
+        uint64_t sum = 0;
+        for (object_values::const_iterator it = value_.map_->begin(); it != value_.map_->end(); ++it) {
+            char const* name = it->first.data();
+            sum += hash_mix(hash_bytes(name, name + it->first.length()) ^ hash_mix(it->second.hash()));
+        }
+        return hash_mix(sum ^ hash_mix(vt_object + uint64_t(value_.map_->size())));
+    }
+    default:
+        JSON_ASSERT_UNREACHABLE;
+    }
+    return 0; // unreachable
+}
+
+void value::cache_hash() const
+{
+    uint64_t h = hash();
+    extra_info& extra = extras();
+    extra.hash_ = h;
+    extra.has_hash_ = true;
+}
+
+void value::set_source(char const* begin, char const* end)
+{
+    touch();
+    extras().source_.assign(begin, end);
+    mark_source();
+}
+
+bool value::get_source(char const** begin, char const** end) const
+{
+    if (!extras_ || extras_->source_.empty())
+        return false;
+    *begin = extras_->source_.data();
+    *end = *begin + extras_->source_.size();
+    return true;
+}
+
+bool value::is_from_source() const { return from_source_; }
+
+void value::mark_source()
+{
+    from_source_ = true;
+    has_source_parts_ = true;
+    // The text is that of this document; a shared value may be in others.
+    own();
+    if ((type_ == vt_array || type_ == vt_object) && value_.map_) {
+        for (object_values::iterator it = value_.map_->begin(); it != value_.map_->end(); ++it)
+            it->second.mark_source();
+    }
+}
+
+void value::forget_source()
+{
+    if (!has_source_parts_)
+        return;
+    from_source_ = false;
+    has_source_parts_ = false;
+    if ((type_ == vt_array || type_ == vt_object) && value_.map_) {
+        for (object_values::iterator it = value_.map_->begin(); it != value_.map_->end(); ++it)
+            it->second.forget_source();
+    }
+}
+
 void value::set_offset_start(size_t start) { start_ = start; }
 
 void value::set_offset_limit(size_t limit) { limit_ = limit; }
@@ -1389,11 +1690,14 @@ value::const_iterator value::end() const
 
 value::iterator value::begin()
 {
+    touch();
     switch (type_) {
     case vt_array:
     case vt_object:
-        if (value_.map_)
+        if (value_.map_) {
+            leak();
             return iterator(value_.map_->begin());
+        }
         break;
     default:
         break;
@@ -1403,11 +1707,14 @@ value::iterator value::begin()
 
 value::iterator value::end()
 {
+    touch();
     switch (type_) {
     case vt_array:
     case vt_object:
-        if (value_.map_)
+        if (value_.map_) {
+            leak();
             return iterator(value_.map_->end());
+        }
         break;
     default:
         break;
@@ -1415,6 +1722,206 @@ value::iterator value::end()
     return iterator();
 }
 
+// class deduper
+// //////////////////////////////////////////////////////////////////
+
+// Makes the equal subtrees and strings of a document share one copy. Every
+// value is hashed once, from the bottom up; then, from the top down, each
+// array, object or string that is equal to one met before takes its payload,
+// and what is in it is not looked at again.
+class deduper {
+public:
+    deduper()
+        : next_(0)
+    {
+    }
+
+    void run(value& root)
+    {
+        measure(root);
+        share(root);
+    }
+
+private:
+    struct node {
+        uint64_t hash;
+        size_t size; // of the subtree, in nodes
+        bool plain; // no comments under it
+    };
+    typedef std::unordered_multimap<uint64_t, value*> value_table;
+    typedef std::unordered_multimap<uint64_t, char const*> string_table;
+
+    static bool has_comments(value const& v);
+    static bool identical(value const& a, value const& b);
+    size_t measure(value const& v);
+    void share(value& v);
+    char const* intern(char const* text, unsigned length);
+
+    std::vector<node> nodes_; // in the order share() meets them
+    size_t next_;
+    value_table containers_;
+    string_table strings_;
+};
+
+bool deduper::has_comments(value const& v)
+{
+    if (!v.extras_)
+        return false;
+    for (int comment = 0; comment < number_of_comment_placement; ++comment) {
+        if (v.extras_->comments_[comment].comment_)
+            return true;
+    }
+    return false;
+}
+
+// As operator==, but 0.0 and -0.0 differ, and NaN is equal to itself: one
+// takes the place of the other.
+bool deduper::identical(value const& a, value const& b)
+{
+    if (a.type_ != b.type_)
+        return false;
+    switch (a.type_) {
+    case vt_null:
+        return true;
+    case vt_int:
+        return a.value_.int_ == b.value_.int_;
+    case vt_uint:
+        return a.value_.uint_ == b.value_.uint_;
+    case vt_real:
+        return memcmp(&a.value_.real_, &b.value_.real_, sizeof(double)) == 0;
+    case vt_bool:
+        return a.value_.bool_ == b.value_.bool_;
+    case vt_string: {
+        if (!a.value_.string_ || !b.value_.string_)
+            return a.value_.string_ == b.value_.string_;
+        unsigned a_length;
+        unsigned b_length;
+        char const* a_str;
+        char const* b_str;
+        decode_prefixed_string(a.allocated_, a.value_.string_, &a_length, &a_str);
+        decode_prefixed_string(b.allocated_, b.value_.string_, &b_length, &b_str);
+        return a_length == b_length && memcmp(a_str, b_str, a_length) == 0;
+    }
+    case vt_array:
+    case vt_object: {
+        if (a.value_.map_ == b.value_.map_)
+            return true;
+        if (a.value_.map_->size() != b.value_.map_->size())
+            return false;
+        value::object_values::const_iterator b_it = b.value_.map_->begin();
+        for (value::object_values::const_iterator a_it = a.value_.map_->begin();
+             a_it != a.value_.map_->end(); ++a_it, ++b_it) {
+            if (!(a_it->first == b_it->first) || !identical(a_it->second, b_it->second))
+                return false;
+        }
+        return true;
+    }
+    default:
+        JSON_ASSERT_UNREACHABLE;
+    }
+    return false; // unreachable
+}
+
+// \return the index of 'v' in nodes_.
+size_t deduper::measure(value const& v)
+{
+    size_t at = nodes_.size();
+    nodes_.push_back(node());
+    uint64_t h;
+    bool plain = true;
+    if (v.type_ == vt_array || v.type_ == vt_object) {
+        h = hash_mix(v.type_);
+        for (value::object_values::const_iterator it = v.value_.map_->begin(); it != v.value_.map_->end(); ++it) {
+            size_t child = measure(it->second);
+            plain = plain && nodes_[child].plain && !has_comments(it->second);
+            uint64_t child_hash = nodes_[child].hash;
+            if (it->first.data())
+                child_hash ^= hash_mix(hash_bytes(it->first.data(), it->first.data() + it->first.length()));
+            h = hash_mix(h + child_hash);
+        }
+    }
+    else {
+        h = v.hash();
+    }
+    nodes_[at].hash = h;
+    nodes_[at].size = nodes_.size() - at;
+    nodes_[at].plain = plain;
+    return at;
+}
+
+void deduper::share(value& v)
+{
+    node const here = nodes_[next_];
+    size_t const end = next_ + here.size;
+    ++next_;
+    if (v.type_ == vt_string) {
+        if (v.allocated_ && v.value_.string_) {
+            unsigned length;
+            char const* text;
+            decode_prefixed_string(true, v.value_.string_, &length, &text);
+            char const* held = intern(text, length);
+            if (held != text) {
+                char* prefixed = share_prefixed_string(const_cast<char*>(held) - sizeof(string_prefix));
+                release_prefixed_string(v.value_.string_);
+                v.value_.string_ = prefixed;
+            }
+        }
+        return;
+    }
+    if (v.type_ != vt_array && v.type_ != vt_object)
+        return;
+    // What was handed out into a leaked container (see value::leak()) must
+    // still reach it, and it only: it neither takes the elements or members
+    // of another, nor gives its own. What is in it may still be shared.
+    if (here.plain && !v.value_.map_->leaked_) {
+        std::pair<value_table::iterator, value_table::iterator> range = containers_.equal_range(here.hash);
+        for (value_table::iterator it = range.first; it != range.second; ++it) {
+            if (identical(*it->second, v)) {
+                value::shared_values* held = it->second->value_.map_;
+                if (held != v.value_.map_) {
+                    held->share();
+                    v.value_.map_->release();
+                    v.value_.map_ = held;
+                }
+                next_ = end;
+                return;
+            }
+        }
+        containers_.insert(std::make_pair(here.hash, &v));
+    }
+    // The names and values in it are about to change: they must be its own.
+    v.own();
+    for (value::object_values::iterator it = v.value_.map_->begin(); it != v.value_.map_->end(); ++it) {
+        value::czstring const& name = it->first;
+        if (name.data() && !name.is_static_string()) {
+            // The text, and so the order, of the name stays the same.
+            const_cast<value::czstring&>(name).share(intern(name.data(), name.length()));
+        }
+        share(it->second);
+    }
+}
+
+// \return the first text equal to [text, text + length) met, which is 'text'
+//         if it is the first.
+char const* deduper::intern(char const* text, unsigned length)
+{
+    uint64_t h = hash_bytes(text, text + length);
+    std::pair<string_table::iterator, string_table::iterator> range = strings_.equal_range(h);
+    for (string_table::iterator it = range.first; it != range.second; ++it) {
+        char const* held = it->second;
+        if (reinterpret_cast<string_prefix const*>(held - sizeof(string_prefix))->length_ == length
+            && memcmp(held, text, length) == 0)
+            return held;
+    }
+    strings_.insert(std::make_pair(h, text));
+    return text;
+}
+
+void dedupe(value& root)
+{
+    deduper().run(root);
+}
+
 // class path_argument
 // //////////////////////////////////////////////////////////////////
 
@@ -1422,6 +1929,7 @@ path_argument::path_argument()
     : key_()
     , index_()
     , kind_(kind_none)
+    , position_(0)
 {
 }
 
@@ -1429,6 +1937,7 @@ path_argument::path_argument(array_index index)
     : key_()
     , index_(index)
     , kind_(kind_index)
+    , position_(0)
 {
 }
 
@@ -1436,13 +1945,15 @@ path_argument::path_argument(const char* key)
     : key_(key)
     , index_()
     , kind_(kind_key)
+    , position_(0)
 {
 }
 
 path_argument::path_argument(std::string const& key)
-    : key_(key.c_str())
+    : key_(key)
     , index_()
     , kind_(kind_key)
+    , position_(0)
 {
 }
 
@@ -1467,25 +1978,35 @@ path::path(std::string const& path,
 
 void path::make_path(std::string const& path, in_args const& in)
 {
-    const char* current = path.c_str();
+    const char* begin = path.c_str();
+    const char* current = begin;
     const char* end = current + path.length();
     in_args::const_iterator it_in_arg = in.begin();
     while (current != end) {
+        size_t position = size_t(current - begin);
         if (*current == '[') {
             ++current;
-            if (*current == '%')
-                add_path_in_arg(path, in, it_in_arg, path_argument::kind_index);
+            if (current != end && *current == '%') {
+                add_path_in_arg(path, in, it_in_arg, path_argument::kind_index, position);
+                ++current;
+            }
             else {
-                array_index index = 0;
-                for (; current != end && *current >= '0' && *current <= '9'; ++current)
+                if (current == end || *current < '0' || *current > '9')
+                    invalidPath(path, size_t(current - begin), "an index");
+                largest_uint_t index = 0;
+                for (; current != end && *current >= '0' && *current <= '9'; ++current) {
                     index = index * 10 + array_index(*current - '0');
-                args_.push_back(index);
+                    if (index > value::max_uint)
+                        invalidPath(path, position + 1, "an index that fits in array_index");
+                }
+                args_.push_back(array_index(index));
+                args_.back().position_ = position;
             }
             if (current == end || *current++ != ']')
-                invalidPath(path, int(current - path.c_str()));
+                invalidPath(path, size_t(current - begin), "']'");
         }
         else if (*current == '%') {
-            add_path_in_arg(path, in, it_in_arg, path_argument::kind_key);
+            add_path_in_arg(path, in, it_in_arg, path_argument::kind_key, position);
             ++current;
         }
         else if (*current == '.') {
@@ -1496,75 +2017,101 @@ void path::make_path(std::string const& path, in_args const& in)
             while (current != end && !strchr("[.", *current))
                 ++current;
             args_.push_back(std::string(begin_name, current));
+            args_.back().position_ = position;
         }
     }
 }
 
-void path::add_path_in_arg(std::string const& /*path*/,
+void path::add_path_in_arg(std::string const& path,
     in_args const& in,
     in_args::const_iterator& it_in_arg,
-    path_argument::kind kind)
+    path_argument::kind kind,
+    size_t position)
 {
-    if (it_in_arg == in.end()) {
-        // Error: missing argument %d
-    }
-    else if ((*it_in_arg)->kind_ != kind) {
-        // Error: bad argument type
+    std::ostringstream oss;
+    if (it_in_arg == in.end() || (*it_in_arg)->kind_ == path_argument::kind_none) {
+        oss << "Missing argument for '%' at " << position << " of path \"" << path << "\"";
+        throw_runtime_error(oss.str());
     }
-    else {
-        args_.push_back(**it_in_arg);
+    if ((*it_in_arg)->kind_ != kind) {
+        oss << "The argument for '%' at " << position << " of path \"" << path << "\" must be "
+            << (kind == path_argument::kind_index ? "an index" : "a key");
+        throw_runtime_error(oss.str());
     }
+    args_.push_back(**it_in_arg);
+    args_.back().position_ = position;
+    ++it_in_arg;
 }
 
-void path::invalidPath(std::string const& /*path*/, int /*location*/)
+void path::invalidPath(std::string const& path, size_t location, char const* expected)
 {
-    // Error: invalid path.
+    std::ostringstream oss;
+    oss << "Invalid path \"" << path << "\": expected " << expected << " at " << location;
+    throw_runtime_error(oss.str());
 }
 
-value const& path::resolve(value const& root) const
+// One step down from 'node', or NULL.
+value const* path::step(value const& node, path_argument const& arg)
+{
+    if (arg.kind_ == path_argument::kind_index) {
+        if (!node.is_array() || !node.is_valid_index(arg.index_))
+            return NULL;
+        return &node[arg.index_];
+    }
+    if (!node.is_object())
+        return NULL;
+    return node.find(arg.key_.data(), arg.key_.data() + arg.key_.size());
+}
+
+value const* path::find(value const& root, std::string* errs) const
 {
-    const value* node = &root;
+    value const* node = &root;
     for (Args::const_iterator it = args_.begin(); it != args_.end(); ++it) {
         path_argument const& arg = *it;
-        if (arg.kind_ == path_argument::kind_index) {
-            if (!node->is_array() || !node->is_valid_index(arg.index_)) {
-                // Error: unable to resolve path (array value expected at position...
-            }
-            node = &((*node)[arg.index_]);
-        }
-        else if (arg.kind_ == path_argument::kind_key) {
-            if (!node->is_object()) {
-                // Error: unable to resolve path (object value expected at position...)
-            }
-            node = &((*node)[arg.key_]);
-            if (node == &value::null_ref) {
-                // Error: unable to resolve path (object has no member named '' at
-                // position...)
+        value const* next = step(*node, arg);
+        if (!next) {
+            if (errs) {
+                std::ostringstream oss;
+                oss << "Unable to resolve path at " << arg.position_ << ": ";
+                if (arg.kind_ == path_argument::kind_index && !node->is_array())
+                    oss << "array value expected";
+                else if (arg.kind_ == path_argument::kind_index)
+                    oss << "index " << arg.index_ << " is out of range";
+                else if (!node->is_object())
+                    oss << "object value expected";
+                else
+                    oss << "object has no member named '" << arg.key_ << "'";
+                *errs = oss.str();
             }
+            return NULL;
         }
+        node = next;
     }
-    return *node;
+    return node;
 }
 
-value path::resolve(value const& root, value const& default_value) const
+void path::find(value const* const* roots, size_t count, value const** found) const
 {
-    const value* node = &root;
+    std::copy(roots, roots + count, found);
     for (Args::const_iterator it = args_.begin(); it != args_.end(); ++it) {
         path_argument const& arg = *it;
-        if (arg.kind_ == path_argument::kind_index) {
-            if (!node->is_array() || !node->is_valid_index(arg.index_))
-                return default_value;
-            node = &((*node)[arg.index_]);
-        }
-        else if (arg.kind_ == path_argument::kind_key) {
-            if (!node->is_object())
-                return default_value;
-            node = &((*node)[arg.key_]);
-            if (node == &value::null_ref)
-                return default_value;
+        for (size_t index = 0; index != count; ++index) {
+            if (found[index])
+                found[index] = step(*found[index], arg);
         }
     }
-    return *node;
+}
+
+value const& path::resolve(value const& root) const
+{
+    value const* found = find(root);
+    return found ? *found : value::null_ref;
+}
+
+value path::resolve(value const& root, value const& default_value) const
+{
+    value const* found = find(root);
+    return found ? *found : default_value;
 }
 
 value& path::make(value& root) const
@@ -1573,16 +2120,20 @@ value& path::make(value& root) const
     for (Args::const_iterator it = args_.begin(); it != args_.end(); ++it) {
         path_argument const& arg = *it;
         if (arg.kind_ == path_argument::kind_index) {
-            if (!node->is_array()) {
-                // Error: node is not an array at position ...
+            if (!node->is_array() && !node->is_null()) {
+                std::ostringstream oss;
+                oss << "in json::path::make(): array value expected at " << arg.position_;
+                throw_logic_error(oss.str());
             }
             node = &((*node)[arg.index_]);
         }
         else if (arg.kind_ == path_argument::kind_key) {
-            if (!node->is_object()) {
-                // Error: node is not an object at position...
+            if (!node->is_object() && !node->is_null()) {
+                std::ostringstream oss;
+                oss << "in json::path::make(): object value expected at " << arg.position_;
+                throw_logic_error(oss.str());
             }
-            node = &((*node)[arg.key_]);
+            node = node->demand(arg.key_.data(), arg.key_.data() + arg.key_.size());
         }
     }
     return *node;
@@ -8,6 +8,7 @@
 #include <string>
 #include <vector>
 #include <exception>
+#include <functional> // std::hash
 
 #include <map>
 
@@ -133,6 +134,10 @@ private:
  */
 class JSON_API value {
 	friend class value_iterator_base;
+	friend class deduper;
+	friend class reader;
+	friend class our_reader;
+	friend class value_sink;
 
 public:
 	typedef std::vector<std::string> members;
@@ -188,6 +193,8 @@ private:
 		char const* data() const;
 		unsigned length() const;
 		bool is_static_string() const;
+		/// Hold the equal name at 'data', of another czstring, instead.
+		void share(char const* data);
 
 	private:
 		void swap(czstring& other);
@@ -197,7 +204,7 @@ private:
 			unsigned length_ : 30; // 1GB max
 		};
 
-		char const* cstr_; // actually, a prefixed string, unless policy is noDup
+		char const* cstr_; // actually, the text of a prefixed string, unless policy is noDup
 		union {
 			array_index index_;
 			string_storage storage_;
@@ -252,11 +259,20 @@ json::value obj_value(json::vt_object); // {}
 	value(static_string const& value);
 	value(std::string const& value); ///< Copy data() til size(). Embedded zeroes too.
 	value(bool value);
-	/// Deep copy.
+	/** Copy. The copy shares the elements or members, and the string, of
+	 * 'other' (see is_shared()), until either changes, so it takes constant
+	 * time for a document as the readers make it.
+	 *
+	 * An array or object that handed out a reference or an iterator to what
+	 * is in it, through a non-const member like operator[](), append() or
+	 * begin(), is copied in full instead: what is in it may still change
+	 * through those, and the copy must not. So are values that keep their
+	 * source text (see set_source()).
+	 */
 	value(value const& other);
 	~value();
 
-	/// Deep copy, then swap(other).
+	/// Copy, then swap(other).
 	/// \note Over-write existing comments. To preserve comments, use #swap_payload().
 	value& operator=(value other);
 	/// Swap everything.
@@ -271,6 +287,8 @@ json::value obj_value(json::vt_object); // {}
 	bool operator<=(value const& other) const;
 	bool operator>=(value const& other) const;
 	bool operator>(value const& other) const;
+	/// false at once if both values have a cached hash (see cache_hash()),
+	/// and they differ.
 	bool operator==(value const& other) const;
 	bool operator!=(value const& other) const;
 	int compare(value const& other) const;
@@ -413,7 +431,7 @@ json::value obj_value(json::vt_object); // {}
 	/// most general and efficient version of object-mutators.
 	/// \note As stated elsewhere, behavior is undefined if (end-key) >= 2^30
 	/// \return non-zero, but JSON_ASSERT if this is neither object nor vt_null.
-	value const* demand(char const* key, char const* end);
+	value* demand(char const* key, char const* end);
 	/// \brief Remove and return the named member.
 	///
 	/// Do nothing if it did not exist.
@@ -440,7 +458,7 @@ json::value obj_value(json::vt_object); // {}
 	bool remove_member(const char* key, const char* end, value* removed);
 	/** \brief Remove the indexed array element.
 
-	  O(n) expensive operations.
+	  O(n): the elements after it are swapped down, not copied.
 	  Update 'removed' iff removed.
 	  \return true iff removed (no exceptions)
   */
@@ -474,6 +492,66 @@ json::value obj_value(json::vt_object); // {}
 
 	std::string toStyledString() const;
 
+	/// \name Cached text
+	/// For writers that memoize the text of containers (see the "cache"
+	/// setting of stream_writer_builder). Every non-const member function
+	/// drops the text cached for its value, since it may change the value or
+	/// hand out a way to change it. Reaching a child through operator[] thus
+	/// drops the caches of all its ancestors on the way. A child changed
+	/// through a reference obtained before its ancestors were last written
+	/// does not: get references anew, or call drop_cached_text() on each
+	/// ancestor.
+	///@{
+	/// \return the text cached under 'key', or NULL.
+	std::string const* cached_text(std::string const& key) const;
+	/// Cache 'text' under 'key', replacing what was cached; 'text' is emptied.
+	void set_cached_text(std::string const& key, std::string& text) const;
+	void drop_cached_text();
+	///@}
+
+	/// \name Structural hash
+	/// hash() is consistent with operator==: equal values hash the same.
+	/// Members of objects are combined in a way that does not depend on their
+	/// order, elements of arrays in one that does. Comments and offsets do not
+	/// count. The hash is the same on every platform and in every run, so it
+	/// may be stored.
+	///@{
+	uint64_t hash() const;
+	/** Keep hash() in this value, for hash() and operator== to use, until it
+	 * changes. What counts as a change is what drops cached_text(). Meant for
+	 * the large containers that are hashed or compared often, such as keys
+	 * of a hash table; hash() of a value with cached hashes in it uses them.
+	 */
+	void cache_hash() const;
+	///@}
+
+	/** true if the elements or members of this array or object are shared
+	 * with other values (see the copy constructor, and dedupe()). Changing
+	 * this value copies them first, but not what is in them, which stays
+	 * shared: only the values on the way to what changes are copied.
+	 */
+	bool is_shared() const;
+
+	/// \name Source text
+	/// Kept by char_reader_builder with "keep_source", so that writers can
+	/// copy the text of unchanged values from it instead of writing them
+	/// anew. What counts as a change is what drops cached_text(); values
+	/// that are copied, swapped, or moved into another value by assignment
+	/// do not take their source text along.
+	///@{
+	/** \brief Keep a copy of [begin, end), and mark this value and every value
+	 * in it as unchanged from it.
+	 * \pre The offsets of these values are those of [begin, end), as after
+	 *      char_reader::parse().
+	 */
+	void set_source(char const* begin, char const* end);
+	/// \return true, with the text kept by set_source() on this value.
+	bool get_source(char const** begin, char const** end) const;
+	/// true if the text at [get_offset_start(), get_offset_limit()) of the
+	/// source kept by the document is still that of this value.
+	bool is_from_source() const;
+	///@}
+
 	const_iterator begin() const;
 	const_iterator end() const;
 
@@ -502,6 +580,29 @@ private:
 		char* comment_;
 	};
 
+	// What few values have, allocated when first needed.
+	struct extra_info {
+		comment_info comments_[number_of_comment_placement];
+		std::string cache_key_; // empty if no text is cached
+		std::string cache_text_;
+		std::string source_;
+		uint64_t hash_;
+		bool has_hash_; // hash_ is hash()
+	};
+
+	// The members or elements of a value, with a count of the values that
+	// hold them.
+	struct shared_values;
+
+	extra_info& extras() const;
+	void touch();
+	void drop_derived();
+	void own();
+	void leak();
+	void set_shareable();
+	void mark_source();
+	void forget_source();
+
 	// struct MemberNamesTransform
 	//{
 	//   typedef const char *result_type;
@@ -516,13 +617,15 @@ private:
 		largest_uint_t uint_;
 		double real_;
 		bool bool_;
-		char* string_; // actually ptr to unsigned, followed by str, unless !allocated_
-		object_values* map_;
+		char* string_; // actually ptr to a count and a length, followed by str, unless !allocated_
+		shared_values* map_;
 	} value_;
 	value_type type_ : 8;
 	unsigned int allocated_ : 1; // Notes: if declared as bool, bitfield is useless.
+	unsigned int from_source_ : 1; // see is_from_source()
+	unsigned int has_source_parts_ : 1; // this value or values in it may be from_source_
 	// If not allocated_, string_ must be null-terminated.
-	comment_info* comments_;
+	mutable extra_info* extras_; // for the cached text of const values
 
 	// [start, limit) byte offsets in the source JSON text from which this value
 	// was extracted.
@@ -530,12 +633,38 @@ private:
 	size_t limit_;
 };
 
+/** \brief Make the equal subtrees and strings of 'root' share one copy.
+ *
+ * Documents that repeat themselves, such as arrays of records with the same
+ * member names, or with the same nested values, take much less memory after:
+ * - strings and member names with the same text share one copy of it;
+ * - arrays and objects that are equal, down to the type of every number,
+ *   share their elements or members (see value::is_shared()).
+ *
+ * Nothing changes for those who read 'root'. A shared array or object is
+ * copied when a value that holds it is changed, so that the others are not;
+ * only its elements or members are, not what is in them. Arrays and objects
+ * with comments in them are not shared. The offsets of the values in a
+ * shared array or object are those of the first of its holders.
+ *
+ * References and iterators obtained before stay good, and changing a value
+ * through one changes that value only: an array or object that handed one
+ * out through a non-const member (see value(value const&)) keeps its own
+ * elements or members. So a document built by hand shares only its strings
+ * and the containers it was not reached through; one as the readers make
+ * it shares everything equal.
+ *
+ * Takes time about proportional to the size of 'root', once.
+ */
+void JSON_API dedupe(value& root);
+
 /** \brief Experimental and untested: represents an element of the "path" to
  * access a node.
  */
 class JSON_API path_argument {
 public:
 	friend class path;
+	friend class extractor;
 
 	path_argument();
 	path_argument(array_index index);
@@ -551,9 +680,10 @@ private:
 	std::string key_;
 	array_index index_;
 	kind kind_;
+	size_t position_; // in the text of the path, for errors
 };
 
-/** \brief Experimental and untested: represents a "path" to access a node.
+/** \brief Represents a "path" to access a node.
  *
  * Syntax:
  * - "." => root node
@@ -563,9 +693,15 @@ private:
  * - ".[0][1][2].name1[3]"
  * - ".%" => member name is provided as parameter
  * - ".[%]" => index is provied as parameter
+ *
+ * The text is parsed once, by the constructor: indices are decoded, and
+ * keys are kept with their length, so that following a path does neither
+ * strlen() nor allocate. Build a path once and use it on many documents.
  */
 class JSON_API path {
 public:
+	/// \throw std::runtime_error if 'path' is not valid, or the arguments do
+	///        not match its '%'s.
 	path(std::string const& path,
 		path_argument const& a1 = path_argument(),
 		path_argument const& a2 = path_argument(),
@@ -573,13 +709,27 @@ public:
 		path_argument const& a4 = path_argument(),
 		path_argument const& a5 = path_argument());
 
+	/// The node at this path in 'root', or value::null_ref if there is none.
 	value const& resolve(value const& root) const;
 	value resolve(value const& root, value const& default_value) const;
+	/** The node at this path in 'root', or NULL if there is none. Does not
+	 *  allocate, unless it fails and 'errs' is not NULL: *errs then says
+	 *  which step of the path failed, and why.
+	 */
+	value const* find(value const& root, std::string* errs = NULL) const;
+	/** find() in 'count' documents at once: found[i] is find(*roots[i]).
+	 *  All documents take each step of the path together.
+	 */
+	void find(value const* const* roots, size_t count, value const** found) const;
 	/// Creates the "path" to access the specified node and returns a reference on
 	/// the node.
+	/// \throw std::logic_error if a node on the way is neither null nor of the
+	///        type the path needs.
 	value& make(value& root) const;
 
 private:
+	friend class extractor;
+
 	typedef std::vector<const path_argument*> in_args;
 	typedef std::vector<path_argument> Args;
 
@@ -587,8 +737,10 @@ private:
 	void add_path_in_arg(std::string const& path,
 		in_args const& in,
 		in_args::const_iterator& it_in_arg,
-		path_argument::kind kind);
-	void invalidPath(std::string const& path, int location);
+		path_argument::kind kind,
+		size_t position);
+	void invalidPath(std::string const& path, size_t location, char const* expected);
+	static value const* step(value const& node, path_argument const& arg);
 
 	Args args_;
 };
@@ -767,6 +919,12 @@ namespace std {
 /// Specialize std::swap() for json::value.
 template <>
 inline void swap(json::value& a, json::value& b) { a.swap(b); }
+
+/// So that a json::value can be the key of a std::unordered_map.
+template <>
+struct hash<json::value> {
+	size_t operator()(json::value const& v) const { return size_t(v.hash()); }
+};
 }
 
 #if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
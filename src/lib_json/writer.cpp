@@ -3,14 +3,19 @@
 
 #include "writer.h"
 #include "tool.h"
-#include <iomanip>
+#include "assertions.h"
+#include "structural_index.h"
 #include <memory>
 #include <sstream>
 #include <utility>
 #include <set>
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <cstdio>
+#include <exception>
+#include <system_error>
+#include <thread>
 
 #if defined(_MSC_VER) && _MSC_VER >= 1200 && _MSC_VER < 1800 // Between VC++ 6.0 and VC++ 11.0
 #include <float.h>
@@ -42,26 +47,6 @@ typedef std::unique_ptr<stream_writer> StreamwriterPtr;
 typedef std::auto_ptr<stream_writer> StreamwriterPtr;
 #endif
 
-static bool contains_control_char(const char* str)
-{
-    while (*str) {
-        if (is_control_char(*(str++)))
-            return true;
-    }
-    return false;
-}
-
-static bool contains_control_char0(const char* str, unsigned len)
-{
-    char const* end = str + len;
-    while (end != str) {
-        if (is_control_char(*str) || 0 == *str)
-            return true;
-        ++str;
-    }
-    return false;
-}
-
 std::string value_to_string(largest_int_t value)
 {
     uint_to_string_buffer buffer;
@@ -99,11 +84,9 @@ std::string value_to_string(uint32_t value)
 
 #endif // # if defined(JSON_HAS_INT64)
 
-std::string value_to_string(double value)
+// Print 'value' into 'buffer', returning its length.
+static int double_to_buffer(double value, char (&buffer)[32])
 {
-    // allocate a buffer that is more than large enough to store the 16 digits of
-    // precision requested below.
-    char buffer[32];
     int len = -1;
 
 // Print into the buffer. We need not request the alternative representation
@@ -137,150 +120,124 @@ std::string value_to_string(double value)
 #endif
     assert(len >= 0);
     fix_numeric_locale(buffer, buffer + len);
+    return len;
+}
+
+std::string value_to_string(double value)
+{
+    // allocate a buffer that is more than large enough to store the 16 digits of
+    // precision requested below.
+    char buffer[32];
+    double_to_buffer(value, buffer);
     return buffer;
 }
 
 std::string value_to_string(bool value) { return value ? "true" : "false"; }
 
-std::string value_to_quoted_string(const char* value)
+// Escape sequences of the control characters, by value.
+static char const* const control_escapes[0x20] = {
+    "\\u0000", "\\u0001", "\\u0002", "\\u0003", "\\u0004", "\\u0005", "\\u0006", "\\u0007",
+    "\\b", "\\t", "\\n", "\\u000B", "\\f", "\\r", "\\u000E", "\\u000F",
+    "\\u0010", "\\u0011", "\\u0012", "\\u0013", "\\u0014", "\\u0015", "\\u0016", "\\u0017",
+    "\\u0018", "\\u0019", "\\u001A", "\\u001B", "\\u001C", "\\u001D", "\\u001E", "\\u001F"
+};
+
+// Copies the runs that need no escaping in one go, between the characters
+// that find_char_to_escape() stops at.
+// (Note: forward slashes are *not* escaped. Even though \/ is a legal escape
+// in JSON, a bare slash is also legal. blep notes: escaping \/ may be useful
+// in javascript to avoid the </ sequence; a flag could allow it.)
+static std::string value_to_quoted_string_n(const char* value, unsigned length)
 {
     if (value == NULL)
         return "";
-    // Not sure how to handle unicode...
-    if (strpbrk(value, "\"\\\b\f\n\r\t") == NULL && !contains_control_char(value))
-        return std::string("\"") + value + "\"";
-    // We have to walk value and escape any special characters.
-    // Appending to std::string is not efficient, but this should be rare.
-    // (Note: forward slashes are *not* rare, but I am not escaping them.)
-    std::string::size_type maxsize = strlen(value) * 2 + 3; // allescaped+quotes+NULL
     std::string result;
-    result.reserve(maxsize); // to avoid lots of mallocs
-    result += "\"";
-    for (const char* c = value; *c != 0; ++c) {
-        switch (*c) {
-        case '\"':
-            result += "\\\"";
-            break;
-        case '\\':
-            result += "\\\\";
-            break;
-        case '\b':
-            result += "\\b";
-            break;
-        case '\f':
-            result += "\\f";
-            break;
-        case '\n':
-            result += "\\n";
-            break;
-        case '\r':
-            result += "\\r";
-            break;
-        case '\t':
-            result += "\\t";
-            break;
-        // case '/':
-        // Even though \/ is considered a legal escape in JSON, a bare
-        // slash is also legal, so I see no reason to escape it.
-        // (I hope I am not misunderstanding something.
-        // blep notes: actually escaping \/ may be useful in javascript to avoid </
-        // sequence.
-        // Should add a flag to allow this compatibility mode and prevent this
-        // sequence from occurring.
-        default:
-            if (is_control_char(*c)) {
-                std::ostringstream oss;
-                oss << "\\u" << std::hex << std::uppercase << std::setfill('0')
-                    << std::setw(4) << static_cast<int>(*c);
-                result += oss.str();
-            }
-            else {
-                result += *c;
-            }
+    result.reserve(length + 2); // enough unless something is escaped
+    result += '"';
+    char const* end = value + length;
+    for (char const* current = value;;) {
+        char const* run_end = find_char_to_escape(current, end);
+        result.append(current, run_end - current);
+        if (run_end == end)
             break;
-        }
+        unsigned char c = static_cast<unsigned char>(*run_end);
+        if (c < 0x20)
+            result += control_escapes[c];
+        else
+            result += c == '"' ? "\\\"" : "\\\\";
+        current = run_end + 1;
     }
-    result += "\"";
+    result += '"';
     return result;
 }
 
-// https://github.com/upcaste/upcaste/blob/master/src/upcore/src/cstring/strnpbrk.cpp
-static char const* strnpbrk(char const* s, char const* accept, size_t n)
+std::string value_to_quoted_string(const char* value)
 {
-    assert((s || !n) && accept);
+    if (value == NULL)
+        return "";
+    return value_to_quoted_string_n(value, static_cast<unsigned>(strlen(value)));
+}
 
-    char const* const end = s + n;
-    for (char const* cur = s; cur < end; ++cur) {
-        int const c = *cur;
-        for (char const* a = accept; *a; ++a) {
-            if (*a == c) {
-                return cur;
-            }
-        }
-    }
-    return NULL;
+std::string value_to_quoted_string(const char* value, unsigned length)
+{
+    return value_to_quoted_string_n(value, length);
 }
-static std::string value_to_quoted_string_n(const char* value, unsigned length)
+
+// Lengths of the strings above, found without making them.
+
+static size_t string_size(largest_uint_t value)
+{
+    size_t size = 1;
+    for (; value >= 10; value /= 10)
+        ++size;
+    return size;
+}
+
+static size_t string_size(largest_int_t value)
+{
+    if (value >= 0)
+        return string_size(largest_uint_t(value));
+    return 1 + string_size(largest_uint_t(0) - largest_uint_t(value));
+}
+
+static size_t string_size(double value)
+{
+    char buffer[32];
+    return double_to_buffer(value, buffer);
+}
+
+static size_t quoted_string_size(const char* value, size_t length)
 {
     if (value == NULL)
-        return "";
-    // Not sure how to handle unicode...
-    if (strnpbrk(value, "\"\\\b\f\n\r\t", length) == NULL && !contains_control_char0(value, length))
-        return std::string("\"") + value + "\"";
-    // We have to walk value and escape any special characters.
-    // Appending to std::string is not efficient, but this should be rare.
-    // (Note: forward slashes are *not* rare, but I am not escaping them.)
-    std::string::size_type maxsize = length * 2 + 3; // allescaped+quotes+NULL
-    std::string result;
-    result.reserve(maxsize); // to avoid lots of mallocs
-    result += "\"";
+        return 0;
+    size_t size = length + 2;
     char const* end = value + length;
-    for (const char* c = value; c != end; ++c) {
-        switch (*c) {
-        case '\"':
-            result += "\\\"";
-            break;
-        case '\\':
-            result += "\\\\";
-            break;
-        case '\b':
-            result += "\\b";
-            break;
-        case '\f':
-            result += "\\f";
+    for (char const* current = value;;) {
+        current = find_char_to_escape(current, end);
+        if (current == end)
             break;
-        case '\n':
-            result += "\\n";
-            break;
-        case '\r':
-            result += "\\r";
-            break;
-        case '\t':
-            result += "\\t";
-            break;
-        // case '/':
-        // Even though \/ is considered a legal escape in JSON, a bare
-        // slash is also legal, so I see no reason to escape it.
-        // (I hope I am not misunderstanding something.)
-        // blep notes: actually escaping \/ may be useful in javascript to avoid </
-        // sequence.
-        // Should add a flag to allow this compatibility mode and prevent this
-        // sequence from occurring.
-        default:
-            if ((is_control_char(*c)) || (*c == 0)) {
-                std::ostringstream oss;
-                oss << "\\u" << std::hex << std::uppercase << std::setfill('0')
-                    << std::setw(4) << static_cast<int>(*c);
-                result += oss.str();
-            }
-            else {
-                result += *c;
-            }
-            break;
-        }
+        unsigned char c = static_cast<unsigned char>(*current);
+        size += (c < 0x20 ? strlen(control_escapes[c]) : 2) - 1;
+        ++current;
+    }
+    return size;
+}
+
+// Length of a value that is neither a string nor a container.
+static size_t scalar_size(value const& value, size_t null_size)
+{
+    switch (value.type()) {
+    case vt_int:
+        return string_size(value.as_largest_int());
+    case vt_uint:
+        return string_size(value.as_largest_uint());
+    case vt_real:
+        return string_size(value.as_double());
+    case vt_bool:
+        return value.as_bool() ? 4 : 5;
+    default:
+        return null_size;
     }
-    result += "\"";
-    return result;
 }
 
 // Class writer
@@ -291,7 +248,8 @@ writer::~writer() {}
 // //////////////////////////////////////////////////////////////////
 
 fast_writer::fast_writer()
-    : yaml_compatibility_enabled_(false)
+    : source_(NULL)
+    , yaml_compatibility_enabled_(false)
     , drop_null_placeholders_(false)
     , omit_ending_line_feed_(false)
 {
@@ -305,7 +263,8 @@ void fast_writer::omit_ending_line_feed() { omit_ending_line_feed_ = true; }
 
 std::string fast_writer::write(value const& root)
 {
-    document_ = "";
+    document_.clear();
+    source_ = source_of(root);
     write_value(root);
     if (!omit_ending_line_feed_)
         document_ += "\n";
@@ -314,6 +273,11 @@ std::string fast_writer::write(value const& root)
 
 void fast_writer::write_value(value const& value)
 {
+    if (source_ && value.is_from_source()) {
+        document_.append(source_ + value.get_offset_start(),
+            value.get_offset_limit() - value.get_offset_start());
+        return;
+    }
     switch (value.type()) {
     case vt_null:
         if (!drop_null_placeholders_)
@@ -361,6 +325,198 @@ void fast_writer::write_value(value const& value)
     }
 }
 
+size_t fast_writer::serialized_size(value const& root) const
+{
+    return value_size(root, source_of(root)) + (omit_ending_line_feed_ ? 0 : 1);
+}
+
+// The source kept with 'root', if the text of its unchanged values is what
+// this writer would write for them.
+char const* fast_writer::source_of(value const& root) const
+{
+    char const* begin;
+    char const* end;
+    if (yaml_compatibility_enabled_ || drop_null_placeholders_ || !root.get_source(&begin, &end))
+        return NULL;
+    return begin;
+}
+
+size_t fast_writer::value_size(value const& value, char const* source) const
+{
+    if (source && value.is_from_source())
+        return value.get_offset_limit() - value.get_offset_start();
+    switch (value.type()) {
+    case vt_string: {
+        char const* str = value.as_cstring();
+        return str ? quoted_string_size(str, strlen(str)) : 0;
+    }
+    case vt_array: {
+        size_t size = value.size();
+        size_t total = 2 + (size ? size - 1 : 0);
+        for (value::array_index index = 0; index < size; ++index)
+            total += value_size(value[index], source);
+        return total;
+    }
+    case vt_object: {
+        size_t colon_size = yaml_compatibility_enabled_ ? 2 : 1;
+        size_t total = 2;
+        for (value::const_iterator it = value.begin(); it != value.end(); ++it) {
+            char const* end;
+            char const* name = it.member_name(&end);
+            if (it != value.begin())
+                ++total;
+            total += quoted_string_size(name, end - name) + colon_size + value_size(*it, source);
+        }
+        return total;
+    }
+    default:
+        return scalar_size(value, drop_null_placeholders_ ? 0 : 4);
+    }
+}
+
+// Class gather_writer
+// //////////////////////////////////////////////////////////////////
+
+gather_writer::gather_writer(size_t min_reference_size)
+    : source_(NULL)
+    , min_reference_size_(min_reference_size)
+    , size_(0)
+{
+}
+
+void gather_writer::write(value const& root)
+{
+    runs_.clear();
+    scratch_.clear();
+    pieces_.clear();
+    char const* end;
+    if (!root.get_source(&source_, &end))
+        source_ = NULL;
+    write_value(root);
+    pieces_.reserve(runs_.size());
+    for (size_t index = 0; index != runs_.size(); ++index) {
+        run const& run = runs_[index];
+        piece piece = { run.external_ ? run.external_ : scratch_.data() + run.begin_, run.size_ };
+        pieces_.push_back(piece);
+    }
+    size_ = scratch_.size();
+    for (size_t index = 0; index != runs_.size(); ++index) {
+        if (runs_[index].external_)
+            size_ += runs_[index].size_;
+    }
+}
+
+std::string gather_writer::str() const
+{
+    std::string text;
+    text.reserve(size_);
+    for (size_t index = 0; index != pieces_.size(); ++index)
+        text.append(pieces_[index].data_, pieces_[index].size_);
+    return text;
+}
+
+void gather_writer::copy(char const* data, size_t size)
+{
+    if (runs_.empty() || runs_.back().external_) {
+        run run = { NULL, scratch_.size(), 0 };
+        runs_.push_back(run);
+    }
+    scratch_.append(data, size);
+    runs_.back().size_ += size;
+}
+
+void gather_writer::reference(char const* data, size_t size)
+{
+    run run = { data, 0, size };
+    runs_.push_back(run);
+}
+
+void gather_writer::copy_or_reference(char const* data, size_t size)
+{
+    if (size >= min_reference_size_ && size != 0)
+        reference(data, size);
+    else
+        copy(data, size);
+}
+
+void gather_writer::write_value(value const& value)
+{
+    if (source_ && value.is_from_source()) {
+        copy_or_reference(source_ + value.get_offset_start(),
+            value.get_offset_limit() - value.get_offset_start());
+        return;
+    }
+    switch (value.type()) {
+    case vt_null:
+        copy("null", 4);
+        break;
+    case vt_int: {
+        std::string const text = value_to_string(value.as_largest_int());
+        copy(text.data(), text.size());
+    } break;
+    case vt_uint: {
+        std::string const text = value_to_string(value.as_largest_uint());
+        copy(text.data(), text.size());
+    } break;
+    case vt_real: {
+        char buffer[32];
+        copy(buffer, double_to_buffer(value.as_double(), buffer));
+    } break;
+    case vt_string: {
+        char const* str;
+        char const* end;
+        if (value.get_string(&str, &end))
+            write_string(str, end);
+    } break;
+    case vt_bool:
+        if (value.as_bool())
+            copy("true", 4);
+        else
+            copy("false", 5);
+        break;
+    case vt_array: {
+        copy("[", 1);
+        array_index size = value.size();
+        for (array_index index = 0; index < size; ++index) {
+            if (index > 0)
+                copy(",", 1);
+            write_value(value[index]);
+        }
+        copy("]", 1);
+    } break;
+    case vt_object: {
+        copy("{", 1);
+        for (value::const_iterator it = value.begin(); it != value.end(); ++it) {
+            if (it != value.begin())
+                copy(",", 1);
+            char const* end;
+            char const* name = it.member_name(&end);
+            write_string(name, end);
+            copy(":", 1);
+            write_value(*it);
+        }
+        copy("}", 1);
+    } break;
+    }
+}
+
+// Like value_to_quoted_string_n(), but long runs are referenced.
+void gather_writer::write_string(char const* begin, char const* end)
+{
+    copy("\"", 1);
+    for (char const* current = begin;;) {
+        char const* run_end = find_char_to_escape(current, end);
+        copy_or_reference(current, run_end - current);
+        if (run_end == end)
+            break;
+        unsigned char c = static_cast<unsigned char>(*run_end);
+        char const* escape = c < 0x20 ? control_escapes[c] : c == '"' ? "\\\"" : "\\\\";
+        copy(escape, strlen(escape));
+        current = run_end + 1;
+    }
+    copy("\"", 1);
+}
+
 // Class styled_writer
 // //////////////////////////////////////////////////////////////////
 
@@ -821,84 +977,269 @@ enum class comment_style {
     all ///< Keep all comments.
 };
 
-struct built_styled_stream_writer : public stream_writer {
-    built_styled_stream_writer(
+// Appends to a string, so that the text is not copied at the end, as it
+// would be out of an ostringstream. Small writes gather in a buffer, as they
+// do in one; the string is complete once the stream is flushed.
+class string_buf : public std::streambuf {
+public:
+    explicit string_buf(std::string* out)
+        : out_(out)
+    {
+        setp(buffer_, buffer_ + sizeof buffer_);
+    }
+    ~string_buf() { sync(); }
+
+protected:
+    virtual int_type overflow(int_type c)
+    {
+        sync();
+        if (!traits_type::eq_int_type(c, traits_type::eof()))
+            sputc(traits_type::to_char_type(c));
+        return traits_type::not_eof(c);
+    }
+    virtual std::streamsize xsputn(char const* s, std::streamsize n)
+    {
+        if (n > epptr() - pptr()) {
+            sync();
+            if (n > epptr() - pptr()) {
+                out_->append(s, static_cast<size_t>(n));
+                return n;
+            }
+        }
+        memcpy(pptr(), s, static_cast<size_t>(n));
+        pbump(static_cast<int>(n));
+        return n;
+    }
+    virtual int sync()
+    {
+        out_->append(pbase(), pptr() - pbase());
+        setp(buffer_, buffer_ + sizeof buffer_);
+        return 0;
+    }
+
+private:
+    std::string* out_;
+    char buffer_[4096];
+};
+
+/// Where built_styled_stream_writer and emitter put newlines and indentation,
+/// so that both write the same text.
+struct styled_layout {
+    styled_layout(
         std::string const& indentation,
         comment_style cs,
         std::string const& colon_symbol,
-        std::string const& null_symbol,
-        std::string const& ending_linefeed_symbol);
-    virtual int write(value const& root, std::ostream* sout);
+        std::string const& null_symbol);
+    /// From the settings of a stream_writer_builder.
+    explicit styled_layout(value const& settings);
 
-private:
-    void write_value(value const& value);
-    void write_array_value(value const& value);
-    bool is_multiline_array(value const& value);
-    void push_value(std::string const& value);
-    void writeIndent();
+    void start(std::ostream* sout);
+    void write_indent();
     void write_with_indent(std::string const& value);
     void indent();
     void unindent();
-    void write_comment_before_value(value const& root);
-    void write_comment_after_value_on_same_line(value const& root);
-    static bool has_comment_for_value(value const& value);
-
-    typedef std::vector<std::string> ChildValues;
-
-    ChildValues child_values_;
-    std::string indentString_;
-    int right_margin_;
+    /// An array with that many elements is never written on one line.
+    bool too_many_for_one_line(size_t size) const;
+    /// Nor one whose elements take that many characters.
+    bool too_long_for_one_line(size_t size, size_t length) const;
+    void write_one_line_array(std::vector<std::string> const& values);
+
+    std::ostream* sout_;
+    std::string indent_string_;
     std::string indentation_;
     comment_style cs_;
     std::string colon_symbol_;
     std::string null_symbol_;
-    std::string ending_linefeed_symbol_;
-    bool add_child_values_ : 1;
-    bool indented_ : 1;
+    size_t right_margin_;
+    bool indented_;
 };
-built_styled_stream_writer::built_styled_stream_writer(
+
+styled_layout::styled_layout(
     std::string const& indentation,
     comment_style cs,
     std::string const& colon_symbol,
-    std::string const& null_symbol,
-    std::string const& ending_linefeed_symbol)
-    : right_margin_(74)
+    std::string const& null_symbol)
+    : sout_(NULL)
     , indentation_(indentation)
     , cs_(cs)
     , colon_symbol_(colon_symbol)
     , null_symbol_(null_symbol)
-    , ending_linefeed_symbol_(ending_linefeed_symbol)
-    , add_child_values_(false)
+    , right_margin_(74)
     , indented_(false)
 {
 }
-int built_styled_stream_writer::write(value const& root, std::ostream* sout)
+
+styled_layout::styled_layout(value const& settings)
+    : sout_(NULL)
+    , indentation_(settings["indentation"].as_string())
+    , cs_(comment_style::all)
+    , colon_symbol_(" : ")
+    , null_symbol_("null")
+    , right_margin_(74)
+    , indented_(false)
+{
+    std::string cs_str = settings["comment_style"].as_string();
+    bool eyc = settings["enable_yaml_compatibility"].as_bool();
+    bool dnp = settings["drop_null_placeholders"].as_bool();
+    if (cs_str == "all") {
+        cs_ = comment_style::all;
+    }
+    else if (cs_str == "none") {
+        cs_ = comment_style::none;
+    }
+    else {
+        throw_runtime_error("comment_style must be 'all' or 'none'");
+    }
+    if (eyc) {
+        colon_symbol_ = ": ";
+    }
+    else if (indentation_.empty()) {
+        colon_symbol_ = ":";
+    }
+    if (dnp) {
+        null_symbol_ = "";
+    }
+}
+
+void styled_layout::start(std::ostream* sout)
 {
     sout_ = sout;
-    add_child_values_ = false;
+    indent_string_ = "";
     indented_ = true;
-    indentString_ = "";
-    write_comment_before_value(root);
+}
+
+void styled_layout::write_indent()
+{
+    // blep intended this to look at the so-far-written string
+    // to determine whether we are already indented, but
+    // with a stream we cannot do that. So we rely on some saved state.
+    // The caller checks indented_.
+
+    if (!indentation_.empty()) {
+        // In this case, drop newlines too.
+        *sout_ << '\n' << indent_string_;
+    }
+}
+
+void styled_layout::write_with_indent(std::string const& value)
+{
     if (!indented_)
-        writeIndent();
-    indented_ = true;
-    write_value(root);
-    write_comment_after_value_on_same_line(root);
-    *sout_ << ending_linefeed_symbol_;
-    sout_ = NULL;
-    return 0;
+        write_indent();
+    *sout_ << value;
+    indented_ = false;
 }
-void built_styled_stream_writer::write_value(value const& value)
+
+void styled_layout::indent() { indent_string_ += indentation_; }
+
+void styled_layout::unindent()
 {
-    switch (value.type()) {
-    case vt_null:
-        push_value(null_symbol_);
-        break;
-    case vt_int:
-        push_value(value_to_string(value.as_largest_int()));
-        break;
-    case vt_uint:
-        push_value(value_to_string(value.as_largest_uint()));
+    assert(indent_string_.size() >= indentation_.size());
+    indent_string_.resize(indent_string_.size() - indentation_.size());
+}
+
+bool styled_layout::too_many_for_one_line(size_t size) const
+{
+    return size * 3 >= right_margin_;
+}
+
+bool styled_layout::too_long_for_one_line(size_t size, size_t length) const
+{
+    return 4 + (size - 1) * 2 + length >= right_margin_; // '[ ' + ', '*n + ' ]'
+}
+
+void styled_layout::write_one_line_array(std::vector<std::string> const& values)
+{
+    *sout_ << "[";
+    if (!indentation_.empty())
+        *sout_ << " ";
+    for (size_t index = 0; index < values.size(); ++index) {
+        if (index > 0)
+            *sout_ << ", ";
+        *sout_ << values[index];
+    }
+    if (!indentation_.empty())
+        *sout_ << " ";
+    *sout_ << "]";
+}
+
+struct built_styled_stream_writer : public stream_writer {
+    built_styled_stream_writer(
+        styled_layout const& layout,
+        std::string const& ending_linefeed_symbol,
+        int threads,
+        bool cache);
+    virtual int write(value const& root, std::ostream* sout);
+
+private:
+    struct job;
+
+    void write_value(value const& value);
+    void write_cached(value const& value);
+    void write_object_value(value const& value);
+    void write_array_value(value const& value);
+    void write_member(value const& object, std::string const& name, bool last);
+    void write_element(value const& array, unsigned index, bool last);
+    void write_children(value const& container, value::members const* members,
+        size_t begin, size_t end);
+    bool write_children_in_parallel(value const& container, value::members const* members);
+    static void run_job(job* job);
+    bool is_multiline_array(value const& value);
+    void push_value(std::string const& value);
+    void write_comment_before_value(value const& root);
+    void write_comment_after_value_on_same_line(value const& root);
+    static bool has_comment_for_value(value const& value);
+
+    typedef std::vector<std::string> ChildValues;
+
+    ChildValues child_values_;
+    styled_layout layout_;
+    std::string ending_linefeed_symbol_;
+    std::string cache_key_; // the settings, or empty to write without the cache
+    int threads_;
+    bool add_child_values_ : 1;
+};
+built_styled_stream_writer::built_styled_stream_writer(
+    styled_layout const& layout,
+    std::string const& ending_linefeed_symbol,
+    int threads,
+    bool cache)
+    : layout_(layout)
+    , ending_linefeed_symbol_(ending_linefeed_symbol)
+    , threads_(threads)
+    , add_child_values_(false)
+{
+    if (cache) {
+        cache_key_ = layout_.indentation_ + '\0' + layout_.colon_symbol_ + '\0'
+            + layout_.null_symbol_ + '\0' + (layout_.cs_ == comment_style::all ? 'a' : 'n');
+    }
+}
+int built_styled_stream_writer::write(value const& root, std::ostream* sout)
+{
+    sout_ = sout;
+    layout_.start(sout);
+    add_child_values_ = false;
+    write_comment_before_value(root);
+    if (!layout_.indented_)
+        layout_.write_indent();
+    layout_.indented_ = true;
+    write_value(root);
+    write_comment_after_value_on_same_line(root);
+    *sout_ << ending_linefeed_symbol_;
+    sout_ = NULL;
+    layout_.sout_ = NULL;
+    return 0;
+}
+void built_styled_stream_writer::write_value(value const& value)
+{
+    switch (value.type()) {
+    case vt_null:
+        push_value(layout_.null_symbol_);
+        break;
+    case vt_int:
+        push_value(value_to_string(value.as_largest_int()));
+        break;
+    case vt_uint:
+        push_value(value_to_string(value.as_largest_uint()));
         break;
     case vt_real:
         push_value(value_to_string(value.as_double()));
@@ -918,34 +1259,68 @@ void built_styled_stream_writer::write_value(value const& value)
         push_value(value_to_string(value.as_bool()));
         break;
     case vt_array:
-        write_array_value(value);
+    case vt_object:
+        if (!cache_key_.empty() && !add_child_values_ && !value.empty())
+            write_cached(value);
+        else if (value.is_array())
+            write_array_value(value);
+        else
+            write_object_value(value);
         break;
-    case vt_object: {
-        value::members members(value.get_member_names());
-        if (members.empty())
-            push_value("{}");
-        else {
-            write_with_indent("{");
-            indent();
-            value::members::iterator it = members.begin();
-            for (;;) {
-                std::string const& name = *it;
-                class value const& child_value = value[name];
-                write_comment_before_value(child_value);
-                write_with_indent(value_to_quoted_string_n(name.data(), name.length()));
-                *sout_ << colon_symbol_;
-                write_value(child_value);
-                if (++it == members.end()) {
-                    write_comment_after_value_on_same_line(child_value);
-                    break;
-                }
-                *sout_ << ",";
-                write_comment_after_value_on_same_line(child_value);
-            }
-            unindent();
-            write_with_indent("}");
-        }
-    } break;
+    }
+}
+
+// The text of a container depends on the settings, on its depth, and on
+// whether the line is already indented; its key in the cache holds all three.
+void built_styled_stream_writer::write_cached(value const& value)
+{
+    std::string const key = cache_key_ + (layout_.indented_ ? '1' : '0') + layout_.indent_string_;
+    std::string const* text = value.cached_text(key);
+    if (text) {
+        // As after writing any container but an array on one line, which
+        // leaves it alone; nothing reads it after one of those.
+        layout_.indented_ = false;
+    }
+    else {
+        std::string fresh;
+        string_buf buf(&fresh);
+        std::ostream sout(&buf);
+        std::ostream* const outer = sout_;
+        sout_ = &sout;
+        layout_.sout_ = &sout;
+        // Values in shared containers are in other documents too, which
+        // other threads may be writing: nothing is cached in them.
+        bool const shared = value.is_shared();
+        std::string inner_key;
+        if (shared)
+            inner_key.swap(cache_key_);
+        if (value.is_array())
+            write_array_value(value);
+        else
+            write_object_value(value);
+        if (shared)
+            inner_key.swap(cache_key_);
+        sout.flush();
+        sout_ = outer;
+        layout_.sout_ = outer;
+        value.set_cached_text(key, fresh);
+        text = value.cached_text(key);
+    }
+    *sout_ << *text;
+}
+
+void built_styled_stream_writer::write_object_value(value const& value)
+{
+    value::members members(value.get_member_names());
+    if (members.empty())
+        push_value("{}");
+    else {
+        layout_.write_with_indent("{");
+        layout_.indent();
+        if (!write_children_in_parallel(value, &members))
+            write_children(value, &members, 0, members.size());
+        layout_.unindent();
+        layout_.write_with_indent("}");
     }
 }
 
@@ -955,56 +1330,211 @@ void built_styled_stream_writer::write_array_value(value const& value)
     if (size == 0)
         push_value("[]");
     else {
-        bool is_multiline = (cs_ == comment_style::all) || is_multiline_array(value);
+        bool is_multiline = (layout_.cs_ == comment_style::all) || is_multiline_array(value);
         if (is_multiline) {
-            write_with_indent("[");
-            indent();
+            layout_.write_with_indent("[");
+            layout_.indent();
             bool has_child_value = !child_values_.empty();
-            unsigned index = 0;
-            for (;;) {
-                class value const& child_value = value[index];
-                write_comment_before_value(child_value);
-                if (has_child_value)
-                    write_with_indent(child_values_[index]);
-                else {
-                    if (!indented_)
-                        writeIndent();
-                    indented_ = true;
-                    write_value(child_value);
-                    indented_ = false;
-                }
-                if (++index == size) {
+            if (!has_child_value) {
+                if (!write_children_in_parallel(value, NULL))
+                    write_children(value, NULL, 0, size);
+            }
+            else {
+                for (unsigned index = 0; index != size; ++index) {
+                    class value const& child_value = value[index];
+                    write_comment_before_value(child_value);
+                    layout_.write_with_indent(child_values_[index]);
+                    if (index + 1 != size)
+                        *sout_ << ",";
                     write_comment_after_value_on_same_line(child_value);
-                    break;
                 }
-                *sout_ << ",";
-                write_comment_after_value_on_same_line(child_value);
             }
-            unindent();
-            write_with_indent("]");
+            layout_.unindent();
+            layout_.write_with_indent("]");
         }
         else // output on a single line
         {
             assert(child_values_.size() == size);
-            *sout_ << "[";
-            if (!indentation_.empty())
-                *sout_ << " ";
-            for (unsigned index = 0; index < size; ++index) {
-                if (index > 0)
-                    *sout_ << ", ";
-                *sout_ << child_values_[index];
-            }
-            if (!indentation_.empty())
-                *sout_ << " ";
-            *sout_ << "]";
+            layout_.write_one_line_array(child_values_);
+        }
+    }
+}
+
+void built_styled_stream_writer::write_member(value const& object, std::string const& name, bool last)
+{
+    class value const& child_value = object[name];
+    write_comment_before_value(child_value);
+    layout_.write_with_indent(value_to_quoted_string_n(name.data(), name.length()));
+    *sout_ << layout_.colon_symbol_;
+    write_value(child_value);
+    if (!last)
+        *sout_ << ",";
+    write_comment_after_value_on_same_line(child_value);
+}
+
+void built_styled_stream_writer::write_element(value const& array, unsigned index, bool last)
+{
+    class value const& child_value = array[index];
+    write_comment_before_value(child_value);
+    if (!layout_.indented_)
+        layout_.write_indent();
+    layout_.indented_ = true;
+    write_value(child_value);
+    layout_.indented_ = false;
+    if (!last)
+        *sout_ << ",";
+    write_comment_after_value_on_same_line(child_value);
+}
+
+// Children [begin, end) of an indented container; 'members' are the names of
+// those of an object, NULL for an array.
+void built_styled_stream_writer::write_children(value const& container,
+    value::members const* members, size_t begin, size_t end)
+{
+    size_t const size = container.size();
+    for (size_t index = begin; index != end; ++index) {
+        if (members)
+            write_member(container, (*members)[index], index + 1 == size);
+        else
+            write_element(container, static_cast<unsigned>(index), index + 1 == size);
+    }
+}
+
+// Parallel writing of large containers
+// ////////////////////////////////
+//
+// The children of a container are cut into contiguous ranges, each written by
+// a copy of the writer into a string of its own, on its own thread. Every
+// child starts on a new line at the same depth, so the copies only need the
+// indentation of the container to write what the writer itself would. The
+// first range is written on the calling thread, straight to the stream, and
+// the others follow it in order.
+//
+// A child weighs one, plus its own number of children. Containers are split
+// when they weigh enough for two jobs; until then, the writer looks for one
+// further down.
+
+// Below this weight per job, a thread costs more than it saves.
+static size_t const min_job_weight = 4096;
+
+static size_t child_weight(value const& child)
+{
+    return 1 + (child.is_array() || child.is_object() ? child.size() : 0);
+}
+
+struct built_styled_stream_writer::job {
+    built_styled_stream_writer* writer_;
+    value const* container_;
+    value::members const* members_;
+    size_t begin_;
+    size_t end_;
+    std::string text_;
+    std::exception_ptr failure_;
+};
+
+// static
+void built_styled_stream_writer::run_job(job* job)
+{
+    try {
+        built_styled_stream_writer& writer = *job->writer_;
+        if (writer.sout_) {
+            writer.write_children(*job->container_, job->members_, job->begin_, job->end_);
+            return;
+        }
+        string_buf buf(&job->text_);
+        std::ostream sout(&buf);
+        writer.sout_ = &sout;
+        writer.layout_.sout_ = &sout;
+        writer.write_children(*job->container_, job->members_, job->begin_, job->end_);
+        sout.flush();
+    }
+    catch (...) {
+        job->failure_ = std::current_exception();
+    }
+}
+
+bool built_styled_stream_writer::write_children_in_parallel(value const& container,
+    value::members const* members)
+{
+    if (threads_ == 1)
+        return false;
+    size_t const size = container.size();
+    // By index, in the order they are written: the elements an array was
+    // never given are nulls, with no map entry to step to.
+    std::vector<size_t> weights;
+    weights.reserve(size);
+    if (members) {
+        for (value::const_iterator it = container.begin(); it != container.end(); ++it)
+            weights.push_back(child_weight(*it));
+    }
+    else {
+        for (value::array_index index = 0; index < size; ++index)
+            weights.push_back(child_weight(container[index]));
+    }
+    size_t total = 0;
+    for (size_t index = 0; index != size; ++index)
+        total += weights[index];
+    size_t threads = threads_ ? size_t(threads_) : size_t(std::thread::hardware_concurrency());
+    threads = std::min(std::min(threads, size), total / min_job_weight);
+    if (threads < 2)
+        return false;
+
+    // Cut after the child that reaches each multiple of total / threads.
+    std::vector<job> jobs(1);
+    jobs[0].begin_ = 0;
+    size_t done = 0;
+    for (size_t index = 0; jobs.size() != threads && index + 1 < size; ++index) {
+        done += weights[index];
+        if (done * threads >= total * jobs.size()) {
+            jobs.back().end_ = index + 1;
+            jobs.push_back(job());
+            jobs.back().begin_ = index + 1;
+        }
+    }
+    jobs.back().end_ = size;
+
+    std::string const ending_linefeed_symbol;
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i != jobs.size(); ++i) {
+        jobs[i].container_ = &container;
+        jobs[i].members_ = members;
+        if (i == 0) {
+            jobs[i].writer_ = this;
+            continue;
+        }
+        jobs[i].writer_ = new built_styled_stream_writer(layout_, ending_linefeed_symbol, 1, false);
+        jobs[i].writer_->cache_key_ = cache_key_;
+        try {
+            workers.push_back(std::thread(run_job, &jobs[i]));
         }
+        catch (std::system_error const&) {
+            run_job(&jobs[i]); // out of threads
+        }
+    }
+    int const threads_setting = threads_;
+    threads_ = 1; // no nested splits
+    run_job(&jobs[0]);
+    threads_ = threads_setting;
+    for (size_t i = 0; i != workers.size(); ++i)
+        workers[i].join();
+
+    std::exception_ptr failure = jobs[0].failure_;
+    for (size_t i = 1; i != jobs.size(); ++i) {
+        if (!failure)
+            failure = jobs[i].failure_;
+        if (!failure)
+            *sout_ << jobs[i].text_;
+        delete jobs[i].writer_;
     }
+    if (failure)
+        std::rethrow_exception(failure);
+    return true;
 }
 
 bool built_styled_stream_writer::is_multiline_array(value const& value)
 {
     int size = value.size();
-    bool is_multiline = size * 3 >= right_margin_;
+    bool is_multiline = layout_.too_many_for_one_line(size);
     child_values_.clear();
     for (int index = 0; index < size && !is_multiline; ++index) {
         class value const& child_value = value[index];
@@ -1014,16 +1544,16 @@ bool built_styled_stream_writer::is_multiline_array(value const& value)
     {
         child_values_.reserve(size);
         add_child_values_ = true;
-        int lineLength = 4 + (size - 1) * 2; // '[ ' + ', '*n + ' ]'
+        size_t length = 0;
         for (int index = 0; index < size; ++index) {
             if (has_comment_for_value(value[index])) {
                 is_multiline = true;
             }
             write_value(value[index]);
-            lineLength += int(child_values_[index].length());
+            length += child_values_[index].length();
         }
         add_child_values_ = false;
-        is_multiline = is_multiline || lineLength >= right_margin_;
+        is_multiline = is_multiline || layout_.too_long_for_one_line(size, length);
     }
     return is_multiline;
 }
@@ -1036,65 +1566,36 @@ void built_styled_stream_writer::push_value(std::string const& value)
         *sout_ << value;
 }
 
-void built_styled_stream_writer::writeIndent()
-{
-    // blep intended this to look at the so-far-written string
-    // to determine whether we are already indented, but
-    // with a stream we cannot do that. So we rely on some saved state.
-    // The caller checks indented_.
-
-    if (!indentation_.empty()) {
-        // In this case, drop newlines too.
-        *sout_ << '\n' << indentString_;
-    }
-}
-
-void built_styled_stream_writer::write_with_indent(std::string const& value)
-{
-    if (!indented_)
-        writeIndent();
-    *sout_ << value;
-    indented_ = false;
-}
-
-void built_styled_stream_writer::indent() { indentString_ += indentation_; }
-
-void built_styled_stream_writer::unindent()
-{
-    assert(indentString_.size() >= indentation_.size());
-    indentString_.resize(indentString_.size() - indentation_.size());
-}
-
 void built_styled_stream_writer::write_comment_before_value(value const& root)
 {
-    if (cs_ == comment_style::none)
+    if (layout_.cs_ == comment_style::none)
         return;
     if (!root.has_comment(comment_before))
         return;
 
-    if (!indented_)
-        writeIndent();
+    if (!layout_.indented_)
+        layout_.write_indent();
     std::string const& comment = root.get_comment(comment_before);
     std::string::const_iterator iter = comment.begin();
     while (iter != comment.end()) {
         *sout_ << *iter;
         if (*iter == '\n' && (iter != comment.end() && *(iter + 1) == '/'))
-            // writeIndent();  // would write extra newline
-            *sout_ << indentString_;
+            // write_indent();  // would write extra newline
+            *sout_ << layout_.indent_string_;
         ++iter;
     }
-    indented_ = false;
+    layout_.indented_ = false;
 }
 
 void built_styled_stream_writer::write_comment_after_value_on_same_line(value const& root)
 {
-    if (cs_ == comment_style::none)
+    if (layout_.cs_ == comment_style::none)
         return;
     if (root.has_comment(comment_after_on_same_line))
         *sout_ << " " + root.get_comment(comment_after_on_same_line);
 
     if (root.has_comment(comment_after)) {
-        writeIndent();
+        layout_.write_indent();
         *sout_ << root.get_comment(comment_after);
     }
 }
@@ -1105,6 +1606,486 @@ bool built_styled_stream_writer::has_comment_for_value(value const& value)
     return value.has_comment(comment_before) || value.has_comment(comment_after_on_same_line) || value.has_comment(comment_after);
 }
 
+// Class styled_size
+// //////////////////////////////////////////////////////////////////
+//
+// Follows built_styled_stream_writer one call at a time, adding up lengths
+// instead of writing. Of the state of the layout, only the depth and whether
+// the current line is indented affect the count.
+
+struct styled_size {
+    explicit styled_size(styled_layout const& layout);
+    size_t count(value const& root);
+
+private:
+    void write_indent();
+    void write_with_indent(size_t length);
+    void write_value(value const& value);
+    void write_array_value(value const& value);
+    bool is_multiline_array(value const& value, size_t* length);
+    void write_comment_before_value(value const& root);
+    void write_comment_after_value_on_same_line(value const& root);
+
+    styled_layout const& layout_;
+    size_t size_;
+    size_t depth_;
+    bool indented_;
+};
+
+styled_size::styled_size(styled_layout const& layout)
+    : layout_(layout)
+    , size_(0)
+    , depth_(0)
+    , indented_(true)
+{
+}
+
+size_t styled_size::count(value const& root)
+{
+    write_comment_before_value(root);
+    if (!indented_)
+        write_indent();
+    indented_ = true;
+    write_value(root);
+    write_comment_after_value_on_same_line(root);
+    return size_;
+}
+
+void styled_size::write_indent()
+{
+    if (!layout_.indentation_.empty())
+        size_ += 1 + depth_ * layout_.indentation_.size();
+}
+
+void styled_size::write_with_indent(size_t length)
+{
+    if (!indented_)
+        write_indent();
+    size_ += length;
+    indented_ = false;
+}
+
+void styled_size::write_value(value const& value)
+{
+    switch (value.type()) {
+    case vt_string: {
+        char const* str;
+        char const* end;
+        if (value.get_string(&str, &end))
+            size_ += quoted_string_size(str, end - str);
+        break;
+    }
+    case vt_array:
+        write_array_value(value);
+        break;
+    case vt_object:
+        if (value.empty()) {
+            size_ += 2;
+            break;
+        }
+        write_with_indent(1);
+        ++depth_;
+        for (value::const_iterator it = value.begin();;) {
+            char const* end;
+            char const* name = it.member_name(&end);
+            class value const& child_value = *it;
+            write_comment_before_value(child_value);
+            write_with_indent(quoted_string_size(name, end - name));
+            size_ += layout_.colon_symbol_.size();
+            write_value(child_value);
+            if (++it == value.end()) {
+                write_comment_after_value_on_same_line(child_value);
+                break;
+            }
+            ++size_;
+            write_comment_after_value_on_same_line(child_value);
+        }
+        --depth_;
+        write_with_indent(1);
+        break;
+    default:
+        size_ += scalar_size(value, layout_.null_symbol_.size());
+        break;
+    }
+}
+
+void styled_size::write_array_value(value const& value)
+{
+    unsigned size = value.size();
+    size_t length = 0;
+    if (size == 0)
+        size_ += 2;
+    else if (layout_.cs_ == comment_style::all || is_multiline_array(value, &length)) {
+        write_with_indent(1);
+        ++depth_;
+        for (unsigned index = 0;;) {
+            class value const& child_value = value[index];
+            write_comment_before_value(child_value);
+            if (!indented_)
+                write_indent();
+            indented_ = true;
+            write_value(child_value);
+            indented_ = false;
+            if (++index == size) {
+                write_comment_after_value_on_same_line(child_value);
+                break;
+            }
+            ++size_;
+            write_comment_after_value_on_same_line(child_value);
+        }
+        --depth_;
+        write_with_indent(1);
+    }
+    else {
+        size_t padding = layout_.indentation_.empty() ? 0 : 2;
+        size_ += 2 + padding + length + (size - 1) * 2;
+    }
+}
+
+// 'length' is that of the elements, when they fit on one line.
+bool styled_size::is_multiline_array(value const& value, size_t* length)
+{
+    unsigned size = value.size();
+    if (layout_.too_many_for_one_line(size))
+        return true;
+    for (unsigned index = 0; index < size; ++index) {
+        class value const& child_value = value[index];
+        if ((child_value.is_array() || child_value.is_object()) && child_value.size() > 0)
+            return true;
+    }
+    // Only scalars and empty containers are left; they do not touch the layout.
+    bool is_multiline = false;
+    size_t before = size_;
+    for (unsigned index = 0; index < size; ++index) {
+        class value const& child_value = value[index];
+        if (child_value.has_comment(comment_before) || child_value.has_comment(comment_after_on_same_line) || child_value.has_comment(comment_after))
+            is_multiline = true;
+        write_value(child_value);
+    }
+    *length = size_ - before;
+    size_ = before;
+    return is_multiline || layout_.too_long_for_one_line(size, *length);
+}
+
+void styled_size::write_comment_before_value(value const& root)
+{
+    if (layout_.cs_ == comment_style::none || !root.has_comment(comment_before))
+        return;
+    if (!indented_)
+        write_indent();
+    std::string const& comment = root.get_comment(comment_before);
+    size_ += comment.size();
+    for (size_t index = 0; index + 1 < comment.size(); ++index) {
+        if (comment[index] == '\n' && comment[index + 1] == '/')
+            size_ += depth_ * layout_.indentation_.size();
+    }
+    indented_ = false;
+}
+
+void styled_size::write_comment_after_value_on_same_line(value const& root)
+{
+    if (layout_.cs_ == comment_style::none)
+        return;
+    if (root.has_comment(comment_after_on_same_line))
+        size_ += 1 + root.get_comment(comment_after_on_same_line).size();
+    if (root.has_comment(comment_after)) {
+        write_indent();
+        size_ += root.get_comment(comment_after).size();
+    }
+}
+
+size_t serialized_size(stream_writer_builder const& builder, value const& root)
+{
+    return styled_size(styled_layout(builder.settings_)).count(root);
+}
+
+// Class emitter
+// //////////////////////////////////////////////////////////////////
+//
+// Follows built_styled_stream_writer one call at a time. Where the writer
+// looks ahead, the emitter waits instead: the opening bracket of a container
+// is written with its first child, so that an empty one can still come out
+// as "{}" or "[]". With comment_style "none", the elements of an array are
+// held back for as long as the array may still fit on one line; that takes
+// at most a line's worth of text.
+
+emitter::emitter(stream_writer_builder const& builder, std::ostream* sout)
+    : layout_(new styled_layout(builder.settings_))
+    , one_line_length_(0)
+    , empty_candidate_(false)
+    , done_(false)
+{
+    layout_->start(sout);
+}
+
+emitter::~emitter()
+{
+    delete layout_;
+}
+
+void emitter::begin_object() { begin('{'); }
+
+void emitter::end_object() { end('}'); }
+
+void emitter::begin_array() { begin('['); }
+
+void emitter::end_array() { end(']'); }
+
+void emitter::key(char const* name)
+{
+    key(name, name + strlen(name));
+}
+
+void emitter::key(std::string const& name)
+{
+    key(name.data(), name.data() + name.size());
+}
+
+void emitter::key(char const* begin, char const* end)
+{
+    settle_empty_candidate();
+    JSON_ASSERT_MESSAGE(!frames_.empty() && frames_.back().type_ == '{' && !frames_.back().has_key_,
+        "emitter::key() is only allowed for the next member of an object");
+    frame& object = frames_.back();
+    if (object.count_ == 0) {
+        layout_->write_with_indent("{");
+        layout_->indent();
+    }
+    else {
+        *layout_->sout_ << ",";
+    }
+    ++object.count_;
+    object.has_key_ = true;
+    layout_->write_with_indent(value_to_quoted_string_n(begin, static_cast<unsigned>(end - begin)));
+    *layout_->sout_ << layout_->colon_symbol_;
+}
+
+void emitter::null() { write_scalar(layout_->null_symbol_); }
+
+void emitter::value(bool scalar) { write_scalar(value_to_string(scalar)); }
+
+void emitter::value(int32_t scalar)
+{
+    write_scalar(value_to_string(largest_int_t(scalar)));
+}
+
+void emitter::value(uint32_t scalar)
+{
+    write_scalar(value_to_string(largest_uint_t(scalar)));
+}
+
+#if defined(JSON_HAS_INT64)
+void emitter::value(int64_t scalar) { write_scalar(value_to_string(scalar)); }
+
+void emitter::value(uint64_t scalar) { write_scalar(value_to_string(scalar)); }
+#endif // if defined(JSON_HAS_INT64)
+
+void emitter::value(double scalar) { write_scalar(value_to_string(scalar)); }
+
+void emitter::value(char const* scalar)
+{
+    value(scalar, scalar + strlen(scalar));
+}
+
+void emitter::value(std::string const& scalar)
+{
+    value(scalar.data(), scalar.data() + scalar.size());
+}
+
+void emitter::value(char const* begin, char const* end)
+{
+    write_scalar(value_to_quoted_string_n(begin, static_cast<unsigned>(end - begin)));
+}
+
+void emitter::value(json::value const& root)
+{
+    switch (root.type()) {
+    case vt_null:
+        null();
+        break;
+    case vt_int:
+        write_scalar(value_to_string(root.as_largest_int()));
+        break;
+    case vt_uint:
+        write_scalar(value_to_string(root.as_largest_uint()));
+        break;
+    case vt_real:
+        value(root.as_double());
+        break;
+    case vt_string: {
+        char const* str;
+        char const* end;
+        if (root.get_string(&str, &end))
+            value(str, end);
+        else
+            write_scalar("");
+    } break;
+    case vt_bool:
+        value(root.as_bool());
+        break;
+    case vt_array: {
+        begin_array();
+        array_index size = root.size();
+        for (array_index index = 0; index < size; ++index)
+            value(root[index]);
+        end_array();
+    } break;
+    case vt_object: {
+        begin_object();
+        for (value_const_iterator it = root.begin(); it != root.end(); ++it) {
+            char const* end;
+            char const* name = it.member_name(&end);
+            key(name, end);
+            value(*it);
+        }
+        end_object();
+    } break;
+    }
+}
+
+bool emitter::done() const { return done_; }
+
+void emitter::begin(char type)
+{
+    settle_empty_candidate();
+    if (!frames_.empty() && frames_.back().one_line_) {
+        // Empty or not? Only the next call will tell.
+        empty_candidate_ = true;
+    }
+    else {
+        JSON_ASSERT_MESSAGE(!done_, "emitter: the root value is already complete");
+        if (!frames_.empty())
+            start_child(frames_.back());
+    }
+    frame child;
+    child.type_ = type;
+    child.count_ = 0;
+    child.has_key_ = false;
+    child.one_line_ = type == '[' && layout_->cs_ == comment_style::none && !empty_candidate_;
+    frames_.push_back(child);
+}
+
+void emitter::end(char type)
+{
+    JSON_ASSERT_MESSAGE(!frames_.empty() && frames_.back().type_ == (type == '}' ? '{' : '[')
+            && !frames_.back().has_key_,
+        "emitter: end_object() or end_array() does not match");
+    frame const closed = frames_.back();
+    frames_.pop_back();
+    if (empty_candidate_) {
+        empty_candidate_ = false;
+        add_one_line_value(type == '}' ? "{}" : "[]");
+        return;
+    }
+    if (closed.count_ == 0) {
+        *layout_->sout_ << (type == '}' ? "{}" : "[]");
+    }
+    else if (closed.one_line_) {
+        layout_->write_one_line_array(one_line_values_);
+        one_line_values_.clear();
+        one_line_length_ = 0;
+    }
+    else {
+        layout_->unindent();
+        layout_->write_with_indent(type == '}' ? "}" : "]");
+    }
+    end_child();
+}
+
+void emitter::write_scalar(std::string const& text)
+{
+    settle_empty_candidate();
+    if (frames_.empty()) {
+        JSON_ASSERT_MESSAGE(!done_, "emitter: the root value is already complete");
+    }
+    else if (frames_.back().one_line_) {
+        add_one_line_value(text);
+        return;
+    }
+    else {
+        start_child(frames_.back());
+    }
+    *layout_->sout_ << text;
+    end_child();
+}
+
+// What the writer does before a child value: the key of an object member
+// is already written; an array element starts on a line of its own.
+void emitter::start_child(frame& parent)
+{
+    if (parent.type_ == '{') {
+        JSON_ASSERT_MESSAGE(parent.has_key_, "emitter: a member of an object needs a key() first");
+        parent.has_key_ = false;
+        return;
+    }
+    if (parent.count_ == 0) {
+        layout_->write_with_indent("[");
+        layout_->indent();
+    }
+    else {
+        *layout_->sout_ << ",";
+    }
+    ++parent.count_;
+    if (!layout_->indented_)
+        layout_->write_indent();
+    layout_->indented_ = true;
+}
+
+// ... and after it.
+void emitter::end_child()
+{
+    if (frames_.empty())
+        done_ = true;
+    else if (frames_.back().type_ == '[')
+        layout_->indented_ = false;
+}
+
+void emitter::add_one_line_value(std::string const& text)
+{
+    frame& array = frames_.back();
+    one_line_values_.push_back(text);
+    one_line_length_ += text.length();
+    ++array.count_;
+    if (layout_->too_many_for_one_line(array.count_)
+        || layout_->too_long_for_one_line(array.count_, one_line_length_))
+        break_lines();
+}
+
+// The one-line array at the top turns out not to fit: write what was held
+// back, one element per line.
+void emitter::break_lines()
+{
+    frame& array = frames_.back();
+    array.one_line_ = false;
+    for (size_t index = 0; index < one_line_values_.size(); ++index) {
+        if (index == 0) {
+            layout_->write_with_indent("[");
+            layout_->indent();
+        }
+        else {
+            *layout_->sout_ << ",";
+        }
+        layout_->write_with_indent(one_line_values_[index]);
+    }
+    one_line_values_.clear();
+    one_line_length_ = 0;
+}
+
+// Something is written into the container that was begun in a one-line
+// array, so that array does not fit on one line.
+void emitter::settle_empty_candidate()
+{
+    if (!empty_candidate_)
+        return;
+    empty_candidate_ = false;
+    frame child = frames_.back();
+    frames_.pop_back();
+    break_lines();
+    start_child(frames_.back());
+    child.one_line_ = child.type_ == '[' && layout_->cs_ == comment_style::none;
+    frames_.push_back(child);
+}
+
 ///////////////
 // stream_writer
 
@@ -1132,35 +2113,13 @@ stream_writer_builder::~stream_writer_builder()
 
 stream_writer* stream_writer_builder::new_stream_writer() const
 {
-    std::string indentation = settings_["indentation"].as_string();
-    std::string cs_str = settings_["comment_style"].as_string();
-    bool eyc = settings_["enable_yaml_compatibility"].as_bool();
-    bool dnp = settings_["drop_null_placeholders"].as_bool();
-    comment_style cs = comment_style::all;
-    if (cs_str == "all") {
-        cs = comment_style::all;
-    }
-    else if (cs_str == "none") {
-        cs = comment_style::none;
-    }
-    else {
-        throw_runtime_error("comment_style must be 'all' or 'none'");
-    }
-    std::string colon_symbol = " : ";
-    if (eyc) {
-        colon_symbol = ": ";
-    }
-    else if (indentation.empty()) {
-        colon_symbol = ":";
-    }
-    std::string null_symbol = "null";
-    if (dnp) {
-        null_symbol = "";
-    }
     std::string ending_linefeed_symbol = "";
+    int threads = settings_["threads"].as_int();
+    if (threads < 0)
+        throw_runtime_error("threads must be >= 0");
+    bool cache = settings_["cache"].as_bool();
     return new built_styled_stream_writer(
-        indentation, cs,
-        colon_symbol, null_symbol, ending_linefeed_symbol);
+        styled_layout(settings_), ending_linefeed_symbol, threads, cache);
 }
 static void get_valid_writer_keys(std::set<std::string>* valid_keys)
 {
@@ -1169,6 +2128,8 @@ static void get_valid_writer_keys(std::set<std::string>* valid_keys)
     valid_keys->insert("comment_style");
     valid_keys->insert("enable_yaml_compatibility");
     valid_keys->insert("drop_null_placeholders");
+    valid_keys->insert("threads");
+    valid_keys->insert("cache");
 }
 bool stream_writer_builder::validate(json::value* invalid) const
 {
@@ -1200,15 +2161,20 @@ void stream_writer_builder::set_defaults(json::value* settings)
     (*settings)["indentation"] = "\t";
     (*settings)["enable_yaml_compatibility"] = false;
     (*settings)["drop_null_placeholders"] = false;
+    (*settings)["threads"] = 1;
+    (*settings)["cache"] = false;
     //! [StreamwriterBuilderDefaults]
 }
 
-std::string write_string(stream_writer::factory const& builder, value const& root)
+std::string write_string(stream_writer::factory const& factory, value const& root)
 {
-    std::ostringstream sout;
-    StreamwriterPtr const writer(builder.new_stream_writer());
+    std::string result;
+    string_buf buf(&result);
+    std::ostream sout(&buf);
+    StreamwriterPtr const writer(factory.new_stream_writer());
     writer->write(root, &sout);
-    return sout.str();
+    sout.flush();
+    return result;
 }
 
 std::ostream& operator<<(std::ostream& sout, value const& root)
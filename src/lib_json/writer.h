@@ -58,8 +58,9 @@ public:
 	}; // factory
 }; // stream_writer
 
-/** \brief Write into stringstream, then return string, for convenience.
+/** \brief Write into a string, then return it, for convenience.
  * A stream_writer will be created from the factory, used, and then deleted.
+ * The text is written straight into the string, which is not copied after.
  */
 std::string JSON_API write_string(stream_writer::factory const& factory, value const& root);
 
@@ -93,6 +94,18 @@ public:
 		Strictly speaking, this is not valid JSON. But when the output is being
 		fed to a browser's Javascript, it makes for smaller output and the
 		browser can handle the output just fine.
+	- "threads": int
+	  - Write the children of large arrays and objects on up to this many
+		threads, each into a buffer of its own, and join the buffers in order.
+		0 means one thread per core; 1 (the default) writes on the calling
+		thread only. The text is the same either way.
+	- "cache": false or true
+	  - Keep the text of every non-empty array and object in the #value, and
+		write it again as long as the value is unchanged. Writing a document
+		again after changing a few leaves then costs about as much as writing
+		the changed containers. See value::cached_text() for what counts as a
+		change. A value must not be written from several threads at once
+		with the cache on.
 
 	You can examine 'settings_` yourself
 	to see the defaults. You can also write and read them just like any
@@ -125,6 +138,106 @@ public:
 	static void set_defaults(json::value* settings);
 };
 
+/** \brief Number of characters that the stream_writer made by 'builder'
+ * writes for 'root'.
+
+ The text is not made: numbers are printed on the stack, and strings are only
+ scanned for the characters to escape. Use it to reserve a buffer, or to send
+ a length ahead of the text. It costs about as much as writing does, so the
+ writers do not call it themselves.
+ \throw std::exception on invalid settings, like new_stream_writer().
+ */
+size_t JSON_API serialized_size(stream_writer_builder const& builder, value const& root);
+
+struct styled_layout;
+
+/** \brief Writes JSON piece by piece, without building a #value.
+
+The text is laid out exactly as the stream_writer made by the same builder
+would lay out the equivalent #value (without comments). Memory use grows with
+the nesting depth only, not with the size of the output.
+
+Usage:
+\code
+  json::stream_writer_builder builder;
+  json::emitter out(builder, &std::cout);
+  out.begin_object();
+  out.key("id");
+  out.value(42);
+  out.key("tags");
+  out.begin_array();
+  out.value("new");
+  out.end_array();
+  out.end_object();
+\endcode
+
+Calls out of order, such as a value in an object without a key() before
+it, throw std::logic_error.
+*/
+class JSON_API emitter {
+public:
+	/// \throw std::exception on invalid settings, like new_stream_writer().
+	emitter(stream_writer_builder const& builder, std::ostream* sout);
+	~emitter();
+
+	void begin_object();
+	void end_object();
+	void begin_array();
+	void end_array();
+
+	/// Name of the next member of the current object.
+	void key(char const* name);
+	/// \param begin may contain embedded zeroes.
+	void key(char const* begin, char const* end);
+	void key(std::string const& name);
+
+	void null();
+	void value(bool scalar);
+	void value(int32_t scalar);
+	void value(uint32_t scalar);
+#if defined(JSON_HAS_INT64)
+	void value(int64_t scalar);
+	void value(uint64_t scalar);
+#endif // if defined(JSON_HAS_INT64)
+	void value(double scalar);
+	void value(char const* scalar);
+	/// \param begin may contain embedded zeroes.
+	void value(char const* begin, char const* end);
+	void value(std::string const& scalar);
+	/// A whole #value, as if each of its parts had been emitted in turn.
+	void value(json::value const& root);
+
+	/// \return true once the root value is complete.
+	bool done() const;
+
+private:
+	emitter(emitter const&); // no impl
+	void operator=(emitter const&); // no impl
+
+	struct frame {
+		char type_; // '{' or '['
+		size_t count_; // children started so far
+		bool has_key_; // a key() is waiting for its value
+		bool one_line_; // elements so far are in one_line_values_
+	};
+
+	void begin(char type);
+	void end(char type);
+	void write_scalar(std::string const& text);
+	void start_child(frame& parent);
+	void end_child();
+	void add_one_line_value(std::string const& text);
+	void break_lines();
+	void settle_empty_candidate();
+
+	styled_layout* layout_;
+	std::vector<frame> frames_;
+	std::vector<std::string> one_line_values_;
+	size_t one_line_length_;
+	bool empty_candidate_; // the top frame was just begun in a one-line array
+	bool done_;
+};
+
 /** \brief Abstract class for writers.
  * \deprecated Use stream_writer. (And really, this is an implementation detail.)
  */
@@ -141,6 +254,11 @@ public:
  * The JSON document is written in a single line. It is not intended for 'human'
  *consumption,
  * but may be usefull to support feature such as RPC where bandwith is limited.
+ *
+ * If the root keeps its source (see the "keep_source" setting of
+ * char_reader_builder), values unchanged since they were read are copied from
+ * it, whitespace included, unless yaml compatibility or dropped null
+ * placeholders change how they would be written.
  * \sa reader, value
  * \deprecated Use stream_writer_builder.
  */
@@ -161,18 +279,97 @@ public:
 
 	void omit_ending_line_feed();
 
+	/// Number of characters that write() returns for 'root'.
+	size_t serialized_size(value const& root) const;
+
 public: // overridden from writer
 	virtual std::string write(value const& root);
 
 private:
 	void write_value(value const& value);
+	char const* source_of(value const& root) const;
+	size_t value_size(value const& value, char const* source) const;
 
 	std::string document_;
+	char const* source_; // kept with the root being written, or NULL
 	bool yaml_compatibility_enabled_;
 	bool drop_null_placeholders_;
 	bool omit_ending_line_feed_;
 };
 
+/** \brief Lays out a value as a list of pieces, for scatter-gather output.
+
+The text is that of fast_writer, without the ending newline (and with strings
+in full, even with embedded zeroes). Long runs of string contents that need no
+escaping are not copied: their pieces point into the storage of the #value.
+Brackets, punctuation, numbers, escapes and short runs are copied into a
+scratch buffer owned by the writer, and adjacent copies share a piece.
+
+If the root keeps its source (see the "keep_source" setting of
+char_reader_builder), values unchanged since they were read are taken from
+it, whitespace included, and referenced in place when long enough.
+
+The pieces are valid until 'root' is changed or destroyed, or the writer
+is used again or destroyed.
+
+Usage:
+\code
+  json::gather_writer writer;
+  writer.write(root);
+  std::vector<struct iovec> iov(writer.pieces().size());
+  for (size_t i = 0; i != iov.size(); ++i) {
+    iov[i].iov_base = const_cast<char*>(writer.pieces()[i].data_);
+    iov[i].iov_len = writer.pieces()[i].size_;
+  }
+  writev(fd, &iov[0], iov.size()); // in batches of at most IOV_MAX
+\endcode
+*/
+class JSON_API gather_writer {
+public:
+	/// A run of the text, like a struct iovec.
+	struct piece {
+		char const* data_;
+		size_t size_;
+	};
+
+	/// \param min_reference_size Runs of string contents at least this long
+	///        are referenced in place rather than copied.
+	explicit gather_writer(size_t min_reference_size = 256);
+
+	void write(value const& root);
+
+	std::vector<piece> const& pieces() const { return pieces_; }
+	/// Length of the whole text.
+	size_t size() const { return size_; }
+	/// The whole text, joined.
+	std::string str() const;
+
+private:
+	gather_writer(gather_writer const&); // no impl
+	void operator=(gather_writer const&); // no impl
+
+	// A piece being laid out; scratch_ may still move, so copies are
+	// located by offset until write() is done.
+	struct run {
+		char const* external_; // NULL for scratch_[begin_, begin_ + size_)
+		size_t begin_;
+		size_t size_;
+	};
+
+	void write_value(value const& value);
+	void write_string(char const* begin, char const* end);
+	void copy_or_reference(char const* data, size_t size);
+	void copy(char const* data, size_t size);
+	void reference(char const* data, size_t size);
+
+	std::vector<run> runs_;
+	std::string scratch_;
+	std::vector<piece> pieces_;
+	char const* source_; // kept with the root being written, or NULL
+	size_t min_reference_size_;
+	size_t size_;
+};
+
 /** \brief Writes a value in <a HREF="http://www.json.org">JSON</a> format in a
  *human friendly way.
  *
@@ -307,6 +504,8 @@ std::string JSON_API value_to_string(largest_uint_t value);
 std::string JSON_API value_to_string(double value);
 std::string JSON_API value_to_string(bool value);
 std::string JSON_API value_to_quoted_string(const char* value);
+/// \param value may contain embedded zeroes.
+std::string JSON_API value_to_quoted_string(const char* value, unsigned length);
 
 /// \brief Output using the styled_stream_writer.
 /// \see json::operator>>()
@@ -5,6 +5,7 @@
 #include "config.h"
 #include "json.h"
 #include <cstring>
+#include <unordered_map>
 
 // Make numeric limits more convenient to talk about.
 // Assumes int type in 32 bits.
@@ -265,6 +266,17 @@ JSONTEST_FIXTURE(ValueTest, arrays)
     JSONTEST_ASSERT_EQUAL(true, array1_.remove_index(2, &got));
     JSONTEST_ASSERT_EQUAL(json::value(17), got);
     JSONTEST_ASSERT_EQUAL(false, array1_.remove_index(2, &got)); // gone now
+
+    // The elements an array was never given move down too, as nulls.
+    json::value sparse;
+    sparse[0] = "a";
+    sparse[3] = "d";
+    JSONTEST_ASSERT_EQUAL(true, sparse.remove_index(0, &got));
+    JSONTEST_ASSERT_EQUAL(json::value("a"), got);
+    JSONTEST_ASSERT_EQUAL(3u, sparse.size());
+    JSONTEST_ASSERT_EQUAL(json::value(), sparse[0]);
+    JSONTEST_ASSERT_EQUAL(json::value(), sparse[1]);
+    JSONTEST_ASSERT_EQUAL(json::value("d"), sparse[2]);
 }
 
 JSONTEST_FIXTURE(ValueTest, null)
@@ -1678,6 +1690,174 @@ JSONTEST_FIXTURE(ValueTest, zeroesInKeys)
     }
 }
 
+JSONTEST_FIXTURE(ValueTest, hash)
+{
+    json::value a;
+    a["x"] = 1;
+    a["y"][0] = "s";
+    a["y"][1] = -0.0;
+    json::value b;
+    b["y"][1] = 0.0;
+    b["y"][0] = "s";
+    b["x"] = 1;
+    JSONTEST_ASSERT(a == b);
+    JSONTEST_ASSERT_EQUAL(a.hash(), b.hash());
+    b["y"][0] = "t";
+    JSONTEST_ASSERT(a.hash() != b.hash());
+
+    // Arrays depend on the order of their elements.
+    json::value ab(json::vt_array);
+    ab.append(1);
+    ab.append(2);
+    json::value ba(json::vt_array);
+    ba.append(2);
+    ba.append(1);
+    JSONTEST_ASSERT(ab.hash() != ba.hash());
+
+    // The same in every run.
+    JSONTEST_ASSERT_EQUAL(UINT64_C(0x2393b94e049159f4), json::value("abc").hash());
+
+    // A cached hash is dropped on change, and is copied.
+    a.cache_hash();
+    uint64_t before = a.hash();
+    json::value copy(a);
+    a["x"] = 2;
+    JSONTEST_ASSERT(a.hash() != before);
+    JSONTEST_ASSERT_EQUAL(before, copy.hash());
+    copy.cache_hash();
+    a.cache_hash();
+    JSONTEST_ASSERT(!(a == copy));
+    a["x"] = 1;
+    JSONTEST_ASSERT(a == copy);
+
+    std::unordered_map<json::value, int> counts;
+    ++counts[a];
+    ++counts[copy];
+    ++counts[b];
+    JSONTEST_ASSERT_EQUAL(2u, counts.size());
+    JSONTEST_ASSERT_EQUAL(2, counts[a]);
+}
+
+JSONTEST_FIXTURE(ValueTest, dedupe)
+{
+    json::value root(json::vt_array);
+    for (int i = 0; i < 3; ++i) {
+        json::value record;
+        record["id"] = i;
+        record["name"] = "widget";
+        record["tags"].append("a");
+        record["tags"].append(i == 2 ? -0.0 : 0.0);
+        root.append(record);
+    }
+    json::value commented(json::vt_array);
+    commented.append(1);
+    commented[0].set_comment("// one", json::comment_before);
+    root.append(commented);
+    root.append(commented);
+    json::value const before(root);
+    json::dedupe(root);
+    JSONTEST_ASSERT(root == before);
+
+    // Equal subtrees share their elements, equal strings and names their text.
+    json::value const& r = root;
+    JSONTEST_ASSERT(r[0]["tags"].is_shared());
+    JSONTEST_ASSERT_EQUAL(&r[0]["tags"][1], &r[1]["tags"][1]);
+    JSONTEST_ASSERT(!r[2]["tags"].is_shared()); // -0.0 is not 0.0
+    JSONTEST_ASSERT(!r[0].is_shared());
+    JSONTEST_ASSERT_EQUAL(r[0]["name"].as_cstring(), r[2]["name"].as_cstring());
+    JSONTEST_ASSERT_EQUAL(r[0]["tags"][0].as_cstring(), r[2]["tags"][0].as_cstring());
+    char const* end;
+    JSONTEST_ASSERT_EQUAL(r[0].begin().member_name(&end), r[2].begin().member_name(&end));
+    JSONTEST_ASSERT(!r[3].is_shared()); // comments are not shared
+    JSONTEST_ASSERT_STRING_EQUAL("// one", r[4][0].get_comment(json::comment_before));
+
+    // Changing one holder changes it alone.
+    root[1]["tags"].append(true);
+    JSONTEST_ASSERT_EQUAL(3u, r[1]["tags"].size());
+    JSONTEST_ASSERT_EQUAL(2u, r[0]["tags"].size());
+    JSONTEST_ASSERT(!r[0]["tags"].is_shared());
+    root[2]["name"] = "gadget";
+    JSONTEST_ASSERT_STRING_EQUAL("widget", r[0]["name"].as_string());
+    json::value copy(r[0]);
+    JSONTEST_ASSERT(copy == before[0]);
+
+    // So does changing it through a reference obtained before, or through
+    // the document after.
+    json::value doc;
+    json::reader reader;
+    JSONTEST_ASSERT(reader.parse("{\"a\": {\"x\": [1]}, \"b\": {\"x\": [1]}, \"c\": {\"x\": [1]}}", doc));
+    json::value& held = doc["a"]["x"];
+    json::dedupe(doc);
+    json::value const& d = doc;
+    JSONTEST_ASSERT(d["b"].is_shared());
+    JSONTEST_ASSERT(!d["a"].is_shared());
+    held.append(2);
+    doc["b"]["x"][0] = 3;
+    json::fast_writer fast;
+    fast.omit_ending_line_feed();
+    JSONTEST_ASSERT_STRING_EQUAL("{\"a\":{\"x\":[1,2]},\"b\":{\"x\":[3]},\"c\":{\"x\":[1]}}",
+        fast.write(doc));
+}
+
+JSONTEST_FIXTURE(ValueTest, copyOnWrite)
+{
+    json::value doc;
+    json::reader reader;
+    JSONTEST_ASSERT(reader.parse("{\"a\": {\"b\": [1, \"two\"]}, \"c\": {\"d\": true}}", doc));
+    json::value snapshot(doc);
+    json::value const& before = snapshot;
+    json::value const& after = doc;
+    JSONTEST_ASSERT(after.is_shared());
+    JSONTEST_ASSERT_EQUAL(&before["a"], &after["a"]);
+
+    // Changing a value copies the containers on the way to it, and no more.
+    doc["a"]["b"].append(3);
+    JSONTEST_ASSERT_EQUAL(2u, before["a"]["b"].size());
+    JSONTEST_ASSERT_EQUAL(3u, after["a"]["b"].size());
+    JSONTEST_ASSERT(!after.is_shared());
+    JSONTEST_ASSERT(!after["a"]["b"].is_shared());
+    JSONTEST_ASSERT(after["c"].is_shared());
+    JSONTEST_ASSERT_EQUAL(&before["c"]["d"], &after["c"]["d"]);
+    JSONTEST_ASSERT_EQUAL(before["a"]["b"][1].as_cstring(), after["a"]["b"][1].as_cstring());
+    char const* end;
+    JSONTEST_ASSERT_EQUAL(before.begin().member_name(&end), after.begin().member_name(&end));
+
+    doc.remove_member("c");
+    JSONTEST_ASSERT(before.is_member("c"));
+    JSONTEST_ASSERT(!before["c"].is_shared());
+
+    // So does changing it through an iterator.
+    json::value copy;
+    copy = snapshot;
+    for (json::value::iterator it = snapshot["a"]["b"].begin(); it != snapshot["a"]["b"].end(); ++it)
+        *it = 0;
+    JSONTEST_ASSERT_EQUAL(1, copy["a"]["b"][0].as_int());
+    JSONTEST_ASSERT_STRING_EQUAL("two", copy["a"]["b"][1].as_string());
+    JSONTEST_ASSERT_EQUAL(0, before["a"]["b"][1].as_int());
+
+    // What was handed out before a copy changes the original only.
+    json::value built;
+    json::value& items = built["items"];
+    items.append(1);
+    json::value backup = built;
+    items.append(2);
+    JSONTEST_ASSERT_EQUAL(1u, backup["items"].size());
+    JSONTEST_ASSERT_EQUAL(2u, built["items"].size());
+
+    json::value& first = built["items"][0];
+    json::value::iterator last = built["items"].begin();
+    ++last;
+    std::vector<json::value> kept(3, built);
+    first = 7;
+    *last = 8;
+    for (size_t i = 0; i < kept.size(); ++i) {
+        JSONTEST_ASSERT_EQUAL(1, kept[i]["items"][0].as_int());
+        JSONTEST_ASSERT_EQUAL(2, kept[i]["items"][1].as_int());
+    }
+    JSONTEST_ASSERT_EQUAL(7, built["items"][0].as_int());
+    JSONTEST_ASSERT_EQUAL(8, built["items"][1].as_int());
+}
+
 struct writerTest : JsonTest::TestCase {
 };
 
@@ -1727,6 +1907,202 @@ JSONTEST_FIXTURE(StreamwriterTest, writeZeroes)
     }
 }
 
+JSONTEST_FIXTURE(StreamwriterTest, escapes)
+{
+    // Long enough for the vectorized scan, with escapes on both sides of a
+    // 16-byte boundary.
+    std::string text("0123456789abcd\"\\\x01\x1f\b\f\n\r\t/\x7f\xc3\xa9"
+                     "end");
+    std::string expected("\"0123456789abcd\\\"\\\\\\u0001\\u001F"
+                         "\\b\\f\\n\\r\\t/\x7f\xc3\xa9"
+                         "end\"");
+    JSONTEST_ASSERT_STRING_EQUAL(expected,
+        json::value_to_quoted_string(text.data(), static_cast<unsigned>(text.size())));
+    JSONTEST_ASSERT_STRING_EQUAL(expected, json::value_to_quoted_string(text.c_str()));
+    json::stream_writer_builder b;
+    JSONTEST_ASSERT_STRING_EQUAL(expected, json::write_string(b, json::value(text)));
+}
+
+JSONTEST_FIXTURE(StreamwriterTest, serializedSize)
+{
+    json::value root;
+    root["name"] = "tab\there \"quoted\"";
+    root["numbers"].append(-12);
+    root["numbers"].append(json::largest_uint_t(18446744073709551615ull));
+    root["numbers"].append(0.1);
+    root["numbers"].append(json::value());
+    root["nested"]["long"] = json::value(json::vt_array);
+    for (int index = 0; index < 30; ++index)
+        root["nested"]["long"].append(index);
+    root["nested"]["empty"] = json::value(json::vt_object);
+    root["numbers"].set_comment("// numbers", json::comment_before);
+    root["name"].set_comment("/* after */", json::comment_after_on_same_line);
+    char const* indentations[] = { "\t", "   ", "" };
+    for (int mode = 0; mode < 12; ++mode) {
+        json::stream_writer_builder b;
+        b["indentation"] = indentations[mode % 3];
+        b["comment_style"] = mode & 4 ? "none" : "all";
+        b["enable_yaml_compatibility"] = (mode & 8) != 0;
+        b["drop_null_placeholders"] = (mode & 8) != 0;
+        JSONTEST_ASSERT_EQUAL(json::write_string(b, root).size(),
+            json::serialized_size(b, root));
+    }
+    json::fast_writer fast;
+    JSONTEST_ASSERT_EQUAL(fast.write(root).size(), fast.serialized_size(root));
+    fast.enable_yaml_compatibility();
+    fast.drop_null_placeholders();
+    fast.omit_ending_line_feed();
+    JSONTEST_ASSERT_EQUAL(fast.write(root).size(), fast.serialized_size(root));
+}
+
+JSONTEST_FIXTURE(StreamwriterTest, threads)
+{
+    // Heavy enough to be split, with the large container below the root.
+    json::value root;
+    root["before"] = "first";
+    json::value& items = root["items"];
+    for (int index = 0; index < 6000; ++index) {
+        json::value& item = items[index];
+        item["id"] = index;
+        item["tags"].append("a");
+        item["tags"].append(index * 0.5);
+    }
+    items[17].set_comment("// seventeen", json::comment_before);
+    items[4000]["id"].set_comment("/* id */", json::comment_after_on_same_line);
+    root["members"] = items[0];
+    for (int index = 0; index < 9000; ++index)
+        root["members"][std::to_string(index)] = index;
+    char const* indentations[] = { "\t", "" };
+    for (int mode = 0; mode < 4; ++mode) {
+        json::stream_writer_builder b;
+        b["indentation"] = indentations[mode % 2];
+        b["comment_style"] = mode & 2 ? "none" : "all";
+        std::string const expected = json::write_string(b, root);
+        b["threads"] = 3;
+        JSONTEST_ASSERT_STRING_EQUAL(expected, json::write_string(b, root));
+        b["threads"] = 0;
+        JSONTEST_ASSERT_STRING_EQUAL(expected, json::write_string(b, root));
+    }
+    // The elements a sparse array was never given weigh as nulls.
+    json::value sparse;
+    sparse[0] = 1;
+    for (int index = 0; index < 20000; ++index)
+        sparse[999][index] = index;
+    sparse[1999] = 2;
+    json::value holes;
+    for (int index = 0; index < 30000; index += 3)
+        holes[index]["id"] = index;
+    for (int mode = 0; mode < 2; ++mode) {
+        json::stream_writer_builder b;
+        b["indentation"] = indentations[mode];
+        std::string const expected = json::write_string(b, sparse);
+        std::string const expected_holes = json::write_string(b, holes);
+        b["threads"] = 4;
+        JSONTEST_ASSERT_STRING_EQUAL(expected, json::write_string(b, sparse));
+        JSONTEST_ASSERT_STRING_EQUAL(expected_holes, json::write_string(b, holes));
+    }
+    json::stream_writer_builder b;
+    // Far longer than what write_string() buffers, and the same as streamed.
+    std::ostringstream streamed;
+    streamed << root;
+    JSONTEST_ASSERT_STRING_EQUAL(streamed.str(), json::write_string(b, root));
+    b["threads"] = -1;
+    JSONTEST_ASSERT_THROWS(json::write_string(b, root));
+}
+
+JSONTEST_FIXTURE(StreamwriterTest, cache)
+{
+    json::value root;
+    root["a"]["b"].append(1);
+    root["a"]["b"].append("two");
+    root["a"]["c"]["d"] = true;
+    root["e"] = json::value(json::vt_array);
+    json::stream_writer_builder plain;
+    json::stream_writer_builder cached;
+    cached["cache"] = true;
+    json::value const& const_root = root;
+
+    std::string expected = json::write_string(plain, root);
+    JSONTEST_ASSERT_STRING_EQUAL(expected, json::write_string(cached, const_root));
+    JSONTEST_ASSERT(const_root["a"]["c"].cached_text("") == NULL);
+    JSONTEST_ASSERT_STRING_EQUAL(expected, json::write_string(cached, const_root));
+
+    // Reaching a leaf drops the caches on its path, and only those.
+    root["a"]["b"][1] = "three";
+    expected = json::write_string(plain, root);
+    JSONTEST_ASSERT_STRING_EQUAL(expected, json::write_string(cached, const_root));
+    root["a"]["c"].remove_member("d");
+    root["e"].append(json::value(json::vt_object));
+    expected = json::write_string(plain, root);
+    JSONTEST_ASSERT_STRING_EQUAL(expected, json::write_string(cached, const_root));
+
+    // Other settings do not share cached text.
+    plain["indentation"] = "";
+    cached["indentation"] = "";
+    JSONTEST_ASSERT_STRING_EQUAL(json::write_string(plain, root),
+        json::write_string(cached, const_root));
+
+    // Copies do not take the cache along.
+    std::string text("x");
+    const_root.set_cached_text("key", text);
+    JSONTEST_ASSERT(text.empty());
+    JSONTEST_ASSERT_STRING_EQUAL("x", *const_root.cached_text("key"));
+    json::value copy(const_root);
+    JSONTEST_ASSERT(copy.cached_text("key") == NULL);
+    root.drop_cached_text();
+    JSONTEST_ASSERT(const_root.cached_text("key") == NULL);
+}
+
+struct GatherWriterTest : JsonTest::TestCase {
+};
+
+JSONTEST_FIXTURE(GatherWriterTest, sameAsFastWriter)
+{
+    json::value root;
+    root["blob"] = std::string(1000, 'b') + "\"\n" + std::string(300, 'c');
+    root["short"] = "tab\there";
+    root["numbers"].append(-7);
+    root["numbers"].append(json::largest_uint_t(18446744073709551615ull));
+    root["numbers"].append(2.5);
+    root["numbers"].append(json::value());
+    root["numbers"].append(true);
+    root["empty"] = json::value(json::vt_object);
+    json::fast_writer fast;
+    fast.omit_ending_line_feed();
+    std::string const expected = fast.write(root);
+
+    json::gather_writer writer;
+    writer.write(root);
+    JSONTEST_ASSERT_STRING_EQUAL(expected, writer.str());
+    JSONTEST_ASSERT_EQUAL(expected.size(), writer.size());
+
+    // Both long runs of the blob are referenced in place.
+    char const* str;
+    char const* end;
+    root["blob"].get_string(&str, &end);
+    int referenced = 0;
+    for (size_t index = 0; index != writer.pieces().size(); ++index) {
+        json::gather_writer::piece const& piece = writer.pieces()[index];
+        if (piece.data_ >= str && piece.data_ < end)
+            ++referenced;
+    }
+    JSONTEST_ASSERT_EQUAL(2, referenced);
+    JSONTEST_ASSERT_EQUAL(5u, writer.pieces().size());
+
+    json::gather_writer copying(size_t(-1));
+    copying.write(root);
+    JSONTEST_ASSERT_STRING_EQUAL(expected, copying.str());
+    JSONTEST_ASSERT_EQUAL(1u, copying.pieces().size());
+
+    // The elements an array was never given are written as null.
+    json::value sparse;
+    sparse[0] = 1;
+    sparse[4] = 5;
+    json::gather_writer holes;
+    holes.write(sparse);
+    JSONTEST_ASSERT_STRING_EQUAL("[1,null,null,null,5]", holes.str());
+}
+
 struct ReaderTest : JsonTest::TestCase {
 };
 
@@ -1927,6 +2303,77 @@ JSONTEST_FIXTURE(CharReaderTest, parseWithStackLimit)
     }
 }
 
+JSONTEST_FIXTURE(CharReaderTest, keepSource)
+{
+    std::string const doc = "{ \"a\" : [1, 2.50], \"b\" : {\"c\":\"x\"} }";
+    char const* engines[] = { "classic", "simd" };
+    for (int i = 0; i < 2; ++i) {
+        json::char_reader_builder b;
+        b["engine"] = engines[i];
+        b["keep_source"] = true;
+        json::value root;
+        std::istringstream in(doc);
+        JSONTEST_ASSERT(json::parse_from_stream(b, in, &root, NULL));
+        JSONTEST_ASSERT(root.is_from_source());
+
+        // Unchanged values are copied with their spacing and spelling.
+        json::fast_writer fast;
+        fast.omit_ending_line_feed();
+        JSONTEST_ASSERT_STRING_EQUAL(doc, fast.write(root));
+        root["b"]["c"] = "y";
+        JSONTEST_ASSERT(!root.is_from_source());
+        JSONTEST_ASSERT(!root["b"].is_from_source());
+        JSONTEST_ASSERT(root["a"].is_from_source());
+        std::string const expected = "{\"a\":[1, 2.50],\"b\":{\"c\":\"y\"}}";
+        JSONTEST_ASSERT_STRING_EQUAL(expected, fast.write(root));
+        json::gather_writer gather;
+        gather.write(root);
+        JSONTEST_ASSERT_STRING_EQUAL(expected, gather.str());
+        json::stream_writer_builder compact;
+        compact["indentation"] = "";
+        JSONTEST_ASSERT_STRING_EQUAL("{\"a\":[1,2.5],\"b\":{\"c\":\"y\"}}",
+            json::write_string(compact, root));
+
+        // Values that leave the document leave its source behind.
+        json::value copy(root["a"]);
+        JSONTEST_ASSERT(!copy.is_from_source());
+        json::value moved;
+        moved.swap(root["a"]);
+        JSONTEST_ASSERT(!moved.is_from_source());
+        JSONTEST_ASSERT_STRING_EQUAL("[1,2.5]", fast.write(moved));
+    }
+
+    // Text that is not plain JSON is not kept.
+    json::char_reader_builder b;
+    b["keep_source"] = true;
+    json::value root;
+    std::istringstream commented("[1] // one");
+    JSONTEST_ASSERT(json::parse_from_stream(b, commented, &root, NULL));
+    JSONTEST_ASSERT(!root.is_from_source());
+    b["allow_single_quotes"] = true;
+    std::istringstream quoted("['x']");
+    JSONTEST_ASSERT(json::parse_from_stream(b, quoted, &root, NULL));
+    JSONTEST_ASSERT(!root[0].is_from_source());
+}
+
+JSONTEST_FIXTURE(CharReaderTest, dedupe)
+{
+    std::string const doc = "[{\"k\": [1, 2], \"s\": \"text\"}, {\"k\": [1, 2], \"s\": \"text\"}]";
+    json::char_reader_builder b;
+    b["dedupe"] = true;
+    JSONTEST_ASSERT(b.validate(NULL));
+    json::value root;
+    std::istringstream in(doc);
+    JSONTEST_ASSERT(json::parse_from_stream(b, in, &root, NULL));
+    json::value const& r = root;
+    JSONTEST_ASSERT(r[0].is_shared());
+    JSONTEST_ASSERT_EQUAL(&r[0]["s"], &r[1]["s"]);
+    JSONTEST_ASSERT_EQUAL(2u, r[1]["k"].size());
+    json::fast_writer fast;
+    JSONTEST_ASSERT_STRING_EQUAL("[{\"k\":[1,2],\"s\":\"text\"},{\"k\":[1,2],\"s\":\"text\"}]\n",
+        fast.write(root));
+}
+
 struct CharReaderStrictModeTest : JsonTest::TestCase {
 };
 
@@ -2375,6 +2822,1475 @@ JSONTEST_FIXTURE(IteratorTest, indexes)
     JSONTEST_ASSERT(it == json.end());
 }
 
+struct TapeTest : JsonTest::TestCase {
+};
+
+JSONTEST_FIXTURE(TapeTest, parse)
+{
+    json::char_reader_builder b;
+    json::tape doc;
+    std::string errs;
+    char const text[] = "{ \"name\" : \"tape\", \"list\" : [1, -2, 3.5, true, null, \"a\\tb\"],"
+                        " \"empty\" : {}, \"big\" : 18446744073709551615 }";
+    bool ok = json::parse_tape(b, text, text + std::strlen(text), &doc, &errs);
+    JSONTEST_ASSERT(ok);
+    JSONTEST_ASSERT(errs.size() == 0);
+    json::tape_view root = doc.root();
+    JSONTEST_ASSERT(root.is_object());
+    JSONTEST_ASSERT_EQUAL(4u, root.size());
+    JSONTEST_ASSERT_STRING_EQUAL("tape", root["name"].as_string());
+    json::tape_view list = root["list"];
+    JSONTEST_ASSERT(list.is_array());
+    JSONTEST_ASSERT_EQUAL(6u, list.size());
+    JSONTEST_ASSERT_EQUAL(1, list[0].as_int());
+    JSONTEST_ASSERT_EQUAL(-2, list[1].as_int());
+    JSONTEST_ASSERT_EQUAL(3.5, list[2].as_double());
+    JSONTEST_ASSERT(list[3].as_bool());
+    JSONTEST_ASSERT(list[4].is_null());
+    JSONTEST_ASSERT_STRING_EQUAL("a\tb", list[5].as_string());
+    JSONTEST_ASSERT(list[6].is_null());
+    JSONTEST_ASSERT(root["empty"].is_object());
+    JSONTEST_ASSERT(root["empty"].empty());
+    JSONTEST_ASSERT(root["big"].isUInt64());
+    JSONTEST_ASSERT(root["missing"].is_null());
+    JSONTEST_ASSERT(!root.is_member("missing"));
+}
+
+JSONTEST_FIXTURE(TapeTest, iterate)
+{
+    json::char_reader_builder b;
+    json::tape doc;
+    char const text[] = "{ \"a\" : [10, {\"x\" : 1}], \"b\" : 20 }";
+    JSONTEST_ASSERT(json::parse_tape(b, text, text + std::strlen(text), &doc, NULL));
+    json::tape_view root = doc.root();
+    json::tape_view::const_iterator it = root.begin();
+    JSONTEST_ASSERT(it != root.end());
+    JSONTEST_ASSERT_STRING_EQUAL("a", it.name());
+    JSONTEST_ASSERT(it->is_array());
+    json::tape_view::const_iterator element = it->begin();
+    JSONTEST_ASSERT_EQUAL(0, element.index());
+    JSONTEST_ASSERT_EQUAL(10, element->as_int());
+    ++element;
+    JSONTEST_ASSERT_EQUAL(1, element.index());
+    JSONTEST_ASSERT_EQUAL(1, (*element)["x"].as_int());
+    ++element;
+    JSONTEST_ASSERT(element == it->end());
+    ++it;
+    JSONTEST_ASSERT_STRING_EQUAL("b", it.name());
+    JSONTEST_ASSERT_EQUAL(20, it->as_int());
+    ++it;
+    JSONTEST_ASSERT(it == root.end());
+}
+
+JSONTEST_FIXTURE(TapeTest, toValue)
+{
+    json::char_reader_builder b;
+    char const text[] = "{ \"a\" : [1, 2.25, \"\\u00e9\", {\"b\" : false}], \"c\" : null }";
+    json::tape doc;
+    JSONTEST_ASSERT(json::parse_tape(b, text, text + std::strlen(text), &doc, NULL));
+    json::char_reader* reader(b.new_char_reader());
+    json::value expected;
+    JSONTEST_ASSERT(reader->parse(text, text + std::strlen(text), &expected, NULL));
+    JSONTEST_ASSERT_EQUAL(expected, doc.root().to_value());
+    delete reader;
+}
+
+JSONTEST_FIXTURE(TapeTest, parseWithOneError)
+{
+    json::char_reader_builder b;
+    json::char_reader* reader(b.new_char_reader());
+    char const text[] = "{ \"property\" :: \"value\" }";
+    json::value root;
+    std::string expected;
+    JSONTEST_ASSERT(!reader->parse(text, text + std::strlen(text), &root, &expected));
+    json::tape doc;
+    std::string errs;
+    JSONTEST_ASSERT(!json::parse_tape(b, text, text + std::strlen(text), &doc, &errs));
+    JSONTEST_ASSERT_STRING_EQUAL(expected, errs);
+    JSONTEST_ASSERT(doc.empty());
+    delete reader;
+}
+
+JSONTEST_FIXTURE(TapeTest, dupKeys)
+{
+    json::char_reader_builder b;
+    json::char_reader_builder::strict_mode(&b.settings_);
+    char const text[] = "{ \"a\" : 1, \"b\" : 2, \"a\" : 3 }";
+    json::tape doc;
+    std::string errs;
+    JSONTEST_ASSERT(!json::parse_tape(b, text, text + std::strlen(text), &doc, &errs));
+    JSONTEST_ASSERT(errs.find("Duplicate key: 'a'") != std::string::npos);
+}
+
+struct LazyTest : JsonTest::TestCase {
+};
+
+JSONTEST_FIXTURE(LazyTest, onDemand)
+{
+    json::char_reader_builder b;
+    json::lazy_document doc;
+    std::string errs;
+    char const text[] = "{ \"header\" : { \"name\" : \"lazy\", \"id\" : 7 },"
+                        " \"body\" : [ [1, 2], {\"x\" : [3]} ], \"tail\" : \"t\\u00e9\" }";
+    bool ok = json::parse_lazy(b, text, text + std::strlen(text), &doc, &errs);
+    JSONTEST_ASSERT(ok);
+    JSONTEST_ASSERT(errs.size() == 0);
+    json::lazy_value root = doc.root();
+    JSONTEST_ASSERT(root.is_object());
+    JSONTEST_ASSERT(!root.is_expanded());
+    JSONTEST_ASSERT_EQUAL(1u, doc.decoded_count());
+    JSONTEST_ASSERT_STRING_EQUAL("lazy", root["header"]["name"].as_string());
+    JSONTEST_ASSERT_EQUAL(7, root["header"]["id"].as_int());
+    JSONTEST_ASSERT(root.is_expanded());
+    JSONTEST_ASSERT(!root["body"].is_expanded());
+    JSONTEST_ASSERT_EQUAL(6u, doc.decoded_count());
+    JSONTEST_ASSERT_EQUAL(strstr(text, "[ [") - text, root["body"].get_offset_start());
+    JSONTEST_ASSERT_EQUAL(strstr(text, ", \"tail\"") - text, root["body"].get_offset_limit());
+    JSONTEST_ASSERT_STRING_EQUAL("t\xc3\xa9", root["tail"].as_string());
+    JSONTEST_ASSERT(root["missing"].is_null());
+    JSONTEST_ASSERT_EQUAL(2u, root["body"].size());
+    JSONTEST_ASSERT_EQUAL(3, root["body"][1]["x"][0].as_int());
+    JSONTEST_ASSERT(root["body"][2].is_null());
+}
+
+JSONTEST_FIXTURE(LazyTest, iterate)
+{
+    json::char_reader_builder b;
+    json::lazy_document doc;
+    char const text[] = "{ \"a\" : [10, {\"x\" : 1}], \"b\" : 20 }";
+    JSONTEST_ASSERT(json::parse_lazy(b, text, text + std::strlen(text), &doc, NULL));
+    json::lazy_value root = doc.root();
+    json::lazy_value::const_iterator it = root.begin();
+    JSONTEST_ASSERT(it != root.end());
+    JSONTEST_ASSERT_STRING_EQUAL("a", it.name());
+    json::lazy_value::const_iterator element = it->begin();
+    JSONTEST_ASSERT_EQUAL(0, element.index());
+    JSONTEST_ASSERT_EQUAL(10, element->as_int());
+    ++element;
+    JSONTEST_ASSERT_EQUAL(1, element.index());
+    JSONTEST_ASSERT_EQUAL(1, (*element)["x"].as_int());
+    ++element;
+    JSONTEST_ASSERT(element == it->end());
+    ++it;
+    JSONTEST_ASSERT_STRING_EQUAL("b", it.name());
+    JSONTEST_ASSERT_EQUAL(20, it->as_int());
+    ++it;
+    JSONTEST_ASSERT(it == root.end());
+}
+
+JSONTEST_FIXTURE(LazyTest, toValue)
+{
+    json::char_reader_builder b;
+    char const text[] = "{ \"a\" : [1, 2.25, \"s\", {\"b\" : false}], \"c\" : null, \"\\n\" : {} }";
+    json::lazy_document doc;
+    JSONTEST_ASSERT(json::parse_lazy(b, text, text + std::strlen(text), &doc, NULL));
+    json::char_reader* reader(b.new_char_reader());
+    json::value expected;
+    JSONTEST_ASSERT(reader->parse(text, text + std::strlen(text), &expected, NULL));
+    JSONTEST_ASSERT_EQUAL(expected, doc.root().to_value());
+    delete reader;
+}
+
+JSONTEST_FIXTURE(LazyTest, deferredError)
+{
+    json::char_reader_builder b;
+    char const text[] = "{ \"good\" : 1, \"bad\" : { \"property\" :: \"value\" } }";
+    json::lazy_document doc;
+    std::string errs;
+    JSONTEST_ASSERT(json::parse_lazy(b, text, text + std::strlen(text), &doc, &errs));
+    json::lazy_value root = doc.root();
+    JSONTEST_ASSERT_EQUAL(1, root["good"].as_int());
+    JSONTEST_ASSERT_THROWS(root["bad"]["property"]);
+    JSONTEST_ASSERT(!root["bad"].is_expanded());
+}
+
+JSONTEST_FIXTURE(LazyTest, parseWithOneError)
+{
+    json::char_reader_builder b;
+    char const text[] = "{ \"property\" : [ \"value\" }";
+    json::lazy_document doc;
+    std::string errs;
+    JSONTEST_ASSERT(!json::parse_lazy(b, text, text + std::strlen(text), &doc, &errs));
+    JSONTEST_ASSERT_STRING_EQUAL(
+        "* Line 1, Column 26\n  Missing ',' or ']' in array declaration\n", errs);
+    JSONTEST_ASSERT(doc.empty());
+}
+
+struct SimdEngineTest : JsonTest::TestCase {
+};
+
+// Strings with runs of backslashes and quotes that straddle the 64-byte
+// blocks of the structural index.
+static std::string simd_sample()
+{
+    std::string text = "{\n";
+    for (int i = 1; i < 80; ++i) {
+        text += "  \"k" + std::string(i % 7, ' ') + std::string(i, '\\') + std::string(i % 2, '\\')
+            + "\" : [\"" + std::string(i, 'x') + "\\\\\\\"" + std::string(i % 5, '\\') + std::string(i % 5, '\\')
+            + "\", " + (i % 3 ? "-12.5e2" : "18446744073709551615") + ", {}, [], true, null],\n";
+    }
+    text += "  \"last\" : \"\\u00e9\\t{[,:]}\"\n}";
+    return text;
+}
+
+JSONTEST_FIXTURE(SimdEngineTest, sameAsClassic)
+{
+    std::string text = simd_sample();
+    json::char_reader_builder classic;
+    json::char_reader_builder simd;
+    simd["engine"] = "simd";
+    json::char_reader* classic_reader = classic.new_char_reader();
+    json::char_reader* simd_reader = simd.new_char_reader();
+    json::value expected;
+    json::value root;
+    std::string errs;
+    JSONTEST_ASSERT(classic_reader->parse(text.data(), text.data() + text.size(), &expected, &errs));
+    JSONTEST_ASSERT(simd_reader->parse(text.data(), text.data() + text.size(), &root, &errs));
+    JSONTEST_ASSERT(errs.size() == 0);
+    JSONTEST_ASSERT(expected == root);
+    JSONTEST_ASSERT_EQUAL(80u, root.size());
+    json::value const& member = root["k  \\"];
+    JSONTEST_ASSERT(member.is_array());
+    JSONTEST_ASSERT_EQUAL(expected["k  \\"].get_offset_start(), member.get_offset_start());
+    JSONTEST_ASSERT_EQUAL(expected["k  \\"][0].get_offset_limit(), member[0].get_offset_limit());
+    JSONTEST_ASSERT_EQUAL(expected.get_offset_limit(), root.get_offset_limit());
+    json::tape doc;
+    JSONTEST_ASSERT(json::parse_tape(simd, text.data(), text.data() + text.size(), &doc, &errs));
+    JSONTEST_ASSERT(expected == doc.root().to_value());
+    delete simd_reader;
+    delete classic_reader;
+}
+
+JSONTEST_FIXTURE(SimdEngineTest, sameErrors)
+{
+    json::char_reader_builder classic;
+    json::char_reader_builder simd;
+    simd["engine"] = "simd";
+    char const* texts[] = {
+        "{ \"property\" :: \"value\" }",
+        "[ 1, 2, ]",
+        "[ \"a\\qb\" ]",
+        "{ \"a\" : tru }",
+        "[ 1 ] [ 2 ]",
+        "{ \"a\" : 1 // comment\n }",
+        "[ \"unterminated ]",
+    };
+    for (size_t i = 0; i < sizeof(texts) / sizeof(texts[0]); ++i) {
+        char const* text = texts[i];
+        json::char_reader* classic_reader = classic.new_char_reader();
+        json::char_reader* simd_reader = simd.new_char_reader();
+        json::value expected;
+        json::value root;
+        std::string expected_errs;
+        std::string errs;
+        bool expected_ok = classic_reader->parse(text, text + std::strlen(text), &expected, &expected_errs);
+        bool ok = simd_reader->parse(text, text + std::strlen(text), &root, &errs);
+        JSONTEST_ASSERT_EQUAL(expected_ok, ok) << text;
+        JSONTEST_ASSERT_STRING_EQUAL(expected_errs, errs);
+        JSONTEST_ASSERT(expected == root) << text;
+        delete simd_reader;
+        delete classic_reader;
+    }
+}
+
+JSONTEST_FIXTURE(SimdEngineTest, stackLimit)
+{
+    json::char_reader_builder b;
+    b["engine"] = "simd";
+    b["stack_limit"] = 2;
+    char const text[] = "[[[1]]]";
+    json::char_reader* reader = b.new_char_reader();
+    json::value root;
+    std::string errs;
+    JSONTEST_ASSERT_THROWS(reader->parse(text, text + std::strlen(text), &root, &errs));
+    delete reader;
+}
+
+JSONTEST_FIXTURE(SimdEngineTest, badEngine)
+{
+    json::char_reader_builder b;
+    b["engine"] = "turbo";
+    JSONTEST_ASSERT_THROWS(b.new_char_reader());
+}
+
+struct ParallelReaderTest : JsonTest::TestCase {
+};
+
+// A top-level array big enough to be split into several slices.
+static std::string parallel_sample()
+{
+    std::string text = "[\n";
+    for (int i = 0; i < 4000; ++i) {
+        if (i)
+            text += ",\n";
+        text += "  { \"id\" : " + std::to_string(i) + ", \"name\" : \"a \\\"quoted\\\" [name], {}\","
+            " \"list\" : [1.5, null, {}, []] }";
+    }
+    text += "\n]\n";
+    return text;
+}
+
+JSONTEST_FIXTURE(ParallelReaderTest, sameAsSequential)
+{
+    std::string text = parallel_sample();
+    json::char_reader_builder sequential;
+    json::char_reader_builder parallel;
+    parallel["threads"] = 4;
+    json::char_reader* sequential_reader = sequential.new_char_reader();
+    json::char_reader* parallel_reader = parallel.new_char_reader();
+    json::value expected;
+    json::value root;
+    std::string errs;
+    JSONTEST_ASSERT(sequential_reader->parse(text.data(), text.data() + text.size(), &expected, &errs));
+    JSONTEST_ASSERT(parallel_reader->parse(text.data(), text.data() + text.size(), &root, &errs));
+    JSONTEST_ASSERT(errs.size() == 0);
+    JSONTEST_ASSERT(expected == root);
+    JSONTEST_ASSERT_EQUAL(4000u, root.size());
+    JSONTEST_ASSERT_EQUAL(expected.get_offset_start(), root.get_offset_start());
+    JSONTEST_ASSERT_EQUAL(expected.get_offset_limit(), root.get_offset_limit());
+    JSONTEST_ASSERT_EQUAL(expected[3999]["list"][0].get_offset_start(),
+        root[3999]["list"][0].get_offset_start());
+    delete parallel_reader;
+    delete sequential_reader;
+}
+
+JSONTEST_FIXTURE(ParallelReaderTest, errorOffsets)
+{
+    std::string text = parallel_sample();
+    text.replace(text.rfind("null"), 4, "nul!");
+    json::char_reader_builder sequential;
+    json::char_reader_builder parallel;
+    parallel["threads"] = 4;
+    json::char_reader* sequential_reader = sequential.new_char_reader();
+    json::char_reader* parallel_reader = parallel.new_char_reader();
+    json::value root;
+    std::string expected;
+    std::string errs;
+    JSONTEST_ASSERT(!sequential_reader->parse(text.data(), text.data() + text.size(), &root, &expected));
+    JSONTEST_ASSERT(!parallel_reader->parse(text.data(), text.data() + text.size(), &root, &errs));
+    JSONTEST_ASSERT_STRING_EQUAL(expected, errs);
+    JSONTEST_ASSERT(errs.find("Line 4001") != std::string::npos);
+    delete parallel_reader;
+    delete sequential_reader;
+}
+
+JSONTEST_FIXTURE(ParallelReaderTest, stackLimit)
+{
+    std::string text = parallel_sample();
+    json::char_reader_builder b;
+    b["threads"] = 4;
+    b["stack_limit"] = 2;
+    json::char_reader* reader = b.new_char_reader();
+    json::value root;
+    std::string errs;
+    JSONTEST_ASSERT_THROWS(reader->parse(text.data(), text.data() + text.size(), &root, &errs));
+    delete reader;
+}
+
+JSONTEST_FIXTURE(ParallelReaderTest, badThreads)
+{
+    json::char_reader_builder b;
+    b["threads"] = -1;
+    JSONTEST_ASSERT_THROWS(b.new_char_reader());
+}
+
+struct CursorTest : JsonTest::TestCase {
+};
+
+// Events of a whole document, one letter each, for both engines.
+static std::string cursor_events(json::char_reader_builder const& b, std::string const& text)
+{
+    static char const letters[] = "-{}[]ksnbz.!";
+    json::cursor in(b);
+    in.reset(text.data(), text.data() + text.size());
+    std::string events;
+    for (;;) {
+        json::event_type e = in.next();
+        events += letters[e];
+        if (e == json::et_end_of_stream || e == json::et_error)
+            return events;
+    }
+}
+
+JSONTEST_FIXTURE(CursorTest, events)
+{
+    char const* engines[] = { "classic", "simd" };
+    for (int i = 0; i < 2; ++i) {
+        json::char_reader_builder b;
+        b["engine"] = engines[i];
+        JSONTEST_ASSERT_STRING_EQUAL("{ksk[nbzs]k{}k[]}.",
+            cursor_events(b, "{\"a\": \"x\", \"b\": [1, true, null, \"}\"], \"c\": {}, \"d\": []}"));
+        JSONTEST_ASSERT_STRING_EQUAL("n.", cursor_events(b, " 12 "));
+        JSONTEST_ASSERT_STRING_EQUAL("[n!", cursor_events(b, "[1 2]"));
+        JSONTEST_ASSERT_STRING_EQUAL("{k!", cursor_events(b, "{\"a\" 1}"));
+        JSONTEST_ASSERT_STRING_EQUAL("{ks!", cursor_events(b, "{\"a\": \"b\""));
+    }
+    json::char_reader_builder b;
+    b["fail_if_extra"] = true;
+    JSONTEST_ASSERT_STRING_EQUAL("[]!", cursor_events(b, "[] 1"));
+    b["strict_root"] = true;
+    JSONTEST_ASSERT_STRING_EQUAL("!", cursor_events(b, "1"));
+    json::char_reader_builder::strict_mode(&b.settings_);
+    b["allow_dropped_null_placeholders"] = true;
+    JSONTEST_ASSERT_STRING_EQUAL("[zznz].", cursor_events(b, "[,,1,]"));
+}
+
+JSONTEST_FIXTURE(CursorTest, skip)
+{
+    std::string text = "{\"a\": {\"x\": [\"]\\\"}\", {}]}, \"b\": 2, \"c\": [[1], \"[\"]}";
+    char const* engines[] = { "classic", "simd" };
+    for (int i = 0; i < 2; ++i) {
+        json::char_reader_builder b;
+        b["engine"] = engines[i];
+        json::cursor in(b);
+        in.reset(text.data(), text.data() + text.size());
+        JSONTEST_ASSERT(in.next() == json::et_begin_object);
+        JSONTEST_ASSERT_EQUAL(0, in.depth());
+        JSONTEST_ASSERT(in.next() == json::et_key);
+        JSONTEST_ASSERT_EQUAL(1, in.depth());
+        JSONTEST_ASSERT(in.skip());
+        JSONTEST_ASSERT_STRING_EQUAL("{\"x\": [\"]\\\"}\", {}]}",
+            text.substr(in.get_offset_start(), in.get_offset_limit() - in.get_offset_start()));
+        JSONTEST_ASSERT(in.next() == json::et_key);
+        JSONTEST_ASSERT_EQUAL(27u, in.get_offset_start());
+        JSONTEST_ASSERT(in.skip());
+        JSONTEST_ASSERT_STRING_EQUAL("2",
+            text.substr(in.get_offset_start(), in.get_offset_limit() - in.get_offset_start()));
+        JSONTEST_ASSERT(in.next() == json::et_key);
+        JSONTEST_ASSERT(in.next() == json::et_begin_array);
+        JSONTEST_ASSERT_EQUAL(1, in.depth());
+        JSONTEST_ASSERT(in.skip());
+        JSONTEST_ASSERT_STRING_EQUAL("[[1], \"[\"]",
+            text.substr(in.get_offset_start(), in.get_offset_limit() - in.get_offset_start()));
+        JSONTEST_ASSERT(in.next() == json::et_end_object);
+        JSONTEST_ASSERT(in.next() == json::et_end_of_stream);
+    }
+}
+
+JSONTEST_FIXTURE(CursorTest, skipErrors)
+{
+    char const* engines[] = { "classic", "simd" };
+    for (int i = 0; i < 2; ++i) {
+        json::char_reader_builder b;
+        b["engine"] = engines[i];
+        json::cursor in(b);
+        std::string text = "{\"a\": [1, {\"b\": 2]]}";
+        in.reset(text.data(), text.data() + text.size());
+        in.next();
+        in.next();
+        JSONTEST_ASSERT(!in.skip());
+        JSONTEST_ASSERT(in.event() == json::et_error);
+        JSONTEST_ASSERT(in.next() == json::et_error);
+        JSONTEST_ASSERT_STRING_EQUAL(
+            "* Line 1, Column 18\n  Missing ',' or '}' in object declaration\n",
+            in.get_formatted_messages());
+        text = "[\"abc]";
+        in.reset(text.data(), text.data() + text.size());
+        in.next();
+        JSONTEST_ASSERT(!in.skip());
+        JSONTEST_ASSERT_STRING_EQUAL(
+            "* Line 1, Column 2\n  Missing closing quote at end of string\n",
+            in.get_formatted_messages());
+    }
+}
+
+JSONTEST_FIXTURE(CursorTest, payload)
+{
+    std::string text = "{\"id\": -7, \"name\": \"a\\tb\", \"ok\": true, \"x\": 1.5,"
+                       " \"tags\": [\"p\", {\"q\": null}], \"n\": null}";
+    char const* engines[] = { "classic", "simd" };
+    for (int i = 0; i < 2; ++i) {
+        json::char_reader_builder b;
+        b["engine"] = engines[i];
+        json::cursor in(b);
+        in.reset(text.data(), text.data() + text.size());
+        JSONTEST_ASSERT(in.next() == json::et_begin_object);
+        JSONTEST_ASSERT(in.next() == json::et_key);
+        char const* str;
+        char const* end;
+        JSONTEST_ASSERT(in.get_string(&str, &end));
+        JSONTEST_ASSERT(str == text.data() + 2); // not copied
+        JSONTEST_ASSERT(in.is_key("id"));
+        JSONTEST_ASSERT(!in.is_key("i"));
+        JSONTEST_ASSERT(in.next() == json::et_number);
+        JSONTEST_ASSERT(!in.is_key("id"));
+        JSONTEST_ASSERT_EQUAL(-7, in.as_int());
+        JSONTEST_ASSERT_EQUAL(-7.0, in.as_double());
+        JSONTEST_ASSERT_THROWS(in.as_uint());
+        in.next();
+        JSONTEST_ASSERT(in.next() == json::et_string);
+        JSONTEST_ASSERT_STRING_EQUAL("a\tb", in.as_string());
+        in.next();
+        JSONTEST_ASSERT(in.next() == json::et_bool);
+        JSONTEST_ASSERT_EQUAL(true, in.as_bool());
+        in.next();
+        JSONTEST_ASSERT(in.next() == json::et_number);
+        JSONTEST_ASSERT_EQUAL(1.5, in.as_double());
+        JSONTEST_ASSERT(in.next() == json::et_key);
+        JSONTEST_ASSERT(in.next() == json::et_begin_array);
+        JSONTEST_ASSERT_THROWS(in.as_int());
+        json::value tags;
+        JSONTEST_ASSERT(in.get_value(&tags));
+        JSONTEST_ASSERT_EQUAL(2u, tags.size());
+        JSONTEST_ASSERT_STRING_EQUAL("p", tags[0].as_string());
+        JSONTEST_ASSERT(tags[1].is_member("q"));
+        JSONTEST_ASSERT_EQUAL(57u, tags.get_offset_start());
+        JSONTEST_ASSERT(in.next() == json::et_key);
+        JSONTEST_ASSERT(in.is_key("n"));
+        JSONTEST_ASSERT(in.next() == json::et_null);
+        json::value n(1);
+        JSONTEST_ASSERT(in.get_value(&n));
+        JSONTEST_ASSERT(n.is_null());
+        JSONTEST_ASSERT(in.next() == json::et_end_object);
+        JSONTEST_ASSERT(in.next() == json::et_end_of_stream);
+    }
+}
+
+JSONTEST_FIXTURE(CursorTest, payloadErrors)
+{
+    json::char_reader_builder b;
+    json::cursor in(b);
+    std::string text = "[\"a\\qb\", 1]";
+    in.reset(text.data(), text.data() + text.size());
+    in.next();
+    // The bad escape is only found when the string is decoded.
+    JSONTEST_ASSERT(in.next() == json::et_string);
+    JSONTEST_ASSERT_THROWS(in.as_string());
+    JSONTEST_ASSERT(in.event() == json::et_error);
+    JSONTEST_ASSERT(in.next() == json::et_error);
+    JSONTEST_ASSERT_STRING_EQUAL(
+        "* Line 1, Column 2\n  Bad escape sequence in string\nSee Line 1, Column 6 for detail.\n",
+        in.get_formatted_messages());
+
+    text = "[[1, 2 3], 4]";
+    in.reset(text.data(), text.data() + text.size());
+    in.next();
+    in.next();
+    json::value inner;
+    JSONTEST_ASSERT(!in.get_value(&inner));
+    JSONTEST_ASSERT(in.event() == json::et_error);
+    JSONTEST_ASSERT_STRING_EQUAL(
+        "* Line 1, Column 8\n  Missing ',' or ']' in array declaration\n",
+        in.get_formatted_messages());
+}
+
+struct BindTest : JsonTest::TestCase {
+};
+
+struct bound_point {
+    bound_point()
+        : x(0)
+        , y(0)
+        , visible(false)
+    {
+    }
+    int32_t x;
+    int32_t y;
+    bool visible;
+    std::string label;
+    std::vector<bound_point> links;
+    json::value extra;
+};
+
+namespace json {
+template <>
+struct bind<bound_point> {
+    template <typename Fields>
+    static void fields(Fields& f)
+    {
+        f("x", &bound_point::x);
+        f("y", &bound_point::y);
+        f("visible", &bound_point::visible);
+        f("label", &bound_point::label);
+        f("links", &bound_point::links);
+        f("extra", &bound_point::extra);
+    }
+};
+}
+
+JSONTEST_FIXTURE(BindTest, roundTrip)
+{
+    std::string text = "{\"x\": 1, \"unknown\": {\"x\": [2]}, \"y\": -2, \"la\\u0062el\": \"a\\\"b\","
+                       " \"visible\": null, \"links\": [{\"x\": 3, \"links\": []}],"
+                       " \"extra\": [true, {}]}";
+    json::char_reader_builder b;
+    bound_point p;
+    p.visible = true;
+    std::string errs;
+    JSONTEST_ASSERT(json::parse_bound(b, text.data(), text.data() + text.size(), &p, &errs));
+    JSONTEST_ASSERT_STRING_EQUAL("", errs);
+    JSONTEST_ASSERT_EQUAL(1, p.x);
+    JSONTEST_ASSERT_EQUAL(-2, p.y);
+    JSONTEST_ASSERT_EQUAL(true, p.visible); // null keeps the value
+    JSONTEST_ASSERT_STRING_EQUAL("a\"b", p.label);
+    JSONTEST_ASSERT_EQUAL(1u, p.links.size());
+    JSONTEST_ASSERT_EQUAL(3, p.links[0].x);
+    JSONTEST_ASSERT_EQUAL(2u, p.extra.size());
+
+    std::ostringstream out;
+    json::write_bound(out, p);
+    std::string const expected = "{\"x\":1,\"y\":-2,\"visible\":true,\"label\":\"a\\\"b\","
+                                 "\"links\":[{\"x\":3,\"y\":0,\"visible\":false,\"label\":\"\","
+                                 "\"links\":[],\"extra\":null}],\"extra\":[true,{}]}";
+    JSONTEST_ASSERT_STRING_EQUAL(expected, out.str());
+
+    bound_point again;
+    JSONTEST_ASSERT(json::parse_bound(b, expected.data(), expected.data() + expected.size(), &again, 0));
+    std::ostringstream out_again;
+    json::write_bound(out_again, again);
+    JSONTEST_ASSERT_STRING_EQUAL(expected, out_again.str());
+}
+
+JSONTEST_FIXTURE(BindTest, errors)
+{
+    json::char_reader_builder b;
+    bound_point p;
+    std::string errs;
+    char const* text = "{\"x\": \"1\"}";
+    JSONTEST_ASSERT(!json::parse_bound(b, text, text + std::strlen(text), &p, &errs));
+    JSONTEST_ASSERT_STRING_EQUAL("* Line 1, Column 7\n  Expected a number\n", errs);
+    text = "{\"x\": 1,\n \"y\": 3000000000}";
+    JSONTEST_ASSERT(!json::parse_bound(b, text, text + std::strlen(text), &p, &errs));
+    JSONTEST_ASSERT_STRING_EQUAL("* Line 2, Column 7\n  Number out of range for int32_t\n", errs);
+    text = "[1]";
+    JSONTEST_ASSERT(!json::parse_bound(b, text, text + std::strlen(text), &p, &errs));
+    JSONTEST_ASSERT_STRING_EQUAL("* Line 1, Column 1\n  Expected an object\n", errs);
+    text = "{\"links\": [{\"x\": 1]}";
+    JSONTEST_ASSERT(!json::parse_bound(b, text, text + std::strlen(text), &p, &errs));
+    JSONTEST_ASSERT_STRING_EQUAL(
+        "* Line 1, Column 19\n  Missing ',' or '}' in object declaration\n", errs);
+    std::vector<int32_t> numbers;
+    text = "[1, 2, 3] 4";
+    JSONTEST_ASSERT(json::parse_bound(b, text, text + std::strlen(text), &numbers, &errs));
+    JSONTEST_ASSERT_EQUAL(3u, numbers.size());
+    b["fail_if_extra"] = true;
+    JSONTEST_ASSERT(!json::parse_bound(b, text, text + std::strlen(text), &numbers, &errs));
+}
+
+JSONTEST_FIXTURE(BindTest, keyTable)
+{
+    json::key_table keys;
+    std::vector<std::string> names;
+    for (int i = 0; i < 200; ++i) {
+        std::ostringstream name;
+        name << "member" << i;
+        names.push_back(name.str());
+        keys.add(names.back().c_str());
+    }
+    for (int i = 0; i < 200; ++i) {
+        std::string const& name = names[i];
+        JSONTEST_ASSERT_EQUAL(i, keys.find(name.data(), name.data() + name.size()));
+    }
+    char const missing[] = "member200";
+    JSONTEST_ASSERT_EQUAL(-1, keys.find(missing, missing + 9));
+    JSONTEST_ASSERT_EQUAL(-1, keys.find(missing, missing));
+    JSONTEST_ASSERT_EQUAL(-1, json::key_table().find(missing, missing + 9));
+}
+
+struct EmitterTest : JsonTest::TestCase {
+};
+
+JSONTEST_FIXTURE(EmitterTest, sameAsWriter)
+{
+    json::value root;
+    root["name"] = "a\tb";
+    root["empty"] = json::value(json::vt_object);
+    root["short"].append(1);
+    root["short"].append(json::value(json::vt_array));
+    root["short"].append(json::value());
+    for (int i = 0; i < 30; ++i)
+        root["long"].append(i);
+    root["nested"].append(json::value(json::vt_array));
+    root["nested"][1]["x"] = 1.5;
+    root["nested"][1]["y"].append(true);
+    char const* styles[] = { "all", "none" };
+    char const* indentations[] = { "   ", "" };
+    for (int i = 0; i < 4; ++i) {
+        json::stream_writer_builder b;
+        b["comment_style"] = styles[i % 2];
+        b["indentation"] = indentations[i / 2];
+        std::ostringstream out;
+        json::emitter e(b, &out);
+        JSONTEST_ASSERT(!e.done());
+        e.value(root);
+        JSONTEST_ASSERT(e.done());
+        JSONTEST_ASSERT_STRING_EQUAL(json::write_string(b, root), out.str());
+    }
+}
+
+JSONTEST_FIXTURE(EmitterTest, pieces)
+{
+    json::stream_writer_builder b;
+    b["comment_style"] = "none";
+    b["indentation"] = "   ";
+    std::ostringstream out;
+    json::emitter e(b, &out);
+    e.begin_object();
+    e.key("id");
+    e.value(42);
+    e.key(std::string("tags"));
+    e.begin_array();
+    e.value("x");
+    e.begin_object();
+    e.end_object();
+    e.null();
+    e.end_array();
+    e.key("more");
+    e.begin_array();
+    e.begin_array();
+    e.value(true);
+    e.end_array();
+    e.end_array();
+    e.end_object();
+    JSONTEST_ASSERT(e.done());
+    JSONTEST_ASSERT_STRING_EQUAL("{\n   \"id\" : 42,\n   \"tags\" : [ \"x\", {}, null ],\n"
+                                 "   \"more\" : \n   [\n      [ true ]\n   ]\n}",
+        out.str());
+}
+
+JSONTEST_FIXTURE(EmitterTest, outOfOrder)
+{
+    json::stream_writer_builder b;
+    std::ostringstream out;
+    json::emitter e(b, &out);
+    e.begin_object();
+    JSONTEST_ASSERT_THROWS(e.value(1));
+    JSONTEST_ASSERT_THROWS(e.end_array());
+    e.key("a");
+    JSONTEST_ASSERT_THROWS(e.key("b"));
+    JSONTEST_ASSERT_THROWS(e.end_object());
+    e.value(1);
+    e.end_object();
+    JSONTEST_ASSERT_THROWS(e.value(2));
+    JSONTEST_ASSERT_THROWS(e.begin_array());
+}
+
+struct CborTest : JsonTest::TestCase {
+};
+
+static std::string cbor_hex(json::value const& root)
+{
+    json::cbor_writer_builder b;
+    std::string const bytes = json::write_string(b, root);
+    std::string hex;
+    for (size_t index = 0; index != bytes.size(); ++index) {
+        char digits[3];
+        snprintf(digits, sizeof digits, "%02x", static_cast<unsigned char>(bytes[index]));
+        hex += digits;
+    }
+    return hex;
+}
+
+static bool cbor_parse(std::string const& bytes, json::value* root, std::string* errs)
+{
+    json::cbor_reader_builder b;
+    b["reject_dup_keys"] = true;
+    json::char_reader* reader(b.new_char_reader());
+    bool ok = reader->parse(bytes.data(), bytes.data() + bytes.size(), root, errs);
+    delete reader;
+    return ok;
+}
+
+JSONTEST_FIXTURE(CborTest, encode)
+{
+    // From RFC 8949, appendix A.
+    JSONTEST_ASSERT_STRING_EQUAL("17", cbor_hex(23));
+    JSONTEST_ASSERT_STRING_EQUAL("1818", cbor_hex(24));
+    JSONTEST_ASSERT_STRING_EQUAL("1903e8", cbor_hex(1000));
+    JSONTEST_ASSERT_STRING_EQUAL("1b000000e8d4a51000", cbor_hex(json::largest_int_t(1000000000000LL)));
+    JSONTEST_ASSERT_STRING_EQUAL("1bffffffffffffffff", cbor_hex(json::largest_uint_t(18446744073709551615ull)));
+    JSONTEST_ASSERT_STRING_EQUAL("3903e7", cbor_hex(-1000));
+    JSONTEST_ASSERT_STRING_EQUAL("f90000", cbor_hex(0.0));
+    JSONTEST_ASSERT_STRING_EQUAL("f98000", cbor_hex(-0.0));
+    JSONTEST_ASSERT_STRING_EQUAL("f93c00", cbor_hex(1.0));
+    JSONTEST_ASSERT_STRING_EQUAL("fb3ff199999999999a", cbor_hex(1.1));
+    JSONTEST_ASSERT_STRING_EQUAL("f97bff", cbor_hex(65504.0));
+    JSONTEST_ASSERT_STRING_EQUAL("fa47c35000", cbor_hex(100000.0));
+    JSONTEST_ASSERT_STRING_EQUAL("f90001", cbor_hex(5.960464477539063e-8));
+    JSONTEST_ASSERT_STRING_EQUAL("fb7e37e43c8800759c", cbor_hex(1.0e+300));
+    JSONTEST_ASSERT_STRING_EQUAL("f4", cbor_hex(false));
+    JSONTEST_ASSERT_STRING_EQUAL("f5", cbor_hex(true));
+    JSONTEST_ASSERT_STRING_EQUAL("f6", cbor_hex(json::value()));
+    JSONTEST_ASSERT_STRING_EQUAL("6449455446", cbor_hex("IETF"));
+    JSONTEST_ASSERT_STRING_EQUAL("60", cbor_hex(json::value(json::vt_string)));
+    json::value root;
+    root["a"] = 1;
+    root["b"].append(2);
+    root["b"].append(3);
+    JSONTEST_ASSERT_STRING_EQUAL("a26161016162820203", cbor_hex(root));
+    // The elements an array was never given are null.
+    json::value sparse;
+    sparse[0] = 1;
+    sparse[3] = 5;
+    JSONTEST_ASSERT_STRING_EQUAL("8401f6f605", cbor_hex(sparse));
+}
+
+JSONTEST_FIXTURE(CborTest, roundTrip)
+{
+    json::value root;
+    root["int"] = json::largest_int_t(-9223372036854775807LL - 1);
+    root["uint"] = json::largest_uint_t(18446744073709551615ull);
+    root["small"] = 7;
+    root["real"].append(0.1);
+    root["real"].append(3.0);
+    root["real"].append(1e-310);
+    root["real"].append(-65504.0);
+    root["string"] = std::string("nul\0and \xc3\xa9", 9);
+    root["nested"]["empty"] = json::value(json::vt_array);
+    root["nested"]["none"] = json::value(json::vt_object);
+    root["nested"]["flag"] = true;
+    json::cbor_writer_builder wide;
+    wide["compact_floats"] = false;
+    for (int compact = 0; compact < 2; ++compact) {
+        std::string const bytes = compact ? json::write_string(json::cbor_writer_builder(), root)
+                                          : json::write_string(wide, root);
+        json::value decoded;
+        std::string errs;
+        JSONTEST_ASSERT(cbor_parse(bytes, &decoded, &errs));
+        JSONTEST_ASSERT_STRING_EQUAL("", errs);
+        JSONTEST_ASSERT(decoded == root);
+        JSONTEST_ASSERT_EQUAL(json::vt_uint, decoded["uint"].type());
+        JSONTEST_ASSERT_EQUAL(json::vt_real, decoded["real"][1].type());
+        JSONTEST_ASSERT_EQUAL(bytes.size(), decoded.get_offset_limit());
+    }
+}
+
+JSONTEST_FIXTURE(CborTest, decode)
+{
+    json::value root;
+    std::string errs;
+    // Indefinite lengths, a tag, undefined and a single precision float.
+    std::string const bytes("\xbf\x61\x61\x9f\x01\xff\x7f\x61\x62\x61\x63\xff\xc1\x1a\x51\x4b\x67\xb0\x61\x75\xf7\x61\x66\xfa\x3f\x80\x00\x00\xff", 29);
+    JSONTEST_ASSERT(cbor_parse(bytes, &root, &errs));
+    JSONTEST_ASSERT_EQUAL(1, root["a"][0].as_int());
+    JSONTEST_ASSERT_EQUAL(1363896240, root["bc"].as_int());
+    JSONTEST_ASSERT(root["u"].is_null());
+    JSONTEST_ASSERT_EQUAL(1.0, root["f"].as_double());
+    JSONTEST_ASSERT_EQUAL(12u, root["bc"].get_offset_start());
+
+    JSONTEST_ASSERT(!cbor_parse(std::string("\x82\x01", 2), &root, &errs));
+    JSONTEST_ASSERT_STRING_EQUAL("* Byte 1\n  Unexpected end of data\n", errs);
+    JSONTEST_ASSERT(!cbor_parse(std::string("\x01\x02", 2), &root, &errs));
+    JSONTEST_ASSERT_STRING_EQUAL("* Byte 1\n  Extra data after the root item\n", errs);
+    JSONTEST_ASSERT(!cbor_parse(std::string("\xa1\x01\x02", 3), &root, &errs));
+    JSONTEST_ASSERT_STRING_EQUAL("* Byte 1\n  Map key is not a string\n", errs);
+    JSONTEST_ASSERT(!cbor_parse(std::string("\xa2\x61\x61\x01\x61\x61\x02", 7), &root, &errs));
+    JSONTEST_ASSERT_STRING_EQUAL("* Byte 4\n  Duplicate key: 'a'\n", errs);
+    JSONTEST_ASSERT(!cbor_parse(std::string("\x3b\x80\x00\x00\x00\x00\x00\x00\x00", 9), &root, &errs));
+    JSONTEST_ASSERT_STRING_EQUAL("* Byte 0\n  Negative integer below the range of vt_int\n", errs);
+    JSONTEST_ASSERT(!cbor_parse(std::string("\xc2\x41\x01", 3), &root, &errs));
+    JSONTEST_ASSERT(!cbor_parse(std::string("\x9b\xff\xff\xff\xff\xff\xff\xff\xff", 9), &root, &errs));
+    JSONTEST_ASSERT(!cbor_parse(std::string("\xff", 1), &root, &errs));
+    JSONTEST_ASSERT(!cbor_parse(std::string("\x1f", 1), &root, &errs));
+}
+
+struct MsgpackTest : JsonTest::TestCase {
+};
+
+static std::string msgpack_hex(json::value const& root)
+{
+    json::msgpack_writer_builder b;
+    std::string const bytes = json::write_string(b, root);
+    std::string hex;
+    for (size_t index = 0; index != bytes.size(); ++index) {
+        char digits[3];
+        snprintf(digits, sizeof digits, "%02x", static_cast<unsigned char>(bytes[index]));
+        hex += digits;
+    }
+    return hex;
+}
+
+JSONTEST_FIXTURE(MsgpackTest, encode)
+{
+    JSONTEST_ASSERT_STRING_EQUAL("7f", msgpack_hex(127));
+    JSONTEST_ASSERT_STRING_EQUAL("cc80", msgpack_hex(128));
+    JSONTEST_ASSERT_STRING_EQUAL("cd0100", msgpack_hex(256));
+    JSONTEST_ASSERT_STRING_EQUAL("cfffffffffffffffff", msgpack_hex(json::largest_uint_t(18446744073709551615ull)));
+    JSONTEST_ASSERT_STRING_EQUAL("e0", msgpack_hex(-32));
+    JSONTEST_ASSERT_STRING_EQUAL("d0df", msgpack_hex(-33));
+    JSONTEST_ASSERT_STRING_EQUAL("d1ff7f", msgpack_hex(-129));
+    JSONTEST_ASSERT_STRING_EQUAL("d38000000000000000", msgpack_hex(json::largest_int_t(-9223372036854775807LL - 1)));
+    JSONTEST_ASSERT_STRING_EQUAL("ca3fc00000", msgpack_hex(1.5));
+    JSONTEST_ASSERT_STRING_EQUAL("cb3fb999999999999a", msgpack_hex(0.1));
+    JSONTEST_ASSERT_STRING_EQUAL("c0", msgpack_hex(json::value()));
+    JSONTEST_ASSERT_STRING_EQUAL("c3", msgpack_hex(true));
+    JSONTEST_ASSERT_STRING_EQUAL("a3616263", msgpack_hex("abc"));
+    JSONTEST_ASSERT_STRING_EQUAL("a0", msgpack_hex(json::value(json::vt_string)));
+    JSONTEST_ASSERT_STRING_EQUAL("d920", msgpack_hex(std::string(32, ' ')).substr(0, 4));
+    json::value root;
+    root["a"] = 1;
+    root["b"].append(2);
+    root["b"].append(3);
+    JSONTEST_ASSERT_STRING_EQUAL("82a16101a162920203", msgpack_hex(root));
+    root["b"].resize(16);
+    JSONTEST_ASSERT_STRING_EQUAL("dc0010", msgpack_hex(root["b"]).substr(0, 6));
+    // The elements an array was never given are nil.
+    json::value sparse;
+    sparse[0] = 1;
+    sparse[3] = 5;
+    JSONTEST_ASSERT_STRING_EQUAL("9401c0c005", msgpack_hex(sparse));
+}
+
+JSONTEST_FIXTURE(MsgpackTest, roundTrip)
+{
+    json::value root;
+    root["int"] = json::largest_int_t(-9223372036854775807LL - 1);
+    root["uint"] = json::largest_uint_t(18446744073709551615ull);
+    root["small"] = -7;
+    root["real"].append(0.1);
+    root["real"].append(3.0);
+    root["real"].append(-1e300);
+    root["string"] = std::string("nul\0and \xc3\xa9", 9);
+    root["long"] = std::string(70000, 'x');
+    root["nested"]["empty"] = json::value(json::vt_array);
+    root["nested"]["none"] = json::value(json::vt_object);
+    root["nested"]["flag"] = false;
+    std::string const bytes = json::write_string(json::msgpack_writer_builder(), root);
+    json::msgpack_reader_builder b;
+    json::char_reader* reader(b.new_char_reader());
+    json::value decoded;
+    std::string errs;
+    JSONTEST_ASSERT(reader->parse(bytes.data(), bytes.data() + bytes.size(), &decoded, &errs));
+    JSONTEST_ASSERT(decoded == root);
+    JSONTEST_ASSERT_EQUAL(json::vt_real, decoded["real"][1].type());
+    JSONTEST_ASSERT_EQUAL(bytes.size(), decoded.get_offset_limit());
+
+    JSONTEST_ASSERT(!reader->parse(bytes.data(), bytes.data() + bytes.size() - 1, &decoded, &errs));
+    std::string const ext("\xd4\x01\x00", 3);
+    JSONTEST_ASSERT(!reader->parse(ext.data(), ext.data() + ext.size(), &decoded, &errs));
+    JSONTEST_ASSERT_STRING_EQUAL("* Byte 0\n  Extension types are not supported\n", errs);
+    std::string const key("\x81\x01\x02", 3);
+    JSONTEST_ASSERT(!reader->parse(key.data(), key.data() + key.size(), &decoded, &errs));
+    JSONTEST_ASSERT_STRING_EQUAL("* Byte 1\n  Map key is not a string\n", errs);
+    delete reader;
+}
+
+JSONTEST_FIXTURE(MsgpackTest, stream)
+{
+    json::value first;
+    first["id"] = 1;
+    first["tags"].append(std::string(300, 't'));
+    json::value second(json::vt_array);
+    second.append(2.5);
+    std::string bytes = json::write_string(json::msgpack_writer_builder(), first)
+        + json::write_string(json::msgpack_writer_builder(), second);
+    bytes += std::string("\x92\xc1\x01", 3); // invalid, but its extent is known
+    bytes += std::string("\x05", 1);
+
+    // Fed byte by byte, each message comes out when its last byte is in.
+    json::msgpack_reader_builder b;
+    json::msgpack_stream in(b);
+    std::vector<json::value> messages;
+    int errors = 0;
+    for (size_t index = 0; index != bytes.size(); ++index) {
+        in.feed(&bytes[index], &bytes[index] + 1);
+        json::value message;
+        while (in.next(&message))
+            messages.push_back(message);
+        if (!in.good()) {
+            JSONTEST_ASSERT_STRING_EQUAL("* Byte 1\n  Format 0xc1 is never used\n", in.get_formatted_messages());
+            ++errors;
+        }
+    }
+    JSONTEST_ASSERT_EQUAL(1, errors);
+    JSONTEST_ASSERT_EQUAL(3u, messages.size());
+    JSONTEST_ASSERT(messages[0] == first);
+    JSONTEST_ASSERT(messages[1] == second);
+    JSONTEST_ASSERT_EQUAL(5, messages[2].as_int());
+    JSONTEST_ASSERT_EQUAL(0u, in.buffered());
+
+    // A partial message stays buffered until the rest is fed.
+    in.feed(bytes.data(), bytes.data() + 10);
+    json::value message;
+    JSONTEST_ASSERT(!in.next(&message));
+    JSONTEST_ASSERT(in.good());
+    JSONTEST_ASSERT_EQUAL(10u, in.buffered());
+    in.feed(bytes.data() + 10, bytes.data() + bytes.size());
+    JSONTEST_ASSERT(in.next(&message));
+    JSONTEST_ASSERT(message == first);
+    in.reset();
+    JSONTEST_ASSERT_EQUAL(0u, in.buffered());
+}
+
+struct SnapshotTest : JsonTest::TestCase {
+};
+
+JSONTEST_FIXTURE(SnapshotTest, sameAsValue)
+{
+    json::value root;
+    root["int"] = -5;
+    root["int64"] = json::largest_int_t(-9223372036854775807LL - 1);
+    root["uint"] = json::largest_uint_t(4000000000u);
+    root["uint64"] = json::largest_uint_t(18446744073709551615ull);
+    root["real"] = 0.1;
+    root["flags"].append(true);
+    root["flags"].append(false);
+    root["flags"].append(json::value());
+    root["text"] = std::string("with\0zero", 9);
+    root["nested"]["text"] = std::string("with\0zero", 9);
+    root["nested"]["empty"] = json::value(json::vt_object);
+    root["b"] = 1;
+    root["ba"] = 2;
+    root[""] = 3;
+    std::string const bytes = json::write_snapshot(root);
+
+    json::snapshot doc;
+    std::string errs;
+    JSONTEST_ASSERT(doc.reset(bytes.data(), bytes.data() + bytes.size(), &errs));
+    JSONTEST_ASSERT_STRING_EQUAL("", errs);
+    JSONTEST_ASSERT_EQUAL(bytes.size(), doc.size());
+    json::snapshot_view view = doc.root();
+    JSONTEST_ASSERT(view.to_value() == root);
+    JSONTEST_ASSERT_EQUAL(json::vt_uint, view["uint"].type());
+    JSONTEST_ASSERT_EQUAL(-5, view["int"].as_int());
+    JSONTEST_ASSERT_EQUAL(2, view["ba"].as_int());
+    JSONTEST_ASSERT_EQUAL(3, view[""].as_int());
+    JSONTEST_ASSERT(view["bb"].is_null());
+    JSONTEST_ASSERT(view["flags"][1].is_bool());
+    JSONTEST_ASSERT(view["flags"][3].is_null());
+    JSONTEST_ASSERT_EQUAL(9u, view["text"].as_string().size());
+    JSONTEST_ASSERT(view["nested"]["empty"].empty());
+
+    // Members come in the order of #value.
+    json::value::members names = view.get_member_names();
+    JSONTEST_ASSERT(names == root.get_member_names());
+    for (json::snapshot_view::const_iterator it = view["flags"].begin(); it != view["flags"].end(); ++it)
+        JSONTEST_ASSERT(it->to_value() == root["flags"][it.index()]);
+
+    // Equal strings are kept once.
+    char const* first;
+    char const* second;
+    char const* end;
+    view["text"].get_string(&first, &end);
+    view["nested"]["text"].get_string(&second, &end);
+    JSONTEST_ASSERT(first == second);
+
+    // A string value that was never given one is kept as an empty string.
+    std::string const blank = json::write_snapshot(json::value(json::vt_string));
+    JSONTEST_ASSERT(doc.reset(blank.data(), blank.data() + blank.size(), &errs));
+    JSONTEST_ASSERT_EQUAL(json::vt_string, doc.root().type());
+    JSONTEST_ASSERT_STRING_EQUAL("", doc.root().as_string());
+}
+
+JSONTEST_FIXTURE(SnapshotTest, reset)
+{
+    std::string bytes = json::write_snapshot(json::value(7));
+    json::snapshot doc;
+    std::string errs;
+    JSONTEST_ASSERT(!doc.reset(bytes.data(), bytes.data() + 8, &errs));
+    JSONTEST_ASSERT_STRING_EQUAL("Not a snapshot", errs);
+    JSONTEST_ASSERT(doc.empty());
+    JSONTEST_ASSERT(doc.root().is_null());
+    bytes[4] = 2;
+    JSONTEST_ASSERT(!doc.reset(bytes.data(), bytes.data() + bytes.size(), &errs));
+    JSONTEST_ASSERT_STRING_EQUAL("Unsupported snapshot version", errs);
+    bytes[4] = 1;
+    bytes += "trailing bytes are not read";
+    JSONTEST_ASSERT(doc.reset(bytes.data(), bytes.data() + bytes.size(), &errs));
+    JSONTEST_ASSERT_EQUAL(7, doc.root().as_int());
+
+    // Offsets beyond the end read as null.
+    json::value root;
+    root["a"] = "x";
+    bytes = json::write_snapshot(root);
+    bytes[20] = char(0xff);
+    JSONTEST_ASSERT(doc.reset(bytes.data(), bytes.data() + bytes.size(), &errs));
+    JSONTEST_ASSERT_EQUAL(0u, doc.root().size());
+    JSONTEST_ASSERT(doc.root()["a"].is_null());
+}
+
+struct PathTest : JsonTest::TestCase {
+};
+
+JSONTEST_FIXTURE(PathTest, find)
+{
+    json::value root;
+    root["a"]["b"].append(1);
+    root["a"]["b"].append("two");
+    root["a"][std::string("n\0ul", 4)] = true;
+    root["c"] = 3;
+
+    json::path const two(".a.b[1]");
+    JSONTEST_ASSERT(two.find(root) == &root["a"]["b"][1]);
+    JSONTEST_ASSERT_STRING_EQUAL("two", two.resolve(root).as_string());
+    JSONTEST_ASSERT(json::path(".").find(root) == &root);
+    JSONTEST_ASSERT(json::path(".a.%", std::string("n\0ul", 4)).find(root)->as_bool());
+    JSONTEST_ASSERT_EQUAL(1, json::path(".%.b[%]", "a", json::array_index(0)).find(root)->as_int());
+
+    std::string errs;
+    JSONTEST_ASSERT(json::path(".a.b[2]").find(root, &errs) == NULL);
+    JSONTEST_ASSERT_STRING_EQUAL("Unable to resolve path at 4: index 2 is out of range", errs);
+    JSONTEST_ASSERT(json::path(".c[0]").find(root, &errs) == NULL);
+    JSONTEST_ASSERT_STRING_EQUAL("Unable to resolve path at 2: array value expected", errs);
+    JSONTEST_ASSERT(json::path(".c.d").find(root, &errs) == NULL);
+    JSONTEST_ASSERT_STRING_EQUAL("Unable to resolve path at 3: object value expected", errs);
+    JSONTEST_ASSERT(json::path(".a.x").find(root, &errs) == NULL);
+    JSONTEST_ASSERT_STRING_EQUAL("Unable to resolve path at 3: object has no member named 'x'", errs);
+    JSONTEST_ASSERT(json::path(".a.x").resolve(root).is_null());
+    JSONTEST_ASSERT_EQUAL(7, json::path(".a.x").resolve(root, 7).as_int());
+
+    // Batches take each step for every document.
+    json::value other;
+    other["a"]["b"].append(5);
+    other["a"]["b"].append(6);
+    json::value const* roots[] = { &root, &other, &other["a"] };
+    json::value const* found[3];
+    two.find(roots, 3, found);
+    JSONTEST_ASSERT(found[0] == &root["a"]["b"][1]);
+    JSONTEST_ASSERT(found[1] == &other["a"]["b"][1]);
+    JSONTEST_ASSERT(found[2] == NULL);
+}
+
+JSONTEST_FIXTURE(PathTest, errors)
+{
+    JSONTEST_ASSERT_THROWS(json::path(".a[1"));
+    JSONTEST_ASSERT_THROWS(json::path(".a[]"));
+    JSONTEST_ASSERT_THROWS(json::path(".a[x]"));
+    JSONTEST_ASSERT_THROWS(json::path(".a[99999999999]"));
+    JSONTEST_ASSERT_THROWS(json::path(".%"));
+    JSONTEST_ASSERT_THROWS(json::path(".[%]", "key"));
+    try {
+        json::path(".a[1");
+    }
+    catch (std::exception const& e) {
+        JSONTEST_ASSERT_STRING_EQUAL("Invalid path \".a[1\": expected ']' at 4", e.what());
+    }
+
+    json::value root;
+    json::path(".a[1].b").make(root) = 2;
+    JSONTEST_ASSERT_EQUAL(2, root["a"][1]["b"].as_int());
+    JSONTEST_ASSERT_THROWS(json::path(".a.b").make(root));
+}
+
+struct ExtractorTest : JsonTest::TestCase {
+};
+
+static char const extractor_doc[] = "{\"user\": {\"id\": 7, \"name\": \"ann\", \"tags\": [\"a\", \"b\", \"c\"]},"
+                                    " \"other\": [{\"x\": 1}], \"last\": null}";
+
+JSONTEST_FIXTURE(ExtractorTest, dom)
+{
+    json::extractor fields;
+    JSONTEST_ASSERT_EQUAL(0u, fields.add(json::path(".user.name")));
+    JSONTEST_ASSERT_EQUAL(1u, fields.add(json::path(".user.tags[2]")));
+    JSONTEST_ASSERT_EQUAL(2u, fields.add(json::path(".user.missing")));
+    JSONTEST_ASSERT_EQUAL(3u, fields.add(json::path(".user.tags[9]")));
+    JSONTEST_ASSERT_EQUAL(4u, fields.add(json::path(".last")));
+    JSONTEST_ASSERT_EQUAL(5u, fields.add(json::path(".user")));
+    JSONTEST_ASSERT_EQUAL(6u, fields.add(json::path(".user.name")));
+    JSONTEST_ASSERT_EQUAL(7u, fields.add(json::path(".other.x")));
+    JSONTEST_ASSERT_EQUAL(8u, fields.size());
+
+    json::value root;
+    json::reader reader;
+    JSONTEST_ASSERT(reader.parse(extractor_doc, root));
+    json::value const* found[8];
+    fields.extract(root, found);
+    JSONTEST_ASSERT(found[0] == &root["user"]["name"]);
+    JSONTEST_ASSERT(found[1] == &root["user"]["tags"][2]);
+    JSONTEST_ASSERT(found[2] == NULL);
+    JSONTEST_ASSERT(found[3] == NULL);
+    JSONTEST_ASSERT(found[4] == &root["last"]);
+    JSONTEST_ASSERT(found[5] == &root["user"]);
+    JSONTEST_ASSERT(found[6] == found[0]);
+    JSONTEST_ASSERT(found[7] == NULL);
+
+    // Enough wanted members to go through the object instead of looking
+    // each one up.
+    json::extractor many;
+    char const* names[] = { ".a", ".c", ".d", ".f", ".g" };
+    for (int i = 0; i < 5; ++i)
+        many.add(json::path(names[i]));
+    JSONTEST_ASSERT(reader.parse("{\"b\": 1, \"c\": 2, \"d\": 3, \"e\": 4, \"g\": 5}", root));
+    json::value const* members[5];
+    many.extract(root, members);
+    JSONTEST_ASSERT(members[0] == NULL);
+    JSONTEST_ASSERT(members[1] == &root["c"]);
+    JSONTEST_ASSERT(members[2] == &root["d"]);
+    JSONTEST_ASSERT(members[3] == NULL);
+    JSONTEST_ASSERT(members[4] == &root["g"]);
+}
+
+JSONTEST_FIXTURE(ExtractorTest, cursor)
+{
+    json::extractor fields;
+    fields.add(json::path(".user.tags[1]"));
+    fields.add(json::path(".user.id"));
+    fields.add(json::path(".user.missing"));
+    fields.add(json::path(".last"));
+    fields.add(json::path(".user.tags"));
+
+    json::char_reader_builder b;
+    json::cursor in(b);
+    std::string text(extractor_doc);
+    in.reset(text.data(), text.data() + text.size());
+    json::value values[5];
+    bool found[5];
+    JSONTEST_ASSERT(fields.extract(in, values, found));
+    JSONTEST_ASSERT(found[0] && values[0] == "b");
+    JSONTEST_ASSERT(found[1] && values[1] == 7);
+    JSONTEST_ASSERT(!found[2] && values[2].is_null());
+    JSONTEST_ASSERT(found[3] && values[3].is_null());
+    JSONTEST_ASSERT(found[4] && values[4].size() == 3u);
+    JSONTEST_ASSERT(in.next() == json::et_end_of_stream);
+
+    // Reading stops once every path is found: the error after it is not seen.
+    json::extractor first;
+    first.add(json::path(".a[0]"));
+    text = "{\"a\": [1, 2], \"b\": ]";
+    in.reset(text.data(), text.data() + text.size());
+    JSONTEST_ASSERT(first.extract(in, values, found));
+    JSONTEST_ASSERT(found[0] && values[0] == 1);
+    text = "{\"b\": ], \"a\": [1, 2]}";
+    in.reset(text.data(), text.data() + text.size());
+    JSONTEST_ASSERT(!first.extract(in, values, found));
+    JSONTEST_ASSERT(in.event() == json::et_error);
+}
+
+struct QueryTest : JsonTest::TestCase {
+};
+
+// The selected nodes, written compactly and separated by spaces.
+static std::string query_results(json::value const& root, char const* expression)
+{
+    std::vector<json::value const*> results;
+    json::query(expression).select(root, &results);
+    json::stream_writer_builder b;
+    b["indentation"] = "";
+    std::string written;
+    for (size_t i = 0; i < results.size(); ++i) {
+        if (i)
+            written += ' ';
+        written += json::write_string(b, *results[i]);
+    }
+    return written;
+}
+
+JSONTEST_FIXTURE(QueryTest, select)
+{
+    json::value root;
+    json::reader reader;
+    JSONTEST_ASSERT(reader.parse(
+        "{\"store\": {\"book\": ["
+        "  {\"title\": \"A\", \"price\": 8.5, \"isbn\": \"1\"},"
+        "  {\"title\": \"B\", \"price\": 12},"
+        "  {\"title\": \"C\", \"price\": 8, \"isbn\": \"2\"},"
+        "  {\"title\": \"D\", \"price\": 22.5}],"
+        " \"bicycle\": {\"price\": 20}},"
+        " \"limit\": 10, \"n\": [0, 1, 2, 3, 4, 5]}", root));
+
+    JSONTEST_ASSERT_STRING_EQUAL("\"A\" \"B\" \"C\" \"D\"", query_results(root, "$.store.book[*].title"));
+    JSONTEST_ASSERT_STRING_EQUAL("\"B\"", query_results(root, "$['store'][\"book\"][1].title"));
+    JSONTEST_ASSERT_STRING_EQUAL("\"D\" \"A\"", query_results(root, "$.store.book[-1, 0].title"));
+    JSONTEST_ASSERT_STRING_EQUAL("20 8.5 12 8 22.5", query_results(root, "$..price"));
+    JSONTEST_ASSERT_STRING_EQUAL("\"A\" \"C\"", query_results(root, "$.store.book[?@.price < 10].title"));
+    JSONTEST_ASSERT_STRING_EQUAL("\"A\" \"C\"", query_results(root, "$.store.book[?(@.price < $.limit && @.isbn)].title"));
+    JSONTEST_ASSERT_STRING_EQUAL("\"B\" \"D\"", query_results(root, "$.store.book[?!@.isbn].title"));
+    JSONTEST_ASSERT_STRING_EQUAL("\"C\"", query_results(root, "$.store.book[?@.price == 8.0 || @['title'] == 'X'].title"));
+    JSONTEST_ASSERT_STRING_EQUAL("{\"price\":20}", query_results(root, "$.store[?@.price >= 20 && @.price != 22.5]"));
+    JSONTEST_ASSERT_STRING_EQUAL("", query_results(root, "$.store.book[?@.title > 5]"));
+    JSONTEST_ASSERT_STRING_EQUAL("1 2 3", query_results(root, "$.n[1:4]"));
+    JSONTEST_ASSERT_STRING_EQUAL("0 2 4", query_results(root, "$.n[::2]"));
+    JSONTEST_ASSERT_STRING_EQUAL("5 4 3", query_results(root, "$.n[:-4:-1]"));
+    JSONTEST_ASSERT_STRING_EQUAL("4 5", query_results(root, "$.n[-2:]"));
+    JSONTEST_ASSERT_STRING_EQUAL("", query_results(root, "$.n[::0]"));
+    JSONTEST_ASSERT_STRING_EQUAL("", query_results(root, "$.n[9]"));
+    JSONTEST_ASSERT_STRING_EQUAL("", query_results(root, "$.missing[*]"));
+    JSONTEST_ASSERT_STRING_EQUAL("3 4 5", query_results(root, "$.n[?@ > 2]"));
+    JSONTEST_ASSERT(json::query("$").first(root) == &root);
+
+    json::query first("$..book[?@.price > 10]");
+    JSONTEST_ASSERT(first.first(root) == &root["store"]["book"][1]);
+    JSONTEST_ASSERT(json::query("$.nothing").first(root) == NULL);
+
+    // A step past the end of the array, however large, ends the slice.
+    JSONTEST_ASSERT_STRING_EQUAL("5", query_results(root, "$.n[5::9223372036854775807]"));
+    JSONTEST_ASSERT_STRING_EQUAL("0", query_results(root, "$.n[0::-9223372036854775807]"));
+    JSONTEST_ASSERT_STRING_EQUAL("5 0", query_results(root, "$.n[::-5]"));
+
+    // The elements an array was never given are null, and are selected too.
+    json::value sparse;
+    sparse[0] = 1;
+    sparse[4] = 5;
+    JSONTEST_ASSERT_STRING_EQUAL("1 null null null 5", query_results(sparse, "$[*]"));
+    JSONTEST_ASSERT_STRING_EQUAL("null null null", query_results(sparse, "$[?@ == null]"));
+}
+
+JSONTEST_FIXTURE(QueryTest, errors)
+{
+    JSONTEST_ASSERT_THROWS(json::query("store"));
+    JSONTEST_ASSERT_THROWS(json::query("$.store["));
+    JSONTEST_ASSERT_THROWS(json::query("$.[0]"));
+    JSONTEST_ASSERT_THROWS(json::query("$['a"));
+    JSONTEST_ASSERT_THROWS(json::query("$[?@.a = 1]"));
+    JSONTEST_ASSERT_THROWS(json::query("$[?1]"));
+    JSONTEST_ASSERT_THROWS(json::query("$[99999999999999999999]"));
+    try {
+        json::query("$.a[?@.b <]");
+    }
+    catch (std::exception const& e) {
+        JSONTEST_ASSERT_STRING_EQUAL("Invalid query \"$.a[?@.b <]\": expected a value at 10", e.what());
+    }
+}
+
+struct PatchTest : JsonTest::TestCase {
+};
+
+static json::value patch_parse(char const* text)
+{
+    json::value parsed;
+    json::reader reader;
+    reader.parse(text, parsed);
+    return parsed;
+}
+
+static std::string patch_write(json::value const& root)
+{
+    json::stream_writer_builder b;
+    b["indentation"] = "";
+    return json::write_string(b, root);
+}
+
+JSONTEST_FIXTURE(PatchTest, apply)
+{
+    json::value doc = patch_parse("{\"a\": {\"b\": [1, 2, 3]}, \"c\": \"x\", \"~/\": 0}");
+    std::string errs;
+    JSONTEST_ASSERT(json::apply_patch(doc, patch_parse("["
+        "{\"op\": \"add\", \"path\": \"/a/b/1\", \"value\": 9},"
+        "{\"op\": \"add\", \"path\": \"/a/b/-\", \"value\": 4},"
+        "{\"op\": \"remove\", \"path\": \"/a/b/0\"},"
+        "{\"op\": \"replace\", \"path\": \"/c\", \"value\": {\"d\": null}},"
+        "{\"op\": \"move\", \"from\": \"/a/b\", \"path\": \"/c/e\"},"
+        "{\"op\": \"copy\", \"from\": \"/c/e/0\", \"path\": \"/a/f\"},"
+        "{\"op\": \"test\", \"path\": \"/~0~1\", \"value\": 0.0},"
+        "{\"op\": \"add\", \"path\": \"/a/f\", \"value\": true}]"), &errs));
+    JSONTEST_ASSERT_STRING_EQUAL("", errs);
+    JSONTEST_ASSERT_STRING_EQUAL("{\"a\":{\"f\":true},\"c\":{\"d\":null,\"e\":[9,2,3,4]},\"~/\":0}",
+        patch_write(doc));
+
+    // A copy made before is left as it was.
+    json::value const copy(doc);
+    JSONTEST_ASSERT(json::apply_patch(doc, patch_parse("[{\"op\": \"replace\", \"path\": \"/c/e/0\", \"value\": 0}]")));
+    JSONTEST_ASSERT_EQUAL(9, copy["c"]["e"][0].as_int());
+    JSONTEST_ASSERT_EQUAL(0, doc["c"]["e"][0].as_int());
+
+    // The values on the way to a change are written anew, not from the source.
+    json::char_reader_builder b;
+    b["keep_source"] = true;
+    json::value kept;
+    std::istringstream in("{\"a\": [1, 2]}");
+    JSONTEST_ASSERT(json::parse_from_stream(b, in, &kept, NULL));
+    JSONTEST_ASSERT(json::apply_patch(kept, patch_parse("[{\"op\": \"replace\", \"path\": \"/a/0\", \"value\": 5}]")));
+    json::fast_writer fast;
+    fast.omit_ending_line_feed();
+    JSONTEST_ASSERT_STRING_EQUAL("{\"a\":[5,2]}", fast.write(kept));
+
+    // So is the text cached by a writer.
+    json::stream_writer_builder cached;
+    cached["cache"] = true;
+    cached["indentation"] = "";
+    json::value const& const_kept = kept;
+    JSONTEST_ASSERT_STRING_EQUAL("{\"a\":[5,2]}", json::write_string(cached, const_kept));
+    JSONTEST_ASSERT(json::apply_patch(kept, patch_parse("[{\"op\": \"add\", \"path\": \"/a/-\", \"value\": 3}]")));
+    JSONTEST_ASSERT_STRING_EQUAL("{\"a\":[5,2,3]}", json::write_string(cached, const_kept));
+
+    // The elements an array was never given are nulls to move along.
+    json::value sparse;
+    sparse[0] = "a";
+    sparse[3] = "d";
+    JSONTEST_ASSERT(json::apply_patch(sparse, patch_parse("["
+        "{\"op\": \"add\", \"path\": \"/1\", \"value\": \"b\"},"
+        "{\"op\": \"remove\", \"path\": \"/0\"},"
+        "{\"op\": \"remove\", \"path\": \"/1\"}]")));
+    JSONTEST_ASSERT_STRING_EQUAL("[\"b\",null,\"d\"]", patch_write(sparse));
+
+    JSONTEST_ASSERT(json::apply_patch(doc, patch_parse("[{\"op\": \"add\", \"path\": \"\", \"value\": [1]}]")));
+    JSONTEST_ASSERT_STRING_EQUAL("[1]", patch_write(doc));
+}
+
+JSONTEST_FIXTURE(PatchTest, rollback)
+{
+    char const* text = "{\"a\": {\"b\": [1, 2, 3]}, \"c\": \"x\"}";
+    json::value doc = patch_parse(text);
+    std::string const before = patch_write(doc);
+    std::string errs;
+    JSONTEST_ASSERT(!json::apply_patch(doc, patch_parse("["
+        "{\"op\": \"move\", \"from\": \"/a/b/0\", \"path\": \"/a/b/2\"},"
+        "{\"op\": \"remove\", \"path\": \"/c\"},"
+        "{\"op\": \"move\", \"from\": \"/a\", \"path\": \"/z\"},"
+        "{\"op\": \"replace\", \"path\": \"/z/b/0\", \"value\": 7},"
+        "{\"op\": \"add\", \"path\": \"/z/b/1\", \"value\": 8},"
+        "{\"op\": \"move\", \"from\": \"/z\", \"path\": \"/y/q\"}]"), &errs));
+    JSONTEST_ASSERT_STRING_EQUAL("Operation 5: the parent of \"/y/q\" is not an object or an array", errs);
+    JSONTEST_ASSERT_STRING_EQUAL(before, patch_write(doc));
+
+    char const* failing[] = {
+        "{}",
+        "[{\"op\": \"test\", \"path\": \"/c\", \"value\": \"y\"}]",
+        "[{\"op\": \"remove\", \"path\": \"/a/b/3\"}]",
+        "[{\"op\": \"add\", \"path\": \"/a/b/01\", \"value\": 0}]",
+        "[{\"op\": \"add\", \"path\": \"/a/b/4\", \"value\": 0}]",
+        "[{\"op\": \"move\", \"from\": \"/a\", \"path\": \"/a/b/0\"}]",
+        "[{\"op\": \"replace\", \"path\": \"a\", \"value\": 0}]",
+        "[{\"op\": \"remove\", \"path\": \"/a/~2\"}]",
+        "[{\"op\": \"frobnicate\", \"path\": \"/a\"}]",
+        "[{\"op\": \"add\", \"path\": \"/a/x\"}]",
+    };
+    for (size_t i = 0; i < sizeof failing / sizeof failing[0]; ++i) {
+        JSONTEST_ASSERT(!json::apply_patch(doc, patch_parse(failing[i]), &errs));
+        JSONTEST_ASSERT_STRING_EQUAL(before, patch_write(doc));
+    }
+}
+
+JSONTEST_FIXTURE(PatchTest, diff)
+{
+    json::value from = patch_parse("{\"a\": [1, 2, 3, 4, 5], \"b\": {\"c\": 1, \"d/\": 2}, \"e\": null}");
+    json::value to = patch_parse("{\"a\": [1, 9, 3, 5, 6], \"b\": {\"c\": 1.5, \"f\": 2}, \"e\": null}");
+    JSONTEST_ASSERT_STRING_EQUAL("["
+        "{\"op\":\"replace\",\"path\":\"/a/1\",\"value\":9},"
+        "{\"op\":\"remove\",\"path\":\"/a/3\"},"
+        "{\"op\":\"add\",\"path\":\"/a/4\",\"value\":6},"
+        "{\"op\":\"replace\",\"path\":\"/b/c\",\"value\":1.5},"
+        "{\"op\":\"remove\",\"path\":\"/b/d~1\"},"
+        "{\"op\":\"add\",\"path\":\"/b/f\",\"value\":2}]",
+        patch_write(json::diff(from, to)));
+    JSONTEST_ASSERT_EQUAL(0u, json::diff(from, from).size());
+
+    char const* pairs[][2] = {
+        { "[1, 2, 3]", "[3, 2, 1]" },
+        { "[{\"id\": 1}, {\"id\": 2}, {\"id\": 3}]", "[{\"id\": 0}, {\"id\": 2}, {\"id\": 1, \"x\": true}]" },
+        { "[[1, 2], [3]]", "[[3], [1, 2], []]" },
+        { "{\"a\": [1]}", "[1]" },
+        { "[]", "[1, 2, 3]" },
+        { "[1, 2, 3, 1, 2, 3]", "[2, 3, 1]" },
+        { "\"x\"", "{\"~\": {\"\": 1}}" },
+    };
+    for (size_t i = 0; i < sizeof pairs / sizeof pairs[0]; ++i) {
+        json::value doc = patch_parse(pairs[i][0]);
+        json::value target = patch_parse(pairs[i][1]);
+        std::string errs;
+        JSONTEST_ASSERT(json::apply_patch(doc, json::diff(doc, target), &errs));
+        JSONTEST_ASSERT_STRING_EQUAL("", errs);
+        JSONTEST_ASSERT(doc == target);
+    }
+
+    // The elements an array was never given are nulls to compare.
+    json::value sparse;
+    sparse[0] = "a";
+    sparse[3] = "d";
+    json::value full = patch_parse("[\"a\", null, null, \"d\"]");
+    json::value shorter = patch_parse("[\"a\", \"d\"]");
+    JSONTEST_ASSERT_EQUAL(0u, json::diff(sparse, full).size());
+    json::value doc = sparse;
+    JSONTEST_ASSERT(json::apply_patch(doc, json::diff(sparse, full)));
+    JSONTEST_ASSERT_STRING_EQUAL(patch_write(full), patch_write(doc));
+    JSONTEST_ASSERT(json::apply_patch(doc, json::diff(sparse, shorter)));
+    JSONTEST_ASSERT_STRING_EQUAL(patch_write(shorter), patch_write(doc));
+    doc = shorter;
+    JSONTEST_ASSERT(json::apply_patch(doc, json::diff(shorter, sparse)));
+    JSONTEST_ASSERT_STRING_EQUAL(patch_write(sparse), patch_write(doc));
+}
+
 int main(int argc, const char* argv[])
 {
     JsonTest::Runner runner;
@@ -2403,10 +4319,19 @@ int main(int argc, const char* argv[])
     //JSONTEST_REGISTER_FIXTURE(runner, ValueTest, nulls);
     JSONTEST_REGISTER_FIXTURE(runner, ValueTest, zeroes);
     JSONTEST_REGISTER_FIXTURE(runner, ValueTest, zeroesInKeys);
+    JSONTEST_REGISTER_FIXTURE(runner, ValueTest, hash);
+    JSONTEST_REGISTER_FIXTURE(runner, ValueTest, dedupe);
+    JSONTEST_REGISTER_FIXTURE(runner, ValueTest, copyOnWrite);
 
     JSONTEST_REGISTER_FIXTURE(runner, writerTest, drop_null_placeholders);
     JSONTEST_REGISTER_FIXTURE(runner, StreamwriterTest, drop_null_placeholders);
     JSONTEST_REGISTER_FIXTURE(runner, StreamwriterTest, writeZeroes);
+    JSONTEST_REGISTER_FIXTURE(runner, StreamwriterTest, escapes);
+    JSONTEST_REGISTER_FIXTURE(runner, StreamwriterTest, serializedSize);
+    JSONTEST_REGISTER_FIXTURE(runner, StreamwriterTest, threads);
+    JSONTEST_REGISTER_FIXTURE(runner, StreamwriterTest, cache);
+
+    JSONTEST_REGISTER_FIXTURE(runner, GatherWriterTest, sameAsFastWriter);
 
     JSONTEST_REGISTER_FIXTURE(runner, ReaderTest, parseWithNoErrors);
     JSONTEST_REGISTER_FIXTURE(
@@ -2422,6 +4347,8 @@ int main(int argc, const char* argv[])
     JSONTEST_REGISTER_FIXTURE(runner, CharReaderTest, parseChineseWithOneError);
     JSONTEST_REGISTER_FIXTURE(runner, CharReaderTest, parseWithDetailError);
     JSONTEST_REGISTER_FIXTURE(runner, CharReaderTest, parseWithStackLimit);
+    JSONTEST_REGISTER_FIXTURE(runner, CharReaderTest, keepSource);
+    JSONTEST_REGISTER_FIXTURE(runner, CharReaderTest, dedupe);
 
     JSONTEST_REGISTER_FIXTURE(runner, CharReaderStrictModeTest, dupKeys);
 
@@ -2443,5 +4370,59 @@ int main(int argc, const char* argv[])
     JSONTEST_REGISTER_FIXTURE(runner, IteratorTest, names);
     JSONTEST_REGISTER_FIXTURE(runner, IteratorTest, indexes);
 
+    JSONTEST_REGISTER_FIXTURE(runner, TapeTest, parse);
+    JSONTEST_REGISTER_FIXTURE(runner, TapeTest, iterate);
+    JSONTEST_REGISTER_FIXTURE(runner, TapeTest, toValue);
+    JSONTEST_REGISTER_FIXTURE(runner, TapeTest, parseWithOneError);
+    JSONTEST_REGISTER_FIXTURE(runner, TapeTest, dupKeys);
+
+    JSONTEST_REGISTER_FIXTURE(runner, LazyTest, onDemand);
+    JSONTEST_REGISTER_FIXTURE(runner, LazyTest, iterate);
+    JSONTEST_REGISTER_FIXTURE(runner, LazyTest, toValue);
+    JSONTEST_REGISTER_FIXTURE(runner, LazyTest, deferredError);
+    JSONTEST_REGISTER_FIXTURE(runner, LazyTest, parseWithOneError);
+
+    JSONTEST_REGISTER_FIXTURE(runner, SimdEngineTest, sameAsClassic);
+    JSONTEST_REGISTER_FIXTURE(runner, SimdEngineTest, sameErrors);
+    JSONTEST_REGISTER_FIXTURE(runner, SimdEngineTest, stackLimit);
+    JSONTEST_REGISTER_FIXTURE(runner, SimdEngineTest, badEngine);
+
+    JSONTEST_REGISTER_FIXTURE(runner, ParallelReaderTest, sameAsSequential);
+    JSONTEST_REGISTER_FIXTURE(runner, ParallelReaderTest, errorOffsets);
+    JSONTEST_REGISTER_FIXTURE(runner, ParallelReaderTest, stackLimit);
+    JSONTEST_REGISTER_FIXTURE(runner, ParallelReaderTest, badThreads);
+    JSONTEST_REGISTER_FIXTURE(runner, CursorTest, events);
+    JSONTEST_REGISTER_FIXTURE(runner, CursorTest, skip);
+    JSONTEST_REGISTER_FIXTURE(runner, CursorTest, skipErrors);
+    JSONTEST_REGISTER_FIXTURE(runner, CursorTest, payload);
+    JSONTEST_REGISTER_FIXTURE(runner, CursorTest, payloadErrors);
+    JSONTEST_REGISTER_FIXTURE(runner, BindTest, roundTrip);
+    JSONTEST_REGISTER_FIXTURE(runner, BindTest, errors);
+    JSONTEST_REGISTER_FIXTURE(runner, BindTest, keyTable);
+    JSONTEST_REGISTER_FIXTURE(runner, EmitterTest, sameAsWriter);
+    JSONTEST_REGISTER_FIXTURE(runner, EmitterTest, pieces);
+    JSONTEST_REGISTER_FIXTURE(runner, EmitterTest, outOfOrder);
+
+    JSONTEST_REGISTER_FIXTURE(runner, CborTest, encode);
+    JSONTEST_REGISTER_FIXTURE(runner, CborTest, roundTrip);
+    JSONTEST_REGISTER_FIXTURE(runner, CborTest, decode);
+
+    JSONTEST_REGISTER_FIXTURE(runner, MsgpackTest, encode);
+    JSONTEST_REGISTER_FIXTURE(runner, MsgpackTest, roundTrip);
+    JSONTEST_REGISTER_FIXTURE(runner, MsgpackTest, stream);
+
+    JSONTEST_REGISTER_FIXTURE(runner, SnapshotTest, sameAsValue);
+    JSONTEST_REGISTER_FIXTURE(runner, SnapshotTest, reset);
+
+    JSONTEST_REGISTER_FIXTURE(runner, PathTest, find);
+    JSONTEST_REGISTER_FIXTURE(runner, PathTest, errors);
+    JSONTEST_REGISTER_FIXTURE(runner, ExtractorTest, dom);
+    JSONTEST_REGISTER_FIXTURE(runner, ExtractorTest, cursor);
+    JSONTEST_REGISTER_FIXTURE(runner, QueryTest, select);
+    JSONTEST_REGISTER_FIXTURE(runner, QueryTest, errors);
+    JSONTEST_REGISTER_FIXTURE(runner, PatchTest, apply);
+    JSONTEST_REGISTER_FIXTURE(runner, PatchTest, rollback);
+    JSONTEST_REGISTER_FIXTURE(runner, PatchTest, diff);
+
     return runner.runCommandLine(argc, argv);
 }
@@ -59,7 +59,7 @@ def safeReadFile(path):
 
 def runAllTests(jsontest_executable_path, input_dir = None,
                  use_valgrind=False, with_json_checker=False,
-                 writerClass='StyledWriter'):
+                 writerClass='styled_writer', engine=None):
     if not input_dir:
         input_dir = os.path.join(os.getcwd(), 'data')
     tests = glob(os.path.join(input_dir, '*.json'))
@@ -75,6 +75,8 @@ def runAllTests(jsontest_executable_path, input_dir = None,
         print('TESTING:', input_path, end=' ')
         options = is_json_checker_test and '--json-checker' or ''
         options += ' --json-writer %s'%writerClass
+        if engine:
+            options += ' --json-engine %s'%engine
         cmd = '%s%s %s "%s"' % (            valgrind_path, jsontest_executable_path, options,
             input_path)
         status, process_output = getStatusOutput(cmd)
@@ -134,6 +136,8 @@ def main():
     parser.add_option("-c", "--with-json-checker",
                   action="store_true", dest="with_json_checker", default=False,
                   help="run all the tests from the official JSONChecker test suite of json.org")
+    parser.add_option("--engine", dest="engine", default=None,
+                  help="parse with char_reader_builder and this engine (classic or simd) instead of the old reader")
     parser.enable_interspersed_args()
     options, args = parser.parse_args()
 
@@ -149,19 +153,22 @@ def main():
     status = runAllTests(jsontest_executable_path, input_path,
                          use_valgrind=options.valgrind,
                          with_json_checker=options.with_json_checker,
-                         writerClass='StyledWriter')
+                         writerClass='styled_writer',
+                         engine=options.engine)
     if status:
         sys.exit(status)
     status = runAllTests(jsontest_executable_path, input_path,
                          use_valgrind=options.valgrind,
                          with_json_checker=options.with_json_checker,
-                         writerClass='StyledStreamWriter')
+                         writerClass='styled_stream_writer',
+                         engine=options.engine)
     if status:
         sys.exit(status)
     status = runAllTests(jsontest_executable_path, input_path,
                          use_valgrind=options.valgrind,
                          with_json_checker=options.with_json_checker,
-                         writerClass='BuiltStyledStreamWriter')
+                         writerClass='built_styled_stream_writer',
+                         engine=options.engine)
     if status:
         sys.exit(status)
 